@@ -0,0 +1,104 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+// Rounding error of the accumulation of the image:
+//   accumulation [samples] [pixels]
+// adds up to 100M samples per pixel, 4 pixels by default, the way the
+// kernel accumulates them: a float sum, and a float sum compensated with
+// Kahan summation like --compensated. Samples are uniform radiance with
+// one firefly a thousand times brighter every thousand samples. At every
+// power of ten it prints the largest relative error of both sums against a
+// double precision reference, next to their worst case bounds: (n - 1) u
+// for the float sum and 2u + n u^2 for the compensated one, with the unit
+// roundoff u = 2^-24. Samples are positive, so the relative error of the sum
+// is the relative error of the pixel value.
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+/** Running sums of a pixel */
+struct Pixel {
+    float   naive = 0.0f;       //!< Float sum
+    float   kahan = 0.0f;       //!< Compensated float sum
+    float   error = 0.0f;       //!< Rounding error left out of the compensated sum
+    double  reference = 0.0;    //!< Double precision sum
+};
+
+/** Add a sample the way the kernel does, volatile keeps the compiler from simplifying the error to 0 */
+static void accumulate(Pixel& pixel, float sample) {
+    pixel.naive += sample;
+
+    volatile float y = sample - pixel.error;
+    volatile float sum = pixel.kahan + y;
+    pixel.error = (sum - pixel.kahan) - y;
+    pixel.kahan = sum;
+
+    pixel.reference += double(sample);
+}
+
+int main(int argc, char** argv) {
+    const uint64_t samples = argc > 1 ? std::max(std::strtoull(argv[1], nullptr, 10), 10ull) : 100000000ull;
+    const int count = std::max(argc > 2 ? std::atoi(argv[2]) : 4, 1);
+
+    const double u = std::ldexp(1.0, -24);
+    std::vector<Pixel> pixels(static_cast<size_t>(count));
+    uint32_t h = 1;
+    auto next = [&h]() {
+        // xorshift32
+        h ^= h << 13;
+        h ^= h >> 17;
+        h ^= h << 5;
+        return float(h & 0xFFFFFF) / float(0xFFFFFF);
+    };
+
+    std::cout << count << " pixels, relative error of the sum (worst case bound)" << std::endl;
+    std::cout << std::setw(10) << "samples" << std::setw(26) << "float" << std::setw(26) << "compensated" << std::endl;
+
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t report = 1000;
+    for (uint64_t n = 1; n <= samples; ++n) {
+        for (Pixel& pixel : pixels) {
+            const float firefly = next() < 0.001f ? 1000.0f : 1.0f;
+            accumulate(pixel, firefly * next());
+        }
+
+        if (n != report && n != samples) continue;
+        double naive = 0.0, kahan = 0.0;
+        for (const Pixel& pixel : pixels) {
+            naive = std::max(naive, std::abs(double(pixel.naive) - pixel.reference) / pixel.reference);
+            kahan = std::max(kahan, std::abs(double(pixel.kahan) - pixel.reference) / pixel.reference);
+        }
+
+        const double naiveBound = double(n - 1) * u;
+        const double kahanBound = 2.0 * u + double(n) * u * u;
+        std::cout << std::setw(10) << n << std::scientific << std::setprecision(2)
+            << std::setw(12) << naive << " (" << std::setw(9) << naiveBound << ")"
+            << std::setw(14) << kahan << " (" << std::setw(9) << kahanBound << ")"
+            << std::defaultfloat << std::endl;
+        report *= 10;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << seconds << " s" << std::endl;
+    return EXIT_SUCCESS;
+}
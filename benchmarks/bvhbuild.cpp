@@ -0,0 +1,233 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+// Build time and quality of the CPU bounding volume hierarchy:
+//   bvhbuild [primitives|rods|scene] [runs] [budget]
+// builds the tree of a cloud of random spheres, 1M by default, of a cloud
+// crossed by long rods, or of a built-in scene, with object splits only (SAH) and with spatial splits
+// under a duplication budget, 0.3 by default (SBVH). For each it prints the
+// best and mean build time, the node and reference counts, the depth, the
+// surface area heuristic cost and the traversal steps of primary rays: the
+// nodes visited and the primitives tested per ray, followed by the leaf
+// size histogram and the leaf depth distribution. Rays intersect spheres
+// exactly and other primitives by their bounds.
+
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+
+#include "../src/scene/Bvh.h"
+#include "../src/scene/Primitive.h"
+#include "../src/util/ThreadPool.h"
+
+/**
+ * Spheres of varied size scattered in a cube, the same cloud on every
+ * platform. Rods are long thin cylinders across the cube, whose bounds
+ * overlap most of the spheres.
+ */
+static std::vector<scene::Primitive> cloud(size_t count, size_t rods = 0) {
+    std::vector<scene::Primitive> primitives;
+    primitives.reserve(count + rods);
+
+    const float side = 2.0f * std::cbrt(float(count));
+    uint32_t h = 1;
+    auto next = [&h]() {
+        // xorshift32
+        h ^= h << 13;
+        h ^= h >> 17;
+        h ^= h << 5;
+        return float(h & 0xFFFFFF) / float(0xFFFFFF);
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3 center = side * (glm::vec3(next(), next(), next()) - 0.5f);
+        primitives.push_back(scene::makeSphere(uint32_t(i % 9), center, 0.1f + 0.9f * next()));
+    }
+
+    for (size_t i = 0; i < rods; ++i) {
+        const glm::vec3 center = 0.5f * side * (glm::vec3(next(), next(), next()) - 0.5f);
+        const glm::vec3 axis = glm::vec3(next(), next(), next()) - 0.5f;
+        primitives.push_back(scene::makeCylinder(uint32_t(i % 9), center, axis, 0.2f, 0.5f * side));
+    }
+    return primitives;
+}
+
+/** Nodes visited and primitives tested by some rays */
+struct Steps {
+    double nodes = 0.0;
+    double tests = 0.0;
+};
+
+/** Distance to the nearest hit of a ray with a box, or a miss */
+static bool hitBox(const scene::Aabb& box, const glm::vec3& origin, const glm::vec3& inverse, float tMax, float& t) {
+    const glm::vec3 t0 = (box.min - origin) * inverse;
+    const glm::vec3 t1 = (box.max - origin) * inverse;
+    const glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+    t = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    return t <= std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+}
+
+/** Distance to the nearest hit of a ray with a primitive, or a miss */
+static bool hitPrimitive(const scene::Primitive& primitive, const glm::vec3& origin, const glm::vec3& direction,
+        const glm::vec3& inverse, float tMax, float& t) {
+    if (primitive.type == scene::Primitive::SPHERE && primitive.velocity == glm::vec3(0.0f)) {
+        const glm::vec3 oc = origin - primitive.center;
+        const float b = glm::dot(oc, direction);
+        const float d = b * b - glm::dot(oc, oc) + primitive.radius * primitive.radius;
+        if (d < 0.0f) return false;
+        t = -b - std::sqrt(d);
+        if (t < 0.0f) t = -b + std::sqrt(d);
+        return t >= 0.0f && t < tMax;
+    }
+
+    scene::Aabb box;
+    return scene::primitiveBounds(primitive, 0.0f, box) && hitBox(box, origin, inverse, tMax, t) && t < tMax;
+}
+
+/**
+ * Trace primary rays through the tree the way the kernel does: nearest
+ * child first, skipping the children behind the closest hit
+ */
+static Steps traverse(const scene::Bvh& bvh, const std::vector<scene::Primitive>& primitives) {
+    static constexpr int SIZE = 256;
+
+    Steps steps;
+    const std::vector<scene::Bvh::Node>& nodes = bvh.getNodes();
+    if (nodes.empty()) return steps;
+
+    // Camera framing the bulk of the primitive centers, so a large ground doesn't shrink the rest to a few pixels
+    scene::Aabb bulk;
+    std::vector<float> centers[3];
+    for (const scene::Primitive& primitive : primitives) {
+        scene::Aabb box;
+        if (!scene::primitiveBounds(primitive, 0.0f, box)) continue;
+        for (int axis = 0; axis < 3; ++axis) centers[axis].push_back(primitive.center[axis]);
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        std::vector<float>& c = centers[axis];
+        std::nth_element(c.begin(), c.begin() + c.size() / 20, c.end());
+        bulk.min[axis] = c[c.size() / 20];
+        std::nth_element(c.begin(), c.begin() + c.size() - 1 - c.size() / 20, c.end());
+        bulk.max[axis] = c[c.size() - 1 - c.size() / 20];
+    }
+
+    const float radius = std::max(0.5f * glm::length(bulk.max - bulk.min), 1.0f);
+    const glm::vec3 forward = glm::normalize(glm::vec3(-0.6f, -0.4f, -0.7f));
+    const glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    const glm::vec3 up = glm::cross(right, forward);
+    const glm::vec3 origin = bulk.center() - 2.5f * radius * forward;
+    const float halfSize = 0.45f;
+
+    for (int y = 0; y < SIZE; ++y) {
+        for (int x = 0; x < SIZE; ++x) {
+            const glm::vec2 uv = (glm::vec2(x, y) + 0.5f) / float(SIZE) * 2.0f - 1.0f;
+            const glm::vec3 direction = glm::normalize(forward + halfSize * (uv.x * right + uv.y * up));
+            const glm::vec3 inverse = 1.0f / direction;
+
+            float tMax = std::numeric_limits<float>::max();
+            uint32_t stack[scene::Bvh::MAX_DEPTH];
+            uint32_t size = 0;
+            uint32_t current = 0;
+            float t;
+            if (!hitBox(nodes[0].bounds, origin, inverse, tMax, t)) continue;
+            for (;;) {
+                const scene::Bvh::Node& node = nodes[current];
+                steps.nodes += 1.0;
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                        steps.tests += 1.0;
+                        if (hitPrimitive(primitives[bvh.getIndices()[i]], origin, direction, inverse, tMax, t)) tMax = t;
+                    }
+                } else {
+                    float tLeft, tRight;
+                    const bool left = hitBox(nodes[node.first].bounds, origin, inverse, tMax, tLeft);
+                    const bool right = hitBox(nodes[node.first + 1].bounds, origin, inverse, tMax, tRight);
+                    if (left && right) {
+                        const bool leftFirst = tLeft <= tRight;
+                        stack[size++] = leftFirst ? node.first + 1 : node.first;
+                        current = leftFirst ? node.first : node.first + 1;
+                        continue;
+                    }
+                    if (left || right) {
+                        current = left ? node.first : node.first + 1;
+                        continue;
+                    }
+                }
+
+                // Pop the next node in front of the closest hit
+                bool found = false;
+                while (size > 0 && !found) {
+                    current = stack[--size];
+                    found = hitBox(nodes[current].bounds, origin, inverse, tMax, t);
+                }
+                if (!found) break;
+            }
+        }
+    }
+
+    steps.nodes /= double(SIZE * SIZE);
+    steps.tests /= double(SIZE * SIZE);
+    return steps;
+}
+
+int main(int argc, char** argv) {
+    const std::string what = argc > 1 ? argv[1] : "1000000";
+    const int runs = std::max(argc > 2 ? std::atoi(argv[2]) : 3, 1);
+    const float budget = argc > 3 ? float(std::atof(argv[3])) : 0.3f;
+
+    std::vector<scene::Primitive> primitives;
+    if (what.find_first_not_of("0123456789") == std::string::npos) {
+        primitives = cloud(std::stoul(what));
+    } else if (what == "rods") {
+        primitives = cloud(100000, 100);
+    } else {
+        primitives = scene::namedScene(what);
+        if (primitives.empty()) {
+            std::cerr << "bvhbuild: unknown scene '" << what << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << primitives.size() << " primitives, " << util::ThreadPool::instance().size() << " threads"
+        << std::endl;
+
+    for (const float duplication : { 0.0f, budget }) {
+        double best = 0.0, total = 0.0;
+        scene::Bvh bvh;
+        for (int run = 0; run < runs; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            bvh = scene::Bvh::build(primitives, 0.0f, duplication);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = run == 0 ? ms : std::min(best, ms);
+            total += ms;
+        }
+
+        const Steps steps = traverse(bvh, primitives);
+        std::cout << (duplication > 0.0f ? "SBVH, budget " + std::to_string(duplication) : std::string("SAH")) << std::endl;
+        std::cout << "  build: " << best << " ms best, " << total / runs << " ms mean of " << runs << std::endl;
+        std::cout << "  primary rays: " << steps.nodes << " nodes, " << steps.tests << " primitive tests per ray"
+            << std::endl;
+        bvh.report(std::cout);
+        if (budget <= 0.0f) break;
+    }
+    return EXIT_SUCCESS;
+}
@@ -20,13 +20,13 @@
 
 #include <glad/glad.h>
 
-#include "scene/OrbitCamera.h"
+#include "scene/ThinLensCamera.h"
 
 
 /**
  * Renderer interface.
  */
-class Renderer : public scene::OrbitCamera {
+class Renderer : public scene::ThinLensCamera {
 public:
 
     // Prevent unwanted constructions and destructions
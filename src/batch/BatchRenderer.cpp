@@ -0,0 +1,128 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <chrono>
+#include <iomanip>
+
+#include "../util/Memory.h"
+
+#include "BatchRenderer.h"
+
+namespace batch {
+
+    double JobStats::samplesPerSecond() const {
+        return seconds > 0.0 ? numSamples / seconds : 0.0;
+    }
+
+    double JobStats::pathsPerSecond() const {
+        return samplesPerSecond() * double(width) * double(height);
+    }
+
+    BatchRenderer::BatchRenderer(pathtracer::PathTracer& pathTracer)
+        : pathTracer(pathTracer) {
+
+    }
+
+    JobStats BatchRenderer::run(const Job& job) {
+        using Clock = std::chrono::steady_clock;
+
+        util::resetPeakMemory();
+        const Clock::time_point start = Clock::now();
+        auto elapsed = [&start]() { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+        // The job resolution is the image resolution
+        const GLsizei width = GLsizei(job.width);
+        const GLsizei height = GLsizei(job.height);
+        pathTracer.setSSAA(false);
+        pathTracer.setViewport(0, 0, width, height);
+        pathTracer.setPrimitives(scene::namedScene(job.scene));
+        pathTracer.setPerspective(glm::radians(job.fov), float(width) / float(height), 0.5f, 100.0f);
+
+        pathTracer.setLookAt(glm::vec3(job.lookAt[0], job.lookAt[1], job.lookAt[2]));
+        pathTracer.setTheta(glm::radians(job.theta));
+        pathTracer.setPhi(glm::radians(job.phi));
+        pathTracer.setDistance(job.distance);
+        pathTracer.setAperture(job.aperture);
+        pathTracer.setShutter(job.shutter);
+        if (job.focus > 0.0f) pathTracer.setFocusDistance(job.focus);
+        else if (!pathTracer.autofocus()) pathTracer.setFocusDistance(job.distance);
+        pathTracer.setMaxBounces(job.bounces);
+
+        GLuint layout = pathtracer::BVH_WIDE;
+        pathtracer::BvhBuffer::parseLayout(job.bvh, layout);
+        pathTracer.setBvhLayout(layout);
+        pathTracer.setSpatialSplits(job.sbvh);
+        pathTracer.setSamplesPerDispatch(job.dispatch);
+
+        GLuint format = pathtracer::PathTracer::ACCUMULATION_FLOAT;
+        pathtracer::PathTracer::parseAccumulationFormat(job.accumulation, format);
+        pathTracer.setAccumulationFormat(format);
+
+        GLuint filter = pathtracer::FILTER_BLACKMAN_HARRIS;
+        pathtracer::PathTracer::parseFilter(job.filter, filter);
+        pathTracer.setFilter(filter);
+        pathTracer.setSampleLimit(job.spp);
+        pathTracer.setActive(true);
+        pathTracer.restart();
+
+        for (;;) {
+            if (job.spp > 0 && pathTracer.getNumSamples() >= job.spp) break;
+            if (job.time > 0.0f && elapsed() >= job.time) break;
+
+            pathTracer.render();
+
+            // Dispatches return immediately, wait for them to honor the time budget
+            if (job.time > 0.0f) glFinish();
+        }
+
+        glFinish();
+
+        JobStats stats;
+        stats.output        = job.output;
+        stats.width         = job.width;
+        stats.height        = job.height;
+        stats.numSamples    = pathTracer.getNumSamples();
+        stats.seconds       = elapsed();
+        stats.peakMemory    = util::peakMemory();
+
+        // Encoded on the pool while the next job renders
+        pathTracer.exportImage(job.output);
+
+        return stats;
+    }
+
+    void BatchRenderer::finish() {
+        pathTracer.getExporter().finish();
+    }
+
+    void BatchRenderer::writeStatsHeader(std::ostream& out) {
+        out << "output,width,height,samples,seconds,samples_per_second,paths_per_second,peak_memory_mb"
+            << std::endl;
+    }
+
+    void BatchRenderer::writeStats(std::ostream& out, const JobStats& stats) {
+        out << stats.output << ','
+            << stats.width << ','
+            << stats.height << ','
+            << stats.numSamples << ','
+            << std::fixed << std::setprecision(3) << stats.seconds << ','
+            << stats.samplesPerSecond() << ','
+            << std::setprecision(0) << stats.pathsPerSecond() << ','
+            << std::setprecision(1) << stats.peakMemory / (1024.0 * 1024.0)
+            << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,87 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_BATCH_BATCHRENDERER_H_
+#define PATHTRACER_BATCH_BATCHRENDERER_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "../pathtracer/PathTracer.h"
+
+#include "Job.h"
+
+namespace batch {
+
+    /** What a job cost */
+    struct JobStats {
+        std::string     output;                 //!< Job output file
+        unsigned int    width           = 0;    //!< Image width
+        unsigned int    height          = 0;    //!< Image height
+        unsigned int    numSamples      = 0;    //!< Samples per pixel rendered
+        double          seconds         = 0.0;  //!< Wall time
+        size_t          peakMemory      = 0;    //!< Peak resident memory in bytes
+
+        /** Samples per pixel per second */
+        double samplesPerSecond() const;
+
+        /** Camera paths (pixel samples) per second */
+        double pathsPerSecond() const;
+    };
+
+    /**
+     * Renders a queue of jobs with an already initialized PathTracer, so the
+     * GL context and the compiled programs are shared by every job. Images
+     * are encoded on the thread pool while the next job renders.
+     */
+    class BatchRenderer {
+    public:
+
+        /**
+         * Constructor
+         * @param[in] pathTracer Initialized path tracer, its context must be current
+         */
+        explicit BatchRenderer(pathtracer::PathTracer& pathTracer);
+
+        /**
+         * Render a job and start exporting its image
+         * @param[in] job Job to render
+         * @return Job statistics, the export is not included
+         */
+        JobStats run(const Job& job);
+
+        /** Wait until every image has been written */
+        void finish();
+
+        /** Write the CSV header of writeStats() */
+        static void writeStatsHeader(std::ostream& out);
+
+        /**
+         * Write statistics as a CSV line
+         * @param[in] out       Output stream
+         * @param[in] stats     Statistics of one job
+         */
+        static void writeStats(std::ostream& out, const JobStats& stats);
+
+    private:
+
+        pathtracer::PathTracer& pathTracer;  //!< Renderer shared by every job
+    };
+}
+
+#endif //PATHTRACER_BATCH_BATCHRENDERER_H_
@@ -0,0 +1,152 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <sstream>
+
+#include "../scene/Primitive.h"
+#include "../pathtracer/BvhBuffer.h"
+#include "../pathtracer/PathTracer.h"
+
+#include "Job.h"
+
+namespace batch {
+
+    /** Parse a whole string as an unsigned integer */
+    static bool parseUnsigned(const std::string& str, unsigned int& value) {
+        if (str.empty() || str[0] == '-') return false;
+        try {
+            size_t end;
+            unsigned long v = std::stoul(str, &end);
+            value = static_cast<unsigned int>(v);
+            return end == str.size() && v == value;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    /** Parse a whole string as a float */
+    static bool parseFloat(const std::string& str, float& value) {
+        try {
+            size_t end;
+            value = std::stof(str, &end);
+            return end == str.size();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    /** Parse one key=value pair into job, false if the key or value is invalid */
+    static bool parseOption(const std::string& key, const std::string& value, Job& job) {
+        if (key == "scene")     { job.scene = value; return true; }
+        if (key == "output")    { job.output = value; return !value.empty(); }
+        if (key == "width")     return parseUnsigned(value, job.width);
+        if (key == "height")    return parseUnsigned(value, job.height);
+        if (key == "spp")       return parseUnsigned(value, job.spp);
+        if (key == "time")      return parseFloat(value, job.time);
+        if (key == "bounces")   return parseUnsigned(value, job.bounces);
+        if (key == "fov")       return parseFloat(value, job.fov);
+        if (key == "theta")     return parseFloat(value, job.theta);
+        if (key == "phi")       return parseFloat(value, job.phi);
+        if (key == "distance")  return parseFloat(value, job.distance);
+        if (key == "aperture")  return parseFloat(value, job.aperture) && job.aperture >= 0.0f;
+        if (key == "shutter")   return parseFloat(value, job.shutter) && job.shutter >= 0.0f;
+        if (key == "sbvh")      return parseFloat(value, job.sbvh) && job.sbvh >= 0.0f;
+        if (key == "dispatch")  return parseUnsigned(value, job.dispatch) && job.dispatch > 0;
+        if (key == "bvh") {
+            GLuint layout;
+            job.bvh = value;
+            return pathtracer::BvhBuffer::parseLayout(value, layout);
+        }
+        if (key == "accumulation") {
+            GLuint format;
+            job.accumulation = value;
+            return pathtracer::PathTracer::parseAccumulationFormat(value, format);
+        }
+        if (key == "filter") {
+            GLuint filter;
+            job.filter = value;
+            return pathtracer::PathTracer::parseFilter(value, filter);
+        }
+        if (key == "focus") {
+            if (value == "auto") { job.focus = 0.0f; return true; }
+            return parseFloat(value, job.focus) && job.focus > 0.0f;
+        }
+        if (key == "lookat") {
+            std::istringstream stream(value);
+            std::string component;
+            for (int i = 0; i < 3; ++i) {
+                if (!std::getline(stream, component, ',') || !parseFloat(component, job.lookAt[i]))
+                    return false;
+            }
+            return stream.peek() == std::char_traits<char>::eof();
+        }
+        return false;
+    }
+
+    /** Check values that are valid one by one but not together */
+    static std::string validate(const Job& job) {
+        if (job.output.empty()) return "missing output";
+        if (job.width == 0 || job.height == 0) return "empty image";
+        if (job.spp == 0 && job.time <= 0.0f) return "needs spp or time";
+        if (job.bounces == 0) return "needs at least one bounce";
+        if (job.fov <= 0.0f || job.fov >= 180.0f) return "fov must be in (0, 180)";
+
+        for (const std::string& scene : scene::sceneNames())
+            if (job.scene == scene) return "";
+        return "unknown scene '" + job.scene + "'";
+    }
+
+    std::vector<Job> readJobs(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) throw JobError("can't open " + path);
+
+        std::vector<Job> jobs;
+        std::string line;
+        for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+            const std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+
+            // Strip comments
+            size_t comment = line.find('#');
+            if (comment != std::string::npos) line.erase(comment);
+
+            Job job;
+            bool empty = true;
+            std::istringstream stream(line);
+            std::string token;
+            while (stream >> token) {
+                size_t equal = token.find('=');
+                if (equal == std::string::npos)
+                    throw JobError(where + "expected key=value, found '" + token + "'");
+
+                if (!parseOption(token.substr(0, equal), token.substr(equal + 1), job))
+                    throw JobError(where + "invalid option '" + token + "'");
+                empty = false;
+            }
+
+            if (empty) continue;
+
+            std::string error = validate(job);
+            if (!error.empty()) throw JobError(where + error);
+
+            jobs.push_back(job);
+        }
+
+        if (file.bad()) throw JobError("error reading " + path);
+        return jobs;
+    }
+}
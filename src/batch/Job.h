@@ -0,0 +1,80 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_BATCH_JOB_H_
+#define PATHTRACER_BATCH_JOB_H_
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace batch {
+
+    /**
+     * @brief Thrown when a job file can't be read or has invalid jobs
+     */
+    class JobError : public std::runtime_error {
+    public:
+        explicit JobError(const std::string& msg) : std::runtime_error(msg) {  }
+    };
+
+    /**
+     * A render of the batch queue. It stops after spp samples or time
+     * seconds, whichever comes first, at least one of them must be set.
+     */
+    struct Job {
+        std::string     scene       = "default";    //!< Built-in scene, see scene::sceneNames()
+        std::string     output;                     //!< Image file: .exr, .pfm or .png
+        unsigned int    width       = 720;          //!< Image width
+        unsigned int    height      = 720;          //!< Image height
+        unsigned int    spp         = 0;            //!< Samples per pixel, 0 = no limit
+        float           time        = 0.0f;         //!< Time budget in seconds, 0 = no limit
+        unsigned int    bounces     = 10;           //!< Max number of ray bounces
+        float           fov         = 90.0f;        //!< Vertical field of view in degrees
+        float           lookAt[3]   = { 0.0f, 0.0f, 0.0f }; //!< Camera lookAt position
+        float           theta       = 0.0f;         //!< Camera Y axis orbit angle in degrees
+        float           phi         = 0.0f;         //!< Camera X axis orbit angle in degrees
+        float           distance    = 5.0f;         //!< Camera distance
+        float           aperture    = 0.0f;         //!< Lens diameter, 0 = pinhole
+        float           focus       = 0.0f;         //!< Focus distance, 0 = autofocus
+        float           shutter     = 0.0f;         //!< Shutter time, 0 = no motion blur
+        std::string     bvh         = "wide";       //!< Bounding volume hierarchy: linear, binary or wide
+        float           sbvh        = 0.3f;         //!< Spatial split reference budget of the hierarchy, 0 = none
+        unsigned int    dispatch    = 8;            //!< Samples per pixel of every kernel launch
+        std::string     accumulation = "float";     //!< Image accumulation: float, half or rgb9e5
+        std::string     filter      = "blackman-harris";    //!< Reconstruction filter: none, box, gaussian, blackman-harris or mitchell
+    };
+
+    /**
+     * Read a job file. Every non empty line is a job made of key=value
+     * pairs separated by spaces, '#' starts a comment:
+     *
+     *     # scene is a built-in scene, see scene::sceneNames()
+     *     output=front.exr width=1280 height=720 spp=1024
+     *     output=side.png theta=90 phi=20 distance=6 lookat=0,0.5,0 time=30
+     *
+     * Keys: scene, output, width, height, spp, time, bounces, fov, lookat,
+     * theta, phi, distance, aperture, focus, shutter, bvh, sbvh, dispatch,
+     * accumulation and filter, see Job.
+     * @param[in] path Job file path
+     * @return Jobs in file order
+     * @throws JobError if the file can't be read or a line is invalid
+     */
+    std::vector<Job> readJobs(const std::string& path);
+}
+
+#endif //PATHTRACER_BATCH_JOB_H_
@@ -0,0 +1,175 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <set>
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+#include "../io/Image.h"
+#include "../io/ImageIO.h"
+#include "../util/ThreadPool.h"
+
+#include "Coordinator.h"
+
+namespace farm {
+
+    static const std::string PREFIX     = "worker-";
+    static const std::string EXTENSION  = ".ckpt";
+
+    std::string workerFile(const std::string& directory, unsigned int index) {
+        return (std::filesystem::path(directory) / (PREFIX + std::to_string(index) + EXTENSION)).string();
+    }
+
+    /** Settings of a partial result, for error messages */
+    static std::string describe(const io::Checkpoint& checkpoint) {
+        char hash[32];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(checkpoint.sceneHash));
+        return std::to_string(checkpoint.width) + "x" + std::to_string(checkpoint.height) + ", scene " + hash +
+            ", worker " + std::to_string(checkpoint.sampleOffset) + " of " + std::to_string(checkpoint.sampleStride);
+    }
+
+    Coordinator::Coordinator(const std::string& directory, const std::string& output)
+        : directory(directory)
+        , output(output)
+        , partials()
+        , numMerged(0) {
+
+    }
+
+    void Coordinator::update() {
+        std::set<std::string> found;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            const std::string name = entry.path().filename().string();
+
+            // Temporary files end with ".ckpt.tmp" and are skipped here
+            if (name.size() <= PREFIX.size() + EXTENSION.size() ||
+                    name.compare(0, PREFIX.size(), PREFIX) != 0 ||
+                    name.compare(name.size() - EXTENSION.size(), EXTENSION.size(), EXTENSION) != 0)
+                continue;
+
+            const std::string file = entry.path().string();
+            found.insert(file);
+
+            std::error_code timeError;
+            auto time = entry.last_write_time(timeError);
+            if (timeError) continue;
+
+            auto it = partials.find(file);
+            if (it != partials.end() && it->second.time == time) continue;
+
+            // Workers replace their file with a rename, it is never half written
+            try {
+                partials[file] = { time, io::readCheckpoint(file) };
+            } catch (const io::CheckpointError& e) {
+                std::cerr << "merge: " << e.what() << std::endl;
+            }
+        }
+
+        if (error) {
+            std::cerr << "merge: can't read " << directory << ": " << error.message() << std::endl;
+            return;
+        }
+
+        // Forget the partials whose files were removed
+        for (auto it = partials.begin(); it != partials.end();) {
+            if (found.count(it->first) == 0) it = partials.erase(it);
+            else ++it;
+        }
+    }
+
+    uint64_t Coordinator::merge() {
+        update();
+        numMerged = 0;
+        if (partials.empty()) return 0;
+
+        // Every worker must have rendered the same scene, camera and resolution
+        // with the same worker count. A partial that differs is stale or
+        // misconfigured, merging without it would silently drop samples.
+        const io::Checkpoint& reference = partials.begin()->second.checkpoint;
+        bool consistent = true;
+        for (const auto& partial : partials) {
+            const io::Checkpoint& checkpoint = partial.second.checkpoint;
+            consistent = consistent && checkpoint.width == reference.width &&
+                checkpoint.height == reference.height && checkpoint.sceneHash == reference.sceneHash &&
+                checkpoint.sampleStride == reference.sampleStride;
+        }
+
+        if (!consistent) {
+            std::string files;
+            for (const auto& partial : partials) files += "\n  " + partial.first + ": " + describe(partial.second.checkpoint);
+            throw MergeError("every worker must render the same scene, camera, resolution and worker count:" + files);
+        }
+
+        // Streams are disjoint only with distinct offsets below the stride,
+        // the samples of two workers with the same index would count twice
+        std::map<uint32_t, std::string> streams;
+        for (const auto& partial : partials) {
+            const io::Checkpoint& checkpoint = partial.second.checkpoint;
+            if (checkpoint.sampleOffset >= checkpoint.sampleStride)
+                throw MergeError(partial.first + ": invalid sample stream, " + describe(checkpoint));
+
+            auto inserted = streams.emplace(checkpoint.sampleOffset, partial.first);
+            if (!inserted.second)
+                throw MergeError(partial.first + " and " + inserted.first->second +
+                    " rendered the same samples, worker " + std::to_string(checkpoint.sampleOffset));
+        }
+
+        std::vector<const io::Checkpoint*> merged;
+        uint64_t numSamples = 0;
+
+        for (const auto& partial : partials) {
+            merged.push_back(&partial.second.checkpoint);
+            numSamples += partial.second.checkpoint.numSamples;
+        }
+
+        numMerged = merged.size();
+        if (numSamples == 0) return 0;
+
+        // Sum of the sums over sum of the counts, rows in parallel
+        io::Image image(int(reference.width), int(reference.height), { "R", "G", "B" });
+        const size_t rowFloats = size_t(reference.width) * 3;
+        const double scale = 1.0 / double(numSamples);
+
+        util::ThreadPool::instance().parallelFor(0, reference.height, 16,
+            [&](size_t first, size_t last) {
+                for (size_t i = first * rowFloats; i < last * rowFloats; ++i) {
+                    double sum = 0.0;
+                    for (const io::Checkpoint* checkpoint : merged) sum += checkpoint->sums[i];
+                    image.data()[i] = float(sum * scale);
+                }
+            });
+
+        io::writeImage(output, image);
+        return numSamples;
+    }
+
+    void Coordinator::run(uint64_t targetSamples, float interval) {
+        for (;;) {
+            uint64_t numSamples = merge();
+            std::cout << "merge: " << numSamples << " samples from " << numMerged
+                << " worker(s)" << std::endl;
+
+            if (targetSamples == 0 || numSamples >= targetSamples) break;
+
+            std::this_thread::sleep_for(std::chrono::duration<float>(interval));
+        }
+    }
+}
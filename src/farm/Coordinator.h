@@ -0,0 +1,102 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_FARM_COORDINATOR_H_
+#define PATHTRACER_FARM_COORDINATOR_H_
+
+#include <map>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <filesystem>
+
+#include "../io/Checkpoint.h"
+
+namespace farm {
+
+    /**
+     * @brief Thrown when the workers' partial results can't be merged
+     */
+    class MergeError : public std::runtime_error {
+    public:
+        explicit MergeError(const std::string& msg) : std::runtime_error(msg) {  }
+    };
+
+    /**
+     * Get the file where a worker keeps its partial result. Workers write
+     * io::Checkpoint files atomically, so the coordinator never reads a
+     * partially written one.
+     * @param[in] directory Shared directory
+     * @param[in] index     Worker index
+     */
+    std::string workerFile(const std::string& directory, unsigned int index);
+
+    /**
+     * Merges the partial results that render workers leave in a shared
+     * directory. Every worker renders a disjoint subset of the sample
+     * sequence (see PathTracer::setSampleStream), so the merged image is
+     * the sum of every worker sums divided by the total amount of samples.
+     * Workers never talk to each other, the render scales with their count.
+     */
+    class Coordinator {
+    public:
+
+        /**
+         * Constructor
+         * @param[in] directory Shared directory workers write to
+         * @param[in] output    Merged image: .exr, .pfm or .png
+         */
+        Coordinator(const std::string& directory, const std::string& output);
+
+        /**
+         * Read new partial results and write the merged image
+         * @return Merged samples per pixel
+         * @throws MergeError if the partials weren't all rendered with the same
+         *         scene, camera, resolution and worker count, or two of them
+         *         rendered the same sample stream
+         * @throws io::ImageIOError if the image can't be written
+         */
+        uint64_t merge();
+
+        /**
+         * Merge periodically until the workers reached the target
+         * @param[in] targetSamples Samples per pixel to wait for, 0 merges once
+         * @param[in] interval      Seconds between merges
+         * @throws MergeError if the partials disagree
+         * @throws io::ImageIOError if the image can't be written
+         */
+        void run(uint64_t targetSamples, float interval);
+
+    private:
+
+        /** Worker result and the modification time it was read at */
+        struct Partial {
+            std::filesystem::file_time_type time;
+            io::Checkpoint                  checkpoint;
+        };
+
+        /** Reload worker files changed since the last merge, forget the removed ones */
+        void update();
+
+        std::string                     directory;  //!< Shared directory
+        std::string                     output;     //!< Merged image path
+        std::map<std::string, Partial>  partials;   //!< Worker results by file
+        size_t                          numMerged;  //!< Workers in the last merge
+    };
+}
+
+#endif //PATHTRACER_FARM_COORDINATOR_H_
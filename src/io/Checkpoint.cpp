@@ -0,0 +1,157 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Checkpoint.h"
+
+namespace io {
+
+    static const char      MAGIC[4]    = { 'P', 'T', 'C', 'K' };
+    static const uint32_t  VERSION     = 2;
+
+    /** On disk header, every field little endian */
+    struct Header {
+        char        magic[4];
+        uint32_t    version;
+        uint32_t    width;
+        uint32_t    height;
+        uint32_t    numSamples;
+        uint32_t    sampleSequence;
+        uint32_t    sampleOffset;
+        uint32_t    sampleStride;
+        uint64_t    sceneHash;
+        float       camera[6];  // lookAt, theta, phi, distance
+    };
+
+    // Every field is naturally aligned, no compiler adds padding
+    static_assert(sizeof(Header) == 64, "unexpected checkpoint header layout");
+
+    /** Raw floats are written as they are in memory */
+    static void checkLittleEndian() {
+        const uint16_t probe = 1;
+        if (*reinterpret_cast<const uint8_t*>(&probe) != 1)
+            throw CheckpointError("checkpoints require a little endian host");
+    }
+
+    /** Flush stdio and OS buffers to disk */
+    static bool syncFile(FILE* file) {
+        if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    void writeCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+        checkLittleEndian();
+
+        const size_t numFloats = size_t(checkpoint.width) * checkpoint.height * 3;
+        if (checkpoint.sums.size() != numFloats)
+            throw CheckpointError(path + ": sums don't match checkpoint size");
+
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version          = VERSION;
+        header.width            = checkpoint.width;
+        header.height           = checkpoint.height;
+        header.numSamples       = checkpoint.numSamples;
+        header.sampleSequence   = checkpoint.sampleSequence;
+        header.sampleOffset     = checkpoint.sampleOffset;
+        header.sampleStride     = checkpoint.sampleStride;
+        header.sceneHash        = checkpoint.sceneHash;
+        header.camera[0]        = checkpoint.lookAt[0];
+        header.camera[1]        = checkpoint.lookAt[1];
+        header.camera[2]        = checkpoint.lookAt[2];
+        header.camera[3]        = checkpoint.theta;
+        header.camera[4]        = checkpoint.phi;
+        header.camera[5]        = checkpoint.distance;
+
+        // Write everything to a temporary file first
+        const std::string tmpPath = path + ".tmp";
+        FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (!file) throw CheckpointError("can't open " + tmpPath + " for writing");
+
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(checkpoint.sums.data(), sizeof(float), numFloats, file) == numFloats &&
+                  syncFile(file);
+        ok = (std::fclose(file) == 0) && ok;
+
+        if (!ok) {
+            std::remove(tmpPath.c_str());
+            throw CheckpointError("error writing " + tmpPath);
+        }
+
+        // Atomically replace the previous checkpoint
+        std::error_code error;
+        std::filesystem::rename(tmpPath, path, error);
+        if (error) throw CheckpointError("can't rename " + tmpPath + ": " + error.message());
+    }
+
+    Checkpoint readCheckpoint(const std::string& path) {
+        checkLittleEndian();
+
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) throw CheckpointError("can't open " + path);
+
+        Header header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+                std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+                header.version != VERSION) {
+            std::fclose(file);
+            throw CheckpointError(path + ": not a version " + std::to_string(VERSION) + " checkpoint");
+        }
+
+        Checkpoint checkpoint;
+        checkpoint.width            = header.width;
+        checkpoint.height           = header.height;
+        checkpoint.numSamples       = header.numSamples;
+        checkpoint.sampleSequence   = header.sampleSequence;
+        checkpoint.sampleOffset     = header.sampleOffset;
+        checkpoint.sampleStride     = header.sampleStride;
+        checkpoint.sceneHash        = header.sceneHash;
+        checkpoint.lookAt[0]        = header.camera[0];
+        checkpoint.lookAt[1]        = header.camera[1];
+        checkpoint.lookAt[2]        = header.camera[2];
+        checkpoint.theta            = header.camera[3];
+        checkpoint.phi              = header.camera[4];
+        checkpoint.distance         = header.camera[5];
+
+        const size_t numFloats = size_t(header.width) * header.height * 3;
+        checkpoint.sums.resize(numFloats);
+
+        bool ok = std::fread(checkpoint.sums.data(), sizeof(float), numFloats, file) == numFloats;
+        std::fclose(file);
+
+        if (!ok) throw CheckpointError(path + ": truncated checkpoint");
+        return checkpoint;
+    }
+
+    void checkSceneHash(const std::string& path, const Checkpoint& checkpoint, uint64_t sceneHash) {
+        if (checkpoint.sceneHash != sceneHash)
+            throw CheckpointError(path + ": checkpoint was rendered with a different scene");
+    }
+}
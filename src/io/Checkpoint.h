@@ -0,0 +1,86 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_IO_CHECKPOINT_H_
+#define PATHTRACER_IO_CHECKPOINT_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+namespace io {
+
+    /**
+     * @brief Thrown when a checkpoint can't be read or written
+     */
+    class CheckpointError : public std::runtime_error {
+    public:
+        explicit CheckpointError(const std::string& msg) : std::runtime_error(msg) {  }
+    };
+
+    /**
+     * Accumulation state needed to continue a render exactly where it stopped.
+     * The file is a small fixed header followed by the RGB sample sums as
+     * little endian floats, rows bottom to top.
+     */
+    struct Checkpoint {
+        uint32_t    width           = 0;    //!< Accumulation texture width
+        uint32_t    height          = 0;    //!< Accumulation texture height
+        uint32_t    numSamples      = 0;    //!< Samples accumulated per pixel
+        uint32_t    sampleSequence  = 0;    //!< Next sample index of the RNG sequence
+        uint32_t    sampleOffset    = 0;    //!< First index of the sample stream
+        uint32_t    sampleStride    = 1;    //!< Distance between indices of the sample stream
+        uint64_t    sceneHash       = 0;    //!< Hash of scene, camera and settings
+
+        float       lookAt[3]       = { 0.0f, 0.0f, 0.0f };    //!< Camera lookAt position
+        float       theta           = 0.0f;                     //!< Camera Y axis orbit angle
+        float       phi             = 0.0f;                     //!< Camera X axis orbit angle
+        float       distance        = 0.0f;                     //!< Camera distance
+
+        std::vector<float> sums;            //!< RGB sample sums, width * height * 3
+    };
+
+    /**
+     * Write a checkpoint atomically: data goes to "path.tmp", which is flushed
+     * to disk and then renamed over path. A crash leaves either the old or the
+     * new checkpoint, never a truncated one.
+     * @param[in] path          Checkpoint file path
+     * @param[in] checkpoint    State to write
+     * @throws CheckpointError on failure
+     */
+    void writeCheckpoint(const std::string& path, const Checkpoint& checkpoint);
+
+    /**
+     * Read a checkpoint
+     * @param[in] path Checkpoint file path
+     * @return The stored state
+     * @throws CheckpointError if the file is missing, truncated or not a checkpoint
+     */
+    Checkpoint readCheckpoint(const std::string& path);
+
+    /**
+     * Check a checkpoint was rendered with the current scene and settings
+     * @param[in] path          Checkpoint file path, for the error message
+     * @param[in] checkpoint    Stored state
+     * @param[in] sceneHash     Hash of the current scene, camera and settings
+     * @throws CheckpointError if the hashes differ
+     */
+    void checkSceneHash(const std::string& path, const Checkpoint& checkpoint, uint64_t sceneHash);
+}
+
+#endif //PATHTRACER_IO_CHECKPOINT_H_
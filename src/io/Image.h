@@ -0,0 +1,98 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_IO_IMAGE_H_
+#define PATHTRACER_IO_IMAGE_H_
+
+#include <string>
+#include <vector>
+
+namespace io {
+
+    /**
+     * Floating point image with an arbitrary list of named channels.
+     * Channels are interleaved per pixel and rows are stored bottom to top,
+     * which is the OpenGL texture layout. Layered channels (AOVs) use the
+     * OpenEXR naming convention: "layer.R", "layer.G", ...
+     */
+    class Image {
+    public:
+
+        /** Empty image */
+        Image() : _width(0), _height(0), _channels(), _pixels() {  }
+
+        /**
+         * Construct an image filled with zeros
+         * @param[in] width     Image width in pixels
+         * @param[in] height    Image height in pixels
+         * @param[in] channels  Channel names
+         */
+        Image(int width, int height, const std::vector<std::string>& channels)
+            : _width(width)
+            , _height(height)
+            , _channels(channels)
+            , _pixels(size_t(width) * size_t(height) * channels.size(), 0.0f) {  }
+
+        /** Get image width */
+        int width() const { return _width; }
+
+        /** Get image height */
+        int height() const { return _height; }
+
+        /** Get number of channels per pixel */
+        int numChannels() const { return int(_channels.size()); }
+
+        /** Get channel names */
+        const std::vector<std::string>& channels() const { return _channels; }
+
+        /**
+         * Find a channel by name
+         * @param[in] name Channel name
+         * @return Channel index or -1 if the image has no such channel
+         */
+        int channelIndex(const std::string& name) const {
+            for (size_t i = 0; i < _channels.size(); ++i)
+                if (_channels[i] == name) return int(i);
+            return -1;
+        }
+
+        /** Get pointer to first channel of pixel (x, y) */
+        ///@{
+        float* pixel(int x, int y) {
+            return &_pixels[(size_t(y) * size_t(_width) + size_t(x)) * _channels.size()];
+        }
+        const float* pixel(int x, int y) const {
+            return &_pixels[(size_t(y) * size_t(_width) + size_t(x)) * _channels.size()];
+        }
+        ///@}
+
+        /** Get raw interleaved pixel data */
+        ///@{
+        float* data() { return _pixels.data(); }
+        const float* data() const { return _pixels.data(); }
+        ///@}
+
+    private:
+
+        int                         _width;     //!< Width in pixels
+        int                         _height;    //!< Height in pixels
+        std::vector<std::string>    _channels;  //!< Channel names
+        std::vector<float>          _pixels;    //!< Interleaved pixel data
+    };
+}
+
+#endif //PATHTRACER_IO_IMAGE_H_
@@ -0,0 +1,338 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include "../util/ThreadPool.h"
+
+#include "ImageIO.h"
+
+namespace io {
+
+    /** Little endian binary serialization helpers */
+    ///@{
+    static void putU8(std::vector<uint8_t>& out, uint8_t v) {
+        out.push_back(v);
+    }
+
+    static void putU16(std::vector<uint8_t>& out, uint16_t v) {
+        out.push_back(uint8_t(v));
+        out.push_back(uint8_t(v >> 8));
+    }
+
+    static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back(uint8_t(v >> (8 * i)));
+    }
+
+    static void putU64(std::vector<uint8_t>& out, uint64_t v) {
+        for (int i = 0; i < 8; ++i) out.push_back(uint8_t(v >> (8 * i)));
+    }
+
+    static void putF32(std::vector<uint8_t>& out, float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        putU32(out, bits);
+    }
+
+    static void putString(std::vector<uint8_t>& out, const std::string& str) {
+        out.insert(out.end(), str.begin(), str.end());
+        out.push_back(0);
+    }
+    ///@}
+
+    /** Write a whole buffer to disk */
+    static void writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) throw ImageIOError("can't open " + path + " for writing");
+
+        file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+        if (!file) throw ImageIOError("error writing " + path);
+    }
+
+    /** Find R, G and B channel indices or throw */
+    static glm::ivec3 rgbChannels(const Image& image, const std::string& path) {
+        glm::ivec3 rgb(image.channelIndex("R"), image.channelIndex("G"), image.channelIndex("B"));
+        if (rgb.r < 0 || rgb.g < 0 || rgb.b < 0)
+            throw ImageIOError(path + ": image has no R, G and B channels");
+        return rgb;
+    }
+
+    void writePFM(const std::string& path, const Image& image) {
+        glm::ivec3 rgb = rgbChannels(image, path);
+
+        // Negative scale means little endian
+        std::string header = "PF\n" + std::to_string(image.width()) + " " +
+            std::to_string(image.height()) + "\n-1.0\n";
+
+        std::vector<uint8_t> bytes(header.begin(), header.end());
+        bytes.reserve(bytes.size() + size_t(image.width()) * image.height() * 12);
+
+        // PFM scanlines go bottom to top, just like our images
+        for (int y = 0; y < image.height(); ++y) {
+            for (int x = 0; x < image.width(); ++x) {
+                const float* p = image.pixel(x, y);
+                putF32(bytes, p[rgb.r]);
+                putF32(bytes, p[rgb.g]);
+                putF32(bytes, p[rgb.b]);
+            }
+        }
+
+        writeFile(path, bytes);
+    }
+
+    void writePNG(const std::string& path, const Image& image) {
+        glm::ivec3 rgb = rgbChannels(image, path);
+        const int w = image.width();
+        const int h = image.height();
+
+        std::vector<uint8_t> pixels(size_t(w) * size_t(h) * 3);
+
+        util::ThreadPool::instance().parallelFor(0, size_t(h), 64, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; ++y) {
+                // PNG rows go top to bottom
+                uint8_t* row = &pixels[(size_t(h) - 1 - y) * size_t(w) * 3];
+                for (int x = 0; x < w; ++x) {
+                    const float* p = image.pixel(x, int(y));
+                    for (int c = 0; c < 3; ++c) {
+                        float v = std::sqrt(glm::clamp(p[rgb[c]], 0.0f, 1.0f)); // Gamma correction
+                        row[x * 3 + c] = uint8_t(v * 255.0f + 0.5f);
+                    }
+                }
+            }
+        });
+
+        if (!stbi_write_png(path.c_str(), w, h, 3, pixels.data(), w * 3))
+            throw ImageIOError("error writing " + path);
+    }
+
+    /**
+     * OpenEXR byte reordering and delta predictor shared by RLE and ZIP.
+     * @see OpenEXR ImfZip.cpp
+     */
+    static std::vector<uint8_t> exrPredict(const std::vector<uint8_t>& raw) {
+        std::vector<uint8_t> tmp(raw.size());
+
+        // Split even and odd bytes
+        size_t t1 = 0;
+        size_t t2 = (raw.size() + 1) / 2;
+        for (size_t i = 0; i < raw.size(); ++i)
+            tmp[(i & 1) ? t2++ : t1++] = raw[i];
+
+        // Store differences between consecutive bytes
+        for (size_t i = tmp.size() - 1; i > 0; --i)
+            tmp[i] = uint8_t(int(tmp[i]) - int(tmp[i - 1]) + 128);
+
+        return tmp;
+    }
+
+    /**
+     * OpenEXR run length encoding
+     * @see OpenEXR ImfRle.cpp
+     */
+    static std::vector<uint8_t> exrRunLength(const std::vector<uint8_t>& in) {
+        const size_t MIN_RUN = 3;
+        const size_t MAX_RUN = 127;
+
+        std::vector<uint8_t> out;
+        out.reserve(in.size());
+
+        size_t start = 0;
+        size_t end = 1;
+        while (start < in.size()) {
+            while (end < in.size() && in[start] == in[end] && end - start - 1 < MAX_RUN)
+                ++end;
+
+            if (end - start >= MIN_RUN) {
+                // Repeated byte
+                out.push_back(uint8_t(end - start - 1));
+                out.push_back(in[start]);
+                start = end;
+            } else {
+                // Literal bytes until the next run of three
+                while (end < in.size() &&
+                        ((end + 1 >= in.size() || in[end] != in[end + 1]) ||
+                         (end + 2 >= in.size() || in[end + 1] != in[end + 2])) &&
+                        end - start < MAX_RUN)
+                    ++end;
+
+                out.push_back(uint8_t(-int(end - start)));
+                out.insert(out.end(), in.begin() + start, in.begin() + end);
+                start = end;
+            }
+            ++end;
+        }
+
+        return out;
+    }
+
+    /** Compress one scanline block, returns raw data when it doesn't pay off */
+    static std::vector<uint8_t> exrCompress(const std::vector<uint8_t>& raw, ExrCompression compression) {
+        std::vector<uint8_t> packed;
+
+        switch (compression) {
+            case ExrCompression::RLE:
+                packed = exrRunLength(exrPredict(raw));
+                break;
+            case ExrCompression::ZIPS:
+            case ExrCompression::ZIP: {
+                std::vector<uint8_t> predicted = exrPredict(raw);
+                int len = 0;
+                unsigned char* zlib = stbi_zlib_compress(predicted.data(), int(predicted.size()), &len, 8);
+                if (!zlib) throw ImageIOError("zlib compression failed");
+                packed.assign(zlib, zlib + len);
+                STBIW_FREE(zlib);
+                break;
+            }
+            default:
+                return raw;
+        }
+
+        return packed.size() < raw.size() ? packed : raw;
+    }
+
+    void writeEXR(const std::string& path, const Image& image, const ExrOptions& options) {
+        const int w = image.width();
+        const int h = image.height();
+        if (w <= 0 || h <= 0 || image.numChannels() == 0)
+            throw ImageIOError(path + ": empty image");
+
+        // The file format requires channels sorted by name
+        std::vector<int> order(size_t(image.numChannels()));
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return image.channels()[a] < image.channels()[b];
+        });
+
+        const bool half = options.pixelType == ExrPixelType::HALF;
+        const int linesPerBlock = options.compression == ExrCompression::ZIP ? 16 : 1;
+        const size_t numBlocks = size_t((h + linesPerBlock - 1) / linesPerBlock);
+
+        // Header
+        std::vector<uint8_t> file;
+        putU32(file, 20000630); // Magic number
+        putU32(file, 2);        // Version 2, single part scanline
+
+        auto attribute = [&file](const char* name, const char* type, uint32_t size) {
+            putString(file, name);
+            putString(file, type);
+            putU32(file, size);
+        };
+
+        uint32_t chlistSize = 1;
+        for (const std::string& name : image.channels())
+            chlistSize += uint32_t(name.size()) + 1 + 16;
+
+        attribute("channels", "chlist", chlistSize);
+        for (int c : order) {
+            putString(file, image.channels()[c]);
+            putU32(file, uint32_t(options.pixelType));
+            putU32(file, 0);    // pLinear + reserved
+            putU32(file, 1);    // x sampling
+            putU32(file, 1);    // y sampling
+        }
+        putU8(file, 0);
+
+        attribute("compression", "compression", 1);
+        putU8(file, uint8_t(options.compression));
+
+        for (const char* window : { "dataWindow", "displayWindow" }) {
+            attribute(window, "box2i", 16);
+            putU32(file, 0);
+            putU32(file, 0);
+            putU32(file, uint32_t(w - 1));
+            putU32(file, uint32_t(h - 1));
+        }
+
+        attribute("lineOrder", "lineOrder", 1);
+        putU8(file, 0); // Increasing y
+
+        attribute("pixelAspectRatio", "float", 4);
+        putF32(file, 1.0f);
+
+        attribute("screenWindowCenter", "v2f", 8);
+        putF32(file, 0.0f);
+        putF32(file, 0.0f);
+
+        attribute("screenWindowWidth", "float", 4);
+        putF32(file, 1.0f);
+
+        putU8(file, 0); // End of header
+
+        // Pack and compress scanline blocks in parallel
+        std::vector<std::vector<uint8_t>> blocks(numBlocks);
+
+        util::ThreadPool::instance().parallelFor(0, numBlocks, 1, [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) {
+                int y0 = int(b) * linesPerBlock;
+                int y1 = std::min(y0 + linesPerBlock, h);
+
+                std::vector<uint8_t> raw;
+                raw.reserve(size_t(y1 - y0) * w * order.size() * (half ? 2 : 4));
+
+                for (int y = y0; y < y1; ++y) {
+                    int row = h - 1 - y; // EXR scanlines go top to bottom
+                    for (int c : order) {
+                        for (int x = 0; x < w; ++x) {
+                            float v = image.pixel(x, row)[c];
+                            if (half) putU16(raw, glm::packHalf1x16(v));
+                            else putF32(raw, v);
+                        }
+                    }
+                }
+
+                blocks[b] = exrCompress(raw, options.compression);
+            }
+        });
+
+        // Offset table followed by the blocks
+        uint64_t offset = file.size() + numBlocks * sizeof(uint64_t);
+        for (const std::vector<uint8_t>& block : blocks) {
+            putU64(file, offset);
+            offset += 8 + block.size();
+        }
+
+        for (size_t b = 0; b < numBlocks; ++b) {
+            putU32(file, uint32_t(b * linesPerBlock));
+            putU32(file, uint32_t(blocks[b].size()));
+            file.insert(file.end(), blocks[b].begin(), blocks[b].end());
+        }
+
+        writeFile(path, file);
+    }
+
+    void writeImage(const std::string& path, const Image& image, const ExrOptions& options) {
+        std::string ext = path.substr(path.find_last_of('.') + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+        if (ext == "exr")       writeEXR(path, image, options);
+        else if (ext == "pfm")  writePFM(path, image);
+        else if (ext == "png")  writePNG(path, image);
+        else throw ImageIOError(path + ": unknown image format");
+    }
+}
@@ -0,0 +1,93 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_IO_IMAGEIO_H_
+#define PATHTRACER_IO_IMAGEIO_H_
+
+#include <string>
+#include <stdexcept>
+
+#include "Image.h"
+
+namespace io {
+
+    /**
+     * @brief Thrown when an image can't be read or written
+     */
+    class ImageIOError : public std::runtime_error {
+    public:
+        explicit ImageIOError(const std::string& msg) : std::runtime_error(msg) {  }
+    };
+
+    /** OpenEXR channel storage type */
+    enum class ExrPixelType {
+        HALF    = 1,    // 16 bit floats
+        FLOAT   = 2     // 32 bit floats
+    };
+
+    /** OpenEXR scanline compression, values match the file format */
+    enum class ExrCompression {
+        NONE    = 0,    // Uncompressed
+        RLE     = 1,    // Run length encoding, 1 scanline per block
+        ZIPS    = 2,    // Deflate, 1 scanline per block
+        ZIP     = 3     // Deflate, 16 scanlines per block
+    };
+
+    /** OpenEXR writer options */
+    struct ExrOptions {
+        ExrPixelType    pixelType   = ExrPixelType::HALF;
+        ExrCompression  compression = ExrCompression::ZIP;
+    };
+
+    /**
+     * Write Portable Float Map. Only the R, G and B channels are written.
+     * @param[in] path  Output file path
+     * @param[in] image Image with R, G and B channels
+     * @throws ImageIOError on failure
+     */
+    void writePFM(const std::string& path, const Image& image);
+
+    /**
+     * Write scanline OpenEXR file with every image channel. Scanline blocks
+     * are compressed in parallel on util::ThreadPool.
+     * @param[in] path      Output file path
+     * @param[in] image     Image to write
+     * @param[in] options   Pixel type and compression
+     * @throws ImageIOError on failure
+     */
+    void writeEXR(const std::string& path, const Image& image, const ExrOptions& options = ExrOptions());
+
+    /**
+     * Write 8 bit PNG. Radiance is clamped and gamma corrected the same way
+     * ScreenQuad.frag does before display.
+     * @param[in] path  Output file path
+     * @param[in] image Image with R, G and B channels
+     * @throws ImageIOError on failure
+     */
+    void writePNG(const std::string& path, const Image& image);
+
+    /**
+     * Write image choosing the format from the file extension (.exr, .pfm or .png)
+     * @param[in] path      Output file path
+     * @param[in] image     Image to write
+     * @param[in] options   OpenEXR options, ignored by other formats
+     * @throws ImageIOError on failure or unknown extension
+     */
+    void writeImage(const std::string& path, const Image& image, const ExrOptions& options = ExrOptions());
+}
+
+#endif //PATHTRACER_IO_IMAGEIO_H_
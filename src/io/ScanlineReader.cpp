@@ -0,0 +1,309 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdio>
+#include <cctype>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include "../util/ThreadPool.h"
+
+#include "ScanlineReader.h"
+
+namespace io {
+
+    ScanlineReader::ScanlineReader(const std::string& path)
+        : path(path)
+        , bytes()
+        , size(0)
+        , format(Format::PFM_RGB)
+        , _width(0)
+        , _height(0)
+        , swapBytes(false)
+        , scale(1.0f)
+        , rows() {
+
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        const std::streamoff end = file ? std::streamoff(file.tellg()) : -1;
+        if (end < 0) throw ImageIOError("can't open " + path);
+        size = size_t(end);
+        file.close();
+
+        // Chunks are read in parallel, so are the page faults of the fresh
+        // buffer. Nothing is zero filled first.
+        static constexpr size_t CHUNK_SIZE = size_t(16) << 20;
+        bytes.reset(new uint8_t[size + 1]);
+        std::atomic<bool> failed(false);
+
+        util::ThreadPool::instance().parallelFor(0, (size + CHUNK_SIZE - 1) / CHUNK_SIZE, 1,
+            [&](size_t begin, size_t end) {
+                std::ifstream chunk(path, std::ios::binary);
+                const size_t first = begin * CHUNK_SIZE;
+                const size_t count = std::min(end * CHUNK_SIZE, size) - first;
+
+                chunk.seekg(std::streamoff(first));
+                chunk.read(reinterpret_cast<char*>(bytes.get() + first), std::streamsize(count));
+                if (!chunk || size_t(chunk.gcount()) != count) failed = true;
+            });
+
+        if (failed) throw ImageIOError("error reading " + path);
+        bytes[size] = 0;    // Header parsing can't run past the end
+
+        if (size >= 2 && bytes[0] == 'P' && (bytes[1] == 'F' || bytes[1] == 'f')) {
+            size_t data = parsePFM();
+            const size_t rowSize = size_t(_width) * (format == Format::PFM_RGB ? 12 : 4);
+            if (size - data < rowSize * size_t(_height))
+                throw ImageIOError(path + ": truncated image");
+
+            // PFM rows go bottom to top
+            rows.resize(size_t(_height));
+            for (int y = 0; y < _height; ++y)
+                rows[size_t(y)] = data + rowSize * size_t(_height - 1 - y);
+        } else if (size >= 2 && bytes[0] == '#' && bytes[1] == '?') {
+            parseRGBE();
+        } else {
+            throw ImageIOError(path + ": not a PFM or Radiance HDR image");
+        }
+    }
+
+    int ScanlineReader::width() const {
+        return _width;
+    }
+
+    int ScanlineReader::height() const {
+        return _height;
+    }
+
+    /** Read a whitespace delimited token starting at pos */
+    static std::string nextToken(const uint8_t* bytes, size_t size, size_t& pos) {
+        while (pos < size && std::isspace(bytes[pos])) ++pos;
+        size_t start = pos;
+        while (pos < size && !std::isspace(bytes[pos])) ++pos;
+        return std::string(reinterpret_cast<const char*>(bytes + start), pos - start);
+    }
+
+    size_t ScanlineReader::parsePFM() {
+        size_t pos = 0;
+        std::string magic = nextToken(bytes.get(), size, pos);
+        format = magic == "PF" ? Format::PFM_RGB : Format::PFM_GRAY;
+
+        try {
+            _width = std::stoi(nextToken(bytes.get(), size, pos));
+            _height = std::stoi(nextToken(bytes.get(), size, pos));
+            scale = std::stof(nextToken(bytes.get(), size, pos));
+        } catch (const std::exception&) {
+            throw ImageIOError(path + ": invalid PFM header");
+        }
+
+        if (_width <= 0 || _height <= 0 || scale == 0.0f)
+            throw ImageIOError(path + ": invalid PFM header");
+
+        // Negative scale means little endian, its magnitude scales the values
+        const uint16_t probe = 1;
+        const bool littleHost = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+        swapBytes = (scale < 0.0f) != littleHost;
+        scale = std::fabs(scale);
+
+        // A single whitespace character separates the header from the data
+        return pos + 1;
+    }
+
+    void ScanlineReader::parseRGBE() {
+        // Header lines end with an empty line
+        size_t pos = 0;
+        for (;;) {
+            size_t eol = pos;
+            while (eol < size && bytes[eol] != '\n') ++eol;
+            if (eol >= size) throw ImageIOError(path + ": truncated Radiance header");
+
+            std::string line(reinterpret_cast<const char*>(bytes.get() + pos), eol - pos);
+            pos = eol + 1;
+
+            if (line.empty()) break;
+            if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+                throw ImageIOError(path + ": unsupported Radiance pixel format " + line.substr(7));
+        }
+
+        // Resolution line, only the standard orientation
+        char y[3], x[3];
+        int height, width, consumed = 0;
+        if (std::sscanf(reinterpret_cast<const char*>(bytes.get() + pos), "%2s %d %2s %d%n",
+                    y, &height, x, &width, &consumed) != 4 ||
+                std::strcmp(y, "-Y") != 0 || std::strcmp(x, "+X") != 0 || width <= 0 || height <= 0)
+            throw ImageIOError(path + ": unsupported Radiance image orientation");
+
+        _width = width;
+        _height = height;
+        pos += size_t(consumed);
+        while (pos < size && bytes[pos] != '\n') ++pos;
+        ++pos;
+
+        // New run length encoding marks every scanline with 2, 2, width
+        const bool rle = _width >= 8 && _width < 0x8000 && pos + 4 <= size &&
+            bytes[pos] == 2 && bytes[pos + 1] == 2 && (bytes[pos + 2] & 0x80) == 0;
+
+        rows.resize(size_t(_height));
+
+        if (!rle) {
+            format = Format::RGBE_FLAT;
+            const size_t rowSize = size_t(_width) * 4;
+            if (size < pos || size - pos < rowSize * size_t(_height))
+                throw ImageIOError(path + ": truncated image");
+            for (int y = 0; y < _height; ++y)
+                rows[size_t(y)] = pos + rowSize * size_t(y);
+            return;
+        }
+
+        // Scanline sizes are only known after walking their runs
+        format = Format::RGBE_RLE;
+        for (int y = 0; y < _height; ++y) {
+            if (pos + 4 > size || bytes[pos] != 2 || bytes[pos + 1] != 2 ||
+                    ((int(bytes[pos + 2]) << 8) | bytes[pos + 3]) != _width)
+                throw ImageIOError(path + ": corrupt scanline " + std::to_string(y));
+
+            rows[size_t(y)] = pos;
+            pos += 4;
+
+            for (int channel = 0; channel < 4; ++channel) {
+                for (int x = 0; x < _width; ) {
+                    if (pos >= size) throw ImageIOError(path + ": truncated image");
+
+                    int count = bytes[pos++];
+                    if (count > 128) {
+                        count -= 128;
+                        pos += 1;
+                    } else {
+                        pos += size_t(count);
+                    }
+
+                    x += count;
+                    if (count == 0 || x > _width || pos > size)
+                        throw ImageIOError(path + ": corrupt scanline " + std::to_string(y));
+                }
+            }
+        }
+    }
+
+    /** Convert a RGBE pixel to floats */
+    static inline void rgbeToFloat(uint8_t r, uint8_t g, uint8_t b, uint8_t e, float* rgb) {
+        if (e == 0) {
+            rgb[0] = rgb[1] = rgb[2] = 0.0f;
+            return;
+        }
+
+        // 2^(e - 136), built from its bits while it is a normal float
+        float f;
+        if (e > 9) {
+            uint32_t bits = uint32_t(e - 9) << 23;
+            std::memcpy(&f, &bits, sizeof(f));
+        } else {
+            f = std::ldexp(1.0f, int(e) - 136);
+        }
+
+        rgb[0] = float(r) * f;
+        rgb[1] = float(g) * f;
+        rgb[2] = float(b) * f;
+    }
+
+    void ScanlineReader::decodeRow(int y, float* rgb, uint8_t* scratch) const {
+        const uint8_t* src = bytes.get() + rows[size_t(y)];
+
+        switch (format) {
+            case Format::PFM_RGB:
+            case Format::PFM_GRAY: {
+                const int channels = format == Format::PFM_RGB ? 3 : 1;
+                const size_t numValues = size_t(_width) * size_t(channels);
+                float* values = format == Format::PFM_RGB ? rgb : reinterpret_cast<float*>(scratch);
+                std::memcpy(values, src, numValues * sizeof(float));
+
+                if (swapBytes) {
+                    uint32_t* words = reinterpret_cast<uint32_t*>(values);
+                    for (size_t i = 0; i < numValues; ++i) {
+                        uint32_t w = words[i];
+                        words[i] = (w >> 24) | ((w >> 8) & 0xFF00u) | ((w << 8) & 0xFF0000u) | (w << 24);
+                    }
+                }
+
+                if (format == Format::PFM_GRAY) {
+                    for (int x = _width - 1; x >= 0; --x)
+                        rgb[x * 3 + 0] = rgb[x * 3 + 1] = rgb[x * 3 + 2] = values[x];
+                }
+
+                if (scale != 1.0f) {
+                    for (size_t i = 0; i < size_t(_width) * 3; ++i) rgb[i] *= scale;
+                }
+                break;
+            }
+
+            case Format::RGBE_FLAT:
+                for (int x = 0; x < _width; ++x, src += 4)
+                    rgbeToFloat(src[0], src[1], src[2], src[3], rgb + x * 3);
+                break;
+
+            case Format::RGBE_RLE: {
+                // Channels are stored one after another, runs were validated on load
+                src += 4;
+                for (int channel = 0; channel < 4; ++channel) {
+                    uint8_t* dst = scratch + size_t(channel) * size_t(_width);
+                    for (int x = 0; x < _width; ) {
+                        int count = *src++;
+                        if (count > 128) {
+                            count -= 128;
+                            std::memset(dst + x, *src++, size_t(count));
+                        } else {
+                            std::memcpy(dst + x, src, size_t(count));
+                            src += count;
+                        }
+                        x += count;
+                    }
+                }
+
+                const uint8_t* r = scratch;
+                const uint8_t* g = r + _width;
+                const uint8_t* b = g + _width;
+                const uint8_t* e = b + _width;
+                for (int x = 0; x < _width; ++x)
+                    rgbeToFloat(r[x], g[x], b[x], e[x], rgb + x * 3);
+                break;
+            }
+        }
+    }
+
+    void ScanlineReader::decode(int blockRows, const BlockConsumer& consumer) const {
+        blockRows = std::max(blockRows, 1);
+        const size_t numBlocks = (size_t(_height) + size_t(blockRows) - 1) / size_t(blockRows);
+        const size_t rowFloats = size_t(_width) * 3;
+
+        util::ThreadPool::instance().parallelFor(0, numBlocks, 1, [&](size_t begin, size_t end) {
+            std::unique_ptr<float[]> rgb(new float[rowFloats * size_t(blockRows)]);
+            std::unique_ptr<uint8_t[]> scratch(new uint8_t[size_t(_width) * 4]);
+
+            for (size_t block = begin; block < end; ++block) {
+                const int first = int(block) * blockRows;
+                const int count = std::min(blockRows, _height - first);
+
+                for (int i = 0; i < count; ++i)
+                    decodeRow(first + i, rgb.get() + rowFloats * size_t(i), scratch.get());
+
+                consumer(first, count, rgb.get());
+            }
+        });
+    }
+}
@@ -0,0 +1,102 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_IO_SCANLINEREADER_H_
+#define PATHTRACER_IO_SCANLINEREADER_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <functional>
+
+#include "ImageIO.h"
+
+namespace io {
+
+    /**
+     * Parallel decoder of HDR images: Portable Float Maps (.pfm) and Radiance
+     * RGBE (.hdr, .pic), flat or run length encoded. The file is read and its
+     * scanlines located once, then blocks of rows are decoded on
+     * util::ThreadPool straight into the consumer, so a huge image never
+     * needs a full float copy in memory.
+     */
+    class ScanlineReader {
+    public:
+
+        /**
+         * Called from any pool thread with decoded rows
+         * @param[in] first First row of the block, counted from the top
+         * @param[in] count Number of rows in the block
+         * @param[in] rgb   RGB floats of the rows, top to bottom
+         */
+        using BlockConsumer = std::function<void(int first, int count, const float* rgb)>;
+
+        /**
+         * Read an image file and locate its scanlines. Scanlines are
+         * validated here, so decoding can't fail.
+         * @param[in] path Image file, the format comes from the file contents
+         * @throws ImageIOError if the file can't be read, is corrupt or isn't supported
+         */
+        explicit ScanlineReader(const std::string& path);
+
+        /** Get image width */
+        int width() const;
+
+        /** Get image height */
+        int height() const;
+
+        /**
+         * Decode every row in parallel. Blocks never overlap and cover the
+         * image, the last one may be shorter.
+         * @param[in] blockRows Rows per block
+         * @param[in] consumer  Receives every block once
+         */
+        void decode(int blockRows, const BlockConsumer& consumer) const;
+
+    private:
+
+        /** Supported encodings */
+        enum class Format {
+            PFM_RGB,    //!< 3 floats per pixel
+            PFM_GRAY,   //!< 1 float per pixel
+            RGBE_FLAT,  //!< 4 bytes per pixel
+            RGBE_RLE    //!< Adaptive run length encoded scanlines
+        };
+
+        /** Parse a PFM header, returns the offset of the pixel data */
+        size_t parsePFM();
+
+        /** Parse a Radiance header and locate the scanlines */
+        void parseRGBE();
+
+        /** Decode row y, counted from the top, into width RGB floats */
+        void decodeRow(int y, float* rgb, uint8_t* scratch) const;
+
+        std::string                 path;       //!< File path, for error messages
+        std::unique_ptr<uint8_t[]>  bytes;      //!< Whole file contents
+        size_t                      size;       //!< File size in bytes
+        Format                      format;     //!< Pixel encoding
+        int                         _width;     //!< Image width
+        int                         _height;    //!< Image height
+        bool                        swapBytes;  //!< PFM floats are big endian?
+        float                       scale;      //!< PFM scale, multiplies every value
+        std::vector<size_t>         rows;       //!< File offset of every row, top to bottom
+    };
+}
+
+#endif //PATHTRACER_IO_SCANLINEREADER_H_
@@ -0,0 +1,84 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "Volume.h"
+
+namespace io {
+
+    /** On disk header, every field little endian */
+    struct VolumeHeader {
+        char        magic[3];
+        uint8_t     version;
+        int32_t     encoding;
+        int32_t     size[3];
+        int32_t     channels;
+        float       bounds[6];  // Ignored, the grid fills its sphere
+    };
+
+    // Packed on disk, the compiler adds no padding after the 4 byte prefix
+    static_assert(sizeof(VolumeHeader) == 48, "unexpected volume header layout");
+
+    Volume readVolume(const std::string& path) {
+        const uint16_t probe = 1;
+        if (*reinterpret_cast<const uint8_t*>(&probe) != 1)
+            throw VolumeError("volumes require a little endian host");
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(std::fopen(path.c_str(), "rb"), std::fclose);
+        if (!file) throw VolumeError("can't open " + path);
+
+        VolumeHeader header;
+        if (std::fread(&header, sizeof(header), 1, file.get()) != 1 ||
+                std::memcmp(header.magic, "VOL", 3) != 0 || header.version != 3)
+            throw VolumeError(path + ": not a grid volume");
+
+        if (header.encoding != 1)
+            throw VolumeError(path + ": only float32 volumes are supported");
+
+        if (header.size[0] <= 0 || header.size[1] <= 0 || header.size[2] <= 0 || header.channels <= 0)
+            throw VolumeError(path + ": invalid volume size");
+
+        Volume volume;
+        volume.width    = uint32_t(header.size[0]);
+        volume.height   = uint32_t(header.size[1]);
+        volume.depth    = uint32_t(header.size[2]);
+
+        const size_t numVoxels = size_t(volume.width) * volume.height * volume.depth;
+        const size_t channels = size_t(header.channels);
+        std::vector<float> values(numVoxels * channels);
+        if (std::fread(values.data(), sizeof(float), values.size(), file.get()) != values.size())
+            throw VolumeError(path + ": truncated volume");
+
+        if (channels == 1) {
+            volume.density = std::move(values);
+            return volume;
+        }
+
+        volume.density.resize(numVoxels);
+        for (size_t i = 0; i < numVoxels; ++i) {
+            float sum = 0.0f;
+            for (size_t c = 0; c < channels; ++c) sum += values[i * channels + c];
+            volume.density[i] = sum / float(channels);
+        }
+
+        return volume;
+    }
+}
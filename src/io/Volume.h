@@ -0,0 +1,56 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PATHTRACER_IO_VOLUME_H_
+#define PATHTRACER_IO_VOLUME_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+namespace io {
+
+    /**
+     * @brief Thrown when a volume can't be read
+     */
+    class VolumeError : public std::runtime_error {
+    public:
+        explicit VolumeError(const std::string& msg) : std::runtime_error(msg) {  }
+    };
+
+    /** Density grid, x varies fastest, then y, then z */
+    struct Volume {
+        uint32_t            width   = 0;    //!< Voxels along x
+        uint32_t            height  = 0;    //!< Voxels along y
+        uint32_t            depth   = 0;    //!< Voxels along z
+        std::vector<float>  density;        //!< width * height * depth values
+    };
+
+    /**
+     * Read a Mitsuba grid volume (.vol): "VOL" version 3, float32 encoding.
+     * Multichannel grids are averaged into one density, the bounding box of
+     * the file is ignored.
+     * @param[in] path Volume file path
+     * @return The density grid
+     * @throws VolumeError if the file is missing, truncated or not supported
+     */
+    Volume readVolume(const std::string& path);
+}
+
+#endif //PATHTRACER_IO_VOLUME_H_
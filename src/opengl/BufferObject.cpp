@@ -71,4 +71,16 @@ namespace opengl {
         glBufferSubData(target, offset, size, data);
     }
 
+    void BufferObject::setStorage(void const* data, GLsizeiptr size, GLbitfield flags) {
+        glBufferStorage(target, size, data, flags);
+    }
+
+    void* BufferObject::mapRange(GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        return glMapBufferRange(target, offset, length, access);
+    }
+
+    void BufferObject::unmap() {
+        glUnmapBuffer(target);
+    }
+
 }
\ No newline at end of file
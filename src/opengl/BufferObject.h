@@ -99,6 +99,34 @@ namespace opengl {
          */
         void setSubData(void const* data, GLsizeiptr size, GLintptr offset);
 
+        /**
+         * Allocate immutable buffer storage
+         * @pre This Object is correctly bound
+         * @param[in] data  Pointer to initial data or nullptr
+         * @param[in] size  Number of bytes to allocate
+         * @param[in] flags Storage flags: GL_MAP_READ_BIT, GL_MAP_PERSISTENT_BIT, etc...
+         * @see https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBufferStorage.xhtml
+         */
+        void setStorage(void const* data, GLsizeiptr size, GLbitfield flags);
+
+        /**
+         * Map a range of the buffer into client memory
+         * @pre This Object is correctly bound
+         * @param[in] offset    First byte of the range
+         * @param[in] length    Number of bytes to map
+         * @param[in] access    Access flags: GL_MAP_READ_BIT, GL_MAP_PERSISTENT_BIT, etc...
+         * @return Pointer to the mapped range or nullptr on failure
+         * @see https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glMapBufferRange.xhtml
+         */
+        void* mapRange(GLintptr offset, GLsizeiptr length, GLbitfield access);
+
+        /**
+         * Release the buffer mapping
+         * @pre This Object is correctly bound
+         * @see https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glMapBuffer.xhtml
+         */
+        void unmap();
+
         /**
          * Set buffer data from std::vector
          * @pre This Object is correctly bound
@@ -0,0 +1,56 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of voxfracturer.
+//
+//    voxfracturer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    voxfracturer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with voxfracturer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "Extensions.h"
+
+namespace opengl {
+
+    // Both extensions share the signature and the enums
+    typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+    static PFNGLMAXSHADERCOMPILERTHREADSPROC glMaxShaderCompilerThreads = nullptr;
+
+    void loadExtensions(GLADloadproc load) {
+        glMaxShaderCompilerThreads = nullptr;
+
+        if (hasExtension("GL_KHR_parallel_shader_compile"))
+            glMaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC) load("glMaxShaderCompilerThreadsKHR");
+        else if (hasExtension("GL_ARB_parallel_shader_compile"))
+            glMaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC) load("glMaxShaderCompilerThreadsARB");
+    }
+
+    bool hasExtension(const std::string& name) {
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+        for (GLint i = 0; i < numExtensions; ++i) {
+            const GLubyte* extension = glGetStringi(GL_EXTENSIONS, GLuint(i));
+            if (extension && name == reinterpret_cast<const char*>(extension)) return true;
+        }
+
+        return false;
+    }
+
+    bool hasParallelShaderCompile() {
+        return glMaxShaderCompilerThreads != nullptr;
+    }
+
+    void maxShaderCompilerThreads(GLuint count) {
+        if (glMaxShaderCompilerThreads) glMaxShaderCompilerThreads(count);
+    }
+}
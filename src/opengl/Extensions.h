@@ -0,0 +1,62 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of voxfracturer.
+//
+//    voxfracturer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    voxfracturer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with voxfracturer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef VOXFRACTURER_OPENGL_EXTENSIONS_H_
+#define VOXFRACTURER_OPENGL_EXTENSIONS_H_
+
+#include <string>
+
+#include <glad/glad.h>
+
+// GL_KHR_parallel_shader_compile, glad is generated without extensions
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR  0x91B0
+#define GL_COMPLETION_STATUS_KHR            0x91B1
+#endif
+
+namespace opengl {
+
+    /**
+     * Load the extension functions used by the application. Requires a
+     * current context.
+     * @param[in] load Function loader, e.g. glfwGetProcAddress
+     */
+    void loadExtensions(GLADloadproc load);
+
+    /**
+     * Is an extension supported by the current context?
+     * @param[in] name Extension name, e.g. "GL_KHR_parallel_shader_compile"
+     */
+    bool hasExtension(const std::string& name);
+
+    /**
+     * Can shaders be compiled and linked asynchronously? True when the
+     * KHR or ARB parallel shader compile extension was loaded, then
+     * GL_COMPLETION_STATUS_KHR can be polled without blocking.
+     * @see https://www.khronos.org/registry/OpenGL/extensions/KHR/KHR_parallel_shader_compile.txt
+     */
+    bool hasParallelShaderCompile();
+
+    /**
+     * Set the number of driver threads compiling shaders
+     * @param[in] count Number of threads, 0xFFFFFFFF lets the driver choose
+     */
+    void maxShaderCompilerThreads(GLuint count);
+}
+
+#endif //VOXFRACTURER_OPENGL_EXTENSIONS_H_
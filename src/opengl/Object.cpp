@@ -15,6 +15,8 @@
 //    You should have received a copy of the GNU General Public License
 //    along with voxfracturer.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <utility>
+
 #include "Object.h"
 
 namespace opengl {
@@ -38,6 +40,11 @@ namespace opengl {
         handler = 0;
     }
 
+    void Object::swapObject(Object& other) {
+        std::swap(handler, other.handler);
+        std::swap(created, other.created);
+    }
+
     GLuint Object::getHandler() const {
         return handler;
     }
@@ -76,6 +76,9 @@ namespace opengl {
         /** Set the Object as destroyed */
         void setAsDestroyed();
 
+        /** Exchange the OpenGL object with other */
+        void swapObject(Object& other);
+
         GLuint handler; //!< OpenGL Object handler
 
     private:
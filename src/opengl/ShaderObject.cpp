@@ -56,11 +56,18 @@ namespace opengl {
     }
 
    void ShaderObject::compile() {
+        compileAsync();
+        updateCompileStatus();
+    }
+
+    void ShaderObject::compileAsync() {
         // Set source code and compile it
         const char* cstr = _source.c_str();
         glShaderSource(handler, 1, &cstr, NULL);
         glCompileShader(handler);
+    }
 
+    void ShaderObject::updateCompileStatus() {
         // Get compilation status
         glGetShaderiv(handler, GL_COMPILE_STATUS, &_compileStatus);
 
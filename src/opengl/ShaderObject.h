@@ -65,6 +65,15 @@ namespace opengl {
          */
         void compile();
 
+        /**
+         * Start compiling without waiting for the result. With
+         * KHR_parallel_shader_compile the driver compiles in the background.
+         */
+        void compileAsync();
+
+        /** Wait for the compilation and read its status and log */
+        void updateCompileStatus();
+
         /**
          * Appends source code
          * @param[in] source More shaders code
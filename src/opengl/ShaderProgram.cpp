@@ -15,6 +15,9 @@
 //    You should have received a copy of the GNU General Public License
 //    along with voxfracturer.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <algorithm>
+
+#include "Extensions.h"
 #include "ShaderProgram.h"
 
 namespace opengl {
@@ -53,9 +56,24 @@ namespace opengl {
     }
 
     void ShaderProgram::link() {
+        linkAsync();
+        updateLinkStatus();
+    }
+
+    void ShaderProgram::linkAsync() {
         // Link and check errors
         glLinkProgram(handler);
+    }
 
+    bool ShaderProgram::isCompletionDone() const {
+        if (!hasParallelShaderCompile()) return true;
+
+        GLint done = GL_FALSE;
+        glGetProgramiv(handler, GL_COMPLETION_STATUS_KHR, &done);
+        return done != GL_FALSE;
+    }
+
+    void ShaderProgram::updateLinkStatus() {
         // Get linking status
         glGetProgramiv(handler, GL_LINK_STATUS, &linkStatus);
 
@@ -76,6 +94,42 @@ namespace opengl {
         }
     }
 
+    void ShaderProgram::setBinaryRetrievable() const {
+        glProgramParameteri(handler, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    std::vector<GLubyte> ShaderProgram::getBinary(GLenum& format) const {
+        GLint length = 0;
+        glGetProgramiv(handler, GL_PROGRAM_BINARY_LENGTH, &length);
+
+        std::vector<GLubyte> binary(size_t(std::max(length, 0)));
+        if (length > 0) {
+            GLsizei written = 0;
+            glGetProgramBinary(handler, length, &written, &format, binary.data());
+            binary.resize(size_t(written));
+        }
+
+        return binary;
+    }
+
+    bool ShaderProgram::loadBinary(GLenum format, const std::vector<GLubyte>& binary) {
+        glProgramBinary(handler, format, binary.data(), GLsizei(binary.size()));
+
+        // An unknown format raises GL_INVALID_ENUM, it only means a cache miss
+        while (glGetError() != GL_NO_ERROR);
+
+        glGetProgramiv(handler, GL_LINK_STATUS, &linkStatus);
+        linkLog = linkStatus == GL_FALSE ? "program binary rejected by the driver" : "";
+
+        return linkStatus != GL_FALSE;
+    }
+
+    void ShaderProgram::swap(ShaderProgram& other) {
+        swapObject(other);
+        std::swap(linkStatus, other.linkStatus);
+        std::swap(linkLog, other.linkLog);
+    }
+
     void ShaderProgram::use() const {
         glUseProgram(handler);
     }
@@ -115,6 +169,15 @@ namespace opengl {
         else return false;
     }
 
+    bool ShaderProgram::uniform(std::string const& name, glm::ivec2 const& value) const {
+        GLint location = glGetUniformLocation(handler, name.c_str());
+        if (location >= 0) {
+            glUniform2iv(location, 1, &value[0]);
+            return true;
+        }
+        else return false;
+    }
+
     bool ShaderProgram::uniform(std::string const& name, glm::vec3 const& value) const {
         GLint location = glGetUniformLocation(handler, name.c_str());
         if (location >= 0) {
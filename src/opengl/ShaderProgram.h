@@ -61,6 +61,21 @@ namespace opengl {
          */
         void link();
 
+        /**
+         * Start linking without waiting for the result. Attached shaders may
+         * still be compiling.
+         */
+        void linkAsync();
+
+        /**
+         * Have compilation and linking finished? Never blocks, always true
+         * without KHR_parallel_shader_compile
+         */
+        bool isCompletionDone() const;
+
+        /** Wait for linking and read its status and log */
+        void updateLinkStatus();
+
         /**
          * Use the shaders program
          * @see https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUseProgram.xhtml
@@ -79,6 +94,34 @@ namespace opengl {
          */
         void detach(const ShaderObject& shader) const;
 
+        /**
+         * Let the driver know getBinary() will be called. Must be set before link()
+         * @see https://www.khronos.org/opengl/wiki/Shader_Compilation#Binary_upload
+         */
+        void setBinaryRetrievable() const;
+
+        /**
+         * Get the binary of the linked program
+         * @param[out] format   Driver specific binary format
+         * @return Program binary, empty if the driver doesn't provide one
+         */
+        std::vector<GLubyte> getBinary(GLenum& format) const;
+
+        /**
+         * Load a binary returned by getBinary() instead of linking. Drivers
+         * reject binaries of other drivers or versions.
+         * @param[in] format    Binary format
+         * @param[in] binary    Program binary
+         * @return True if the program is linked, false if the binary was rejected
+         */
+        bool loadBinary(GLenum format, const std::vector<GLubyte>& binary);
+
+        /**
+         * Exchange programs, e.g. to replace a program by one built elsewhere
+         * @param[in] other Program to exchange with
+         */
+        void swap(ShaderProgram& other);
+
         /**
          * The link status, GL_TRUE or GL_FALSE
          * @return Shader program linking status
@@ -103,6 +146,7 @@ namespace opengl {
         bool uniform(std::string const& name, GLint   value) const;
         bool uniform(std::string const& name, GLuint  value) const;
         bool uniform(std::string const& name, glm::vec2 const& value) const;
+        bool uniform(std::string const& name, glm::ivec2 const& value) const;
         bool uniform(std::string const& name, glm::vec3 const& value) const;
         bool uniform(std::string const& name, glm::uvec3 const& value) const;
         bool uniform(std::string const& name, glm::vec4 const& value) const;
@@ -20,6 +20,8 @@
 #include <chrono>
 #include <thread>
 #include <istream>
+#include <fstream>
+#include <filesystem>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -35,8 +37,12 @@
 #include <imgui/imgui_impl_glfw_gl3.h>
 
 #include "appinfo.h"
+#include "Argument_helper.h"
 #include "GLFWCallbacks.h"
 
+#include "batch/BatchRenderer.h"
+#include "farm/Coordinator.h"
+#include "opengl/Extensions.h"
 #include "pathtracer/PathTracer.h"
 
 
@@ -50,6 +56,168 @@
 #define CLEAR_COLOR     0.0f, 0.0f, 0.0f    // OpenGL clear color
 
 int main(int argc, char** argv) {
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // Parse command line
+    std::string resumePath;
+    std::string checkpointPath;
+    double      checkpointInterval = 60.0;
+    unsigned    workerIndex = 0;
+    unsigned    numWorkers = 0;
+    unsigned    samplesPerPixel = 0;
+    std::string sharedDir;
+    std::string mergeDir;
+    std::string outputPath = "render.exr";
+    std::string batchPath;
+    std::string statsPath;
+    std::string shaderCache = pathtracer::ProgramCache::defaultDirectory();
+    bool        noShaderCache = false;
+    std::string shaderDir = SHADER_DIR;
+    std::string environmentPath;
+    std::string densityGridPath;
+    std::string voxelsPath;
+    std::string sceneName = "default";
+    std::string bvhName = "wide";
+    bool        gpuBvh = false;
+    double      spatialSplits = 0.0;
+    unsigned int persistentGroups = 0;
+    bool        compensated = false;
+    std::string accumulationName = "float";
+    std::string filterName = "blackman-harris";
+    unsigned int leanBatch = 256;
+    unsigned int samplesPerDispatch = 1;
+    unsigned int sdfSteps = 128;
+
+    dsr::Argument_helper args;
+    args.set_name(APP_NAME);
+    args.set_description(APP_DESC);
+    args.set_author(AUTHOR);
+    args.set_version(APP_VERSION);
+    args.set_build_date(APP_COMPILE_DATE);
+    args.new_named_string("r", "resume", "file",
+        "Continue rendering from a checkpoint file", resumePath);
+    args.new_named_string("c", "checkpoint", "file",
+        "Periodically save the render state to file (defaults to the resumed file)", checkpointPath);
+    args.new_named_double("i", "checkpoint-interval", "seconds",
+        "Time between checkpoints and merges, 60 by default", checkpointInterval);
+    args.new_named_unsigned_int("w", "worker", "index",
+        "Render as worker index of a render farm, without window", workerIndex);
+    args.new_named_unsigned_int("n", "workers", "count",
+        "Number of workers of the render farm", numWorkers);
+    args.new_named_string("d", "shared-dir", "dir",
+        "Directory where workers leave their partial results", sharedDir);
+    args.new_named_unsigned_int("s", "spp", "samples",
+        "Samples per pixel a worker renders, or the merge waits for", samplesPerPixel);
+    args.new_named_string("m", "merge", "dir",
+        "Merge the worker results found in dir instead of rendering", mergeDir);
+    args.new_named_string("o", "output", "file",
+        "Merged image file (.exr, .pfm or .png), render.exr by default", outputPath);
+    args.new_named_string("b", "batch", "file",
+        "Render every job of a job file and exit", batchPath);
+    args.new_named_string("t", "stats", "file",
+        "Write batch job statistics as CSV to file", statsPath);
+    args.new_named_string("x", "shader-dir", "dir",
+        "Directory of the shader sources, edits are reloaded while running", shaderDir);
+    args.new_named_string("k", "shader-cache", "dir",
+        "Directory of the compiled shader cache", shaderCache);
+    args.new_flag("K", "no-shader-cache", "Always compile shaders", noShaderCache);
+    args.new_named_string("e", "environment", "file",
+        "Light the scene with an equirectangular HDR map (.pfm or .hdr)", environmentPath);
+    args.new_named_string("g", "density-grid", "file",
+        "Density of the heterogeneous media, a Mitsuba grid volume (.vol)", densityGridPath);
+    args.new_named_string("V", "voxels", "file",
+        "Voxel model of the voxels scene, a Mitsuba grid volume (.vol) of material ids + 1", voxelsPath);
+    args.new_named_string("S", "scene", "name",
+        "Built-in scene: default, field, or spheres, boxes, planes, cylinders, tori, sdf and voxels to benchmark a primitive type",
+        sceneName);
+    args.new_named_string("B", "bvh", "layout",
+        "Bounding volume hierarchy: linear (none), binary or wide, wide by default", bvhName);
+    args.new_flag("G", "gpu-bvh", "Build the hierarchy on the GPU, always binary", gpuBvh);
+    args.new_named_double("P", "sbvh", "budget",
+        "Split primitives across hierarchy nodes, adding up to budget times the primitives as references", spatialSplits);
+    args.new_named_unsigned_int("R", "persistent", "groups",
+        "Keep groups workgroups resident, taking pixels from a work queue", persistentGroups);
+    args.new_flag("C", "compensated", "Accumulate with Kahan summation, for long renders", compensated);
+    args.new_named_string("L", "accumulation", "format",
+        "Accumulate in float, or keep the mean in half or rgb9e5 to save memory, float by default", accumulationName);
+    args.new_named_unsigned_int("N", "lean-batch", "samples",
+        "Samples a tile renders before they go into a half or rgb9e5 image, 256 by default", leanBatch);
+    args.new_named_string("F", "filter", "name",
+        "Reconstruction filter: none (2x supersampling instead), box, gaussian, blackman-harris or mitchell, "
+        "blackman-harris by default", filterName);
+    args.new_named_unsigned_int("D", "dispatch-samples", "samples",
+        "Samples per pixel traced by every kernel launch, 1 by default", samplesPerDispatch);
+    args.new_named_unsigned_int("M", "sdf-steps", "steps",
+        "Sphere tracing step cap of signed distance functions", sdfSteps);
+    args.process(argc, argv);
+
+    // Arguments and batch jobs are checked before paying for the context
+    if (scene::namedScene(sceneName).empty()) {
+        PRINT_ERR("unknown scene '" << sceneName << "'");
+        exit(EXIT_FAILURE);
+    }
+
+    GLuint accumulationFormat;
+    if (!pathtracer::PathTracer::parseAccumulationFormat(accumulationName, accumulationFormat)) {
+        PRINT_ERR("unknown accumulation format '" << accumulationName << "'");
+        exit(EXIT_FAILURE);
+    }
+
+    GLuint filter;
+    if (!pathtracer::PathTracer::parseFilter(filterName, filter)) {
+        PRINT_ERR("unknown filter '" << filterName << "'");
+        exit(EXIT_FAILURE);
+    }
+
+    GLuint bvhLayout;
+    if (!pathtracer::BvhBuffer::parseLayout(bvhName, bvhLayout)) {
+        PRINT_ERR("unknown bvh layout '" << bvhName << "'");
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<batch::Job> jobs;
+    const bool batchMode = !batchPath.empty();
+    if (batchMode) {
+        try {
+            jobs = batch::readJobs(batchPath);
+        } catch (const batch::JobError& e) {
+            PRINT_ERR(e.what());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Coordinator, merges worker results and doesn't need OpenGL
+    if (!mergeDir.empty()) {
+        try {
+            farm::Coordinator(mergeDir, outputPath).run(samplesPerPixel, float(checkpointInterval));
+        } catch (const farm::MergeError& e) {
+            PRINT_ERR("merge: " << e.what());
+            exit(EXIT_FAILURE);
+        } catch (const io::ImageIOError& e) {
+            PRINT_ERR(e.what());
+            exit(EXIT_FAILURE);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Workers render disjoint samples and keep their sums in the shared directory
+    const bool worker = numWorkers > 0;
+    if (worker) {
+        if (workerIndex >= numWorkers || sharedDir.empty()) {
+            PRINT_ERR("a worker needs --shared-dir and an index lower than --workers");
+            exit(EXIT_FAILURE);
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(sharedDir, error);
+
+        // A restarted worker continues its previous partial result
+        checkpointPath = farm::workerFile(sharedDir, workerIndex);
+        if (resumePath.empty() && std::filesystem::exists(checkpointPath, error))
+            resumePath = checkpointPath;
+    }
+
+    if (checkpointPath.empty()) checkpointPath = resumePath;
 
     // Setup window
     glfwSetErrorCallback(errorCallback);
@@ -63,8 +231,7 @@ int main(int argc, char** argv) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, OPENGL_MINOR);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
-    //glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_VISIBLE, worker || batchMode ? GL_FALSE : GL_TRUE);
 
     // Create window with graphics context
     GLFWwindow* window = glfwCreateWindow(WINDOW_SIZE, WINDOW_SIZE, "pathtracer", NULL, NULL);
@@ -73,6 +240,16 @@ int main(int argc, char** argv) {
         exit(EXIT_FAILURE);
     }
 
+    // Hidden contexts sharing objects with the window. Edited shaders are
+    // rebuilt on one, kernel variants on the other if the driver can't
+    // compile them in parallel
+    GLFWwindow* reloadContext = NULL;
+    GLFWwindow* kernelContext = NULL;
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    if (!worker && !batchMode)
+        reloadContext = glfwCreateWindow(1, 1, "pathtracer shader reload", NULL, window);
+    kernelContext = glfwCreateWindow(1, 1, "pathtracer kernel variants", NULL, window);
+
     glfwMakeContextCurrent(window);
     glfwSwapInterval(0); // Enable vsync
 
@@ -89,6 +266,7 @@ int main(int argc, char** argv) {
         PRINT_ERR("glad initialization failed");
         exit(EXIT_FAILURE);
     }
+    opengl::loadExtensions((GLADloadproc) glfwGetProcAddress);
     
     /**********************************************************/
     /*                      Render loop                       */
@@ -99,21 +277,126 @@ int main(int argc, char** argv) {
 
     // Get Renderer instance
     pathtracer::PathTracer& pt = pathtracer::PathTracer::instance();
-    pt.init();
+    pt.setShaderDir(shaderDir);
+    pt.setShaderCache(noShaderCache ? "" : shaderCache);
+    try {
+        pt.init();
+    } catch (const pathtracer::ShaderError& e) {
+        PRINT_ERR(e.what());
+        exit(EXIT_FAILURE);
+    }
+
+    if (kernelContext && !opengl::hasParallelShaderCompile()) {
+        pt.setKernelContext([kernelContext]() { glfwMakeContextCurrent(kernelContext); },
+                            []() { glfwMakeContextCurrent(NULL); });
+    }
+
+    if (reloadContext) {
+        pt.enableHotReload([reloadContext]() { glfwMakeContextCurrent(reloadContext); },
+                           []() { glfwMakeContextCurrent(NULL); });
+    }
 
     // After initialization setup PathTracer
     pt.setClearColor(CLEAR_COLOR);
     pt.setMaxBounces(10);
-    pt.setSSAA(true); // Enable SSAA
+    pt.setFilter(filter);
+    pt.setSSAA(filter == pathtracer::FILTER_NONE); // Without a filter, antialias with SSAA
+
+    if (!environmentPath.empty()) {
+        try {
+            pt.loadEnvironment(environmentPath);
+        } catch (const io::ImageIOError& e) {
+            PRINT_ERR(e.what());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pt.setPrimitives(scene::namedScene(sceneName));
+    pt.setSdfSteps(sdfSteps);
+    pt.setBvhLayout(bvhLayout);
+    pt.setGpuBvh(gpuBvh);
+    pt.setSpatialSplits(float(spatialSplits));
+    pt.setPersistentThreads(GLuint(persistentGroups));
+    pt.setCompensatedSummation(compensated);
+    pt.setAccumulationFormat(accumulationFormat);
+    pt.setLeanBatch(GLuint(leanBatch));
+    pt.setSamplesPerDispatch(GLuint(samplesPerDispatch));
+
+    if (!densityGridPath.empty()) {
+        try {
+            pt.loadDensityGrid(densityGridPath);
+        } catch (const io::VolumeError& e) {
+            PRINT_ERR(e.what());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!voxelsPath.empty()) {
+        try {
+            pt.loadVoxels(voxelsPath);
+        } catch (const io::VolumeError& e) {
+            PRINT_ERR(e.what());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Render the job queue, context and shaders are set up only once
+    if (batchMode) {
+        PRINT_OUT("setup: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()
+            << " seconds (context and shaders)");
+
+        std::ofstream statsFile;
+        if (!statsPath.empty()) {
+            statsFile.open(statsPath);
+            if (!statsFile) PRINT_ERR("can't open " << statsPath);
+            batch::BatchRenderer::writeStatsHeader(statsFile);
+        }
+
+        batch::BatchRenderer renderer(pt);
+        batch::BatchRenderer::writeStatsHeader(std::cout);
+        for (const batch::Job& job : jobs) {
+            batch::JobStats stats = renderer.run(job);
+            batch::BatchRenderer::writeStats(std::cout, stats);
+            if (statsFile) batch::BatchRenderer::writeStats(statsFile, stats);
+        }
+        renderer.finish();
+
+        pt.destroy();
+        if (kernelContext) glfwDestroyWindow(kernelContext);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return EXIT_SUCCESS;
+    }
 
     // WE MUST SET VIEWPORT!!!
     framebufferSizeCallback(window, WINDOW_SIZE, WINDOW_SIZE);
 
+    // Continue a previous render
+    if (worker) pt.setSampleStream(workerIndex, numWorkers);
+    if (worker) pt.setSampleLimit(samplesPerPixel);
+    pt.setCheckpoint(checkpointPath, float(checkpointInterval));
+    if (!resumePath.empty()) {
+        try {
+            pt.resume(resumePath);
+        } catch (const io::CheckpointError& e) {
+            PRINT_ERR(e.what());
+            exit(EXIT_FAILURE);
+        }
+    }
+
     // Render loop
     while (!glfwWindowShouldClose(window)) {
         // Poll and handle events (inputs, window resize, etc.)
         glfwPollEvents();
 
+        // Workers only sample, the final partial result is saved on destroy()
+        if (worker) {
+            if (samplesPerPixel > 0 && pt.getNumSamples() >= samplesPerPixel) break;
+            pt.render();
+            glfwSwapBuffers(window);
+            continue;
+        }
+
         ImGui_ImplGlfwGL3_NewFrame();
 
         pt.render();
@@ -125,6 +408,8 @@ int main(int argc, char** argv) {
 
     // Release resources
     pt.destroy();
+    if (reloadContext) glfwDestroyWindow(reloadContext);
+    if (kernelContext) glfwDestroyWindow(kernelContext);
     glfwDestroyWindow(window);
     glfwTerminate();
 
@@ -0,0 +1,230 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <algorithm>
+
+#include "KernelVariants.h"
+#include "BvhBuffer.h"
+
+namespace pathtracer {
+
+    // std430 packs arrays of uvec4 nodes without padding
+    static_assert(sizeof(BvhBuffer::BinaryNode) == 32, "unexpected binary node layout");
+    static_assert(sizeof(BvhBuffer::WideNode) == 64, "unexpected wide node layout");
+
+    // Wide leaf references hold the count on 7 bits and the first index on 24
+    static_assert(scene::Bvh::MAX_LEAF_SIZE < 128, "leaf too large for a wide reference");
+
+    /** Cell size of the quantization grid of an axis, a power of two */
+    static float cellSize(int exponent) {
+        return std::ldexp(1.0f, exponent);
+    }
+
+    /**
+     * Smallest power of two exponent whose 255 cells cover an axis of a
+     * node, the kernel decodes it from a biased byte as a float exponent
+     */
+    static int gridExponent(float lo, float hi) {
+        int exponent;
+        std::frexp((hi - lo) / 255.0f, &exponent);
+        exponent = std::max(exponent, -126);
+        while (exponent < 127 && lo + 255.0f * cellSize(exponent) < hi) ++exponent;
+        return exponent;
+    }
+
+    /** Collapse a binary subtree into wide nodes, returns the index of the first one */
+    static uint32_t collapse(const scene::Bvh& bvh, uint32_t root, std::vector<BvhBuffer::WideNode>& wide) {
+        const std::vector<scene::Bvh::Node>& nodes = bvh.getNodes();
+
+        // Open the inner child of largest area until the node is full
+        std::vector<uint32_t> children;
+        if (nodes[root].count > 0) children.push_back(root);
+        else children = { nodes[root].first, nodes[root].first + 1 };
+
+        while (children.size() < size_t(BvhBuffer::WIDTH)) {
+            int largest = -1;
+            for (int i = 0; i < int(children.size()); ++i) {
+                const scene::Bvh::Node& child = nodes[children[i]];
+                if (child.count == 0 && (largest < 0 || child.bounds.area() > nodes[children[largest]].bounds.area()))
+                    largest = i;
+            }
+            if (largest < 0) break;
+
+            const uint32_t opened = children[largest];
+            children[largest] = nodes[opened].first;
+            children.push_back(nodes[opened].first + 1);
+        }
+
+        const uint32_t index = uint32_t(wide.size());
+        wide.push_back(BvhBuffer::WideNode());
+
+        BvhBuffer::WideNode node = {};
+        uint32_t exponents[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            const float lo = nodes[root].bounds.min[axis];
+            const int exponent = gridExponent(lo, nodes[root].bounds.max[axis]);
+            node.origin[axis] = lo;
+            exponents[axis] = uint32_t(exponent + 127);
+        }
+        node.exponents = exponents[0] | exponents[1] << 8 | exponents[2] << 16 | uint32_t(children.size()) << 24;
+
+        for (int i = 0; i < int(children.size()); ++i) {
+            const scene::Bvh::Node& child = nodes[children[i]];
+
+            // Round outwards, then fix what the float decoding of the kernel rounds inwards
+            uint32_t lo[3], hi[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                const float origin = node.origin[axis];
+                const float size = cellSize(int(exponents[axis]) - 127);
+                int qlo = int(std::floor((child.bounds.min[axis] - origin) / size));
+                int qhi = int(std::ceil((child.bounds.max[axis] - origin) / size));
+                qlo = std::min(std::max(qlo, 0), 255);
+                qhi = std::min(std::max(qhi, 0), 255);
+                while (qlo > 0 && origin + float(qlo) * size > child.bounds.min[axis]) --qlo;
+                while (qhi < 255 && origin + float(qhi) * size < child.bounds.max[axis]) ++qhi;
+                lo[axis] = uint32_t(qlo);
+                hi[axis] = uint32_t(qhi);
+            }
+
+            const uint32_t shift = 8 * uint32_t(i);
+            for (int axis = 0; axis < 3; ++axis) node.lo[axis] |= lo[axis] << shift;
+            node.hiX |= hi[0] << shift;
+            node.hiY |= hi[1] << shift;
+            node.hiZ |= hi[2] << shift;
+
+            node.children[i] = child.count > 0 ?
+                BvhBuffer::LEAF | child.count << 24 | child.first :
+                collapse(bvh, children[i], wide);
+        }
+
+        wide[index] = node;
+        return index;
+    }
+
+    BvhBuffer::BvhBuffer()
+        : nodes(GL_SHADER_STORAGE_BUFFER)
+        , indices(GL_SHADER_STORAGE_BUFFER)
+        , numNodes(0)
+        , nodeBytes(0) {
+
+    }
+
+    void BvhBuffer::create() {
+        nodes.create();
+        indices.create();
+        upload(scene::Bvh(), false);
+    }
+
+    void BvhBuffer::destroy() {
+        if (nodes.isCreated()) nodes.destroy();
+        if (indices.isCreated()) indices.destroy();
+    }
+
+    void BvhBuffer::upload(const scene::Bvh& bvh, bool wide) {
+        nodes.bind();
+        if (wide) {
+            const std::vector<WideNode> packed = packWide(bvh);
+            nodes.setData(packed, GL_DYNAMIC_DRAW);
+            numNodes = packed.size();
+            nodeBytes = packed.size() * sizeof(WideNode);
+        } else {
+            const std::vector<BinaryNode> packed = packBinary(bvh);
+            nodes.setData(packed, GL_DYNAMIC_DRAW);
+            numNodes = packed.size();
+            nodeBytes = packed.size() * sizeof(BinaryNode);
+        }
+        nodes.unbind();
+
+        std::vector<uint32_t> list = { uint32_t(bvh.getIndices().size()), uint32_t(bvh.getUnbounded().size()) };
+        list.insert(list.end(), bvh.getIndices().begin(), bvh.getIndices().end());
+        list.insert(list.end(), bvh.getUnbounded().begin(), bvh.getUnbounded().end());
+
+        indices.bind();
+        indices.setData(list, GL_DYNAMIC_DRAW);
+        indices.unbind();
+    }
+
+    void BvhBuffer::allocate(size_t numNodes, size_t numPrimitives) {
+        nodes.bind();
+        nodes.setData(nullptr, GLsizeiptr(numNodes * sizeof(BinaryNode)), GL_DYNAMIC_COPY);
+        nodes.unbind();
+        this->numNodes = numNodes;
+        nodeBytes = numNodes * sizeof(BinaryNode);
+
+        indices.bind();
+        indices.setData(nullptr, GLsizeiptr((2 + numPrimitives) * sizeof(uint32_t)), GL_DYNAMIC_COPY);
+        indices.unbind();
+    }
+
+    void BvhBuffer::bind() const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODES_BINDING, nodes.getHandler());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING, indices.getHandler());
+    }
+
+    size_t BvhBuffer::getNumNodes() const {
+        return numNodes;
+    }
+
+    size_t BvhBuffer::getNodeBytes() const {
+        return nodeBytes;
+    }
+
+    bool BvhBuffer::parseLayout(const std::string& name, GLuint& layout) {
+        if (name == "linear")       layout = BVH_LINEAR;
+        else if (name == "binary")  layout = BVH_BINARY;
+        else if (name == "wide")    layout = BVH_WIDE;
+        else return false;
+        return true;
+    }
+
+    std::vector<BvhBuffer::BinaryNode> BvhBuffer::packBinary(const scene::Bvh& bvh) {
+        std::vector<BinaryNode> packed;
+        for (const scene::Bvh::Node& node : bvh.getNodes()) {
+            BinaryNode p = {};
+            for (int i = 0; i < 3; ++i) {
+                p.min[i] = node.bounds.min[i];
+                p.max[i] = node.bounds.max[i];
+            }
+            p.first = node.first;
+            p.count = node.count;
+            packed.push_back(p);
+        }
+
+        // An empty tree is an inner root whose inverted bounds no ray enters
+        if (packed.empty()) {
+            BinaryNode p = {};
+            for (int i = 0; i < 3; ++i) {
+                p.min[i] = 1.0f;
+                p.max[i] = -1.0f;
+            }
+            packed.push_back(p);
+        }
+
+        return packed;
+    }
+
+    std::vector<BvhBuffer::WideNode> BvhBuffer::packWide(const scene::Bvh& bvh) {
+        std::vector<WideNode> packed;
+
+        // An empty tree is a root without children
+        if (bvh.getNodes().empty()) packed.push_back(WideNode());
+        else collapse(bvh, 0, packed);
+
+        return packed;
+    }
+}
@@ -0,0 +1,132 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_BVHBUFFER_H_
+#define PATHTRACER_BVHBUFFER_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "../opengl/BufferObject.h"
+#include "../scene/Bvh.h"
+
+namespace pathtracer {
+
+    /**
+     * Bounding volume hierarchy of the kernel, two shader storage buffers:
+     * the nodes, in the binary or the wide layout, and the primitive indices
+     * of the leaves followed by the unbounded primitives.
+     *
+     * The binary layout spends 32 bytes per node, with float bounds. The
+     * wide layout collapses the binary tree into nodes of up to 4 children
+     * with 64 bytes per node: the children bounds are quantized to 8 bits
+     * per plane on a grid spanning the node, with a power of two cell size
+     * per axis, so a child costs 6 bytes of bounds and a 4 byte reference.
+     */
+    class BvhBuffer {
+    public:
+
+        /** Shader storage binding points, must match Bvh.glsl */
+        static constexpr GLuint NODES_BINDING = 6;
+        static constexpr GLuint INDICES_BINDING = 7;
+
+        /** Children of a wide node */
+        static constexpr int WIDTH = 4;
+
+        /** Leaf flag of a wide child reference, the count is on bits 24-30 and the first index below */
+        static constexpr uint32_t LEAF = 0x80000000u;
+
+        /** Binary node as the kernel reads it, must match traverse_binary() */
+        struct BinaryNode {
+            float       min[3];     //!< Lower corner
+            uint32_t    first;      //!< Leaf: first index, inner: left child, the right one follows
+            float       max[3];     //!< Upper corner
+            uint32_t    count;      //!< Leaf: number of primitives, inner: 0
+        };
+
+        /** Wide node as the kernel reads it, must match traverse_wide() */
+        struct WideNode {
+            float       origin[3];          //!< Lower corner of the quantization grid
+            uint32_t    exponents;          //!< Biased cell size exponent per axis on the low 3 bytes, children on the high one
+            uint32_t    lo[3];              //!< Quantized lower corner per axis, a byte per child
+            uint32_t    hiX;                //!< Quantized upper corner, a byte per child
+            uint32_t    hiY;
+            uint32_t    hiZ;
+            uint32_t    padding[2];
+            uint32_t    children[WIDTH];    //!< Child node, or LEAF | count << 24 | first index
+        };
+
+        /** Default constructor */
+        BvhBuffer();
+
+        /** Create the buffer objects */
+        void create();
+
+        /** Free the buffer objects */
+        void destroy();
+
+        /**
+         * Upload a tree
+         * @param[in] bvh  Tree of the primitives
+         * @param[in] wide Use the wide layout instead of the binary one?
+         */
+        void upload(const scene::Bvh& bvh, bool wide);
+
+        /**
+         * Size the buffers for a tree the GPU writes, see LbvhBuilder
+         * @param[in] numNodes      Nodes in the binary layout
+         * @param[in] numPrimitives Primitives of the leaves and unbounded ones
+         */
+        void allocate(size_t numNodes, size_t numPrimitives);
+
+        /** Bind the buffers to their binding points */
+        void bind() const;
+
+        /** Get the number of uploaded nodes */
+        size_t getNumNodes() const;
+
+        /** Get the size of the uploaded nodes in bytes */
+        size_t getNodeBytes() const;
+
+        /**
+         * Get a layout by name
+         * @param[in]  name   linear, binary or wide
+         * @param[out] layout BVH_* layout
+         * @return False if the name is unknown
+         */
+        static bool parseLayout(const std::string& name, GLuint& layout);
+
+        /** Pack a tree into the binary layout */
+        static std::vector<BinaryNode> packBinary(const scene::Bvh& bvh);
+
+        /** Collapse a tree into the wide layout */
+        static std::vector<WideNode> packWide(const scene::Bvh& bvh);
+
+    private:
+
+        opengl::BufferObject    nodes;      //!< Packed nodes
+        opengl::BufferObject    indices;    //!< Unbounded offset and count, then the indices
+        size_t                  numNodes;   //!< Uploaded nodes
+        size_t                  nodeBytes;  //!< Size of the uploaded nodes
+    };
+
+}
+
+#endif //PATHTRACER_BVHBUFFER_H_
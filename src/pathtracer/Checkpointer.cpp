@@ -0,0 +1,93 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <iostream>
+
+#include "Checkpointer.h"
+
+namespace pathtracer {
+
+    Checkpointer::Checkpointer()
+        : readback()
+        , path()
+        , interval(60.0f)
+        , last(Clock::now())
+        , lastSamples(0) {
+
+    }
+
+    void Checkpointer::setPath(const std::string& path) {
+        this->path = path;
+    }
+
+    const std::string& Checkpointer::getPath() const {
+        return path;
+    }
+
+    void Checkpointer::setInterval(float seconds) {
+        interval = seconds;
+    }
+
+    bool Checkpointer::isEnabled() const {
+        return !path.empty();
+    }
+
+    bool Checkpointer::isDue(GLuint numSamples) const {
+        if (!isEnabled() || interval <= 0.0f) return false;
+        if (readback.pending() > 0 || numSamples == lastSamples) return false;
+
+        return std::chrono::duration<float>(Clock::now() - last).count() >= interval;
+    }
+
+    void Checkpointer::request(GLuint texture, const io::Checkpoint& state, float scale, bool weighted) {
+        if (!isEnabled()) return;
+
+        last = Clock::now();
+        lastSamples = state.numSamples;
+
+        std::string file = path;
+        readback.request({ texture }, GLsizei(state.width), GLsizei(state.height),
+            [state, file, scale, weighted](const float* texels, GLsizei width, GLsizei height) {
+                io::Checkpoint checkpoint = state;
+
+                // Drop the alpha channel, unless it holds the weight
+                const size_t numPixels = size_t(width) * size_t(height);
+                checkpoint.sums.resize(numPixels * 3);
+                for (size_t p = 0; p < numPixels; ++p) {
+                    const float weight = weighted ? texels[p * 4 + 3] : 1.0f;
+                    const float factor = weight != 0.0f ? scale / weight : 0.0f;
+                    checkpoint.sums[p * 3 + 0] = texels[p * 4 + 0] * factor;
+                    checkpoint.sums[p * 3 + 1] = texels[p * 4 + 1] * factor;
+                    checkpoint.sums[p * 3 + 2] = texels[p * 4 + 2] * factor;
+                }
+
+                try {
+                    io::writeCheckpoint(file, checkpoint);
+                } catch (const io::CheckpointError& e) {
+                    std::cerr << "checkpoint: " << e.what() << std::endl;
+                }
+            });
+    }
+
+    void Checkpointer::poll() {
+        readback.poll();
+    }
+
+    void Checkpointer::finish() {
+        readback.finish();
+    }
+}
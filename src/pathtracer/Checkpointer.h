@@ -0,0 +1,97 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_CHECKPOINTER_H_
+#define PATHTRACER_CHECKPOINTER_H_
+
+#include <string>
+#include <chrono>
+
+#include <glad/glad.h>
+
+#include "../io/Checkpoint.h"
+
+#include "TextureReadback.h"
+
+namespace pathtracer {
+
+    /**
+     * Periodically saves the accumulation state. The texture copy is
+     * asynchronous and the file is written on util::ThreadPool, so the render
+     * loop only pays for one GPU texture copy per interval.
+     */
+    class Checkpointer {
+    public:
+
+        /** Default constructor, checkpoints are disabled */
+        Checkpointer();
+
+        /**
+         * Set checkpoint file
+         * @param[in] path File path, empty disables checkpoints
+         */
+        void setPath(const std::string& path);
+
+        /** Get checkpoint file */
+        const std::string& getPath() const;
+
+        /**
+         * Set time between checkpoints
+         * @param[in] seconds Interval in seconds, <= 0 disables periodic checkpoints
+         */
+        void setInterval(float seconds);
+
+        /** Are checkpoints enabled? */
+        bool isEnabled() const;
+
+        /**
+         * Is it time for a new checkpoint?
+         * @param[in] numSamples Current amount of samples
+         * @return True if the interval elapsed, there are new samples and no
+         *         checkpoint is being written
+         */
+        bool isDue(GLuint numSamples) const;
+
+        /**
+         * Start saving a checkpoint. Must be called from the GL thread.
+         * @param[in] texture   Accumulation texture
+         * @param[in] state     Checkpoint without sums, they are read from texture
+         * @param[in] scale     Turns the texels into sums, the sample count if they are means
+         * @param[in] weighted  Texels are divided by their alpha, the filter weight, before the scale
+         */
+        void request(GLuint texture, const io::Checkpoint& state, float scale = 1.0f, bool weighted = false);
+
+        /** Write checkpoints whose readback finished */
+        void poll();
+
+        /** Block until every pending checkpoint has been written */
+        void finish();
+
+    private:
+
+        using Clock = std::chrono::steady_clock;
+
+        TextureReadback     readback;       //!< Asynchronous texture copies
+        std::string         path;           //!< Checkpoint file
+        float               interval;       //!< Seconds between checkpoints
+        Clock::time_point   last;           //!< Time of the last request
+        GLuint              lastSamples;    //!< Samples saved by the last request
+    };
+
+}
+
+#endif //PATHTRACER_CHECKPOINTER_H_
@@ -0,0 +1,142 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "../util/ThreadPool.h"
+
+#include "DensityGrid.h"
+
+namespace pathtracer {
+
+    DensityGrid::DensityGrid()
+        : path()
+        , density(0)
+        , majorant(0)
+        , size(0) {
+
+    }
+
+    void DensityGrid::create() {
+        clear();
+    }
+
+    void DensityGrid::destroy() {
+        glDeleteTextures(1, &density);
+        glDeleteTextures(1, &majorant);
+        density = majorant = 0;
+    }
+
+    void DensityGrid::load(const std::string& path) {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point start = Clock::now();
+
+        io::Volume volume = io::readVolume(path);
+        upload(volume, buildMajorants(volume));
+        this->path = path;
+
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << "density grid: " << path << ", " << size.x << "x" << size.y << "x" << size.z
+            << ", loaded in " << ms << " ms" << std::endl;
+    }
+
+    void DensityGrid::clear() {
+        io::Volume unit;
+        unit.width = unit.height = unit.depth = 1;
+        unit.density = { 1.0f };
+        upload(unit, buildMajorants(unit));
+        path.clear();
+    }
+
+    void DensityGrid::bind() const {
+        glBindTextureUnit(DENSITY_UNIT, density);
+        glBindTextureUnit(MAJORANT_UNIT, majorant);
+    }
+
+    const std::string& DensityGrid::getPath() const {
+        return path;
+    }
+
+    glm::ivec3 DensityGrid::getSize() const {
+        return size;
+    }
+
+    glm::ivec3 DensityGrid::getCells() const {
+        return (size + CELL_SIZE - 1) / CELL_SIZE;
+    }
+
+    std::vector<float> DensityGrid::buildMajorants(const io::Volume& volume) {
+        const glm::ivec3 size(volume.width, volume.height, volume.depth);
+        const glm::ivec3 cells = (size + CELL_SIZE - 1) / CELL_SIZE;
+        std::vector<float> majorants(size_t(cells.x) * cells.y * cells.z);
+
+        // One slab of cells per task
+        util::ThreadPool::instance().parallelFor(0, size_t(cells.z), 1, [&](size_t begin, size_t end) {
+            for (int cz = int(begin); cz < int(end); ++cz)
+            for (int cy = 0; cy < cells.y; ++cy)
+            for (int cx = 0; cx < cells.x; ++cx) {
+                const glm::ivec3 cell(cx, cy, cz);
+                const glm::ivec3 first = glm::max(cell * CELL_SIZE - 1, 0);
+                const glm::ivec3 last = glm::min((cell + 1) * CELL_SIZE, size - 1);
+
+                float value = 0.0f;
+                for (int z = first.z; z <= last.z; ++z)
+                for (int y = first.y; y <= last.y; ++y) {
+                    const float* row = volume.density.data() + (size_t(z) * size.y + size_t(y)) * size.x;
+                    for (int x = first.x; x <= last.x; ++x) value = std::max(value, row[x]);
+                }
+
+                majorants[(size_t(cz) * cells.y + size_t(cy)) * cells.x + size_t(cx)] = value;
+            }
+        });
+
+        return majorants;
+    }
+
+    void DensityGrid::upload(const io::Volume& volume, const std::vector<float>& majorants) {
+        destroy();
+
+        size = glm::ivec3(volume.width, volume.height, volume.depth);
+        const glm::ivec3 cells = getCells();
+
+        // Half floats round densities up by less than 1/1024, the majorants
+        // keep that margin so tracking never sees a density above them
+        glCreateTextures(GL_TEXTURE_3D, 1, &density);
+        glTextureStorage3D(density, 1, GL_R16F, size.x, size.y, size.z);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTextureSubImage3D(density, 0, 0, 0, 0, size.x, size.y, size.z, GL_RED, GL_FLOAT,
+                volume.density.data());
+        glTextureParameteri(density, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(density, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(density, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(density, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(density, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        std::vector<float> padded(majorants.size());
+        for (size_t i = 0; i < majorants.size(); ++i)
+            padded[i] = std::max(majorants[i], 0.0f) * (1.0f + 1.0f / 1024.0f);
+
+        glCreateTextures(GL_TEXTURE_3D, 1, &majorant);
+        glTextureStorage3D(majorant, 1, GL_R32F, cells.x, cells.y, cells.z);
+        glTextureSubImage3D(majorant, 0, 0, 0, 0, cells.x, cells.y, cells.z, GL_RED, GL_FLOAT, padded.data());
+        glTextureParameteri(majorant, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(majorant, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    }
+}
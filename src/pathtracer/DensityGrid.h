@@ -0,0 +1,103 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PATHTRACER_DENSITYGRID_H_
+#define PATHTRACER_DENSITYGRID_H_
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "../io/Volume.h"
+
+namespace pathtracer {
+
+    /**
+     * Density of the heterogeneous media, a 3D texture stretched over the
+     * bounding box of each sphere filled with one of them. A coarse grid
+     * keeps the largest density around every block of CELL_SIZE^3 voxels:
+     * delta and ratio tracking take their steps with the majorant of the
+     * block they cross, so empty blocks are skipped in a single step.
+     * Without a loaded grid the density is 1 everywhere.
+     */
+    class DensityGrid {
+    public:
+
+        /** Texture units of the density and the majorants, must match Medium.glsl */
+        static constexpr GLuint DENSITY_UNIT = 2;
+        static constexpr GLuint MAJORANT_UNIT = 3;
+
+        /** Voxels per majorant cell along each axis */
+        static constexpr int CELL_SIZE = 8;
+
+        /** Default constructor, without grid */
+        DensityGrid();
+
+        /** Create the textures, with a density of 1 */
+        void create();
+
+        /** Free the textures */
+        void destroy();
+
+        /**
+         * Load a grid and build its majorants
+         * @param[in] path Mitsuba .vol file
+         * @throws io::VolumeError if the file can't be read
+         */
+        void load(const std::string& path);
+
+        /** Go back to a density of 1 */
+        void clear();
+
+        /** Bind the textures to their units */
+        void bind() const;
+
+        /** Get the file of the grid, empty without grid */
+        const std::string& getPath() const;
+
+        /** Get the grid size in voxels */
+        glm::ivec3 getSize() const;
+
+        /** Get the majorant grid size in cells */
+        glm::ivec3 getCells() const;
+
+        /**
+         * Build the majorants of a grid. Trilinear filtering reads one voxel
+         * past the block, so that voxel counts too.
+         * @param[in] volume Density grid
+         * @return Largest density of every cell, x varies fastest
+         */
+        static std::vector<float> buildMajorants(const io::Volume& volume);
+
+    private:
+
+        /** Upload a density grid and its majorants */
+        void upload(const io::Volume& volume, const std::vector<float>& majorants);
+
+        std::string     path;           //!< File of the loaded grid
+        GLuint          density;        //!< Density texture
+        GLuint          majorant;       //!< Majorant texture
+        glm::ivec3      size;           //!< Voxels along each axis
+    };
+
+}
+
+#endif //PATHTRACER_DENSITYGRID_H_
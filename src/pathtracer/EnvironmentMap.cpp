@@ -0,0 +1,299 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <glm/gtc/constants.hpp>
+
+#include "EnvironmentMap.h"
+
+namespace pathtracer {
+
+    // std430 array of 3 scalar structs, 12 bytes per entry
+    static_assert(sizeof(EnvironmentMap::Alias) == 12, "unexpected alias table layout");
+
+    /** Power of two from its exponent, exact for normal floats */
+    static inline float exp2i(int exponent) {
+        uint32_t bits = uint32_t(exponent + 127) << 23;
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    /** Average blocks of filter x filter pixels of rows [y0, y1) into a row of texels */
+    static void boxFilterRow(const float* rgb, int width, int y0, int y1, int filter, float* texels) {
+        const int texWidth = (width + filter - 1) / filter;
+
+        for (int tx = 0; tx < texWidth; ++tx) {
+            const int x0 = tx * filter;
+            const int x1 = std::min(x0 + filter, width);
+
+            float r = 0.0f, g = 0.0f, b = 0.0f;
+            for (int y = y0; y < y1; ++y) {
+                const float* src = rgb + (size_t(y) * size_t(width) + size_t(x0)) * 3;
+                for (int x = x0; x < x1; ++x, src += 3) {
+                    r += src[0];
+                    g += src[1];
+                    b += src[2];
+                }
+            }
+
+            const float norm = 1.0f / float((y1 - y0) * (x1 - x0));
+            texels[tx * 3 + 0] = r * norm;
+            texels[tx * 3 + 1] = g * norm;
+            texels[tx * 3 + 2] = b * norm;
+        }
+    }
+
+    EnvironmentMap::EnvironmentMap()
+        : path()
+        , texture(0)
+        , width(0)
+        , height(0)
+        , tableWidth(0)
+        , tableHeight(0)
+        , tables(GL_SHADER_STORAGE_BUFFER) {
+
+    }
+
+    void EnvironmentMap::create() {
+        tables.create();
+
+        // The kernel binds the tables even without map
+        Alias empty = { 1.0f, 0, 1.0f };
+        tables.bind();
+        tables.setData(&empty, sizeof(empty), GL_STATIC_DRAW);
+        tables.unbind();
+    }
+
+    void EnvironmentMap::destroy() {
+        clear();
+        if (tables.isCreated()) tables.destroy();
+    }
+
+    void EnvironmentMap::load(const std::string& path) {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point start = Clock::now();
+
+        // Fails before any state changes
+        io::ScanlineReader reader(path);
+
+        // Maps over the texture limit are box filtered
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        const int filter = std::max((std::max(reader.width(), reader.height()) + maxSize - 1) / maxSize, 1);
+        const int texWidth = (reader.width() + filter - 1) / filter;
+        const int texHeight = (reader.height() + filter - 1) / filter;
+
+        // Texels per sampling cell
+        const int cellWidth = (texWidth + TABLE_WIDTH - 1) / TABLE_WIDTH;
+        const int cellHeight = (texHeight + TABLE_HEIGHT - 1) / TABLE_HEIGHT;
+        const int cols = (texWidth + cellWidth - 1) / cellWidth;
+        const int rows = (texHeight + cellHeight - 1) / cellHeight;
+
+        // Texels aren't zero filled, the tasks touch their pages first
+        std::unique_ptr<uint32_t[]> texels(new uint32_t[size_t(texWidth) * size_t(texHeight)]);
+        std::vector<Alias> aliases(size_t(rows) + size_t(rows) * size_t(cols));
+        std::vector<double> rowWeights(static_cast<size_t>(rows));
+
+        // Every block of rows becomes a row of cells: pack its texels, then
+        // weight the cells by luminance and by the solid angle they cover
+        reader.decode(filter * cellHeight, [&](int first, int count, const float* rgb) {
+            const size_t srcWidth = size_t(reader.width());
+            const int texFirst = first / filter;
+            const int texRows = (count + filter - 1) / filter;
+            const int row = texFirst / cellHeight;
+
+            std::vector<double> weights(size_t(cols), 0.0);
+            std::vector<float> filtered(filter > 1 ? size_t(texWidth) * 3 : 0);
+            std::vector<uint32_t> small, large;
+
+            for (int ty = 0; ty < texRows; ++ty) {
+                const float* texRow = rgb + size_t(ty) * srcWidth * 3;
+                if (filter > 1) {
+                    boxFilterRow(rgb, reader.width(), ty * filter, std::min(ty * filter + filter, count),
+                            filter, filtered.data());
+                    texRow = filtered.data();
+                }
+
+                uint32_t* dst = texels.get() + size_t(texFirst + ty) * size_t(texWidth);
+
+                // A local sum per cell keeps the adds independent
+                for (int col = 0; col < cols; ++col) {
+                    const int x1 = std::min((col + 1) * cellWidth, texWidth);
+                    float luminance = 0.0f;
+
+                    for (int x = col * cellWidth; x < x1; ++x) {
+                        const float* texel = texRow + size_t(x) * 3;
+                        dst[x] = packRGB9E5(texel[0], texel[1], texel[2]);
+                        luminance += 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+                    }
+
+                    weights[size_t(col)] += double(luminance);
+                }
+            }
+
+            const double sinTheta = std::sin((row + 0.5) / rows * glm::pi<double>());
+            for (double& weight : weights) weight = std::max(0.0, weight) * sinTheta;
+
+            rowWeights[size_t(row)] = buildAliasTable(weights,
+                    aliases.data() + size_t(rows) + size_t(row) * size_t(cols), small, large);
+        });
+
+        std::vector<uint32_t> small, large;
+        buildAliasTable(rowWeights, aliases.data(), small, large);
+        const Clock::time_point built = Clock::now();
+
+        // Upload
+        clear();
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, 1, GL_RGB9_E5, texWidth, texHeight);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTextureSubImage2D(texture, 0, 0, 0, texWidth, texHeight, GL_RGB,
+                GL_UNSIGNED_INT_5_9_9_9_REV, texels.get());
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        tables.bind();
+        tables.setData(aliases, GL_STATIC_DRAW);
+        tables.unbind();
+
+        this->path = path;
+        width = texWidth;
+        height = texHeight;
+        tableWidth = cols;
+        tableHeight = rows;
+
+        const double buildMs = std::chrono::duration<double, std::milli>(built - start).count();
+        const double uploadMs = std::chrono::duration<double, std::milli>(Clock::now() - built).count();
+        std::cout << "environment: " << path << ", " << reader.width() << "x" << reader.height()
+            << ", " << cols << "x" << rows << " sampling cells, built in " << buildMs
+            << " ms, uploaded in " << uploadMs << " ms" << std::endl;
+    }
+
+    void EnvironmentMap::clear() {
+        glDeleteTextures(1, &texture);
+        texture = 0;
+        path.clear();
+        width = height = 0;
+        tableWidth = tableHeight = 0;
+    }
+
+    void EnvironmentMap::bind() const {
+        glBindTextureUnit(TEXTURE_UNIT, texture);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, tables.getHandler());
+    }
+
+    bool EnvironmentMap::isLoaded() const {
+        return texture != 0;
+    }
+
+    const std::string& EnvironmentMap::getPath() const {
+        return path;
+    }
+
+    GLsizei EnvironmentMap::getWidth() const {
+        return width;
+    }
+
+    GLsizei EnvironmentMap::getHeight() const {
+        return height;
+    }
+
+    GLsizei EnvironmentMap::getTableWidth() const {
+        return tableWidth;
+    }
+
+    GLsizei EnvironmentMap::getTableHeight() const {
+        return tableHeight;
+    }
+
+    double EnvironmentMap::buildAliasTable(std::vector<double>& weights, Alias* table,
+            std::vector<uint32_t>& small, std::vector<uint32_t>& large) {
+        const size_t n = weights.size();
+
+        double sum = 0.0;
+        for (double weight : weights) sum += weight;
+
+        if (!(sum > 0.0)) {
+            for (size_t i = 0; i < n; ++i)
+                table[i] = { 1.0f, uint32_t(i), float(1.0 / double(n)) };
+            return 0.0;
+        }
+
+        // Weights become probabilities scaled by n, 1 on average
+        small.clear();
+        large.clear();
+        for (size_t i = 0; i < n; ++i) {
+            table[i].pmf = float(weights[i] / sum);
+            weights[i] *= double(n) / sum;
+            (weights[i] < 1.0 ? small : large).push_back(uint32_t(i));
+        }
+
+        // Every small entry is topped up by a large one
+        while (!small.empty() && !large.empty()) {
+            const uint32_t s = small.back();
+            const uint32_t l = large.back();
+            small.pop_back();
+            large.pop_back();
+
+            table[s].prob = float(weights[s]);
+            table[s].alias = l;
+
+            weights[l] = (weights[l] + weights[s]) - 1.0;
+            (weights[l] < 1.0 ? small : large).push_back(l);
+        }
+
+        // Leftovers are 1 up to rounding errors
+        for (uint32_t i : large) table[i].prob = 1.0f, table[i].alias = i;
+        for (uint32_t i : small) table[i].prob = 1.0f, table[i].alias = i;
+
+        return sum;
+    }
+
+    uint32_t EnvironmentMap::packRGB9E5(float r, float g, float b) {
+        // EXT_texture_shared_exponent: 9 bit mantissas, 5 bit exponent, bias 15.
+        // max(0, x) also turns NaNs into 0.
+        const float maxValue = 65408.0f;
+        r = std::min(std::max(0.0f, r), maxValue);
+        g = std::min(std::max(0.0f, g), maxValue);
+        b = std::min(std::max(0.0f, b), maxValue);
+        const float maxChannel = std::max(r, std::max(g, b));
+
+        // floor(log2(maxChannel)) from the float exponent bits
+        int32_t bits;
+        std::memcpy(&bits, &maxChannel, sizeof(bits));
+        int32_t exponent = std::max((bits >> 23) - 127, -16) + 16;
+
+        // Mantissas fit in 10 bits, int32 conversions are the fast ones
+        float scale = exp2i(24 - exponent);
+        if (int32_t(maxChannel * scale + 0.5f) == 512) {
+            ++exponent;
+            scale *= 0.5f;
+        }
+
+        return uint32_t(int32_t(r * scale + 0.5f)) | (uint32_t(int32_t(g * scale + 0.5f)) << 9) |
+            (uint32_t(int32_t(b * scale + 0.5f)) << 18) | (uint32_t(exponent) << 27);
+    }
+}
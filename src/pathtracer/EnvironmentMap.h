@@ -0,0 +1,125 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_ENVIRONMENTMAP_H_
+#define PATHTRACER_ENVIRONMENTMAP_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "../opengl/BufferObject.h"
+#include "../io/ScanlineReader.h"
+
+namespace pathtracer {
+
+    /**
+     * Equirectangular HDR environment, lights every path that escapes the
+     * scene. The radiance lives in a RGB9_E5 texture, 4 bytes per texel.
+     * Directions are importance sampled with alias tables over a grid of
+     * at most TABLE_WIDTH x TABLE_HEIGHT cells: a marginal table picks the
+     * row, the conditional table of that row picks the column, both in
+     * constant time. Decoding, texel packing and the tables are built in
+     * parallel, one block of rows per task.
+     */
+    class EnvironmentMap {
+    public:
+
+        /** Texture unit of the radiance, must match Environment.glsl */
+        static constexpr GLuint TEXTURE_UNIT = 1;
+
+        /** Shader storage binding of the sampling tables, must match Environment.glsl */
+        static constexpr GLuint BINDING = 2;
+
+        /** Largest sampling table, bigger maps average blocks of texels per cell */
+        static constexpr int TABLE_WIDTH = 2048;
+        static constexpr int TABLE_HEIGHT = 1024;
+
+        /** Alias table entry as the kernel reads it */
+        struct Alias {
+            float       prob;   //!< Probability of keeping this entry instead of the alias
+            uint32_t    alias;  //!< Entry taken otherwise
+            float       pmf;    //!< Probability of picking this entry
+        };
+
+        /** Default constructor, without map */
+        EnvironmentMap();
+
+        /** Create the texture and buffer objects */
+        void create();
+
+        /** Free the texture and buffer objects */
+        void destroy();
+
+        /**
+         * Load a map and build its sampling tables
+         * @param[in] path .pfm or .hdr equirectangular image, +Y up
+         * @throws io::ImageIOError if the image can't be read
+         */
+        void load(const std::string& path);
+
+        /** Drop the map, escaped paths see the default sky again */
+        void clear();
+
+        /** Bind the texture and tables to their units */
+        void bind() const;
+
+        /** Is a map loaded? */
+        bool isLoaded() const;
+
+        /** Get the file of the map, empty without map */
+        const std::string& getPath() const;
+
+        /** Get the map size in texels */
+        GLsizei getWidth() const;
+        GLsizei getHeight() const;
+
+        /** Get the sampling grid size in cells */
+        GLsizei getTableWidth() const;
+        GLsizei getTableHeight() const;
+
+        /**
+         * Build an alias table of the weights with Vose's method
+         * @param[in]  weights  Non negative weights, uniform if they add to 0.
+         *                      Overwritten with scratch values.
+         * @param[out] table    Entries, as many as weights
+         * @param[out] small    Scratch index list
+         * @param[out] large    Scratch index list
+         * @return Sum of the weights
+         */
+        static double buildAliasTable(std::vector<double>& weights, Alias* table,
+                std::vector<uint32_t>& small, std::vector<uint32_t>& large);
+
+        /** Pack a color into the RGB9_E5 shared exponent format */
+        static uint32_t packRGB9E5(float r, float g, float b);
+
+    private:
+
+        std::string             path;           //!< File of the loaded map
+        GLuint                  texture;        //!< Radiance, 0 without map
+        GLsizei                 width;          //!< Texture width
+        GLsizei                 height;         //!< Texture height
+        GLsizei                 tableWidth;     //!< Sampling grid columns
+        GLsizei                 tableHeight;    //!< Sampling grid rows
+        opengl::BufferObject    tables;         //!< Marginal table, then one conditional table per row
+    };
+
+}
+
+#endif //PATHTRACER_ENVIRONMENTMAP_H_
@@ -0,0 +1,116 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "../util/ThreadPool.h"
+
+#include "ImageExporter.h"
+
+namespace pathtracer {
+
+    ImageExporter::ImageExporter()
+        : readback()
+        , exrOptions() {
+
+    }
+
+    void ImageExporter::request(const std::vector<Layer>& layers, GLsizei width, GLsizei height,
+            GLuint numSamples, const std::string& path) {
+        std::vector<GLuint> textures;
+        std::vector<std::string> names;
+        std::vector<float> scales;
+        std::vector<bool> weighted;
+        for (const Layer& layer : layers) {
+            textures.push_back(layer.texture);
+            names.push_back(layer.name);
+            scales.push_back(layer.mean || layer.weighted ? 1.0f : 1.0f / float(std::max(numSamples, 1u)));
+            weighted.push_back(layer.weighted);
+        }
+
+        io::ExrOptions options = exrOptions;
+        readback.request(textures, width, height,
+            [names, scales, weighted, path, options](const float* texels, GLsizei w, GLsizei h) {
+                encode(texels, w, h, names, scales, weighted, path, options);
+            });
+    }
+
+    void ImageExporter::poll() {
+        readback.poll();
+    }
+
+    void ImageExporter::finish() {
+        readback.finish();
+    }
+
+    size_t ImageExporter::pending() const {
+        return readback.pending();
+    }
+
+    void ImageExporter::setExrOptions(const io::ExrOptions& options) {
+        exrOptions = options;
+    }
+
+    const io::ExrOptions& ImageExporter::getExrOptions() const {
+        return exrOptions;
+    }
+
+    void ImageExporter::encode(const float* texels, GLsizei width, GLsizei height,
+            const std::vector<std::string>& layers, const std::vector<float>& scales,
+            const std::vector<bool>& weighted, const std::string& path, const io::ExrOptions& options) {
+        auto start = std::chrono::steady_clock::now();
+
+        // Beauty goes to R, G, B; other layers use "layer.R", ...
+        std::vector<std::string> channels;
+        for (const std::string& layer : layers)
+            for (const char* c : { "R", "G", "B" })
+                channels.push_back(layer.empty() ? c : layer + "." + c);
+
+        io::Image image(width, height, channels);
+
+        const size_t numPixels = size_t(width) * size_t(height);
+        const size_t numLayers = layers.size();
+
+        // Average the sample sums and drop the alpha, unless it holds their
+        // weight. Pixels without weight are black.
+        util::ThreadPool::instance().parallelFor(0, numPixels, 1 << 16, [&](size_t first, size_t last) {
+            for (size_t l = 0; l < numLayers; ++l) {
+                const float* src = texels + l * numPixels * 4;
+                for (size_t p = first; p < last; ++p) {
+                    const float weight = weighted[l] ? src[p * 4 + 3] : 1.0f;
+                    const float scale = weight != 0.0f ? scales[l] / weight : 0.0f;
+                    float* dst = image.data() + p * numLayers * 3 + l * 3;
+                    dst[0] = src[p * 4 + 0] * scale;
+                    dst[1] = src[p * 4 + 1] * scale;
+                    dst[2] = src[p * 4 + 2] * scale;
+                }
+            }
+        });
+
+        try {
+            io::writeImage(path, image, options);
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+            std::cout << "export: " << path << " (" << elapsed.count() << " ms)" << std::endl;
+        } catch (const io::ImageIOError& e) {
+            std::cerr << "export: " << e.what() << std::endl;
+        }
+    }
+}
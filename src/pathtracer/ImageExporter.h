@@ -0,0 +1,100 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_IMAGEEXPORTER_H_
+#define PATHTRACER_IMAGEEXPORTER_H_
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "../io/ImageIO.h"
+
+#include "TextureReadback.h"
+
+namespace pathtracer {
+
+    /**
+     * Exports accumulation textures to disk without stalling the render loop.
+     * Textures are fetched with a TextureReadback, then normalized and encoded
+     * on util::ThreadPool straight from the mapped memory.
+     */
+    class ImageExporter {
+    public:
+
+        /** Accumulation texture written as one image layer */
+        struct Layer {
+            std::string name;       //!< Layer name, empty for the beauty pass
+            GLuint      texture;    //!< Texture holding sample sums
+            bool        mean = false;   //!< Holds the mean of the samples instead of their sums
+            bool        weighted = false;   //!< Alpha holds the filter weight of the sums instead of the sample count
+        };
+
+        /** Default constructor */
+        ImageExporter();
+
+        /**
+         * Start reading back the given textures. Must be called from the GL thread.
+         * @param[in] layers        Textures to export, all of them width x height
+         * @param[in] width         Textures width
+         * @param[in] height        Textures height
+         * @param[in] numSamples    Samples accumulated on the textures
+         * @param[in] path          Output file, the extension selects the format
+         */
+        void request(const std::vector<Layer>& layers, GLsizei width, GLsizei height,
+                GLuint numSamples, const std::string& path);
+
+        /** Hand finished readbacks to the encoder and release finished exports */
+        void poll();
+
+        /** Block until every pending export has been written */
+        void finish();
+
+        /** Get number of exports in flight */
+        size_t pending() const;
+
+        /** Set options used for OpenEXR files */
+        void setExrOptions(const io::ExrOptions& options);
+
+        /** Get options used for OpenEXR files */
+        const io::ExrOptions& getExrOptions() const;
+
+    private:
+
+        /**
+         * Build the image from the readback texels and write it
+         * @param[in] texels        RGBA sample sums of every layer
+         * @param[in] width         Image width
+         * @param[in] height        Image height
+         * @param[in] layers        Layer names, in texels order
+         * @param[in] scales        Factor that normalizes every layer
+         * @param[in] weighted      Layers divided by their alpha before the factor
+         * @param[in] path          Output file
+         * @param[in] options       OpenEXR options
+         */
+        static void encode(const float* texels, GLsizei width, GLsizei height,
+                const std::vector<std::string>& layers, const std::vector<float>& scales,
+                const std::vector<bool>& weighted, const std::string& path, const io::ExrOptions& options);
+
+        TextureReadback readback;   //!< Asynchronous texture copies
+        io::ExrOptions  exrOptions; //!< OpenEXR options
+    };
+
+}
+
+#endif //PATHTRACER_IMAGEEXPORTER_H_
@@ -0,0 +1,277 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <tuple>
+#include <iostream>
+
+#include "../opengl/Extensions.h"
+
+#include "KernelVariants.h"
+
+namespace pathtracer {
+
+    bool KernelSettings::operator<(const KernelSettings& other) const {
+        return std::tie(bounces, materials, aovs, sampler, filter, sort, persistent, compensated, tileCulling,
+                        thinLens, motionBlur, environment, media, primitives, sdfSteps, bvh) <
+               std::tie(other.bounces, other.materials, other.aovs, other.sampler, other.filter, other.sort,
+                        other.persistent, other.compensated, other.tileCulling, other.thinLens,
+                        other.motionBlur, other.environment, other.media, other.primitives,
+                        other.sdfSteps, other.bvh);
+    }
+
+    void KernelSettings::inject(ShaderPreprocessor& preprocessor) const {
+        preprocessor.define("FIXED_BOUNCES", std::to_string(bounces) + "u");
+        preprocessor.define("MATERIAL_MASK", std::to_string(materials));
+        preprocessor.define("FIXED_AOVS", std::to_string(aovs) + "u");
+        preprocessor.define("TRAVERSAL_STATS", (aovs & AOV_STATS) ? "1" : "0");
+        preprocessor.define("FIXED_SAMPLER", std::to_string(sampler) + "u");
+        preprocessor.define("FIXED_FILTER", std::to_string(filter) + "u");
+        preprocessor.define("FIXED_SORT", sort ? "true" : "false");
+        preprocessor.define("FIXED_PERSISTENT", persistent ? "true" : "false");
+        preprocessor.define("FIXED_COMPENSATED", compensated ? "true" : "false");
+        preprocessor.define("FIXED_TILE_CULLING", tileCulling ? "1" : "0");
+        preprocessor.define("FIXED_THIN_LENS", thinLens ? "1" : "0");
+        preprocessor.define("FIXED_MOTION_BLUR", motionBlur ? "1" : "0");
+        preprocessor.define("FIXED_ENVIRONMENT", environment ? "1" : "0");
+        preprocessor.define("FIXED_MEDIA", media ? "1" : "0");
+        preprocessor.define("PRIMITIVE_MASK", std::to_string(primitives));
+        preprocessor.define("FIXED_SDF_STEPS", std::to_string(sdfSteps) + "u");
+        preprocessor.define("FIXED_BVH", std::to_string(bvh));
+    }
+
+    KernelVariants::KernelVariants()
+        : programCache(nullptr)
+        , variants()
+        , generation(0)
+        , thread()
+        , mutex()
+        , wakeUp()
+        , running(false)
+        , jobs()
+        , done() {
+
+    }
+
+    KernelVariants::~KernelVariants() {
+        // The context may be gone already, only join the thread
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wakeUp.notify_all();
+        if (thread.joinable()) thread.join();
+    }
+
+    void KernelVariants::setProgramCache(const ProgramCache* cache) {
+        programCache = cache;
+    }
+
+    void KernelVariants::setBackgroundContext(ContextFunction makeCurrent, ContextFunction doneCurrent) {
+        if (thread.joinable()) return;
+
+        running = true;
+        thread = std::thread(&KernelVariants::loop, this, makeCurrent, doneCurrent);
+    }
+
+    opengl::ShaderProgram* KernelVariants::get(const KernelSettings& settings,
+            const ShaderPreprocessor& preprocessor, const std::string& path) {
+        auto it = variants.find(settings);
+        if (it != variants.end())
+            return it->second.state == State::READY ? it->second.program.get() : nullptr;
+
+        Variant& variant = variants[settings];
+
+        ShaderPreprocessor variantPreprocessor = preprocessor;
+        settings.inject(variantPreprocessor);
+        try {
+            variant.source = variantPreprocessor.process(path);
+        } catch (const ShaderError& e) {
+            std::cerr << "kernel variant: " << e.what() << std::endl;
+            variant.state = State::FAILED;
+            return nullptr;
+        }
+
+        // Cached binaries load fast enough for the render thread
+        variant.program = std::make_unique<opengl::ShaderProgram>();
+        if (programCache) {
+            variant.key = programCache->key({ variant.source.code }, variantPreprocessor.getDefines());
+            if (programCache->load(*variant.program, variant.key)) {
+                variant.state = State::READY;
+                return variant.program.get();
+            }
+        }
+
+        if (opengl::hasParallelShaderCompile()) {
+            startBuild(variant);
+        } else if (running) {
+            auto job = std::make_unique<Job>();
+            job->settings = settings;
+            job->source = variant.source;
+            job->generation = generation;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(std::move(job));
+            }
+            wakeUp.notify_all();
+        } else {
+            // Nowhere to build in the background
+            startBuild(variant);
+            finishBuild(variant);
+        }
+
+        return variant.state == State::READY ? variant.program.get() : nullptr;
+    }
+
+    void KernelVariants::poll() {
+        // Parallel builds of the driver
+        for (auto& entry : variants) {
+            Variant& variant = entry.second;
+            if (variant.state == State::BUILDING && variant.shader && variant.program->isCompletionDone())
+                finishBuild(variant);
+        }
+
+        // Builds of the background thread
+        std::vector<std::unique_ptr<Job>> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.swap(done);
+        }
+
+        for (auto& job : finished) {
+            auto it = variants.find(job->settings);
+            if (job->generation != generation || it == variants.end()) {
+                if (job->program->isCreated()) job->program->destroy();
+                continue;
+            }
+
+            it->second.program = std::move(job->program);
+            complete(it->second, job->linked, job->log);
+        }
+    }
+
+    size_t KernelVariants::pending() const {
+        size_t count = 0;
+        for (const auto& entry : variants)
+            if (entry.second.state == State::BUILDING) ++count;
+        return count;
+    }
+
+    void KernelVariants::clear() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.clear();
+        }
+
+        // Builds in flight are discarded by poll()
+        ++generation;
+
+        for (auto& entry : variants) {
+            Variant& variant = entry.second;
+            if (variant.shader) variant.shader->destroy();
+            if (variant.program && variant.program->isCreated()) variant.program->destroy();
+        }
+
+        variants.clear();
+    }
+
+    void KernelVariants::destroy() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wakeUp.notify_all();
+        if (thread.joinable()) thread.join();
+
+        for (auto& job : done)
+            if (job->program->isCreated()) job->program->destroy();
+        done.clear();
+
+        clear();
+    }
+
+    void KernelVariants::startBuild(Variant& variant) {
+        variant.shader = std::make_unique<opengl::ShaderObject>(GL_COMPUTE_SHADER, variant.source.code);
+        variant.shader->create();
+        variant.shader->compileAsync();
+
+        variant.program->create();
+        variant.program->setBinaryRetrievable();
+        variant.program->attach(*variant.shader);
+        variant.program->linkAsync();
+    }
+
+    void KernelVariants::finishBuild(Variant& variant) {
+        variant.shader->updateCompileStatus();
+        variant.program->updateLinkStatus();
+
+        const std::string log = variant.source.remapLog(variant.shader->getCompileLog()) +
+                                variant.program->getLinkLog();
+        variant.shader->destroy();
+        variant.shader.reset();
+
+        complete(variant, variant.program->getLinkStatus() != GL_FALSE, log);
+    }
+
+    void KernelVariants::complete(Variant& variant, bool linked, const std::string& log) {
+        if (!linked) {
+            std::cerr << "kernel variant: build failed, using the generic kernel\n" << log << std::endl;
+            variant.program->destroy();
+            variant.state = State::FAILED;
+            return;
+        }
+
+        variant.state = State::READY;
+        if (programCache) programCache->store(*variant.program, variant.key);
+    }
+
+    void KernelVariants::loop(ContextFunction makeCurrent, ContextFunction doneCurrent) {
+        makeCurrent();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wakeUp.wait(lock, [this]() { return !running || !jobs.empty(); });
+            if (!running) break;
+
+            std::unique_ptr<Job> job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            opengl::ShaderObject shader(GL_COMPUTE_SHADER, job->source.code);
+            shader.create();
+            shader.compile();
+
+            job->program = std::make_unique<opengl::ShaderProgram>();
+            job->program->create();
+            job->program->setBinaryRetrievable();
+            job->program->attach(shader);
+            job->program->link();
+
+            job->linked = job->program->getLinkStatus() != GL_FALSE;
+            job->log = job->source.remapLog(shader.getCompileLog()) + job->program->getLinkLog();
+            shader.destroy();
+
+            // The program must be complete before the render context uses it
+            glFinish();
+
+            lock.lock();
+            done.push_back(std::move(job));
+        }
+
+        lock.unlock();
+        doneCurrent();
+    }
+}
@@ -0,0 +1,216 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_KERNELVARIANTS_H_
+#define PATHTRACER_KERNELVARIANTS_H_
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include <glad/glad.h>
+
+#include "../opengl/ShaderObject.h"
+#include "../opengl/ShaderProgram.h"
+
+#include "../util/Hash.h"
+
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+
+namespace pathtracer {
+
+    // Kernel outputs besides the image, must match PathTracer.comp
+    static constexpr GLuint AOV_ALBEDO  = 1;    //!< First hit albedo
+    static constexpr GLuint AOV_NORMAL  = 2;    //!< First hit normal
+    static constexpr GLuint AOV_STATS   = 4;    //!< Nodes visited, primitives tested, bounces and rays, debug kernel only
+
+    // Sample generators, must match Sampler.glsl
+    static constexpr GLuint SAMPLER_INDEPENDENT = 0;    //!< Independent pseudo random numbers
+    static constexpr GLuint SAMPLER_KRONECKER   = 1;    //!< Low discrepancy Kronecker sequence
+
+    // Reconstruction filters, must match Filter.glsl. Filters past the box
+    // splat every sample over the pixels around it.
+    static constexpr GLuint FILTER_NONE     = 0;    //!< Rays through the pixel corners, no antialiasing
+    static constexpr GLuint FILTER_BOX      = 1;    //!< Rays through a random point of the pixel
+    static constexpr GLuint FILTER_GAUSSIAN = 2;    //!< Gaussian of half a pixel standard deviation, radius 1.5
+    static constexpr GLuint FILTER_BLACKMAN_HARRIS = 3; //!< Blackman-Harris window, radius 1.5
+    static constexpr GLuint FILTER_MITCHELL = 4;    //!< Mitchell-Netravali with B = C = 1/3, radius 2
+
+    // Bounding volume hierarchy layouts, must match Bvh.glsl
+    static constexpr GLuint BVH_LINEAR  = 0;    //!< No hierarchy, rays test every primitive
+    static constexpr GLuint BVH_BINARY  = 2;    //!< Binary tree with float bounds
+    static constexpr GLuint BVH_WIDE    = 4;    //!< 4-wide tree with quantized bounds
+
+    // Smallest number of bounded primitives worth a hierarchy
+    static constexpr size_t BVH_MIN_PRIMITIVES = 16;
+
+    // Smallest scene worth culling per tile, must match TileCulling.glsl
+    static constexpr size_t TILE_MIN_PRIMITIVES = 16;
+
+    /** Render settings a kernel variant is compiled for */
+    struct KernelSettings {
+        GLuint  bounces     = 10;   //!< Max number of ray bounces
+        GLuint  materials   = 0x7;  //!< Material types in use, one bit per type
+        GLuint  aovs        = 0;    //!< Enabled AOV_* outputs, AOV_STATS compiles the traversal counters in
+        GLuint  sampler     = SAMPLER_INDEPENDENT;  //!< SAMPLER_* generator
+        GLuint  filter      = FILTER_NONE;  //!< FILTER_* reconstruction filter
+        bool    sort        = false;    //!< Sort paths by material before shading
+        bool    persistent  = false;    //!< Resident workgroups take pixels from a work queue
+        bool    compensated = false;    //!< Kahan summation of the accumulated image
+        bool    tileCulling = false;    //!< Cull the primitives of the primary rays per workgroup tile
+        bool    thinLens    = false;    //!< Sample the lens, false for a pinhole camera
+        bool    motionBlur  = false;    //!< Sample the shutter time
+        bool    environment = false;    //!< Light with an environment map
+        bool    media       = false;    //!< Dielectrics filled with participating media
+        GLuint  primitives  = 0x7F; //!< Primitive types in use, one bit per type
+        GLuint  sdfSteps    = 128;  //!< Sphere tracing step cap of signed distance functions
+        GLuint  bvh         = BVH_LINEAR;   //!< BVH_* layout of the scene hierarchy
+
+        bool operator<(const KernelSettings& other) const;
+
+        /** Add the defines that fix these settings in the kernel */
+        void inject(ShaderPreprocessor& preprocessor) const;
+
+        /**
+         * Add the settings that change the accumulated image to a hash, a
+         * checkpoint can't resume with others. The rest only change how the
+         * image is computed, or follow from the scene.
+         * @param[in] hash Hash to add them to
+         */
+        void addImageSettings(util::Hash& hash) const {
+            hash.addValue(bounces);
+            hash.addValue(aovs);
+            hash.addValue(sampler);
+            hash.addValue(filter);
+            hash.addValue(sdfSteps);
+        }
+    };
+
+    /**
+     * Kernels specialized for the current render settings. Fixing settings
+     * at compile time lets the compiler unroll the bounce loop, drop unused
+     * material types and remove disabled outputs. Variants are compiled in
+     * the background, with KHR_parallel_shader_compile when the driver
+     * supports it or on a thread with its own context otherwise, while the
+     * generic kernel renders.
+     */
+    class KernelVariants {
+    public:
+
+        /** Makes the background context current on the calling thread, or releases it */
+        using ContextFunction = std::function<void()>;
+
+        /** Default constructor, without variants */
+        KernelVariants();
+
+        /** Stop the background thread */
+        ~KernelVariants();
+
+        /**
+         * Look up and store variants in a program cache
+         * @param[in] cache Program cache, nullptr disables it
+         */
+        void setProgramCache(const ProgramCache* cache);
+
+        /**
+         * Compile on a thread with its own context when the driver can't
+         * compile in parallel. Without it variants are built synchronously.
+         * @param[in] makeCurrent   Makes current a context sharing objects with the render context
+         * @param[in] doneCurrent   Releases that context
+         */
+        void setBackgroundContext(ContextFunction makeCurrent, ContextFunction doneCurrent);
+
+        /**
+         * Get the variant of some settings, building it if needed
+         * @param[in] settings      Render settings
+         * @param[in] preprocessor  Preprocessor of the generic kernel
+         * @param[in] path          Kernel file
+         * @return The variant, nullptr while it is built or if it failed
+         */
+        opengl::ShaderProgram* get(const KernelSettings& settings,
+                const ShaderPreprocessor& preprocessor, const std::string& path);
+
+        /** Collect the variants whose build finished */
+        void poll();
+
+        /** Get number of variants being built */
+        size_t pending() const;
+
+        /** Destroy every variant, e.g. after the kernel source changed */
+        void clear();
+
+        /** Stop the background thread and destroy every variant */
+        void destroy();
+
+    private:
+
+        enum class State { BUILDING, READY, FAILED };
+
+        /** A kernel variant */
+        struct Variant {
+            State                                   state = State::BUILDING;
+            std::unique_ptr<opengl::ShaderProgram>  program;    //!< Linked program
+            std::unique_ptr<opengl::ShaderObject>   shader;     //!< Shader being compiled in parallel
+            ShaderSource                            source;     //!< Preprocessed kernel
+            uint64_t                                key = 0;    //!< Program cache key
+        };
+
+        /** Variant build on the background thread */
+        struct Job {
+            KernelSettings                          settings;
+            ShaderSource                            source;
+            unsigned int                            generation;
+            std::unique_ptr<opengl::ShaderProgram>  program;    //!< Result
+            bool                                    linked = false;
+            std::string                             log;
+        };
+
+        /** Start compiling and linking without waiting */
+        void startBuild(Variant& variant);
+
+        /** Wait for the build and check its result */
+        void finishBuild(Variant& variant);
+
+        /** Move a finished program into its variant */
+        void complete(Variant& variant, bool linked, const std::string& log);
+
+        /** Background thread main loop */
+        void loop(ContextFunction makeCurrent, ContextFunction doneCurrent);
+
+        const ProgramCache*                     programCache;   //!< Optional binary cache
+        std::map<KernelSettings, Variant>       variants;       //!< Variants by settings
+        unsigned int                            generation;     //!< Increased by clear()
+
+        std::thread                             thread;         //!< Background build thread
+        mutable std::mutex                      mutex;          //!< Protects members below
+        std::condition_variable                 wakeUp;         //!< Signals new jobs or stop
+        bool                                    running;        //!< Is the thread running?
+        std::deque<std::unique_ptr<Job>>        jobs;           //!< Builds not started
+        std::vector<std::unique_ptr<Job>>       done;           //!< Builds finished
+    };
+
+}
+
+#endif //PATHTRACER_KERNELVARIANTS_H_
@@ -0,0 +1,176 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "LbvhBuilder.h"
+
+namespace pathtracer {
+
+    /** Radix passes over the 32 bit keys, even so the sorted keys end where they started */
+    static constexpr GLuint RADIX_PASSES = 8;
+    static constexpr GLuint DIGIT_BITS = 4;
+    static constexpr GLuint RADIX = 1u << DIGIT_BITS;
+
+    static_assert(RADIX_PASSES * DIGIT_BITS == 32 && RADIX_PASSES % 2 == 0, "unexpected radix passes");
+
+    LbvhBuilder::LbvhBuilder()
+        : programs()
+        , state(GL_SHADER_STORAGE_BUFFER)
+        , boxes(GL_SHADER_STORAGE_BUFFER)
+        , keys{ opengl::BufferObject(GL_SHADER_STORAGE_BUFFER), opengl::BufferObject(GL_SHADER_STORAGE_BUFFER) }
+        , histogram(GL_SHADER_STORAGE_BUFFER)
+        , slots(GL_SHADER_STORAGE_BUFFER)
+        , visits(GL_SHADER_STORAGE_BUFFER)
+        , capacity(0)
+        , timer(0)
+        , timing(false)
+        , milliseconds(0.0) {
+
+    }
+
+    void LbvhBuilder::create() {
+        state.create();
+        boxes.create();
+        keys[0].create();
+        keys[1].create();
+        histogram.create();
+        slots.create();
+        visits.create();
+        glGenQueries(1, &timer);
+        capacity = 0;
+        reserve(1);
+    }
+
+    void LbvhBuilder::destroy() {
+        for (opengl::ShaderProgram& program : programs) {
+            if (program.isCreated()) program.destroy();
+        }
+
+        for (opengl::BufferObject* buffer : { &state, &boxes, &keys[0], &keys[1], &histogram, &slots, &visits }) {
+            if (buffer->isCreated()) buffer->destroy();
+        }
+
+        if (timer != 0) glDeleteQueries(1, &timer);
+        timer = 0;
+        timing = false;
+    }
+
+    opengl::ShaderProgram& LbvhBuilder::getProgram(Pass pass) {
+        return programs[pass];
+    }
+
+    void LbvhBuilder::reserve(size_t numPrimitives) {
+        if (numPrimitives <= capacity) return;
+
+        // Grow geometrically, scenes that change every frame tend to grow a little at a time
+        capacity = std::max(numPrimitives, capacity + capacity / 2);
+        const size_t blocks = (capacity + GROUP_SIZE * ITEMS - 1) / (GROUP_SIZE * ITEMS);
+
+        const std::pair<opengl::BufferObject*, size_t> sizes[] = {
+            { &state, 7 * sizeof(GLuint) },
+            { &boxes, 2 * capacity * 4 * sizeof(GLfloat) },
+            { &keys[0], capacity * 2 * sizeof(GLuint) },
+            { &keys[1], capacity * 2 * sizeof(GLuint) },
+            { &histogram, RADIX * blocks * sizeof(GLuint) },
+            { &slots, (2 * capacity - 1) * sizeof(GLuint) },
+            { &visits, capacity * sizeof(GLuint) },
+        };
+
+        for (const auto& size : sizes) {
+            size.first->bind();
+            size.first->setData(nullptr, GLsizeiptr(size.second), GL_DYNAMIC_COPY);
+            size.first->unbind();
+        }
+    }
+
+    void LbvhBuilder::dispatch(GLuint groups) {
+        glDispatchCompute(std::max(groups, 1u), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void LbvhBuilder::build(size_t numPrimitives, float shutter, BvhBuffer& bvh) {
+        // Collect the time of the previous build, it has finished by now
+        if (timing) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &elapsed);
+            milliseconds = double(elapsed) * 1e-6;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, timer);
+        timing = true;
+
+        reserve(numPrimitives);
+        bvh.allocate(std::max<size_t>(2 * numPrimitives, 2) - 1, numPrimitives);
+
+        const GLuint count = GLuint(numPrimitives);
+        const GLuint groups = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+        const GLuint blocks = std::max((count + GROUP_SIZE * ITEMS - 1) / (GROUP_SIZE * ITEMS), 1u);
+
+        // Empty centroid bounds and no unbounded primitives yet
+        const std::vector<GLuint> cleared = { ~0u, ~0u, ~0u, 0u, 0u, 0u, 0u };
+        state.bind();
+        state.setSubData(cleared, 0);
+        state.unbind();
+
+        bvh.bind();
+        GLuint binding = FIRST_BINDING;
+        for (const opengl::BufferObject* buffer : { &state, &boxes, &keys[0], &keys[1], &histogram, &slots, &visits })
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding++, buffer->getHandler());
+
+        programs[BOUNDS].use();
+        programs[BOUNDS].uniform("numPrimitives", count);
+        programs[BOUNDS].uniform("shutter", shutter);
+        dispatch(groups);
+
+        programs[MORTON].use();
+        programs[MORTON].uniform("numPrimitives", count);
+        dispatch(groups);
+
+        // Least significant digit first, the keys ping-pong between both buffers
+        for (GLuint pass = 0; pass < RADIX_PASSES; ++pass) {
+            const opengl::BufferObject& in = keys[pass % 2];
+            const opengl::BufferObject& out = keys[(pass + 1) % 2];
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FIRST_BINDING + 2, in.getHandler());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FIRST_BINDING + 3, out.getHandler());
+
+            for (Pass radixPass : { HISTOGRAM, SCAN, SCATTER }) {
+                programs[radixPass].use();
+                programs[radixPass].uniform("numPrimitives", count);
+                programs[radixPass].uniform("digitShift", pass * DIGIT_BITS);
+                programs[radixPass].uniform("numBlocks", blocks);
+                dispatch(radixPass == SCAN ? 1 : blocks);
+            }
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FIRST_BINDING + 2, keys[0].getHandler());
+
+        programs[HIERARCHY].use();
+        programs[HIERARCHY].uniform("numPrimitives", count);
+        dispatch(groups);
+
+        programs[REFIT].use();
+        programs[REFIT].uniform("numPrimitives", count);
+        dispatch(groups);
+
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    double LbvhBuilder::getMilliseconds() const {
+        return milliseconds;
+    }
+}
@@ -0,0 +1,111 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_LBVHBUILDER_H_
+#define PATHTRACER_LBVHBUILDER_H_
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "../opengl/BufferObject.h"
+#include "../opengl/ShaderProgram.h"
+
+#include "BvhBuffer.h"
+
+namespace pathtracer {
+
+    /**
+     * Linear bounding volume hierarchy built on the GPU from the primitive
+     * table, so scenes that change every frame don't wait for a CPU build.
+     * Centroids are sorted by 30 bit Morton code with a radix sort of 4 bit
+     * digits, the hierarchy is emitted from the sorted codes (Karras 2012)
+     * and refitted from the leaves up. The tree lands in a BvhBuffer in the
+     * binary layout, with one primitive per leaf.
+     *
+     * Every pass is a compute program of Lbvh.comp, compiled with LBVH_PASS
+     * set to the pass.
+     */
+    class LbvhBuilder {
+    public:
+
+        /** Build passes, must match Lbvh.comp */
+        enum Pass {
+            BOUNDS = 0,     //!< Primitive and centroid bounds
+            MORTON,         //!< Morton codes
+            HISTOGRAM,      //!< Digit counts per key block
+            SCAN,           //!< Digit offsets per key block
+            SCATTER,        //!< Stable scatter by digit
+            HIERARCHY,      //!< Inner nodes from the sorted codes
+            REFIT,          //!< Node bounds from the leaves up
+            NUM_PASSES
+        };
+
+        /** Invocations of a workgroup and keys per invocation of the radix passes, must match Lbvh.comp */
+        static constexpr GLuint GROUP_SIZE = 256;
+        static constexpr GLuint ITEMS = 16;
+
+        /** Shader storage bindings of the scratch buffers, must match Lbvh.comp */
+        static constexpr GLuint FIRST_BINDING = 8;
+
+        /** Default constructor */
+        LbvhBuilder();
+
+        /** Create the scratch buffers */
+        void create();
+
+        /** Free the scratch buffers and the programs */
+        void destroy();
+
+        /** Get the program of a pass, the application compiles and links it */
+        opengl::ShaderProgram& getProgram(Pass pass);
+
+        /**
+         * Build the tree of the primitives bound to PrimitiveBuffer::BINDING
+         * @param[in]  numPrimitives Primitives of the table
+         * @param[in]  shutter       Shutter time, moving primitives are bounded over all of it
+         * @param[out] bvh           Receives the tree in the binary layout
+         */
+        void build(size_t numPrimitives, float shutter, BvhBuffer& bvh);
+
+        /** Get the GPU time of the last build in milliseconds, measured one build late */
+        double getMilliseconds() const;
+
+    private:
+
+        /** Grow the scratch buffers to hold numPrimitives */
+        void reserve(size_t numPrimitives);
+
+        /** Dispatch the program in use over a number of workgroups, then wait for its writes */
+        static void dispatch(GLuint groups);
+
+        opengl::ShaderProgram   programs[NUM_PASSES];   //!< Program of every pass
+        opengl::BufferObject    state;      //!< Centroid bounds and unbounded count
+        opengl::BufferObject    boxes;      //!< Bounds of every primitive
+        opengl::BufferObject    keys[2];    //!< Sort keys and primitive indices, ping-pong
+        opengl::BufferObject    histogram;  //!< Digit counts, then offsets, per key block
+        opengl::BufferObject    slots;      //!< Node slot of every inner node and leaf
+        opengl::BufferObject    visits;     //!< Children that reached every inner node
+        size_t                  capacity;   //!< Primitives the scratch buffers hold
+        GLuint                  timer;      //!< Time elapsed query of the last build
+        bool                    timing;     //!< Is the query running or pending?
+        double                  milliseconds;   //!< GPU time of the last finished build
+    };
+
+}
+
+#endif //PATHTRACER_LBVHBUILDER_H_
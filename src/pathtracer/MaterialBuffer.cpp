@@ -0,0 +1,102 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include <glm/gtc/packing.hpp>
+
+#include "MaterialBuffer.h"
+
+namespace pathtracer {
+
+    // std430 packs an array of uvec4 without padding
+    static_assert(sizeof(MaterialBuffer::Packed) == 16, "unexpected packed material layout");
+    static_assert(sizeof(MaterialBuffer::PackedMedium) == 32, "unexpected packed medium layout");
+
+    MaterialBuffer::MaterialBuffer()
+        : buffer(GL_SHADER_STORAGE_BUFFER)
+        , mediaBuffer(GL_SHADER_STORAGE_BUFFER)
+        , packed()
+        , packedMedia() {
+
+    }
+
+    void MaterialBuffer::create() {
+        buffer.create();
+        mediaBuffer.create();
+    }
+
+    void MaterialBuffer::destroy() {
+        if (buffer.isCreated()) buffer.destroy();
+        if (mediaBuffer.isCreated()) mediaBuffer.destroy();
+    }
+
+    void MaterialBuffer::upload(const std::vector<scene::Material>& materials,
+            const std::vector<scene::Medium>& media) {
+        packed.clear();
+        for (const scene::Material& material : materials)
+            packed.push_back(pack(material));
+
+        // An empty storage buffer can't be bound
+        if (packed.empty()) packed.push_back(pack(scene::Material()));
+
+        buffer.bind();
+        buffer.setData(packed, GL_DYNAMIC_DRAW);
+        buffer.unbind();
+
+        // The kernel ignores media past the end of the table
+        packedMedia.clear();
+        for (const scene::Medium& medium : media)
+            packedMedia.push_back(pack(medium));
+
+        if (packedMedia.empty()) packedMedia.push_back(pack(scene::Medium()));
+
+        mediaBuffer.bind();
+        mediaBuffer.setData(packedMedia, GL_DYNAMIC_DRAW);
+        mediaBuffer.unbind();
+    }
+
+    void MaterialBuffer::bind() const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer.getHandler());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MEDIA_BINDING, mediaBuffer.getHandler());
+    }
+
+    MaterialBuffer::Packed MaterialBuffer::pack(const scene::Material& material) {
+        Packed p;
+        p.albedoRG      = glm::packHalf2x16(glm::vec2(material.albedo.r, material.albedo.g));
+        p.albedoBFuzz   = glm::packHalf2x16(glm::vec2(material.albedo.b, material.fuzz));
+        p.refIdx        = material.refIdx;
+        p.flags         = uint32_t(material.type) | (material.emissive ? 0x100u : 0u);
+
+        // Only dielectrics have an inside the kernel can tell apart
+        if (material.type == scene::Material::DIELECTRIC && material.medium >= 0 && material.medium < 0xFF)
+            p.flags |= uint32_t(material.medium + 1) << 16;
+
+        return p;
+    }
+
+    MaterialBuffer::PackedMedium MaterialBuffer::pack(const scene::Medium& medium) {
+        PackedMedium p;
+        for (int i = 0; i < 3; ++i) {
+            p.scattering[i] = std::max(medium.scattering[i], 0.0f);
+            p.absorption[i] = std::max(medium.absorption[i], 0.0f);
+        }
+        p.anisotropy    = glm::clamp(medium.anisotropy, -0.99f, 0.99f);
+        p.flags         = medium.heterogeneous ? MEDIUM_HETEROGENEOUS : 0u;
+        return p;
+    }
+}
@@ -0,0 +1,101 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_MATERIALBUFFER_H_
+#define PATHTRACER_MATERIALBUFFER_H_
+
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "../opengl/BufferObject.h"
+#include "../scene/Material.h"
+#include "../scene/Medium.h"
+
+namespace pathtracer {
+
+    /**
+     * Material table of the kernel, a shader storage buffer with 16 bytes per
+     * material, and the table of the media they are filled with, 32 bytes
+     * per medium. Editing materials or media only uploads the tables again,
+     * the kernel is not recompiled.
+     */
+    class MaterialBuffer {
+    public:
+
+        /** Shader storage binding point, must match MaterialLibrary.glsl */
+        static constexpr GLuint BINDING = 0;
+
+        /** Shader storage binding point of the media, must match Medium.glsl */
+        static constexpr GLuint MEDIA_BINDING = 3;
+
+        /** Medium flag of the packed flags: heterogeneous */
+        static constexpr uint32_t MEDIUM_HETEROGENEOUS = 1;
+
+        /** Material as the kernel reads it, must match unpack_material() */
+        struct Packed {
+            uint32_t    albedoRG;       //!< Half float albedo red and green
+            uint32_t    albedoBFuzz;    //!< Half float albedo blue and fuzz
+            float       refIdx;         //!< Refraction index
+            uint32_t    flags;          //!< Type on the low byte, emissive on bit 8, medium + 1 on bits 16-23
+        };
+
+        /** Medium as the kernel reads it, must match get_medium() */
+        struct PackedMedium {
+            float       scattering[3];  //!< Scattering coefficient
+            float       anisotropy;     //!< Henyey-Greenstein g
+            float       absorption[3];  //!< Absorption coefficient
+            uint32_t    flags;          //!< MEDIUM_* flags
+        };
+
+        /** Default constructor */
+        MaterialBuffer();
+
+        /** Create the buffer object */
+        void create();
+
+        /** Free the buffer object */
+        void destroy();
+
+        /**
+         * Upload a material table
+         * @param[in] materials Materials, indexed by the sphere material ids
+         * @param[in] media     Media, indexed by the materials
+         */
+        void upload(const std::vector<scene::Material>& materials, const std::vector<scene::Medium>& media);
+
+        /** Bind the table to its binding point */
+        void bind() const;
+
+        /** Pack a material into the kernel layout */
+        static Packed pack(const scene::Material& material);
+
+        /** Pack a medium into the kernel layout */
+        static PackedMedium pack(const scene::Medium& medium);
+
+    private:
+
+        opengl::BufferObject        buffer;         //!< Packed material table
+        opengl::BufferObject        mediaBuffer;    //!< Packed media table
+        std::vector<Packed>         packed;         //!< Staging copy of the table
+        std::vector<PackedMedium>   packedMedia;    //!< Staging copy of the media
+    };
+
+}
+
+#endif //PATHTRACER_MATERIALBUFFER_H_
@@ -15,24 +15,106 @@
 //    You should have received a copy of the GNU General Public License
 //    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <filesystem>
+
+#include "../opengl/Extensions.h"
+#include "../util/Hash.h"
+
 #include "PathTracer.h"
 
 namespace pathtracer {
 
+    /** Shader storage binding of the autofocus result, must match Autofocus.comp */
+    static constexpr GLuint FOCUS_BINDING = 1;
+
+    /** Shader storage binding of the traversal counters, must match Stats.glsl */
+    static constexpr GLuint STATS_BINDING = 15;
+
+    /** Shader storage binding of the persistent threads work queue, must match PathTracer.comp */
+    static constexpr GLuint WORK_BINDING = 16;
+
+    /** Paths a persistent invocation traces per dispatch, all the samples of at least one pixel, must match PathTracer.comp */
+    static constexpr GLuint PERSISTENT_PATHS = 16;
+
     PathTracer::PathTracer()
             : Renderer()
             , ssaa(false)
+            , viewportWidth(0)
+            , viewportHeight(0)
             , fbWidth(0)
             , fbHeight(0)
             , fbText(0)
+            , albedoText(0)
+            , normalText(0)
+            , statsText(0)
+            , compensationText(0)
+            , batchText(0)
+            , imageView(0)
             , numSamples(0)
+            , sampleOffset(0)
+            , sampleStride(1)
+            , samplesPerDispatch(1)
+            , sampleLimit(0)
             , clearColor(0.0f)
             , projMat(1.0f)
             , isActive(true)
             , maxBounces(10)
+            , sdfSteps(128)
+            , aovs(0)
+            , heatmap(HEATMAP_NONE)
+            , heatmapScale(64.0f)
+            , sampler(SAMPLER_INDEPENDENT)
+            , filter(FILTER_NONE)
+            , sortMaterials(false)
+            , tileCulling(true)
+            , persistentGroups(0)
+            , compensated(false)
+            , accumulationFormat(ACCUMULATION_FLOAT)
+            , leanBatch(256)
+            , tileIndex(0)
+            , tileSamples(0)
+            , bvhLayout(BVH_WIDE)
+            , gpuBvh(false)
+            , spatialSplits(0.0f)
+            , specialize(true)
+            , exportPath("render.exr")
+            , environmentPath("")
+            , densityGridPath("")
+            , voxelsPath("")
+            , exporter()
+            , checkpointer()
+            , programCache()
+            , shaderDir(".")
+            , preprocessor()
+            , reloader()
             , screenQuad()
             , screenQuadProgram()
-            , pathTracerProgram() {
+            , pathTracerProgram()
+            , autofocusProgram()
+            , foldProgram()
+            , focusBuffer(GL_SHADER_STORAGE_BUFFER)
+            , statsBuffer(GL_SHADER_STORAGE_BUFFER)
+            , workQueue(GL_SHADER_STORAGE_BUFFER)
+            , traversalStats()
+            , kernelVariants()
+            , primitives(scene::defaultPrimitives())
+            , primitiveBuffer()
+            , primitivesDirty(false)
+            , materials(scene::defaultMaterials())
+            , materialBuffer()
+            , media(scene::defaultMedia())
+            , materialsDirty(false)
+            , environmentMap()
+            , densityGrid()
+            , voxelGrid()
+            , bvhBuffer()
+            , bvhUploaded(BVH_LINEAR)
+            , bvhShutter(0.0f)
+            , bvhBounded(0)
+            , lbvhBuilder()
+            , bvh()
+            , pathTracerSource() {
 
     }
 
@@ -43,6 +125,33 @@ namespace pathtracer {
 
         // Initialize opengl objects
         screenQuad.create();
+        primitiveBuffer.create();
+        primitiveBuffer.upload(primitives);
+        materialBuffer.create();
+        materialBuffer.upload(materials, media);
+        focusBuffer.create();
+        focusBuffer.bind();
+        focusBuffer.setStorage(nullptr, sizeof(GLfloat), 0);
+        focusBuffer.unbind();
+        statsBuffer.create();
+        statsBuffer.bind();
+        statsBuffer.setStorage(nullptr, 4 * sizeof(GLuint), 0);
+        statsBuffer.unbind();
+        glClearNamedBufferData(statsBuffer.getHandler(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        workQueue.create();
+        workQueue.bind();
+        workQueue.setStorage(nullptr, sizeof(GLuint), 0);
+        workQueue.unbind();
+        environmentMap.create();
+        densityGrid.create();
+        voxelGrid.create();
+        bvhBuffer.create();
+        lbvhBuilder.create();
+        preprocessor.addIncludePath(shaderDir);
+
+        // Let the driver pick how many threads compile kernel variants
+        opengl::maxShaderCompilerThreads(0xFFFFFFFF);
+        kernelVariants.setProgramCache(&programCache);
         initShaders();
 
         // Prepare camera
@@ -50,16 +159,98 @@ namespace pathtracer {
         setLookAt(glm::vec3(0.0f, 0.0f, 0.0f));
     }
 
+    void PathTracer::setShaderDir(const std::string& directory) {
+        shaderDir = directory;
+    }
+
+    void PathTracer::setShaderCache(const std::string& directory) {
+        programCache.setDirectory(directory);
+    }
+
     void PathTracer::destroy() {
+        reloader.stop();
+        kernelVariants.destroy();
+        primitiveBuffer.destroy();
+        materialBuffer.destroy();
+        focusBuffer.destroy();
+        statsBuffer.destroy();
+        workQueue.destroy();
+        environmentMap.destroy();
+        densityGrid.destroy();
+        voxelGrid.destroy();
+        bvhBuffer.destroy();
+        lbvhBuilder.destroy();
 
+        // Save the final state, then write pending files before the context goes away
+        checkpoint();
+        checkpointer.finish();
+        exporter.finish();
     }
 
     void PathTracer::render() {
+        // Encode exports and checkpoints whose readback finished
+        exporter.poll();
+        checkpointer.poll();
+
+        // Samples of the previous kernel can't be mixed with the new one
+        if (reloader.poll(pathTracerProgram, pathTracerSource)) {
+            std::cout << "hot reload: path tracing kernel replaced" << std::endl;
+            kernelVariants.clear();
+            restart();
+        }
+
+        // Samples of the old scene can't be mixed with the new ones
+        if (primitivesDirty) {
+            primitiveBuffer.upload(primitives);
+            primitivesDirty = false;
+            bvhUploaded = BVH_LINEAR;
+            restart();
+        }
+        updateBvh();
+
+        // Samples with old materials can't be mixed with the new ones
+        if (materialsDirty) {
+            materialBuffer.upload(materials, media);
+            materialsDirty = false;
+            restart();
+        }
+
+        if (checkpointer.isDue(numSamples)) checkpoint();
+
                          // force at least one sample
         if (!isActive && numSamples > 0) return; // Don't sample when inactive
 
-        // Increase amount of samples
-        numSamples++;
+        // Samples of this dispatch, the last ones before the limit may be fewer.
+        // Memory lean tiles render a batch of samples, up to the limit too.
+        const bool lean = accumulationFormat != ACCUMULATION_FLOAT;
+        GLuint count = samplesPerDispatch;
+        GLuint batch = leanBatch;
+        if (sampleLimit > 0) count = std::min(count, sampleLimit - std::min(numSamples, sampleLimit));
+        if (sampleLimit > 0) batch = std::min(batch, sampleLimit - std::min(numSamples, sampleLimit));
+        if (lean) count = std::min(count, batch - std::min(tileSamples, batch));
+
+        // The 32 bit traversal totals only hold a sample of the image
+        if (aovs & AOV_STATS) count = std::min(count, 1u);
+        if (count == 0) return;
+
+        // The generic kernel renders until the variant for these settings is ready.
+        // Both draw the same samples, so they can be mixed in the accumulation.
+        // Only the debug variant counts traversal statistics, wait for it.
+        kernelVariants.poll();
+        const KernelSettings settings = kernelSettings();
+        opengl::ShaderProgram* program = &pathTracerProgram;
+        if (specialize || (aovs & AOV_STATS)) {
+            opengl::ShaderProgram* variant = kernelVariants.get(settings, preprocessor,
+                    shaderPath("PathTracer.comp"));
+            if (variant) program = variant;
+            else if (aovs & AOV_STATS) return;
+        }
+
+        // Index of the first sample in the global sequence, then increase amount
+        // of samples. Those of a memory lean batch count once every tile has them.
+        GLuint sampleIndex = sampleOffset + sampleStride * (numSamples + tileSamples);
+        if (lean) tileSamples += count;
+        else numSamples += count;
 
         // Compute modelViewProj matrix
         glm::mat4 vp = projMat * viewMat();
@@ -77,26 +268,152 @@ namespace pathtracer {
         ray01 = (ray01 / ray01.w) - eye;
         ray11 = (ray11 / ray11.w) - eye;
 
-        // Path trace the scene
-        pathTracerProgram.use();
-        pathTracerProgram.uniform("eye",   getEye());
-        pathTracerProgram.uniform("ray00", glm::vec3(ray00));
-        pathTracerProgram.uniform("ray10", glm::vec3(ray10));
-        pathTracerProgram.uniform("ray01", glm::vec3(ray01));
-        pathTracerProgram.uniform("ray11", glm::vec3(ray11));
-        pathTracerProgram.uniform("maxBounces", GLuint(maxBounces));
-        pathTracerProgram.uniform("numSamples", numSamples);
+        // Lens axes are the rows of the view rotation
+        const glm::mat4& view = viewMat();
+        glm::vec3 right     = glm::vec3(view[0][0], view[1][0], view[2][0]);
+        glm::vec3 up        = glm::vec3(view[0][1], view[1][1], view[2][1]);
+        glm::vec3 forward   = -glm::vec3(view[0][2], view[1][2], view[2][2]);
 
-        // Bind framebuffer texture
-        glBindImageTexture(0, fbText, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        // Path trace the scene, variants ignore the uniforms they have fixed
+        program->use();
+        program->uniform("eye",   getEye());
+        program->uniform("ray00", glm::vec3(ray00));
+        program->uniform("ray10", glm::vec3(ray10));
+        program->uniform("ray01", glm::vec3(ray01));
+        program->uniform("ray11", glm::vec3(ray11));
+        program->uniform("lensRadius", getAperture() * 0.5f);
+        program->uniform("focusDistance", getFocusDistance());
+        program->uniform("cameraRight", right);
+        program->uniform("cameraUp", up);
+        program->uniform("cameraForward", forward);
+        program->uniform("shutterTime", getShutter());
+        program->uniform("maxBounces", GLuint(maxBounces));
+        program->uniform("sdfSteps", GLuint(sdfSteps));
+        program->uniform("aovMask", aovs);
+        program->uniform("samplerType", sampler);
+        program->uniform("reconstructionFilter", settings.filter);
+        program->uniform("sampleIndex", sampleIndex);
+        program->uniform("sampleStride", sampleStride);
+        program->uniform("dispatchSamples", count);
+        program->uniform("tileOrigin", tileOrigin());
+        program->uniform("imageExtent", glm::ivec2(fbWidth, fbHeight));
+        program->uniform("sortMaterials", GLint(settings.sort));
+        program->uniform("tileCulling", GLint(settings.tileCulling));
+        program->uniform("persistentThreads", GLint(settings.persistent));
+        program->uniform("compensatedSum", GLint(settings.compensated));
+        program->uniform("bvhLayout", GLint(settings.bvh));
+        program->uniform("environmentEnabled", GLint(settings.environment));
+        program->uniform("environmentCells",
+                glm::ivec2(environmentMap.getTableWidth(), environmentMap.getTableHeight()));
+        program->uniform("mediaEnabled", GLint(settings.media));
+        program->uniform("majorantCellSize", glm::vec3(float(DensityGrid::CELL_SIZE)) /
+                glm::vec3(densityGrid.getSize()));
+
+        // Bind framebuffer and AOV textures, the kernel adds to their values
+        glBindImageTexture(0, lean ? batchText : fbText, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        if (albedoText) glBindImageTexture(1, albedoText, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        if (normalText) glBindImageTexture(2, normalText, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        if (statsText) glBindImageTexture(3, statsText, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        if (compensationText) glBindImageTexture(4, compensationText, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        if (statsText) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATS_BINDING, statsBuffer.getHandler());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WORK_BINDING, workQueue.getHandler());
+        primitiveBuffer.bind();
+        materialBuffer.bind();
+        environmentMap.bind();
+        densityGrid.bind();
+        voxelGrid.bind();
+        bvhBuffer.bind();
 
-        // Compute dispatch number of groups
-        GLuint workGroupsX = GLuint(std::ceil(fbWidth / WORKGROUP_SIZE_X));
-        GLuint workGroupsY = GLuint(std::ceil(fbHeight / WORKGROUP_SIZE_Y));
+        // Compute dispatch number of groups, memory lean ones only cover the tile
+        const glm::ivec2 origin = tileOrigin();
+        const GLsizei width = lean ? std::min(LEAN_TILE_SIZE, fbWidth - origin.x) : fbWidth;
+        const GLsizei height = lean ? std::min(LEAN_TILE_SIZE, fbHeight - origin.y) : fbHeight;
+        GLuint workGroupsX = GLuint(std::ceil(width / WORKGROUP_SIZE_X));
+        GLuint workGroupsY = GLuint(std::ceil(height / WORKGROUP_SIZE_Y));
 
-        // Dispatch compute shader
-        glDispatchCompute(workGroupsX, workGroupsY, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        if (settings.persistent) {
+            // Until the queue runs out, every dispatch takes the share of every
+            // invocation, the dispatches needed are known without a readback
+            const GLuint pixels = std::max(PERSISTENT_PATHS / count, 1u);
+            const GLuint share = persistentGroups * GLuint(WORKGROUP_SIZE_X * WORKGROUP_SIZE_Y) * pixels;
+            const GLuint entries = workGroupsX * workGroupsY * GLuint(WORKGROUP_SIZE_X * WORKGROUP_SIZE_Y);
+
+            glClearNamedBufferData(workQueue.getHandler(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+            for (GLuint taken = 0; taken < entries; taken += share) {
+                glDispatchCompute(persistentGroups, 1, 1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        } else if (settings.filter >= FILTER_GAUSSIAN) {
+            // Splats reach the tiles around theirs, workgroups two tiles apart
+            // don't share pixels. Four dispatches cover the image.
+            for (GLint phase = 0; phase < 4; ++phase) {
+                program->uniform("groupPhase", glm::ivec2(phase & 1, phase >> 1));
+                glDispatchCompute((workGroupsX + 1) / 2, (workGroupsY + 1) / 2, 1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            }
+        } else {
+            // Dispatch compute shader
+            glDispatchCompute(workGroupsX, workGroupsY, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+
+        // The 32 bit totals of a sample are collected before they can overflow.
+        // Waiting for the sample is fine for a debug kernel.
+        if (statsText) {
+            GLuint counters[4];
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glGetNamedBufferSubData(statsBuffer.getHandler(), 0, sizeof(counters), counters);
+            glClearNamedBufferData(statsBuffer.getHandler(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+            traversalStats.nodes += counters[0];
+            traversalStats.tests += counters[1];
+            traversalStats.bounces += counters[2];
+            traversalStats.rays += counters[3];
+            traversalStats.paths += uint64_t(width) * uint64_t(height) * count;
+        }
+
+        // A finished batch goes into the image and the next tile starts. The
+        // samples count when the last tile has them.
+        if (lean && tileSamples == batch) {
+            foldTile(batch);
+            tileSamples = 0;
+            const GLuint tilesX = GLuint((fbWidth + LEAN_TILE_SIZE - 1) / LEAN_TILE_SIZE);
+            const GLuint tilesY = GLuint((fbHeight + LEAN_TILE_SIZE - 1) / LEAN_TILE_SIZE);
+            if (++tileIndex == tilesX * tilesY) {
+                tileIndex = 0;
+                numSamples += batch;
+            }
+        }
+    }
+
+    void PathTracer::foldTile(GLuint samples) {
+        foldProgram.use();
+        foldProgram.uniform("accumulationFormat", accumulationFormat);
+        foldProgram.uniform("tileOrigin", tileOrigin());
+        foldProgram.uniform("storedSamples", numSamples);
+        foldProgram.uniform("batchSamples", samples);
+
+        // Fold.comp packs shared exponents itself, they aren't an image format
+        glBindImageTexture(0, batchText, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        if (accumulationFormat == ACCUMULATION_HALF)
+            glBindImageTexture(1, fbText, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+        else
+            glBindImageTexture(2, imageView, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+
+        const GLuint groups = GLuint(std::ceil(LEAN_TILE_SIZE / WORKGROUP_SIZE_X));
+        glDispatchCompute(groups, groups, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+                GL_TEXTURE_UPDATE_BARRIER_BIT);
+    }
+
+    GLuint PathTracer::imageFilter() const {
+        return accumulationFormat != ACCUMULATION_FLOAT ? std::min(filter, FILTER_BOX) : filter;
+    }
+
+    glm::ivec2 PathTracer::tileOrigin() const {
+        if (accumulationFormat == ACCUMULATION_FLOAT) return glm::ivec2(0);
+        const GLuint tilesX = GLuint((fbWidth + LEAN_TILE_SIZE - 1) / LEAN_TILE_SIZE);
+        return glm::ivec2(tileIndex % tilesX, tileIndex / tilesX) * LEAN_TILE_SIZE;
     }
 
     void PathTracer::renderToQuad() {
@@ -110,6 +427,17 @@ namespace pathtracer {
         glBindTexture(GL_TEXTURE_2D, fbText);
         screenQuadProgram.uniform("textSampler", 0);
         screenQuadProgram.uniform("numSamples", numSamples);
+        screenQuadProgram.uniform("imageSamples", accumulationFormat == ACCUMULATION_FLOAT ? numSamples : 1u);
+        screenQuadProgram.uniform("weighted", GLint(imageFilter() >= FILTER_GAUSSIAN));
+
+        // Heatmaps need the stats AOV
+        const GLuint shown = statsText ? heatmap : HEATMAP_NONE;
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, statsText);
+        glActiveTexture(GL_TEXTURE0);
+        screenQuadProgram.uniform("statsSampler", 1);
+        screenQuadProgram.uniform("heatmap", shown);
+        screenQuadProgram.uniform("heatmapScale", heatmapScale);
 
         screenQuad.bind();
         screenQuad.render();
@@ -135,6 +463,286 @@ namespace pathtracer {
             }
 
             ImGui::SliderInt("maxBounces", &maxBounces, 1, 32);
+            if (ImGui::SliderInt("sdf steps", &sdfSteps, 1, 1024)) restart();
+
+            // Built-in scenes
+            int sceneIndex = -1;
+            std::string sceneItems;
+            for (const std::string& name : scene::sceneNames()) {
+                sceneItems += name;
+                sceneItems.push_back('\0');
+            }
+            if (ImGui::Combo("scene", &sceneIndex, sceneItems.c_str())) {
+                setPrimitives(scene::namedScene(scene::sceneNames()[size_t(sceneIndex)]));
+            }
+
+            // Voxel model of the VOXELS primitives
+            ImGui::InputText("##voxelsPath", voxelsPath, sizeof(voxelsPath));
+            ImGui::SameLine();
+            if (ImGui::Button("Load##voxels")) {
+                try {
+                    loadVoxels(voxelsPath);
+                } catch (const io::VolumeError& e) {
+                    std::cerr << e.what() << std::endl;
+                }
+            }
+
+            glm::ivec3 voxelsSize = voxelGrid.getSize();
+            ImGui::Text("%dx%dx%d voxels, %d occupied, %d KiB", voxelsSize.x, voxelsSize.y, voxelsSize.z,
+                    int(voxelGrid.getNumVoxels()), int(voxelGrid.getBytes() / 1024));
+            if (!voxelGrid.getPath().empty()) {
+                ImGui::SameLine();
+                if (ImGui::Button("Clear##voxels")) clearVoxels();
+            }
+
+            // Kernel configuration
+            int samplerIndex = int(sampler);
+            if (ImGui::Combo("sampler", &samplerIndex, "independent\0kronecker\0")) {
+                setSampler(GLuint(samplerIndex));
+            }
+
+            // Filters are FILTER_NONE, FILTER_BOX, FILTER_GAUSSIAN, FILTER_BLACKMAN_HARRIS and FILTER_MITCHELL
+            int filterIndex = int(filter);
+            if (ImGui::Combo("filter", &filterIndex, "none\0box\0gaussian\0blackman-harris\0mitchell\0")) {
+                setFilter(GLuint(filterIndex));
+                setSSAA(filter == FILTER_NONE); // Like the command line, without a filter antialias with SSAA
+            }
+
+            bool albedo = (aovs & AOV_ALBEDO) != 0;
+            bool normal = (aovs & AOV_NORMAL) != 0;
+            bool aovsChanged = ImGui::Checkbox("albedo AOV", &albedo);
+            ImGui::SameLine();
+            aovsChanged = ImGui::Checkbox("normal AOV", &normal) || aovsChanged;
+            ImGui::SameLine();
+            bool stats = (aovs & AOV_STATS) != 0;
+            aovsChanged = ImGui::Checkbox("stats AOV", &stats) || aovsChanged;
+            if (aovsChanged) {
+                setAOVs((albedo ? AOV_ALBEDO : 0) | (normal ? AOV_NORMAL : 0) | (stats ? AOV_STATS : 0));
+            }
+
+            ImGui::Checkbox("specialized kernel", &specialize);
+            if (specialize && kernelVariants.pending() > 0) {
+                ImGui::SameLine();
+                ImGui::Text("compiling...");
+            }
+
+            ImGui::Checkbox("sort by material", &sortMaterials);
+            ImGui::Checkbox("tile culling", &tileCulling);
+
+            int groups = int(persistentGroups);
+            if (ImGui::SliderInt("persistent groups", &groups, 0, 256, groups > 0 ? "%.0f" : "off"))
+                setPersistentThreads(GLuint(groups));
+
+            bool kahan = compensated;
+            if (ImGui::Checkbox("compensated sum", &kahan))
+                setCompensatedSummation(kahan);
+
+            // Formats are ACCUMULATION_FLOAT, ACCUMULATION_HALF and ACCUMULATION_SHARED_EXPONENT
+            int format = int(accumulationFormat);
+            if (ImGui::Combo("accumulation", &format, "float\0half\0rgb9e5\0"))
+                setAccumulationFormat(GLuint(format));
+            ImGui::SameLine();
+            ImGui::Text("%.1f MiB", double(getAccumulationBytes()) / (1024.0 * 1024.0));
+            if (accumulationFormat != ACCUMULATION_FLOAT) {
+                int batch = int(leanBatch);
+                if (ImGui::SliderInt("lean batch", &batch, 1, 1024)) setLeanBatch(GLuint(batch));
+            }
+
+            int dispatchSamples = int(samplesPerDispatch);
+            if (ImGui::SliderInt("samples per dispatch", &dispatchSamples, 1, 64))
+                setSamplesPerDispatch(GLuint(dispatchSamples));
+
+            // Layouts are BVH_LINEAR, BVH_BINARY and BVH_WIDE
+            int bvhIndex = int(bvhLayout / 2);
+            if (ImGui::Combo("bvh", &bvhIndex, "linear\0binary\0wide\0")) {
+                setBvhLayout(GLuint(bvhIndex * 2));
+            }
+            if (bvhLayout != BVH_LINEAR && !gpuBvh) {
+                ImGui::SameLine();
+                ImGui::Text("%d nodes, %d KiB, depth %d", int(bvhBuffer.getNumNodes()),
+                        int(bvhBuffer.getNodeBytes() / 1024), int(bvh.getDepth()));
+
+                float budget = spatialSplits;
+                if (ImGui::SliderFloat("spatial splits", &budget, 0.0f, 1.0f)) setSpatialSplits(budget);
+                ImGui::SameLine();
+                ImGui::Text("%d references", int(bvh.getIndices().size()));
+            }
+
+            bool gpu = gpuBvh;
+            if (ImGui::Checkbox("gpu bvh build", &gpu)) setGpuBvh(gpu);
+            if (bvhLayout != BVH_LINEAR && gpuBvh) {
+                ImGui::SameLine();
+                ImGui::Text("%d nodes, %d KiB, %.2f ms", int(bvhBuffer.getNumNodes()),
+                        int(bvhBuffer.getNodeBytes() / 1024), lbvhBuilder.getMilliseconds());
+            }
+
+            // Traversal counters of the debug kernel and the shape of the CPU tree
+            if (ImGui::CollapsingHeader("Statistics")) {
+                if (aovs & AOV_STATS) {
+                    int heatmapIndex = int(heatmap);
+                    float scale = heatmapScale;
+                    bool changed = ImGui::Combo("heatmap", &heatmapIndex, "image\0node visits\0primitive tests\0bounces\0");
+                    changed = ImGui::SliderFloat("heatmap scale", &scale, 1.0f, 1024.0f, "%.0f", 3.0f) || changed;
+                    if (changed) setHeatmap(GLuint(heatmapIndex), scale);
+
+                    const double paths = double(std::max<uint64_t>(traversalStats.paths, 1));
+                    ImGui::Text("per path: %.1f nodes, %.1f tests, %.2f bounces, %.2f rays",
+                            double(traversalStats.nodes) / paths, double(traversalStats.tests) / paths,
+                            double(traversalStats.bounces) / paths, double(traversalStats.rays) / paths);
+                } else {
+                    ImGui::Text("enable the stats AOV for traversal counters");
+                }
+
+                if (bvhLayout != BVH_LINEAR && !gpuBvh && !bvh.getNodes().empty()) {
+                    const scene::Bvh::Statistics shape = bvh.getStatistics();
+                    ImGui::Text("SAH cost %.2f, %d leaves, %.2f primitives per leaf", shape.cost, int(shape.leaves),
+                            double(shape.references) / double(shape.leaves));
+
+                    std::vector<float> sizes(shape.leafSizes.begin(), shape.leafSizes.end());
+                    std::vector<float> depths(shape.leafDepths.begin(), shape.leafDepths.end());
+                    ImGui::PlotHistogram("leaf sizes", sizes.data(), int(sizes.size()), 0, nullptr, 0.0f, FLT_MAX,
+                            ImVec2(0, 60));
+                    ImGui::PlotHistogram("leaf depths", depths.data(), int(depths.size()), 0, nullptr, 0.0f, FLT_MAX,
+                            ImVec2(0, 60));
+                    if (ImGui::Button("Print report")) bvh.report(std::cout);
+                }
+            }
+
+            // Thin lens camera, an aperture of 0 is a pinhole
+            if (ImGui::CollapsingHeader("Camera")) {
+                float aperture = getAperture();
+                float focus = getFocusDistance();
+                float shutter = getShutter();
+                bool changed = false;
+
+                if (ImGui::SliderFloat("aperture", &aperture, 0.0f, 1.0f)) {
+                    setAperture(aperture);
+                    changed = true;
+                }
+                if (ImGui::SliderFloat("focus distance", &focus, 0.1f, 50.0f, "%.3f", 2.0f)) {
+                    setFocusDistance(focus);
+                    changed = true;
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Autofocus")) {
+                    changed = autofocus() || changed;
+                }
+                if (ImGui::SliderFloat("shutter", &shutter, 0.0f, 1.0f)) {
+                    setShutter(shutter);
+                    changed = true;
+                }
+
+                if (changed) restart();
+            }
+
+            // Material table, edits are uploaded on the next frame
+            if (ImGui::CollapsingHeader("Materials")) {
+                for (size_t i = 0; i < materials.size(); ++i) {
+                    scene::Material& material = materials[i];
+                    ImGui::PushID(int(i));
+
+                    int type = int(material.type);
+                    bool changed = ImGui::Combo(("material " + std::to_string(i)).c_str(), &type,
+                        "lambert\0metal\0dielectric\0");
+                    material.type = scene::Material::Type(type);
+
+                    changed = ImGui::ColorEdit3("albedo", &material.albedo.r) || changed;
+                    if (material.type == scene::Material::METAL)
+                        changed = ImGui::SliderFloat("fuzz", &material.fuzz, 0.0f, 1.0f) || changed;
+                    if (material.type == scene::Material::DIELECTRIC) {
+                        changed = ImGui::SliderFloat("refraction index", &material.refIdx, 1.0f, 3.0f) || changed;
+
+                        // Media list, entry 0 is "none"
+                        std::string mediaItems("none");
+                        mediaItems.push_back('\0');
+                        for (size_t m = 0; m < media.size(); ++m) {
+                            mediaItems += "medium " + std::to_string(m);
+                            mediaItems.push_back('\0');
+                        }
+                        int medium = material.medium + 1;
+                        if (ImGui::Combo("medium", &medium, mediaItems.c_str())) {
+                            material.medium = medium - 1;
+                            changed = true;
+                        }
+                    }
+
+                    materialsDirty = materialsDirty || changed;
+                    ImGui::PopID();
+                }
+            }
+
+            // Participating media, a refraction index of 1 makes the sphere only a boundary
+            if (ImGui::CollapsingHeader("Media")) {
+                for (size_t i = 0; i < media.size(); ++i) {
+                    scene::Medium& medium = media[i];
+                    ImGui::PushID(int(materials.size() + i));
+                    ImGui::Text("medium %d", int(i));
+
+                    bool changed = ImGui::ColorEdit3("scattering", &medium.scattering.r);
+                    changed = ImGui::ColorEdit3("absorption", &medium.absorption.r) || changed;
+                    changed = ImGui::SliderFloat("anisotropy", &medium.anisotropy, -0.99f, 0.99f) || changed;
+                    changed = ImGui::Checkbox("heterogeneous", &medium.heterogeneous) || changed;
+
+                    materialsDirty = materialsDirty || changed;
+                    ImGui::PopID();
+                }
+
+                ImGui::InputText("##densityGridPath", densityGridPath, sizeof(densityGridPath));
+                ImGui::SameLine();
+                if (ImGui::Button("Load##densityGrid")) {
+                    try {
+                        loadDensityGrid(densityGridPath);
+                    } catch (const io::VolumeError& e) {
+                        std::cerr << e.what() << std::endl;
+                    }
+                }
+
+                if (!densityGrid.getPath().empty()) {
+                    glm::ivec3 size = densityGrid.getSize();
+                    ImGui::Text("%dx%dx%d density grid", size.x, size.y, size.z);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Clear##densityGrid")) clearDensityGrid();
+                }
+            }
+
+            // Environment map, lights the scene instead of the default sky
+            if (ImGui::CollapsingHeader("Environment")) {
+                ImGui::InputText("##environmentPath", environmentPath, sizeof(environmentPath));
+                ImGui::SameLine();
+                if (ImGui::Button("Load")) {
+                    try {
+                        loadEnvironment(environmentPath);
+                    } catch (const io::ImageIOError& e) {
+                        std::cerr << e.what() << std::endl;
+                    }
+                }
+
+                if (environmentMap.isLoaded()) {
+                    ImGui::Text("%dx%d, %dx%d sampling cells", int(environmentMap.getWidth()),
+                        int(environmentMap.getHeight()), int(environmentMap.getTableWidth()),
+                        int(environmentMap.getTableHeight()));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Clear")) clearEnvironment();
+                }
+            }
+
+            // Image export
+            ImGui::InputText("##exportPath", exportPath, sizeof(exportPath));
+            ImGui::SameLine();
+            if (ImGui::Button("Export")) {
+                exportImage(exportPath);
+            }
+
+            io::ExrOptions exr = exporter.getExrOptions();
+            int halfFloat = exr.pixelType == io::ExrPixelType::HALF ? 0 : 1;
+            if (ImGui::Combo("exr pixels", &halfFloat, "half\0float\0")) {
+                exr.pixelType = halfFloat == 0 ? io::ExrPixelType::HALF : io::ExrPixelType::FLOAT;
+                exporter.setExrOptions(exr);
+            }
+
+            if (exporter.pending() > 0) {
+                ImGui::Text("Exporting %d image(s)...", int(exporter.pending()));
+            }
         }
         
         ImGui::End();
@@ -144,6 +752,8 @@ namespace pathtracer {
     void PathTracer::setViewport(GLsizei x, GLsizei y, GLsizei width, GLsizei height) {
         // Update viewport
         glViewport(0, 0, width, height);
+        viewportWidth = width;
+        viewportHeight = height;
 
         GLsizei scale = ssaa ? 2 : 1; // Antialiasing?
         fbWidth = width * scale;
@@ -151,6 +761,7 @@ namespace pathtracer {
 
         // Create new framebuffer texture
         createFrameBufferTexture(fbWidth, fbHeight);
+        createAovTextures();
     }
 
     void PathTracer::setClearColor(float r, float g, float b) {
@@ -159,8 +770,18 @@ namespace pathtracer {
     }
 
     void PathTracer::restart() {
-        // Clear framebuffer texture
-        glClearTexImage(fbText, 0, GL_RGBA, GL_FLOAT, &clearColor.r);
+        // Clear framebuffer texture, there is none before the first setViewport().
+        // Splatted images sum the filter weights in alpha.
+        const glm::vec4 clear = imageFilter() >= FILTER_GAUSSIAN ? glm::vec4(glm::vec3(clearColor), 0.0f) : clearColor;
+        if (fbText) glClearTexImage(fbText, 0, GL_RGBA, GL_FLOAT, &clear.r);
+        if (albedoText) glClearTexImage(albedoText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        if (normalText) glClearTexImage(normalText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        if (statsText) glClearTexImage(statsText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        if (compensationText) glClearTexImage(compensationText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        if (batchText) glClearTexImage(batchText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        tileIndex = 0;
+        tileSamples = 0;
+        traversalStats = TraversalStats();
         numSamples = 0;
     }
 
@@ -168,36 +789,214 @@ namespace pathtracer {
         glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, image);
     }
 
+    void PathTracer::exportImage(const std::string& path) {
+        std::vector<ImageExporter::Layer> layers = {
+            { "", fbText, accumulationFormat != ACCUMULATION_FLOAT, imageFilter() >= FILTER_GAUSSIAN } };
+        if (albedoText) layers.push_back({ "albedo", albedoText });
+        if (normalText) layers.push_back({ "normal", normalText });
+        if (statsText) layers.push_back({ "stats", statsText });
+
+        exporter.request(layers, fbWidth, fbHeight, numSamples, path);
+    }
+
+    ImageExporter& PathTracer::getExporter() {
+        return exporter;
+    }
+
+    void PathTracer::setCheckpoint(const std::string& path, float interval) {
+        checkpointer.setPath(path);
+        checkpointer.setInterval(interval);
+    }
+
+    void PathTracer::checkpoint() {
+        if (!checkpointer.isEnabled() || numSamples == 0) return;
+
+        // Halfway through a memory lean pass, some tiles have more samples than others
+        if (tileIndex != 0 || tileSamples != 0) return;
+
+        io::Checkpoint state;
+        state.width             = uint32_t(fbWidth);
+        state.height            = uint32_t(fbHeight);
+        state.numSamples        = numSamples;
+        state.sampleSequence    = sampleOffset + sampleStride * numSamples;
+        state.sampleOffset      = sampleOffset;
+        state.sampleStride      = sampleStride;
+        state.sceneHash         = sceneHash();
+        state.lookAt[0]         = getLookAt().x;
+        state.lookAt[1]         = getLookAt().y;
+        state.lookAt[2]         = getLookAt().z;
+        state.theta             = getTheta();
+        state.phi               = getPhi();
+        state.distance          = getDistance();
+
+        // Memory lean images hold the mean, checkpoints the sums. Splatted
+        // sums are rescaled to a weight of one per sample.
+        const bool weighted = imageFilter() >= FILTER_GAUSSIAN;
+        checkpointer.request(fbText, state,
+            accumulationFormat == ACCUMULATION_FLOAT && !weighted ? 1.0f : float(numSamples), weighted);
+    }
+
+    void PathTracer::resume(const std::string& path) {
+        io::Checkpoint state = io::readCheckpoint(path);
+
+        if (GLsizei(state.width) != fbWidth || GLsizei(state.height) != fbHeight)
+            throw io::CheckpointError(path + ": checkpoint is " + std::to_string(state.width) + "x" +
+                std::to_string(state.height) + ", framebuffer is " + std::to_string(fbWidth) + "x" +
+                std::to_string(fbHeight));
+
+        // The camera is part of the hash, restore it before checking
+        setLookAt(glm::vec3(state.lookAt[0], state.lookAt[1], state.lookAt[2]));
+        setTheta(state.theta);
+        setPhi(state.phi);
+        setDistance(state.distance);
+
+        io::checkSceneHash(path, state, sceneHash());
+
+        // Continuing with another sample stream would repeat or skip samples
+        if (state.sampleOffset != sampleOffset || state.sampleStride != sampleStride ||
+                state.sampleSequence != sampleOffset + sampleStride * state.numSamples)
+            throw io::CheckpointError(path + ": checkpoint was rendered with a different sample stream");
+
+        // Upload the sums, alpha becomes 1 like after a restart. Memory
+        // lean images hold the mean instead. Splatted images weigh every
+        // sample of the checkpoint as one.
+        std::vector<float>& texels = state.sums;
+        if (accumulationFormat != ACCUMULATION_FLOAT && state.numSamples > 0)
+            for (float& texel : texels) texel /= float(state.numSamples);
+        if (imageFilter() >= FILTER_GAUSSIAN) {
+            std::vector<float> weighted(texels.size() / 3 * 4, float(state.numSamples));
+            for (size_t p = 0; p < texels.size() / 3; ++p)
+                std::copy_n(&texels[p * 3], 3, &weighted[p * 4]);
+            glTextureSubImage2D(fbText, 0, 0, 0, fbWidth, fbHeight, GL_RGBA, GL_FLOAT, weighted.data());
+        } else {
+            glTextureSubImage2D(fbText, 0, 0, 0, fbWidth, fbHeight, GL_RGB, GL_FLOAT, texels.data());
+        }
+
+        // Checkpoints only keep the sums, the compensation and the tile batch start over from them
+        if (compensationText) glClearTexImage(compensationText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        if (batchText) glClearTexImage(batchText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        tileIndex = 0;
+        tileSamples = 0;
+
+        // The kernel seeds its RNG with the sequence index derived from the
+        // sample count, so this also continues the random sequence where it stopped
+        numSamples = state.numSamples;
+    }
+
+    uint64_t PathTracer::sceneHash() const {
+        util::Hash hash;
+        hash.add(pathTracerSource.code);
+        for (const scene::Primitive& primitive : primitives)
+            hash.addValue(PrimitiveBuffer::pack(primitive));
+        for (const scene::Material& material : materials)
+            hash.addValue(MaterialBuffer::pack(material));
+        for (const scene::Medium& medium : media)
+            hash.addValue(MaterialBuffer::pack(medium));
+        hash.addValue(fbWidth);
+        hash.addValue(fbHeight);
+        hash.addValue(projMat);
+        hash.addValue(getLookAt());
+        hash.addValue(getTheta());
+        hash.addValue(getPhi());
+        hash.addValue(getDistance());
+        hash.addValue(getAperture());
+        hash.addValue(getFocusDistance());
+        hash.addValue(getShutter());
+        kernelSettings().addImageSettings(hash);
+        hash.add(environmentMap.getPath());
+        hash.addValue(environmentMap.getWidth());
+        hash.addValue(environmentMap.getHeight());
+        hash.add(densityGrid.getPath());
+        hash.addValue(densityGrid.getSize());
+        hash.add(voxelGrid.getPath());
+        hash.addValue(voxelGrid.getSize());
+        hash.addValue(voxelGrid.getNumVoxels());
+        return hash.get();
+    }
+
     void PathTracer::createFrameBufferTexture(GLsizei width, GLsizei height) {
         // Destroy existing framebuffer texture
         glDeleteTextures(1, &fbText);
+        glDeleteTextures(1, &batchText);
+        glDeleteTextures(1, &imageView);
+        batchText = 0;
+        imageView = 0;
 
         // Create new framebuffer texture
         glGenTextures(1, &fbText);
 
-        // Initialize framebuffer texture
+        // Initialize framebuffer texture, in the format of the accumulation
+        static const GLenum formats[] = { GL_RGBA32F, GL_RGBA16F, GL_RGB9_E5 };
         glBindTexture(GL_TEXTURE_2D, fbText);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+        glTexStorage2D(GL_TEXTURE_2D, 1, formats[accumulationFormat], width, height);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        // Memory lean accumulations only keep the float sums of a tile
+        if (accumulationFormat != ACCUMULATION_FLOAT) {
+            glCreateTextures(GL_TEXTURE_2D, 1, &batchText);
+            glTextureStorage2D(batchText, 1, GL_RGBA32F, LEAN_TILE_SIZE, LEAN_TILE_SIZE);
+            glClearTexImage(batchText, 0, GL_RGBA, GL_FLOAT, nullptr);
+        }
+
+        // Shared exponents are packed by the fold pass through an integer view
+        if (accumulationFormat == ACCUMULATION_SHARED_EXPONENT) {
+            glGenTextures(1, &imageView);
+            glTextureView(imageView, GL_TEXTURE_2D, fbText, GL_R32UI, 0, 1, 0, 1);
+        }
     }
 
-    /** Helper method to create shaders */
-    void createShaderProgram(opengl::ShaderProgram &program,
-            const std::string vertex, const std::string frag) {
-        opengl::ShaderObject vertexObject(GL_VERTEX_SHADER, vertex);
+    void PathTracer::createAovTextures() {
+        glDeleteTextures(1, &albedoText);
+        glDeleteTextures(1, &normalText);
+        glDeleteTextures(1, &statsText);
+        glDeleteTextures(1, &compensationText);
+        albedoText = 0;
+        normalText = 0;
+        statsText = 0;
+        compensationText = 0;
+
+        if (fbWidth == 0 || fbHeight == 0) return;
+
+        // Only the enabled outputs use memory
+        if (aovs & AOV_ALBEDO) {
+            glCreateTextures(GL_TEXTURE_2D, 1, &albedoText);
+            glTextureStorage2D(albedoText, 1, GL_RGBA32F, fbWidth, fbHeight);
+        }
+
+        if (aovs & AOV_NORMAL) {
+            glCreateTextures(GL_TEXTURE_2D, 1, &normalText);
+            glTextureStorage2D(normalText, 1, GL_RGBA32F, fbWidth, fbHeight);
+        }
+
+        if (aovs & AOV_STATS) {
+            glCreateTextures(GL_TEXTURE_2D, 1, &statsText);
+            glTextureStorage2D(statsText, 1, GL_RGBA32F, fbWidth, fbHeight);
+        }
+
+        if (compensated && accumulationFormat == ACCUMULATION_FLOAT) {
+            glCreateTextures(GL_TEXTURE_2D, 1, &compensationText);
+            glTextureStorage2D(compensationText, 1, GL_RGBA32F, fbWidth, fbHeight);
+        }
+    }
+
+    /** Helper method to create shaders, returns the link status */
+    bool createShaderProgram(opengl::ShaderProgram &program,
+            const ShaderSource& vertex, const ShaderSource& frag) {
+        opengl::ShaderObject vertexObject(GL_VERTEX_SHADER, vertex.code);
         vertexObject.create();
         vertexObject.compile();
 
-        std::cout << "vert: " << vertexObject.getCompileLog() << std::endl;
+        std::cout << "vert: " << vertex.remapLog(vertexObject.getCompileLog()) << std::endl;
 
-        opengl::ShaderObject fragObject(GL_FRAGMENT_SHADER, frag);
+        opengl::ShaderObject fragObject(GL_FRAGMENT_SHADER, frag.code);
         fragObject.create();
         fragObject.compile();
 
-        std::cout << "frag: " << fragObject.getCompileLog() << std::endl;
+        std::cout << "frag: " << frag.remapLog(fragObject.getCompileLog()) << std::endl;
 
         program.create();
+        program.setBinaryRetrievable();
         program.attach(vertexObject);
         program.attach(fragObject);
         program.link();
@@ -207,19 +1006,22 @@ namespace pathtracer {
         // Free resources
         vertexObject.destroy();
         fragObject.destroy();
+
+        return program.getLinkStatus() != GL_FALSE;
     }
 
-    /** Helper function to initialize compute shaders */
-    void createComputeShaderProgram(opengl::ShaderProgram& program, const std::string& shaderSource) {
+    /** Helper function to initialize compute shaders, returns the link status */
+    bool createComputeShaderProgram(opengl::ShaderProgram& program, const ShaderSource& shaderSource) {
         // Create the shader object
-        opengl::ShaderObject shaderObject(GL_COMPUTE_SHADER, shaderSource);
+        opengl::ShaderObject shaderObject(GL_COMPUTE_SHADER, shaderSource.code);
         shaderObject.create();
         shaderObject.compile();
 
-        std::cout << "comp: " << shaderObject.getCompileLog() << std::endl;
+        std::cout << "comp: " << shaderSource.remapLog(shaderObject.getCompileLog()) << std::endl;
 
         // Create shaders program
         program.create();
+        program.setBinaryRetrievable();
         program.attach(shaderObject);
         program.link();
 
@@ -227,33 +1029,386 @@ namespace pathtracer {
 
         // Free resources
         shaderObject.destroy();
+
+        return program.getLinkStatus() != GL_FALSE;
     }
 
     void PathTracer::initShaders() {
-        createShaderProgram(screenQuadProgram,
-            // Just a simple way of loading shader sources
-            #include "shaders/ScreenQuad.vert"
-                    ,
-            #include "shaders/ScreenQuad.frag"
-        );
-        createComputeShaderProgram(pathTracerProgram,
-            #include "PathTracer.comp"
-        );
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point start = Clock::now();
+
+        const ShaderSource vertex = preprocessor.process(shaderPath("ScreenQuad.vert"));
+        const ShaderSource frag = preprocessor.process(shaderPath("ScreenQuad.frag"));
+        pathTracerSource = preprocessor.process(shaderPath("PathTracer.comp"));
+
+        // Load linked programs from the cache, compile the missing ones
+        bool warm = true;
+
+        const uint64_t screenQuadKey = programCache.key({ vertex.code, frag.code }, preprocessor.getDefines());
+        if (!programCache.load(screenQuadProgram, screenQuadKey)) {
+            createShaderProgram(screenQuadProgram, vertex, frag);
+            programCache.store(screenQuadProgram, screenQuadKey);
+            warm = false;
+        }
+
+        const uint64_t pathTracerKey = programCache.key({ pathTracerSource.code }, preprocessor.getDefines());
+        if (!programCache.load(pathTracerProgram, pathTracerKey)) {
+            createComputeShaderProgram(pathTracerProgram, pathTracerSource);
+            programCache.store(pathTracerProgram, pathTracerKey);
+            warm = false;
+        }
+
+        const ShaderSource autofocusSource = preprocessor.process(shaderPath("Autofocus.comp"));
+        const uint64_t autofocusKey = programCache.key({ autofocusSource.code }, preprocessor.getDefines());
+        if (!programCache.load(autofocusProgram, autofocusKey)) {
+            createComputeShaderProgram(autofocusProgram, autofocusSource);
+            programCache.store(autofocusProgram, autofocusKey);
+            warm = false;
+        }
+
+        const ShaderSource foldSource = preprocessor.process(shaderPath("Fold.comp"));
+        const uint64_t foldKey = programCache.key({ foldSource.code }, preprocessor.getDefines());
+        if (!programCache.load(foldProgram, foldKey)) {
+            createComputeShaderProgram(foldProgram, foldSource);
+            programCache.store(foldProgram, foldKey);
+            warm = false;
+        }
+
+        // A program per pass of the GPU hierarchy builder
+        for (int pass = 0; pass < LbvhBuilder::NUM_PASSES; ++pass) {
+            ShaderPreprocessor passPreprocessor = preprocessor;
+            passPreprocessor.define("LBVH_PASS", std::to_string(pass));
+            const ShaderSource lbvhSource = passPreprocessor.process(shaderPath("Lbvh.comp"));
+            const uint64_t lbvhKey = programCache.key({ lbvhSource.code }, passPreprocessor.getDefines());
+            opengl::ShaderProgram& lbvhProgram = lbvhBuilder.getProgram(LbvhBuilder::Pass(pass));
+            if (!programCache.load(lbvhProgram, lbvhKey)) {
+                createComputeShaderProgram(lbvhProgram, lbvhSource);
+                programCache.store(lbvhProgram, lbvhKey);
+                warm = false;
+            }
+        }
+
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << "shaders: " << ms << " ms, " << (warm ? "warm (cached binaries)" : "cold (compiled)")
+            << std::endl;
+    }
+
+    void PathTracer::enableHotReload(ShaderReloader::ContextFunction makeCurrent,
+            ShaderReloader::ContextFunction doneCurrent) {
+        reloader.start(pathTracerSource.files, makeCurrent, doneCurrent,
+            [this](opengl::ShaderProgram& program, ShaderSource& source) {
+                source = preprocessor.process(shaderPath("PathTracer.comp"));
+                return createComputeShaderProgram(program, source);
+            });
+    }
+
+    std::string PathTracer::shaderPath(const std::string& name) const {
+        return (std::filesystem::path(shaderDir) / name).string();
     }
 
     void PathTracer::setPerspective(float fovy, float aspect, float zNear, float zFar) {
         projMat = glm::perspective(fovy, aspect, zNear, zFar);
     }
 
+    void PathTracer::setSampleStream(GLuint offset, GLuint stride) {
+        sampleOffset = offset;
+        sampleStride = stride;
+    }
+
+    void PathTracer::setSamplesPerDispatch(GLuint count) {
+        samplesPerDispatch = std::max(count, 1u);
+    }
+
+    void PathTracer::setSampleLimit(GLuint limit) {
+        sampleLimit = limit;
+    }
+
+    GLuint PathTracer::getNumSamples() const {
+        return numSamples;
+    }
+
     void PathTracer::setMaxBounces(unsigned int maxBounces) {
         this->maxBounces = maxBounces;
     }
 
+    void PathTracer::setSdfSteps(unsigned int sdfSteps) {
+        this->sdfSteps = int(sdfSteps);
+    }
+
+    void PathTracer::setAOVs(GLuint aovs) {
+        this->aovs = aovs;
+        createAovTextures();
+        restart();
+    }
+
+    void PathTracer::setHeatmap(GLuint heatmap, float scale) {
+        this->heatmap = heatmap;
+        heatmapScale = std::max(scale, 1e-3f);
+    }
+
+    const TraversalStats& PathTracer::getTraversalStats() const {
+        return traversalStats;
+    }
+
+    void PathTracer::setSampler(GLuint sampler) {
+        this->sampler = sampler;
+        restart();
+    }
+
+    bool PathTracer::parseFilter(const std::string& name, GLuint& filter) {
+        if (name == "none")                 filter = FILTER_NONE;
+        else if (name == "box")             filter = FILTER_BOX;
+        else if (name == "gaussian")        filter = FILTER_GAUSSIAN;
+        else if (name == "blackman-harris") filter = FILTER_BLACKMAN_HARRIS;
+        else if (name == "mitchell")        filter = FILTER_MITCHELL;
+        else return false;
+        return true;
+    }
+
+    void PathTracer::setFilter(GLuint filter) {
+        this->filter = filter;
+        restart();
+    }
+
+    void PathTracer::setPrimitives(const std::vector<scene::Primitive>& primitives) {
+        this->primitives = primitives;
+        primitivesDirty = true;
+    }
+
+    const std::vector<scene::Primitive>& PathTracer::getPrimitives() const {
+        return primitives;
+    }
+
+    void PathTracer::setMaterials(const std::vector<scene::Material>& materials) {
+        this->materials = materials;
+        materialsDirty = true;
+    }
+
+    const std::vector<scene::Material>& PathTracer::getMaterials() const {
+        return materials;
+    }
+
+    void PathTracer::setMedia(const std::vector<scene::Medium>& media) {
+        this->media = media;
+        materialsDirty = true;
+    }
+
+    const std::vector<scene::Medium>& PathTracer::getMedia() const {
+        return media;
+    }
+
+    void PathTracer::loadDensityGrid(const std::string& path) {
+        densityGrid.load(path);
+        restart();
+    }
+
+    void PathTracer::clearDensityGrid() {
+        densityGrid.clear();
+        restart();
+    }
+
+    void PathTracer::loadVoxels(const std::string& path) {
+        voxelGrid.load(path);
+        restart();
+    }
+
+    void PathTracer::clearVoxels() {
+        voxelGrid.clear();
+        restart();
+    }
+
+    void PathTracer::setMaterialSorting(bool sort) {
+        sortMaterials = sort;
+    }
+
+    void PathTracer::setTileCulling(bool culling) {
+        tileCulling = culling;
+    }
+
+    void PathTracer::setPersistentThreads(GLuint groups) {
+        persistentGroups = groups;
+    }
+
+    void PathTracer::setCompensatedSummation(bool compensated) {
+        this->compensated = compensated;
+        createAovTextures();
+        restart();
+    }
+
+    bool PathTracer::parseAccumulationFormat(const std::string& name, GLuint& format) {
+        if (name == "float")        format = ACCUMULATION_FLOAT;
+        else if (name == "half")    format = ACCUMULATION_HALF;
+        else if (name == "rgb9e5")  format = ACCUMULATION_SHARED_EXPONENT;
+        else return false;
+        return true;
+    }
+
+    void PathTracer::setAccumulationFormat(GLuint format) {
+        accumulationFormat = format;
+        if (fbWidth > 0 && fbHeight > 0) createFrameBufferTexture(fbWidth, fbHeight);
+        createAovTextures();
+        restart();
+    }
+
+    void PathTracer::setLeanBatch(GLuint samples) {
+        leanBatch = std::max(samples, 1u);
+        restart();
+    }
+
+    size_t PathTracer::getAccumulationBytes() const {
+        static const size_t texelBytes[] = { 16, 8, 4 };
+        size_t bytes = size_t(fbWidth) * size_t(fbHeight) * texelBytes[accumulationFormat];
+        if (batchText) bytes += size_t(LEAN_TILE_SIZE) * size_t(LEAN_TILE_SIZE) * 16;
+        if (compensationText) bytes += size_t(fbWidth) * size_t(fbHeight) * 16;
+        return bytes;
+    }
+
+    void PathTracer::setBvhLayout(GLuint layout) {
+        bvhLayout = layout;
+    }
+
+    void PathTracer::setGpuBvh(bool gpu) {
+        gpuBvh = gpu;
+        bvhUploaded = BVH_LINEAR;
+    }
+
+    void PathTracer::setSpatialSplits(float budget) {
+        spatialSplits = std::max(budget, 0.0f);
+        bvhUploaded = BVH_LINEAR;
+    }
+
+    GLuint PathTracer::treeLayout() const {
+        return gpuBvh && bvhLayout != BVH_LINEAR ? BVH_BINARY : bvhLayout;
+    }
+
+    void PathTracer::updateBvh() {
+        const GLuint layout = treeLayout();
+        if (layout == BVH_LINEAR) return;
+        if (bvhUploaded == layout && bvhShutter == getShutter()) return;
+
+        if (gpuBvh) {
+            // The tree is built from the uploaded table, only its size is needed here
+            scene::Aabb bounds;
+            bvhBounded = 0;
+            for (const scene::Primitive& primitive : primitives) {
+                if (scene::primitiveBounds(primitive, getShutter(), bounds)) ++bvhBounded;
+            }
+
+            primitiveBuffer.bind();
+            lbvhBuilder.build(primitives.size(), getShutter(), bvhBuffer);
+        } else {
+            // Moving primitives are bounded over the whole shutter interval
+            if (bvhUploaded == BVH_LINEAR || bvhShutter != getShutter())
+                bvh = scene::Bvh::build(primitives, getShutter(), spatialSplits);
+            bvhBuffer.upload(bvh, layout == BVH_WIDE);
+            bvhBounded = bvh.getIndices().size();
+        }
+
+        bvhUploaded = layout;
+        bvhShutter = getShutter();
+    }
+
+    void PathTracer::loadEnvironment(const std::string& path) {
+        environmentMap.load(path);
+        restart();
+    }
+
+    void PathTracer::clearEnvironment() {
+        environmentMap.clear();
+        restart();
+    }
+
+    void PathTracer::setSpecialization(bool specialize) {
+        this->specialize = specialize;
+    }
+
+    void PathTracer::setKernelContext(KernelVariants::ContextFunction makeCurrent,
+            KernelVariants::ContextFunction doneCurrent) {
+        kernelVariants.setBackgroundContext(makeCurrent, doneCurrent);
+    }
+
+    KernelSettings PathTracer::kernelSettings() const {
+        KernelSettings settings;
+        settings.bounces    = GLuint(maxBounces);
+        settings.materials  = scene::materialTypes(materials);
+        settings.primitives = scene::primitiveTypes(primitives);
+        settings.sdfSteps   = GLuint(sdfSteps);
+        settings.aovs       = aovs;
+        settings.sampler    = sampler;
+        settings.filter     = imageFilter();
+
+        settings.media      = scene::usesMedia(materials, media.size());
+
+        // With a single material type and no media every path already runs the same code.
+        // Persistent threads keep their paths, they aren't sorted across invocations.
+        // Splats need the whole workgroup on a tile, paths stay on their invocation.
+        const bool splat = settings.filter >= FILTER_GAUSSIAN;
+        settings.persistent = persistentGroups > 0 && accumulationFormat == ACCUMULATION_FLOAT && !splat;
+        settings.compensated = compensated && accumulationFormat == ACCUMULATION_FLOAT;
+        settings.sort       = sortMaterials && !settings.persistent && !splat &&
+            ((settings.materials & (settings.materials - 1)) != 0 || settings.media);
+        settings.thinLens   = !isPinhole();
+        settings.motionBlur = getShutter() > 0.0f;
+        settings.environment = environmentMap.isLoaded();
+
+        // Lens rays leave the frustum of the tile, they can't be culled. The
+        // barrier of the culling costs more than it saves on small scenes,
+        // and a hierarchy already culls per ray. Traversing costs more than
+        // testing a few primitives, the tree is up to date here. Persistent
+        // threads trace pixels of any tile.
+        settings.bvh = bvhBounded >= BVH_MIN_PRIMITIVES ? treeLayout() : BVH_LINEAR;
+        settings.tileCulling = tileCulling && !settings.thinLens && !settings.persistent &&
+            primitives.size() >= TILE_MIN_PRIMITIVES && settings.bvh == BVH_LINEAR;
+        return settings;
+    }
+
+    bool PathTracer::autofocus() {
+        // The center ray looks along the view direction, find the primitives halfway
+        // through the shutter interval
+        const glm::mat4& view = viewMat();
+        glm::vec3 forward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+
+        // Look at the scene about to be rendered, render() still restarts.
+        // The hierarchy may be built by other programs, use ours after it.
+        if (primitivesDirty) {
+            primitiveBuffer.upload(primitives);
+            bvhUploaded = BVH_LINEAR;
+        }
+        updateBvh();
+
+        autofocusProgram.use();
+        autofocusProgram.uniform("eye", getEye());
+        autofocusProgram.uniform("cameraForward", forward);
+        autofocusProgram.uniform("time", getShutter() * 0.5f);
+        autofocusProgram.uniform("sdfSteps", GLuint(sdfSteps));
+        autofocusProgram.uniform("bvhLayout", GLint(treeLayout()));
+        primitiveBuffer.bind();
+        voxelGrid.bind();
+        bvhBuffer.bind();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOCUS_BINDING, focusBuffer.getHandler());
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        GLfloat distance = -1.0f;
+        glGetNamedBufferSubData(focusBuffer.getHandler(), 0, sizeof(distance), &distance);
+        if (distance <= 0.0f) return false;
+
+        setFocusDistance(distance);
+        return true;
+    }
+
     void PathTracer::setActive(bool active) {
         this->isActive = active;
     }
 
     void PathTracer::setSSAA(bool ssaa) {
+        if (ssaa == this->ssaa) return;
         this->ssaa = ssaa;
+
+        // Resize the framebuffer for the current viewport, if there is one yet
+        if (viewportWidth > 0 && viewportHeight > 0) {
+            setViewport(0, 0, viewportWidth, viewportHeight);
+            restart();
+        }
     }
 }
@@ -39,9 +39,31 @@
 #include "../Renderer.h"
 
 #include "ScreenQuad.h"
+#include "ImageExporter.h"
+#include "Checkpointer.h"
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+#include "ShaderReloader.h"
+#include "KernelVariants.h"
+#include "MaterialBuffer.h"
+#include "PrimitiveBuffer.h"
+#include "EnvironmentMap.h"
+#include "DensityGrid.h"
+#include "VoxelGrid.h"
+#include "BvhBuffer.h"
+#include "LbvhBuilder.h"
 
 
 namespace pathtracer {
+
+    /** Traversal counters of the stats kernel, summed over the samples since the last restart */
+    struct TraversalStats {
+        uint64_t    nodes   = 0;    //!< Hierarchy nodes visited
+        uint64_t    tests   = 0;    //!< Primitive intersection tests
+        uint64_t    bounces = 0;    //!< Path segments
+        uint64_t    rays    = 0;    //!< Closest hit and shadow rays
+        uint64_t    paths   = 0;    //!< Camera paths
+    };
     
     /**
      * OpenGL Renderer which is responsible of drawing the scene.
@@ -64,13 +86,75 @@ namespace pathtracer {
         static constexpr GLfloat WORKGROUP_SIZE_X = 16.0f;
         static constexpr GLfloat WORKGROUP_SIZE_Y = 16.0f;
 
+        // What the screen quad shows, the image or a statistic of the stats AOV, must match ScreenQuad.frag
+        static constexpr GLuint HEATMAP_NONE    = 0;    //!< The image
+        static constexpr GLuint HEATMAP_NODES   = 1;    //!< Nodes visited per sample
+        static constexpr GLuint HEATMAP_TESTS   = 2;    //!< Primitives tested per sample
+        static constexpr GLuint HEATMAP_BOUNCES = 3;    //!< Bounces per sample
+
+        // How the image is accumulated, must match Fold.comp
+        static constexpr GLuint ACCUMULATION_FLOAT  = 0;    //!< RGBA32F sample sums, 16 bytes per pixel
+        static constexpr GLuint ACCUMULATION_HALF   = 1;    //!< RGBA16F mean, 8 bytes per pixel
+        static constexpr GLuint ACCUMULATION_SHARED_EXPONENT = 2;   //!< RGB9_E5 mean, 4 bytes per pixel
+
+        // Side of the tiles of the memory lean accumulations
+        static constexpr GLsizei LEAN_TILE_SIZE = 256;
+
+        /**
+         * Get the ACCUMULATION_* format of a name
+         * @param[in] name      float, half or rgb9e5
+         * @param[out] format   Format, untouched if the name is unknown
+         * @return False if the name is unknown
+         */
+        static bool parseAccumulationFormat(const std::string& name, GLuint& format);
+
+        /**
+         * Get the FILTER_* reconstruction filter of a name
+         * @param[in] name      none, box, gaussian, blackman-harris or mitchell
+         * @param[out] filter   Filter, untouched if the name is unknown
+         * @return False if the name is unknown
+         */
+        static bool parseFilter(const std::string& name, GLuint& filter);
+
         /**
          * Initialize shaders, load objects and set OpenGL configuration.
          * After calling create(), you must set a viewport in order
          * to visualize the scene correctly.
+         * @throws ShaderError if a shader file can't be loaded
          */
         void init();
 
+        /**
+         * Set the directory shaders are loaded from. Must be called before init()
+         * @param[in] directory Shader directory
+         */
+        void setShaderDir(const std::string& directory);
+
+        /**
+         * Rebuild the path tracing kernel in the background when one of its
+         * files changes. The new kernel replaces the old one on render() and
+         * sampling restarts.
+         * @param[in] makeCurrent   Makes current a context sharing objects with the render context
+         * @param[in] doneCurrent   Releases that context
+         */
+        void enableHotReload(ShaderReloader::ContextFunction makeCurrent,
+                ShaderReloader::ContextFunction doneCurrent);
+
+        /**
+         * Compile kernel variants on a background context when the driver
+         * can't compile in parallel
+         * @param[in] makeCurrent   Makes current a context sharing objects with the render context
+         * @param[in] doneCurrent   Releases that context
+         */
+        void setKernelContext(KernelVariants::ContextFunction makeCurrent,
+                KernelVariants::ContextFunction doneCurrent);
+
+        /**
+         * Set the program binary cache directory. Must be called before init()
+         * @param[in] directory Cache directory, empty disables the cache
+         */
+        void setShaderCache(const std::string& directory);
+
         /** Free all resources */
         void destroy();
 
@@ -102,6 +186,34 @@ namespace pathtracer {
         /** Export render image to file */
         void readFrameBuffer(uint8_t* image, size_t w, size_t h) const;
 
+        /**
+         * Export the accumulated radiance without blocking the render loop.
+         * @param[in] path Output file: .exr, .pfm or .png
+         */
+        void exportImage(const std::string& path);
+
+        /** Get the image exporter, e.g. to change OpenEXR options */
+        ImageExporter& getExporter();
+
+        /**
+         * Enable periodic checkpoints of the accumulation state.
+         * @param[in] path      Checkpoint file, empty disables checkpoints
+         * @param[in] interval  Seconds between checkpoints
+         */
+        void setCheckpoint(const std::string& path, float interval);
+
+        /** Save a checkpoint now (asynchronously) */
+        void checkpoint();
+
+        /**
+         * Continue a render from a checkpoint. Restores the camera and the
+         * accumulated samples. Must be called after setViewport().
+         * @param[in] path Checkpoint file
+         * @throws io::CheckpointError if the file can't be read or doesn't
+         *         match the current scene or framebuffer size
+         */
+        void resume(const std::string& path);
+
         /**
          * Change OpenGL clear color.
          * @param[in] r Red component
@@ -115,15 +227,229 @@ namespace pathtracer {
          */
         void restart();
 
+        /**
+         * Select which samples of the global sample sequence this renderer
+         * draws: sample n of the accumulation uses sequence index
+         * offset + n * stride. Processes with the same stride and different
+         * offsets render independent samples whose sums can be merged.
+         * @param[in] offset    First sequence index, usually the worker index
+         * @param[in] stride    Distance between indices, usually the worker count
+         */
+        void setSampleStream(GLuint offset, GLuint stride);
+
+        /**
+         * Trace several samples per pixel in every dispatch, added up in the
+         * kernel before they are accumulated. Doesn't change the image, only
+         * how often the kernel is launched and the accumulation is updated.
+         * Traversal statistics (AOV_STATS) keep one sample per dispatch.
+         * @param[in] count Samples per pixel of a dispatch, at least 1
+         */
+        void setSamplesPerDispatch(GLuint count);
+
+        /**
+         * Stop sampling when some amount of samples is accumulated, the last
+         * dispatch takes fewer samples if needed
+         * @param[in] limit Samples per pixel, 0 for no limit
+         */
+        void setSampleLimit(GLuint limit);
+
+        /** Get the amount of samples accumulated per pixel */
+        GLuint getNumSamples() const;
+
         /** Set max number of ray bounces */
         void setMaxBounces(unsigned int maxBounces);
 
+        /** Set the sphere tracing step cap of signed distance functions */
+        void setSdfSteps(unsigned int sdfSteps);
+
+        /**
+         * Enable arbitrary output variables, exported as image layers.
+         * Sampling restarts.
+         * @param[in] aovs AOV_* bits
+         */
+        void setAOVs(GLuint aovs);
+
+        /**
+         * Show a statistic of the stats AOV as a heatmap instead of the
+         * image. Only the debug kernel enabled by AOV_STATS counts them.
+         * @param[in] heatmap   HEATMAP_* statistic, HEATMAP_NONE shows the image
+         * @param[in] scale     Value per sample shown at the hot end of the scale
+         */
+        void setHeatmap(GLuint heatmap, float scale);
+
+        /** Get the traversal counters of the samples since the last restart, zero without AOV_STATS */
+        const TraversalStats& getTraversalStats() const;
+
+        /**
+         * Select the sample generator, sampling restarts
+         * @param[in] sampler SAMPLER_INDEPENDENT or SAMPLER_KRONECKER
+         */
+        void setSampler(GLuint sampler);
+
+        /**
+         * Select the reconstruction filter, sampling restarts. Past the box,
+         * samples are splatted on the pixels around them weighted by the
+         * filter, and the alpha of the image sums the weights. Antialiases at
+         * the framebuffer resolution, unlike SSAA. Memory lean accumulations
+         * can't splat past their tiles, they use the box instead.
+         * @param[in] filter FILTER_* filter
+         */
+        void setFilter(GLuint filter);
+
+        /**
+         * Replace the primitives of the scene, sampling restarts. Primitive
+         * types the scene doesn't use are compiled out of the kernel variants.
+         * @param[in] primitives Primitives, see scene::namedScene()
+         */
+        void setPrimitives(const std::vector<scene::Primitive>& primitives);
+
+        /** Get the primitives of the scene */
+        const std::vector<scene::Primitive>& getPrimitives() const;
+
+        /**
+         * Replace the material table, sampling restarts. Material types the
+         * table doesn't use are compiled out of the kernel variants.
+         * @param[in] materials Materials, indexed by the sphere material ids
+         */
+        void setMaterials(const std::vector<scene::Material>& materials);
+
+        /** Get the material table */
+        const std::vector<scene::Material>& getMaterials() const;
+
+        /**
+         * Replace the media table, sampling restarts. Dielectric materials
+         * select their medium by index, kernels without media are used
+         * while no material does.
+         * @param[in] media Media, indexed by the materials
+         */
+        void setMedia(const std::vector<scene::Medium>& media);
+
+        /** Get the media table */
+        const std::vector<scene::Medium>& getMedia() const;
+
+        /**
+         * Load the density grid of the heterogeneous media, sampling restarts
+         * @param[in] path Mitsuba .vol file
+         * @throws io::VolumeError if the file can't be read
+         */
+        void loadDensityGrid(const std::string& path);
+
+        /** Go back to a constant density, sampling restarts */
+        void clearDensityGrid();
+
+        /**
+         * Load the voxel model of the VOXELS primitives, sampling restarts
+         * @param[in] path Mitsuba .vol file of material ids + 1, 0 is empty
+         * @throws io::VolumeError if the file can't be read
+         */
+        void loadVoxels(const std::string& path);
+
+        /** Go back to the built-in voxel model, sampling restarts */
+        void clearVoxels();
+
+        /**
+         * Enable/disable sorting paths by material type before shading.
+         * Doesn't change the image, only how coherently the kernel runs.
+         */
+        void setMaterialSorting(bool sort);
+
+        /**
+         * Enable/disable culling the primitives of the primary rays per
+         * workgroup tile. Doesn't change the image, only how many
+         * primitives the first rays test.
+         */
+        void setTileCulling(bool culling);
+
+        /**
+         * Keep some workgroups resident, taking pixels from a work queue and
+         * starting a new path as soon as one ends, instead of launching one
+         * invocation per pixel. Doesn't change the image, only how busy the
+         * invocations are. Paths aren't sorted nor culled per tile then.
+         * @param[in] groups Resident workgroups, 0 launches one invocation per pixel
+         */
+        void setPersistentThreads(GLuint groups);
+
+        /**
+         * Accumulate the image with Kahan summation. A second texture keeps
+         * the rounding error of every pixel and feeds it back into the next
+         * sample, so long renders don't lose the contribution of late
+         * samples to float rounding. Sampling restarts.
+         * @param[in] compensated   Compensated summation?
+         */
+        void setCompensatedSummation(bool compensated);
+
+        /**
+         * Select how the image is accumulated. The memory lean formats keep
+         * the mean of every pixel in a compact texture. The image is rendered
+         * one tile at a time: a batch of samples is added up in a float tile,
+         * then folded into the mean. Paths are neither persistent nor
+         * compensated then. Sampling restarts.
+         * @param[in] format ACCUMULATION_* format
+         */
+        void setAccumulationFormat(GLuint format);
+
+        /**
+         * Set the samples a tile of the memory lean accumulation renders
+         * before they are folded into the image. Larger batches round the
+         * mean less often, smaller ones show the whole image sooner.
+         * Sampling restarts.
+         * @param[in] samples Samples per pixel of a batch, at least 1
+         */
+        void setLeanBatch(GLuint samples);
+
+        /** Get the bytes of the image and the textures it is accumulated with */
+        size_t getAccumulationBytes() const;
+
+        /**
+         * Set the layout of the bounding volume hierarchy of the scene.
+         * Doesn't change the image, only how many primitives rays test.
+         * @param[in] layout BVH_* layout, BVH_LINEAR tests every primitive
+         */
+        void setBvhLayout(GLuint layout);
+
+        /**
+         * Build the hierarchy on the GPU from the primitive table instead of
+         * on the CPU, for scenes whose primitives change every frame. The
+         * GPU tree has a primitive per leaf and always uses the binary
+         * layout, it's cheaper to build and slower to traverse.
+         * @param[in] gpu Build on the GPU?
+         */
+        void setGpuBvh(bool gpu);
+
+        /**
+         * Let the CPU hierarchy split primitives across nodes where that
+         * lowers the traversal cost. The tree traces faster on overlapping
+         * primitives but takes longer to build, it suits final frames.
+         * @param[in] budget Extra primitive references, relative to the bounded primitives. 0 disables spatial splits.
+         */
+        void setSpatialSplits(float budget);
+
+        /**
+         * Light the scene with an equirectangular HDR map, sampling restarts
+         * @param[in] path .pfm or .hdr image
+         * @throws io::ImageIOError if the image can't be read
+         */
+        void loadEnvironment(const std::string& path);
+
+        /** Go back to the default sky, sampling restarts */
+        void clearEnvironment();
+
+        /** Enable/disable kernels specialized for the current settings */
+        void setSpecialization(bool specialize);
+
+        /**
+         * Focus on the primitive under the image center. Waits for the GPU.
+         * @return False if no primitive is under the center, focus doesn't change
+         */
+        bool autofocus();
+
         /** Set if pathtracer is running or stopped */
         void setActive(bool active);
 
         /**
-         * Enable/disable supersampling antialiasing.
-         * Changes will not be effective until setViewport is not invoked.
+         * Enable/disable supersampling antialiasing. With a viewport already
+         * set, the framebuffer is created again at the new size and sampling
+         * restarts, otherwise it takes effect on the next setViewport.
          */
         void setSSAA(bool ssaa);
 
@@ -136,24 +462,123 @@ namespace pathtracer {
          */
         void createFrameBufferTexture(GLsizei width, GLsizei height); 
 
-        /** Create, compile and link shaders */
+        /**
+         * Fold the batch rendered on the current tile into the image of the
+         * memory lean accumulation
+         * @param[in] samples Samples per pixel of the batch
+         */
+        void foldTile(GLuint samples);
+
+        /** Get the first pixel of the current tile of the memory lean accumulation */
+        glm::ivec2 tileOrigin() const;
+
+        /** Get the filter the kernel runs with, memory lean tiles can't splat */
+        GLuint imageFilter() const;
+
+        /**
+         * Create, compile and link shaders
+         * @throws ShaderError if a shader file can't be loaded
+         */
         void initShaders();
 
+        /** (Re)create the AOV textures of the enabled outputs and the compensation texture */
+        void createAovTextures();
+
+        /** Build and upload the hierarchy if the scene, the shutter or the layout changed */
+        void updateBvh();
+
+        /** Get the layout of the uploaded hierarchy, the GPU only builds binary trees */
+        GLuint treeLayout() const;
+
+        /** Get the settings the kernel runs with */
+        KernelSettings kernelSettings() const;
+
+        /** Get the path of a shader file */
+        std::string shaderPath(const std::string& name) const;
+
+        /** Hash of everything that makes accumulated samples incompatible */
+        uint64_t sceneHash() const;
+
         bool        ssaa;       //!< Supersampling antialiasing?
+        GLsizei     viewportWidth;  //!< Viewport width, the framebuffer is twice as large with SSAA
+        GLsizei     viewportHeight; //!< Viewport height
         GLsizei     fbWidth;    //!< Framebuffer width
         GLsizei     fbHeight;   //!< Framebuffer height
         GLuint      fbText;     //!< Texture where to render the scene
+        GLuint      albedoText; //!< Accumulated first hit albedo, 0 if disabled
+        GLuint      normalText; //!< Accumulated first hit normal, 0 if disabled
+        GLuint      statsText;  //!< Accumulated traversal statistics, 0 if disabled
+        GLuint      compensationText;   //!< Rounding error of the accumulation, 0 if disabled
+        GLuint      batchText;  //!< Sample sums of the batch of the current tile, 0 unless memory lean
+        GLuint      imageView;  //!< R32UI view of a shared exponent image, 0 for other formats
         GLuint      numSamples; //!< Path tracing amount of samples
+        GLuint      sampleOffset;   //!< First index of the sample sequence
+        GLuint      sampleStride;   //!< Distance between sample sequence indices
+        GLuint      samplesPerDispatch; //!< Samples per pixel traced by a dispatch
+        GLuint      sampleLimit;    //!< Samples per pixel to stop at, 0 for no limit
         glm::vec4   clearColor; //!< Clear color
         glm::mat4   projMat;    //!< Projection matrix
 
         // Simulation configuration
         bool    isActive;   // Is path tracing running or stopped?
         int     maxBounces; // Max number of ray bounces
-
+        int     sdfSteps;   // Sphere tracing step cap
+        GLuint  aovs;       // Enabled AOV_* outputs
+        GLuint  heatmap;        // HEATMAP_* statistic shown instead of the image
+        float   heatmapScale;   // Value per sample at the hot end of the heatmap
+        GLuint  sampler;    // SAMPLER_* generator
+        GLuint  filter;     // FILTER_* reconstruction filter
+        bool    sortMaterials;  // Sort paths by material before shading?
+        bool    tileCulling;    // Cull primitives per tile for the primary rays?
+        GLuint  persistentGroups;   // Resident workgroups, 0 launches one invocation per pixel
+        bool    compensated;    // Kahan summation of the accumulation?
+        GLuint  accumulationFormat; // ACCUMULATION_* format of the image
+        GLuint  leanBatch;      // Samples per pixel of a tile batch
+        GLuint  tileIndex;      // Tile the memory lean accumulation renders
+        GLuint  tileSamples;    // Samples of the batch of that tile so far
+        GLuint  bvhLayout;      // BVH_* layout of the scene hierarchy
+        bool    gpuBvh;         // Build the hierarchy on the GPU?
+        float   spatialSplits;  // Reference budget of the spatial splits of the CPU hierarchy
+        bool    specialize;     // Use kernel variants?
+
+        char    exportPath[256];    // Export file name edited on the GUI
+        char    environmentPath[256];   // Environment map file edited on the GUI
+        char    densityGridPath[256];   // Density grid file edited on the GUI
+        char    voxelsPath[256];        // Voxel model file edited on the GUI
+
+        ImageExporter           exporter;           //!< Asynchronous image export
+        Checkpointer            checkpointer;       //!< Periodic accumulation checkpoints
+        ProgramCache            programCache;       //!< Linked program binaries on disk
+        std::string             shaderDir;          //!< Directory of the shader files
+        ShaderPreprocessor      preprocessor;       //!< Resolves shader includes and defines
+        ShaderReloader          reloader;           //!< Rebuilds the kernel when its files change
         ScreenQuad              screenQuad;         //!< ScreenQuad where to draw render texture
         opengl::ShaderProgram   screenQuadProgram;  //!< Draw texture to ScreenQuad
-        opengl::ShaderProgram   pathTracerProgram;  //!< Path tracing compute shader
+        opengl::ShaderProgram   pathTracerProgram;  //!< Generic path tracing compute shader
+        opengl::ShaderProgram   autofocusProgram;   //!< Finds the sphere under the image center
+        opengl::ShaderProgram   foldProgram;        //!< Folds tile batches into a memory lean image
+        opengl::BufferObject    focusBuffer;        //!< Autofocus result
+        opengl::BufferObject    statsBuffer;        //!< Traversal counters of the last sample
+        opengl::BufferObject    workQueue;          //!< Next pixel of the persistent threads
+        TraversalStats          traversalStats;     //!< Traversal counters since the last restart
+        KernelVariants          kernelVariants;     //!< Kernels specialized for the settings
+        std::vector<scene::Primitive> primitives;   //!< Shapes of the scene
+        PrimitiveBuffer         primitiveBuffer;    //!< Primitive table on the GPU
+        bool                    primitivesDirty;    //!< Primitives changed since the upload?
+        std::vector<scene::Material> materials;     //!< Material table of the scene
+        MaterialBuffer          materialBuffer;     //!< Material table on the GPU
+        std::vector<scene::Medium> media;           //!< Media inside the dielectrics
+        bool                    materialsDirty;     //!< Materials or media changed since the upload?
+        EnvironmentMap          environmentMap;     //!< Light of the escaped paths
+        DensityGrid             densityGrid;        //!< Density of the heterogeneous media
+        VoxelGrid               voxelGrid;          //!< Voxel model of the VOXELS primitives
+        BvhBuffer               bvhBuffer;          //!< Hierarchy of the primitives on the GPU
+        GLuint                  bvhUploaded;        //!< Layout of the uploaded hierarchy, BVH_LINEAR if outdated
+        float                   bvhShutter;         //!< Shutter the uploaded hierarchy bounds
+        size_t                  bvhBounded;         //!< Primitives in the uploaded hierarchy
+        LbvhBuilder             lbvhBuilder;        //!< Builds the hierarchy on the GPU
+        scene::Bvh              bvh;                //!< Hierarchy of the primitives
+        ShaderSource            pathTracerSource;   //!< Path tracing compute shader source
     };
 
 }
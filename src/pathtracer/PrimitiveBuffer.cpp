@@ -0,0 +1,102 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "PrimitiveBuffer.h"
+
+namespace pathtracer {
+
+    // std430 packs an array of 4 vec4 structs without padding
+    static_assert(sizeof(PrimitiveBuffer::Packed) == 64, "unexpected packed primitive layout");
+
+    PrimitiveBuffer::PrimitiveBuffer()
+        : buffer(GL_SHADER_STORAGE_BUFFER)
+        , packed() {
+
+    }
+
+    void PrimitiveBuffer::create() {
+        buffer.create();
+    }
+
+    void PrimitiveBuffer::destroy() {
+        if (buffer.isCreated()) buffer.destroy();
+    }
+
+    void PrimitiveBuffer::upload(const std::vector<scene::Primitive>& primitives) {
+        packed.clear();
+        for (const scene::Primitive& primitive : primitives)
+            packed.push_back(pack(primitive));
+
+        // An empty storage buffer can't be bound, a sphere far behind everything takes its place
+        if (packed.empty()) packed.push_back(pack(scene::makeSphere(0, glm::vec3(0.0f, -1e6f, 0.0f), 1.0f)));
+
+        buffer.bind();
+        buffer.setData(packed, GL_DYNAMIC_DRAW);
+        buffer.unbind();
+    }
+
+    void PrimitiveBuffer::bind() const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer.getHandler());
+    }
+
+    PrimitiveBuffer::Packed PrimitiveBuffer::pack(const scene::Primitive& primitive) {
+        Packed p = {};
+        for (int i = 0; i < 3; ++i) {
+            p.center[i]     = primitive.center[i];
+            p.velocity[i]   = primitive.velocity[i];
+        }
+        p.type      = primitive.type;
+        p.material  = primitive.material;
+        p.function  = primitive.function;
+
+        glm::vec3 shape(0.0f);
+        switch (primitive.type) {
+            case scene::Primitive::SPHERE:
+                p.size      = primitive.radius;
+                break;
+            case scene::Primitive::BOX:
+                shape       = primitive.halfExtents;
+                break;
+            case scene::Primitive::PLANE:
+                shape       = primitive.axis;
+                break;
+            case scene::Primitive::CYLINDER:
+                p.size      = primitive.radius;
+                p.size2     = primitive.halfHeight;
+                shape       = primitive.axis;
+                break;
+            case scene::Primitive::TORUS:
+                p.size      = primitive.radius;
+                p.size2     = primitive.minorRadius;
+                shape       = primitive.axis;
+                break;
+            case scene::Primitive::SDF:
+                p.size      = primitive.params.x;
+                p.size2     = primitive.params.y;
+                shape       = primitive.halfExtents;
+                break;
+            case scene::Primitive::VOXELS:
+                shape       = primitive.halfExtents;
+                break;
+            default:
+                break;
+        }
+
+        for (int i = 0; i < 3; ++i) p.shape[i] = shape[i];
+        return p;
+    }
+}
@@ -0,0 +1,85 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_PRIMITIVEBUFFER_H_
+#define PATHTRACER_PRIMITIVEBUFFER_H_
+
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "../opengl/BufferObject.h"
+#include "../scene/Primitive.h"
+
+namespace pathtracer {
+
+    /**
+     * Primitive table of the kernel, a shader storage buffer with 64 bytes
+     * per primitive tagged with its type. Editing the scene only uploads the
+     * table again, the kernel is not recompiled.
+     */
+    class PrimitiveBuffer {
+    public:
+
+        /** Shader storage binding point, must match Primitive.glsl */
+        static constexpr GLuint BINDING = 4;
+
+        /** Primitive as the kernel reads it, must match struct Primitive of Primitive.glsl */
+        struct Packed {
+            float       center[3];      //!< Center when the shutter opens
+            float       size;           //!< Radius, torus major radius, params.x of a function
+            float       velocity[3];    //!< Center displacement per unit of shutter time
+            float       size2;          //!< Cylinder half height, torus minor radius, params.y of a function
+            float       shape[3];       //!< Axis of planes, cylinders and tori, half extents of boxes, functions and voxels
+            float       unused;
+            uint32_t    type;           //!< scene::Primitive::Type
+            uint32_t    material;       //!< Index of the material table
+            uint32_t    function;       //!< Signed distance function
+            uint32_t    padding;
+        };
+
+        /** Default constructor */
+        PrimitiveBuffer();
+
+        /** Create the buffer object */
+        void create();
+
+        /** Free the buffer object */
+        void destroy();
+
+        /**
+         * Upload a primitive table
+         * @param[in] primitives Primitives of the scene
+         */
+        void upload(const std::vector<scene::Primitive>& primitives);
+
+        /** Bind the table to its binding point */
+        void bind() const;
+
+        /** Pack a primitive into the kernel layout */
+        static Packed pack(const scene::Primitive& primitive);
+
+    private:
+
+        opengl::BufferObject    buffer;     //!< Packed primitive table
+        std::vector<Packed>     packed;     //!< Staging copy of the table
+    };
+
+}
+
+#endif //PATHTRACER_PRIMITIVEBUFFER_H_
@@ -0,0 +1,187 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "../util/Hash.h"
+
+#include "ProgramCache.h"
+
+namespace pathtracer {
+
+    static const char      MAGIC[4]    = { 'P', 'T', 'P', 'B' };
+    static const uint32_t  VERSION     = 1;
+
+    /** Entry file header, followed by the binary */
+    struct Header {
+        char        magic[4];
+        uint32_t    version;
+        uint32_t    format;     // Driver binary format
+        uint32_t    size;       // Binary size in bytes
+        uint64_t    key;        // Detects hash file name collisions
+    };
+
+    static_assert(sizeof(Header) == 24, "unexpected program cache header layout");
+
+    /** Get a GL string, empty if the driver returns none */
+    static std::string glString(GLenum name) {
+        const GLubyte* str = glGetString(name);
+        return str ? reinterpret_cast<const char*>(str) : "";
+    }
+
+    /** Temporary file name no other process or thread writes at the same time */
+    static std::string tmpEntryPath(const std::string& path) {
+        static std::atomic<unsigned> counter(0);
+#ifdef _WIN32
+        const long pid = long(_getpid());
+#else
+        const long pid = long(getpid());
+#endif
+        return path + "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+    }
+
+    ProgramCache::ProgramCache()
+        : directory() {
+
+    }
+
+    void ProgramCache::setDirectory(const std::string& directory) {
+        this->directory = directory;
+    }
+
+    const std::string& ProgramCache::getDirectory() const {
+        return directory;
+    }
+
+    bool ProgramCache::isEnabled() const {
+        if (directory.empty()) return false;
+
+        GLint numFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+        return numFormats > 0;
+    }
+
+    uint64_t ProgramCache::key(const std::vector<std::string>& sources, const std::string& defines) const {
+        util::Hash hash;
+        for (const std::string& source : sources) hash.add(source);
+        hash.add(defines);
+        hash.add(glString(GL_VENDOR));
+        hash.add(glString(GL_RENDERER));
+        hash.add(glString(GL_VERSION));
+        hash.add(glString(GL_SHADING_LANGUAGE_VERSION));
+        return hash.get();
+    }
+
+    bool ProgramCache::load(opengl::ShaderProgram& program, uint64_t key) const {
+        if (!isEnabled()) return false;
+
+        const std::string path = entryPath(key);
+        std::error_code error;
+        const uintmax_t fileSize = std::filesystem::file_size(path, error);
+        if (error || fileSize < sizeof(Header)) return false;
+
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) return false;
+
+        Header header;
+        std::vector<GLubyte> binary;
+        bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                  std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                  header.version == VERSION && header.key == key && header.size > 0 &&
+                  header.size == fileSize - sizeof(Header);   // Truncated or corrupt entry
+        if (ok) {
+            binary.resize(header.size);
+            ok = std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        std::fclose(file);
+
+        if (!ok) return false;
+
+        program.create();
+        if (program.loadBinary(GLenum(header.format), binary)) return true;
+
+        // Rejected, e.g. the driver changed without changing its version string
+        program.destroy();
+        return false;
+    }
+
+    void ProgramCache::store(const opengl::ShaderProgram& program, uint64_t key) const {
+        if (!isEnabled() || program.getLinkStatus() == GL_FALSE) return;
+
+        GLenum format = 0;
+        std::vector<GLubyte> binary = program.getBinary(format);
+        if (binary.empty()) return;
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version  = VERSION;
+        header.format   = uint32_t(format);
+        header.size     = uint32_t(binary.size());
+        header.key      = key;
+
+        // Write to a temporary file and rename, concurrent instances never see half an entry
+        const std::string path = entryPath(key);
+        const std::string tmpPath = tmpEntryPath(path);
+        FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (!file) {
+            std::cerr << "shader cache: can't open " << tmpPath << " for writing" << std::endl;
+            return;
+        }
+
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+        ok = (std::fclose(file) == 0) && ok;
+
+        if (ok) std::filesystem::rename(tmpPath, path, error);
+        if (!ok || error) {
+            std::remove(tmpPath.c_str());
+            std::cerr << "shader cache: error writing " << path << std::endl;
+        }
+    }
+
+    std::string ProgramCache::defaultDirectory() {
+        std::filesystem::path base;
+#ifdef _WIN32
+        if (const char* localAppData = std::getenv("LOCALAPPDATA")) base = localAppData;
+#else
+        if (const char* cacheHome = std::getenv("XDG_CACHE_HOME")) base = cacheHome;
+        else if (const char* home = std::getenv("HOME")) base = std::filesystem::path(home) / ".cache";
+#endif
+        if (base.empty()) return "";
+        return (base / "pathtracer" / "shaders").string();
+    }
+
+    std::string ProgramCache::entryPath(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return (std::filesystem::path(directory) / name).string();
+    }
+}
@@ -0,0 +1,95 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_PROGRAMCACHE_H_
+#define PATHTRACER_PROGRAMCACHE_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "../opengl/ShaderProgram.h"
+
+namespace pathtracer {
+
+    /**
+     * On disk cache of linked program binaries, so startup skips compiling
+     * shaders. Entries are keyed by a hash of the shader sources, the
+     * preprocessor defines and the driver vendor, renderer and version, so
+     * editing a shader or updating the driver never loads a stale binary.
+     * Cache failures are never fatal, programs are compiled instead.
+     */
+    class ProgramCache {
+    public:
+
+        /** Default constructor, the cache is disabled */
+        ProgramCache();
+
+        /**
+         * Set cache directory
+         * @param[in] directory Directory, empty disables the cache
+         */
+        void setDirectory(const std::string& directory);
+
+        /** Get cache directory */
+        const std::string& getDirectory() const;
+
+        /**
+         * Is the cache usable? False if disabled or the driver has no binary
+         * formats. Requires a current context.
+         */
+        bool isEnabled() const;
+
+        /**
+         * Get the cache key of a program. Requires a current context.
+         * @param[in] sources   Source of every shader stage
+         * @param[in] defines   Preprocessor defines the sources are compiled with
+         */
+        uint64_t key(const std::vector<std::string>& sources, const std::string& defines) const;
+
+        /**
+         * Create program from a cached binary
+         * @param[out] program  Program to create, left destroyed on a miss
+         * @param[in] key       Cache key
+         * @return True on a hit, false if there is no valid binary
+         */
+        bool load(opengl::ShaderProgram& program, uint64_t key) const;
+
+        /**
+         * Save the binary of a linked program, which must have been linked
+         * with ShaderProgram::setBinaryRetrievable()
+         * @param[in] program   Linked program
+         * @param[in] key       Cache key
+         */
+        void store(const opengl::ShaderProgram& program, uint64_t key) const;
+
+        /** Per user cache directory: $XDG_CACHE_HOME, ~/.cache or %LOCALAPPDATA% */
+        static std::string defaultDirectory();
+
+    private:
+
+        /** Get the file of a cache entry */
+        std::string entryPath(uint64_t key) const;
+
+        std::string directory;  //!< Cache directory, empty when disabled
+    };
+
+}
+
+#endif //PATHTRACER_PROGRAMCACHE_H_
@@ -0,0 +1,161 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <regex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+
+#include "ShaderPreprocessor.h"
+
+namespace pathtracer {
+
+    // Directives handled here, commented out ones are left alone
+    static const std::regex VERSION_DIRECTIVE("^\\s*#\\s*version\\b.*");
+    static const std::regex INCLUDE_DIRECTIVE("^\\s*#\\s*include\\b(.*)");
+    static const std::regex INCLUDE_FILE("^\\s*\"([^\"]+)\"\\s*(//.*)?");
+
+    // Source string number at the start of a log line: Mesa "3:12(5):",
+    // NVIDIA "3(12) :", AMD "ERROR: 3:12:"
+    static const std::regex LOG_LOCATION("^(\\s*(?:(?:ERROR|WARNING): )?)(\\d+)(?=[:(]\\d)");
+
+    /** Read a text file as lines without line terminators */
+    static std::vector<std::string> readLines(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) throw ShaderError("can't open " + path);
+
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            lines.push_back(line);
+        }
+
+        if (file.bad()) throw ShaderError("error reading " + path);
+        return lines;
+    }
+
+    std::string ShaderSource::remapLog(const std::string& log) const {
+        std::istringstream in(log);
+        std::string result, line;
+        while (std::getline(in, line)) {
+            std::smatch match;
+            if (std::regex_search(line, match, LOG_LOCATION)) {
+                size_t index = std::stoul(match[2].str());
+                if (index < files.size())
+                    line = match[1].str() + files[index] + match.suffix().str();
+            }
+            result += line + "\n";
+        }
+        return result;
+    }
+
+    ShaderPreprocessor::ShaderPreprocessor()
+        : includePaths()
+        , defines() {
+
+    }
+
+    void ShaderPreprocessor::addIncludePath(const std::string& directory) {
+        includePaths.push_back(directory);
+    }
+
+    void ShaderPreprocessor::define(const std::string& name, const std::string& value) {
+        auto it = std::find_if(defines.begin(), defines.end(),
+            [&name](const std::pair<std::string, std::string>& define) { return define.first == name; });
+
+        if (it != defines.end()) it->second = value;
+        else defines.emplace_back(name, value);
+    }
+
+    void ShaderPreprocessor::clearDefines() {
+        defines.clear();
+    }
+
+    std::string ShaderPreprocessor::getDefines() const {
+        std::string code;
+        for (const auto& define : defines)
+            code += "#define " + define.first + " " + define.second + "\n";
+        return code;
+    }
+
+    ShaderSource ShaderPreprocessor::process(const std::string& path) const {
+        ShaderSource source;
+        processFile(std::filesystem::path(path).lexically_normal().string(), source);
+        return source;
+    }
+
+    void ShaderPreprocessor::processFile(const std::string& path, ShaderSource& source) const {
+        // Every file is included once
+        if (std::find(source.files.begin(), source.files.end(), path) != source.files.end()) return;
+
+        const std::vector<std::string> lines = readLines(path);
+        const std::string index = std::to_string(source.files.size());
+        const bool isMain = source.files.empty();
+        source.files.push_back(path);
+
+        if (isMain) {
+            // Defines go after #version, which must be the first directive
+            bool hasVersion = std::any_of(lines.begin(), lines.end(),
+                [](const std::string& line) { return std::regex_match(line, VERSION_DIRECTIVE); });
+            if (!hasVersion) source.code += getDefines() + "#line 1 0\n";
+        } else {
+            source.code += "#line 1 " + index + "\n";
+        }
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            const std::string& line = lines[i];
+            const std::string nextLine = "#line " + std::to_string(i + 2) + " " + index + "\n";
+            std::smatch match;
+
+            if (isMain && std::regex_match(line, VERSION_DIRECTIVE)) {
+                source.code += line + "\n" + getDefines() + nextLine;
+            } else if (std::regex_match(line, match, INCLUDE_DIRECTIVE)) {
+                const std::string where = path + ":" + std::to_string(i + 1) + ": ";
+                const std::string argument = match[1].str();
+                if (!std::regex_match(argument, match, INCLUDE_FILE))
+                    throw ShaderError(where + "expected #include \"file\"");
+
+                const std::string included = resolve(match[1].str(), path);
+                if (included.empty())
+                    throw ShaderError(where + "can't find included file " + match[1].str());
+
+                processFile(included, source);
+                source.code += nextLine;
+            } else {
+                source.code += line + "\n";
+            }
+        }
+    }
+
+    std::string ShaderPreprocessor::resolve(const std::string& name, const std::string& includer) const {
+        namespace fs = std::filesystem;
+
+        std::vector<fs::path> candidates = { fs::path(includer).parent_path() / name };
+        for (const std::string& directory : includePaths)
+            candidates.push_back(fs::path(directory) / name);
+
+        std::error_code error;
+        for (const fs::path& candidate : candidates) {
+            if (fs::is_regular_file(candidate, error))
+                return candidate.lexically_normal().string();
+        }
+
+        return "";
+    }
+}
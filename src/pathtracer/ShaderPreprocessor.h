@@ -0,0 +1,105 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_SHADERPREPROCESSOR_H_
+#define PATHTRACER_SHADERPREPROCESSOR_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+namespace pathtracer {
+
+    /**
+     * @brief Thrown when a shader file can't be read or preprocessed
+     */
+    class ShaderError : public std::runtime_error {
+    public:
+        explicit ShaderError(const std::string& msg) : std::runtime_error(msg) {  }
+    };
+
+    /** Preprocessed shader, ready to compile */
+    struct ShaderSource {
+        std::string                 code;   //!< GLSL with includes resolved
+        std::vector<std::string>    files;  //!< Files by #line source string number
+
+        /**
+         * Replace source string numbers by file names in a compile log,
+         * e.g. "3:12(5): error" becomes "Sphere.glsl:12(5): error"
+         * @param[in] log Compile or link log
+         */
+        std::string remapLog(const std::string& log) const;
+    };
+
+    /**
+     * Runtime GLSL preprocessor. Resolves #include "file" directives
+     * relative to the including file and then to the include paths. Every
+     * file is included once per shader, like if it started with #pragma
+     * once. Included code is wrapped in #line directives whose source string
+     * number identifies the file, see ShaderSource::remapLog(). Defines are
+     * injected right after #version. Everything else is left to the GLSL
+     * preprocessor.
+     */
+    class ShaderPreprocessor {
+    public:
+
+        /** Default constructor, no include paths nor defines */
+        ShaderPreprocessor();
+
+        /**
+         * Add a directory where to look for included files
+         * @param[in] directory Include directory
+         */
+        void addIncludePath(const std::string& directory);
+
+        /**
+         * Inject a define, replacing a previous one with the same name
+         * @param[in] name  Macro name
+         * @param[in] value Macro value
+         */
+        void define(const std::string& name, const std::string& value = "");
+
+        /** Remove every injected define */
+        void clearDefines();
+
+        /** Get injected defines as GLSL source, e.g. to key caches */
+        std::string getDefines() const;
+
+        /**
+         * Preprocess a shader file
+         * @param[in] path Shader file
+         * @return Preprocessed source
+         * @throws ShaderError if a file can't be read or an include is malformed
+         */
+        ShaderSource process(const std::string& path) const;
+
+    private:
+
+        /** Append file to source, recursively expanding includes */
+        void processFile(const std::string& path, ShaderSource& source) const;
+
+        /** Find an included file, empty if it doesn't exist */
+        std::string resolve(const std::string& name, const std::string& includer) const;
+
+        std::vector<std::string>                            includePaths;   //!< Include directories
+        std::vector<std::pair<std::string, std::string>>    defines;        //!< Injected defines in order
+    };
+
+}
+
+#endif //PATHTRACER_SHADERPREPROCESSOR_H_
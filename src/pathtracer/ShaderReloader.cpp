@@ -0,0 +1,139 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <chrono>
+#include <iostream>
+
+#include "ShaderReloader.h"
+
+namespace pathtracer {
+
+    // Time between modification checks
+    static constexpr std::chrono::milliseconds POLL_INTERVAL(500);
+
+    ShaderReloader::ShaderReloader()
+        : thread()
+        , mutex()
+        , wakeUp()
+        , running(false)
+        , files()
+        , ready()
+        , readySource() {
+
+    }
+
+    ShaderReloader::~ShaderReloader() {
+        // The context may be gone already, only join the thread
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wakeUp.notify_all();
+        if (thread.joinable()) thread.join();
+    }
+
+    void ShaderReloader::start(const std::vector<std::string>& files, ContextFunction makeCurrent,
+            ContextFunction doneCurrent, Build build) {
+        stop();
+
+        this->files = files;
+        running = true;
+        thread = std::thread(&ShaderReloader::loop, this, makeCurrent, doneCurrent, build);
+    }
+
+    void ShaderReloader::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wakeUp.notify_all();
+        if (thread.joinable()) thread.join();
+
+        if (ready) {
+            ready->destroy();
+            ready.reset();
+        }
+    }
+
+    bool ShaderReloader::poll(opengl::ShaderProgram& program, ShaderSource& source) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ready) return false;
+
+        program.swap(*ready);
+        ready->destroy();
+        ready.reset();
+        source = std::move(readySource);
+        return true;
+    }
+
+    void ShaderReloader::loop(ContextFunction makeCurrent, ContextFunction doneCurrent, Build build) {
+        makeCurrent();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        TimeMap times = modificationTimes(files);
+
+        while (!wakeUp.wait_for(lock, POLL_INTERVAL, [this]() { return !running; })) {
+            std::vector<std::string> watched = files;
+            lock.unlock();
+
+            TimeMap current = modificationTimes(watched);
+            if (current != times) {
+                times = current;
+
+                auto program = std::make_unique<opengl::ShaderProgram>();
+                ShaderSource source;
+                bool linked = false;
+                try {
+                    linked = build(*program, source);
+                } catch (const ShaderError& e) {
+                    std::cerr << "hot reload: " << e.what() << std::endl;
+                }
+
+                if (linked) {
+                    // The program must be complete before the render context uses it
+                    glFinish();
+                    times = modificationTimes(source.files);
+
+                    lock.lock();
+                    if (ready) ready->destroy();
+                    ready = std::move(program);
+                    files = source.files;   // Includes may have changed
+                    readySource = std::move(source);
+                    lock.unlock();
+                } else {
+                    std::cerr << "hot reload: build failed, keeping the previous program" << std::endl;
+                    if (program->isCreated()) program->destroy();
+                }
+            }
+
+            lock.lock();
+        }
+
+        lock.unlock();
+        doneCurrent();
+    }
+
+    ShaderReloader::TimeMap ShaderReloader::modificationTimes(const std::vector<std::string>& files) {
+        TimeMap times;
+        for (const std::string& file : files) {
+            std::error_code error;
+            auto time = std::filesystem::last_write_time(file, error);
+            times[file] = error ? std::filesystem::file_time_type::min() : time;
+        }
+        return times;
+    }
+}
@@ -0,0 +1,105 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_SHADERRELOADER_H_
+#define PATHTRACER_SHADERRELOADER_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <filesystem>
+#include <condition_variable>
+
+#include "../opengl/ShaderProgram.h"
+
+#include "ShaderPreprocessor.h"
+
+namespace pathtracer {
+
+    /**
+     * Watches the files of a program and rebuilds it on a background thread
+     * when one of them changes. The thread uses its own context, which must
+     * share objects with the render context. The render loop takes the new
+     * program with poll(), so the old one keeps rendering while the new one
+     * compiles.
+     */
+    class ShaderReloader {
+    public:
+
+        /** Makes the reload context current on the calling thread, or releases it */
+        using ContextFunction = std::function<void()>;
+
+        /**
+         * Builds the program on the reload thread and returns the link status.
+         * It may throw ShaderError.
+         */
+        using Build = std::function<bool(opengl::ShaderProgram& program, ShaderSource& source)>;
+
+        /** Default constructor, nothing is watched */
+        ShaderReloader();
+
+        /** Stop watching */
+        ~ShaderReloader();
+
+        /**
+         * Start watching files
+         * @param[in] files         Files of the current program
+         * @param[in] makeCurrent   Binds the reload context
+         * @param[in] doneCurrent   Releases the reload context
+         * @param[in] build         Rebuilds the program
+         */
+        void start(const std::vector<std::string>& files, ContextFunction makeCurrent,
+                ContextFunction doneCurrent, Build build);
+
+        /** Stop watching. Must be called from the render thread */
+        void stop();
+
+        /**
+         * Exchange program with the last rebuilt one, if any. The replaced
+         * program is destroyed. Must be called from the render thread.
+         * @param[in,out] program   Program in use
+         * @param[out]    source    Source of the new program
+         * @return True if program was replaced
+         */
+        bool poll(opengl::ShaderProgram& program, ShaderSource& source);
+
+    private:
+
+        using TimeMap = std::map<std::string, std::filesystem::file_time_type>;
+
+        /** Reload thread main loop */
+        void loop(ContextFunction makeCurrent, ContextFunction doneCurrent, Build build);
+
+        /** Get the modification time of every file */
+        static TimeMap modificationTimes(const std::vector<std::string>& files);
+
+        std::thread                             thread;         //!< Reload thread
+        std::mutex                              mutex;          //!< Protects members below
+        std::condition_variable                 wakeUp;         //!< Signals stop()
+        bool                                    running;        //!< Is the reload thread running?
+        std::vector<std::string>                files;          //!< Watched files
+        std::unique_ptr<opengl::ShaderProgram>  ready;          //!< Rebuilt program not taken yet
+        ShaderSource                            readySource;    //!< Source of ready
+    };
+
+}
+
+#endif //PATHTRACER_SHADERRELOADER_H_
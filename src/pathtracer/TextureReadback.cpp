@@ -0,0 +1,127 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <chrono>
+
+#include "../util/ThreadPool.h"
+
+#include "TextureReadback.h"
+
+namespace pathtracer {
+
+    // Every texture is read back as RGBA floats
+    static constexpr GLsizeiptr TEXEL_SIZE = 4 * sizeof(GLfloat);
+
+    TextureReadback::TextureReadback()
+        : readbacks() {
+
+    }
+
+    void TextureReadback::request(const std::vector<GLuint>& textures, GLsizei width, GLsizei height,
+            Consumer consumer) {
+        if (textures.empty() || width <= 0 || height <= 0) return;
+
+        const GLsizeiptr textureSize = GLsizeiptr(width) * height * TEXEL_SIZE;
+        const GLsizeiptr size = textureSize * GLsizeiptr(textures.size());
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        auto readback = std::make_unique<Readback>();
+        readback->width = width;
+        readback->height = height;
+        readback->consumer = std::move(consumer);
+
+        // Persistent mapping lets the consumer read while we keep rendering
+        readback->pbo.create();
+        readback->pbo.bind();
+        readback->pbo.setStorage(nullptr, size, flags);
+        readback->mapped = static_cast<const float*>(readback->pbo.mapRange(0, size, flags));
+
+        // Make compute shader image stores visible to texture reads
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+        // Asynchronous copies, the pbo is bound so the pointer is an offset
+        for (size_t i = 0; i < textures.size(); ++i) {
+            glGetTextureImage(textures[i], 0, GL_RGBA, GL_FLOAT, GLsizei(textureSize),
+                    reinterpret_cast<void*>(i * textureSize));
+        }
+
+        readback->pbo.unbind();
+
+        readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush(); // Make sure the fence reaches the GPU
+
+        readbacks.push_back(std::move(readback));
+    }
+
+    void TextureReadback::poll() {
+        for (auto it = readbacks.begin(); it != readbacks.end();) {
+            Readback& readback = **it;
+
+            if (!readback.consuming.valid()) {
+                // Copy done?
+                GLenum status = glClientWaitSync(readback.fence, 0, 0);
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+                    startConsumer(readback);
+                ++it;
+            } else if (readback.consuming.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                release(readback);
+                it = readbacks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void TextureReadback::finish() {
+        for (auto& readback : readbacks) {
+            if (!readback->consuming.valid()) {
+                glClientWaitSync(readback->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                startConsumer(*readback);
+            }
+        }
+
+        for (auto& readback : readbacks) {
+            readback->consuming.wait();
+            release(*readback);
+        }
+
+        readbacks.clear();
+    }
+
+    size_t TextureReadback::pending() const {
+        return readbacks.size();
+    }
+
+    void TextureReadback::startConsumer(Readback& readback) {
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        const Readback* source = &readback;
+        readback.consuming = util::ThreadPool::instance().submit([source]() {
+            source->consumer(source->mapped, source->width, source->height);
+        });
+    }
+
+    void TextureReadback::release(Readback& readback) {
+        if (readback.fence) glDeleteSync(readback.fence);
+
+        readback.pbo.bind();
+        readback.pbo.unmap();
+        readback.pbo.unbind();
+        readback.pbo.destroy();
+    }
+}
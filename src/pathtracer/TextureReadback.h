@@ -0,0 +1,95 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_TEXTUREREADBACK_H_
+#define PATHTRACER_TEXTUREREADBACK_H_
+
+#include <list>
+#include <memory>
+#include <vector>
+#include <future>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "../opengl/BufferObject.h"
+
+namespace pathtracer {
+
+    /**
+     * Asynchronous GPU to CPU copy of float textures.
+     * Textures are copied into a persistently mapped pixel pack buffer, and once
+     * the copy fence signals, a consumer reads the texels on util::ThreadPool
+     * straight from the mapped memory. Nothing on the GL thread ever waits.
+     */
+    class TextureReadback {
+    public:
+
+        /**
+         * Called on a pool thread with the RGBA float texels of every requested
+         * texture, one after another, rows bottom to top.
+         */
+        using Consumer = std::function<void(const float* texels, GLsizei width, GLsizei height)>;
+
+        /** Default constructor */
+        TextureReadback();
+
+        /**
+         * Start copying the given textures. Must be called from the GL thread.
+         * @param[in] textures  Float textures, all of them width x height
+         * @param[in] width     Textures width
+         * @param[in] height    Textures height
+         * @param[in] consumer  Invoked on the pool once the copy is done
+         */
+        void request(const std::vector<GLuint>& textures, GLsizei width, GLsizei height, Consumer consumer);
+
+        /** Hand finished copies to their consumers and release finished readbacks */
+        void poll();
+
+        /** Block until every pending readback has been consumed */
+        void finish();
+
+        /** Get number of readbacks in flight */
+        size_t pending() const;
+
+    private:
+
+        /** One readback in flight */
+        struct Readback {
+            Readback() : pbo(GL_PIXEL_PACK_BUFFER), mapped(nullptr), fence(nullptr) {  }
+
+            opengl::BufferObject    pbo;        //!< Persistently mapped destination
+            const float*            mapped;     //!< Mapped pbo memory
+            GLsync                  fence;      //!< Signals when the copy is done
+            GLsizei                 width;      //!< Textures width
+            GLsizei                 height;     //!< Textures height
+            Consumer                consumer;   //!< Reads the texels
+            std::future<void>       consuming;  //!< Valid once the consumer started
+        };
+
+        /** Submit the consumer to the pool */
+        static void startConsumer(Readback& readback);
+
+        /** Unmap and free readback resources */
+        static void release(Readback& readback);
+
+        std::list<std::unique_ptr<Readback>> readbacks; //!< Readbacks in flight
+    };
+
+}
+
+#endif //PATHTRACER_TEXTUREREADBACK_H_
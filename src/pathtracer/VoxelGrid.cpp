@@ -0,0 +1,123 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include "../util/ThreadPool.h"
+
+#include "VoxelGrid.h"
+
+namespace pathtracer {
+
+    /** Words before the brick map: size and node offset, root grid size and brick offset */
+    static constexpr size_t HEADER_WORDS = 8;
+
+    VoxelGrid::VoxelGrid()
+        : buffer(GL_SHADER_STORAGE_BUFFER)
+        , path()
+        , size(0)
+        , numVoxels(0)
+        , bytes(0) {
+
+    }
+
+    void VoxelGrid::create() {
+        buffer.create();
+        clear();
+    }
+
+    void VoxelGrid::destroy() {
+        if (buffer.isCreated()) buffer.destroy();
+    }
+
+    void VoxelGrid::load(const std::string& path) {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point start = Clock::now();
+
+        upload(build(io::readVolume(path)));
+        this->path = path;
+
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << "voxel grid: " << path << ", " << size.x << "x" << size.y << "x" << size.z
+            << ", " << numVoxels << " voxels in " << bytes / 1024 << " KiB, loaded in " << ms << " ms"
+            << std::endl;
+    }
+
+    void VoxelGrid::clear() {
+        upload(scene::defaultVoxels());
+        path.clear();
+    }
+
+    void VoxelGrid::bind() const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer.getHandler());
+    }
+
+    const std::string& VoxelGrid::getPath() const {
+        return path;
+    }
+
+    glm::ivec3 VoxelGrid::getSize() const {
+        return size;
+    }
+
+    size_t VoxelGrid::getNumVoxels() const {
+        return numVoxels;
+    }
+
+    size_t VoxelGrid::getBytes() const {
+        return bytes;
+    }
+
+    scene::BrickMap VoxelGrid::build(const io::Volume& volume) {
+        std::vector<uint8_t> labels(volume.density.size());
+        util::ThreadPool::instance().parallelFor(0, labels.size(), 1 << 16, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const float label = std::round(volume.density[i]);
+                labels[i] = label > 0.0f ? uint8_t(std::min(label, float(scene::BrickMap::MAX_MATERIAL + 1))) : 0;
+            }
+        });
+
+        return scene::BrickMap::fromDense(glm::ivec3(volume.width, volume.height, volume.depth), labels);
+    }
+
+    void VoxelGrid::upload(const scene::BrickMap& map) {
+        const std::vector<uint32_t>& rootTable = map.getRootTable();
+        const std::vector<uint32_t>& nodes = map.getNodes();
+        const std::vector<uint32_t>& bricks = map.getBricks();
+
+        size = map.getSize();
+        const glm::ivec3 roots = map.getRoots();
+        std::vector<uint32_t> data = {
+            uint32_t(size.x), uint32_t(size.y), uint32_t(size.z), uint32_t(rootTable.size()),
+            uint32_t(roots.x), uint32_t(roots.y), uint32_t(roots.z), uint32_t(rootTable.size() + nodes.size())
+        };
+        data.reserve(HEADER_WORDS + rootTable.size() + nodes.size() + bricks.size());
+        data.insert(data.end(), rootTable.begin(), rootTable.end());
+        data.insert(data.end(), nodes.begin(), nodes.end());
+        data.insert(data.end(), bricks.begin(), bricks.end());
+
+        buffer.bind();
+        buffer.setData(data, GL_STATIC_DRAW);
+        buffer.unbind();
+
+        numVoxels = map.getNumVoxels();
+        bytes = data.size() * sizeof(uint32_t);
+    }
+}
@@ -0,0 +1,102 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PATHTRACER_VOXELGRID_H_
+#define PATHTRACER_VOXELGRID_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "../io/Volume.h"
+#include "../opengl/BufferObject.h"
+#include "../scene/BrickMap.h"
+
+namespace pathtracer {
+
+    /**
+     * Voxel model of the VOXELS primitives, a brick map in a shader storage
+     * buffer stretched over the bounds of each of them. Without a loaded
+     * model the built-in scene::defaultVoxels() is used.
+     */
+    class VoxelGrid {
+    public:
+
+        /** Shader storage binding point, must match Voxels.glsl */
+        static constexpr GLuint BINDING = 5;
+
+        /** Default constructor, without model */
+        VoxelGrid();
+
+        /** Create the buffer object with the built-in model */
+        void create();
+
+        /** Free the buffer object */
+        void destroy();
+
+        /**
+         * Load a label grid: every voxel holds its material id + 1, 0 is empty
+         * @param[in] path Mitsuba .vol file, values are rounded to labels
+         * @throws io::VolumeError if the file can't be read
+         */
+        void load(const std::string& path);
+
+        /** Go back to the built-in model */
+        void clear();
+
+        /** Bind the buffer to its binding point */
+        void bind() const;
+
+        /** Get the file of the model, empty for the built-in one */
+        const std::string& getPath() const;
+
+        /** Get the grid size in voxels */
+        glm::ivec3 getSize() const;
+
+        /** Get the number of occupied voxels */
+        size_t getNumVoxels() const;
+
+        /** Get the size of the brick map on the GPU in bytes */
+        size_t getBytes() const;
+
+        /**
+         * Build the brick map of a label grid
+         * @param[in] volume Grid of material ids + 1
+         * @return The brick map
+         */
+        static scene::BrickMap build(const io::Volume& volume);
+
+    private:
+
+        /** Upload a brick map */
+        void upload(const scene::BrickMap& map);
+
+        opengl::BufferObject    buffer;     //!< Header and brick map
+        std::string             path;       //!< File of the loaded model
+        glm::ivec3              size;       //!< Voxels along each axis
+        size_t                  numVoxels;  //!< Occupied voxels
+        size_t                  bytes;      //!< Size of the buffer
+    };
+
+}
+
+#endif //PATHTRACER_VOXELGRID_H_
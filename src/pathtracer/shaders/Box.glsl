@@ -0,0 +1,45 @@
+#ifndef BOX_GLSL
+#define BOX_GLSL
+
+#include "Ray.glsl"
+
+// Ray parameters where the ray enters and leaves an axis aligned box, the
+// first one is negative if the ray starts inside
+bool box_interval(vec3 box_min, vec3 box_max, Ray ray, out float enter, out float leave) {
+    vec3 inv_dir = 1.0f / ray.dir;
+    vec3 t0 = (box_min - ray.origin) * inv_dir;
+    vec3 t1 = (box_max - ray.origin) * inv_dir;
+    vec3 t_near = min(t0, t1);
+    vec3 t_far = max(t0, t1);
+
+    enter = max(max(t_near.x, t_near.y), t_near.z);
+    leave = min(min(t_far.x, t_far.y), t_far.z);
+    return enter <= leave;
+}
+
+// Intersect Ray-Box test, only finds the ray parameter. On a hit closer
+// than t_max, t_max becomes its ray parameter.
+bool intersect_box(vec3 center, vec3 half_extents, Ray ray, float t_min, inout float t_max) {
+    float enter, leave;
+    if (!box_interval(center - half_extents, center + half_extents, ray, enter, leave)) return false;
+
+    float t = enter > t_min ? enter : leave;
+    if (t > t_min && t < t_max) {
+        t_max = t;
+        return true;
+    }
+
+    return false;
+}
+
+// Outward normal of the face closest to a point of the box
+vec3 box_normal(vec3 center, vec3 half_extents, vec3 point) {
+    vec3 local = (point - center) / half_extents;
+    vec3 dist = abs(local);
+
+    if (dist.x >= dist.y && dist.x >= dist.z) return vec3(sign(local.x), 0.0f, 0.0f);
+    if (dist.y >= dist.z) return vec3(0.0f, sign(local.y), 0.0f);
+    return vec3(0.0f, 0.0f, sign(local.z));
+}
+
+#endif // BOX_GLSL
@@ -0,0 +1,202 @@
+#ifndef BVH_GLSL
+#define BVH_GLSL
+
+#include "Constants.glsl"
+#include "Primitive.glsl"
+
+// Layouts of the bounding volume hierarchy, must match KernelVariants.h.
+// The linear layout has no hierarchy, rays test every primitive.
+#define BVH_LINEAR  0
+#define BVH_BINARY  2
+#define BVH_WIDE    4
+
+#ifdef FIXED_BVH
+#define BVH_LAYOUT FIXED_BVH
+#else
+uniform int bvhLayout;
+#define BVH_LAYOUT bvhLayout
+#endif
+
+#define BVH_MAX_DEPTH   64          // Levels of the binary tree, must match Bvh.h
+#define BVH_LEAF        0x80000000u // Leaf flag of a wide child reference
+#define BVH_MISS        1e30f       // Entry parameter of a missed box
+
+// Nodes of the tree, the root first:
+//  binary: 2 words per node, min.xyz and the left child or first index,
+//          max.xyz and the primitive count, 0 for inner nodes. The right
+//          child follows the left one.
+//  wide:   4 words per node, the origin of the quantization grid and the
+//          biased exponents of its cell size per axis plus the number of
+//          children on the high byte, then the quantized lo.xyz and hi.xyz
+//          with a byte per child, and the child references: the index of
+//          a node, or BVH_LEAF | count << 24 | first index.
+layout(std430, binding = 6) readonly buffer BvhNodeBuffer {
+    uvec4 bvh_nodes[];
+};
+
+// Primitives of the leaves, then the unbounded ones out of the tree
+layout(std430, binding = 7) readonly buffer BvhIndexBuffer {
+    uint bvh_num_bounded;
+    uint bvh_num_unbounded;
+    uint bvh_indices[];
+};
+
+// Inverse ray direction without infinities, keeps the slabs test free of NaN
+vec3 bvh_inverse(vec3 dir) {
+    bvec3 tiny = lessThan(abs(dir), vec3(1e-20f));
+    return 1.0f / mix(dir, vec3(1e-20f), tiny);
+}
+
+// Ray parameter where the ray enters a box before t_max, BVH_MISS if it
+// doesn't. The far side is widened a little so rounding never misses a
+// primitive the linear test would hit.
+float bvh_box(vec3 lo, vec3 hi, vec3 origin, vec3 inv_dir, float t_max) {
+    vec3 t0 = (lo - origin) * inv_dir;
+    vec3 t1 = (hi - origin) * inv_dir;
+    vec3 near = min(t0, t1);
+    vec3 far = max(t0, t1);
+    float t_near = max(max(near.x, near.y), max(near.z, 0.0f));
+    float t_far = min(min(far.x, far.y), min(far.z, t_max)) * 1.0000004f;
+    return t_near <= t_far ? t_near : BVH_MISS;
+}
+
+// Intersect a list of primitives. Returns true when any_hit stops on a hit.
+bool bvh_primitives(uint first, uint count, in Ray ray, bool any_hit, inout float closest, inout int closest_primitive) {
+    for (uint i = first; i < first + count; ++i) {
+        int index = int(bvh_indices[i]);
+        if (intersect_primitive(primitives[index], ray, RAY_T_MIN, closest)) {
+            closest_primitive = index;
+            if (any_hit) return true;
+        }
+    }
+
+    return false;
+}
+
+// Ordered traversal of the binary tree: visit the nearest child first and
+// push the other one with its entry parameter, popped nodes behind the
+// closest hit are skipped
+bool traverse_binary(in Ray ray, bool any_hit, inout float closest, inout int closest_primitive) {
+    vec3 inv_dir = bvh_inverse(ray.dir);
+    uint stack[BVH_MAX_DEPTH];
+    float stack_t[BVH_MAX_DEPTH];
+    int sp = 0;
+
+    // An empty tree has an inner root no ray enters
+    uvec4 root0 = bvh_nodes[0];
+    uvec4 root1 = bvh_nodes[1];
+    if (bvh_box(uintBitsToFloat(root0.xyz), uintBitsToFloat(root1.xyz), ray.origin, inv_dir, closest) >= BVH_MISS)
+        return false;
+
+    uint node = 0u;
+    while (true) {
+        STATS_NODE();
+        uint first = bvh_nodes[2u * node].w;
+        uint count = bvh_nodes[2u * node + 1u].w;
+
+        if (count > 0u) {
+            if (bvh_primitives(first, count, ray, any_hit, closest, closest_primitive)) return true;
+        } else {
+            uvec4 l0 = bvh_nodes[2u * first];
+            uvec4 l1 = bvh_nodes[2u * first + 1u];
+            uvec4 r0 = bvh_nodes[2u * first + 2u];
+            uvec4 r1 = bvh_nodes[2u * first + 3u];
+            float t_left = bvh_box(uintBitsToFloat(l0.xyz), uintBitsToFloat(l1.xyz), ray.origin, inv_dir, closest);
+            float t_right = bvh_box(uintBitsToFloat(r0.xyz), uintBitsToFloat(r1.xyz), ray.origin, inv_dir, closest);
+
+            if (min(t_left, t_right) < BVH_MISS) {
+                bool right_first = t_right < t_left;
+                float t_far = max(t_left, t_right);
+                if (t_far < BVH_MISS && sp < BVH_MAX_DEPTH) {
+                    stack[sp] = right_first ? first : first + 1u;
+                    stack_t[sp++] = t_far;
+                }
+                node = right_first ? first + 1u : first;
+                continue;
+            }
+        }
+
+        // Pop the next node in front of the closest hit
+        while (sp > 0 && stack_t[sp - 1] > closest) --sp;
+        if (sp == 0) break;
+        node = stack[--sp];
+    }
+
+    return false;
+}
+
+// Ordered traversal of the wide tree: decode the children boxes of a node,
+// sort the ones the ray enters by entry parameter, visit the nearest and
+// push the rest, farthest first
+bool traverse_wide(in Ray ray, bool any_hit, inout float closest, inout int closest_primitive) {
+    vec3 inv_dir = bvh_inverse(ray.dir);
+    uint stack[3 * BVH_MAX_DEPTH];
+    float stack_t[3 * BVH_MAX_DEPTH];
+    int sp = 0;
+
+    uint ref = 0u;
+    while (true) {
+        STATS_NODE();
+        if ((ref & BVH_LEAF) != 0u) {
+            if (bvh_primitives(ref & 0xFFFFFFu, (ref >> 24) & 0x7Fu, ray, any_hit, closest, closest_primitive))
+                return true;
+        } else {
+            uvec4 n0 = bvh_nodes[4u * ref];
+            uvec4 n1 = bvh_nodes[4u * ref + 1u];
+            uvec4 n2 = bvh_nodes[4u * ref + 2u];
+            uvec4 n3 = bvh_nodes[4u * ref + 3u];
+
+            // Cell sizes are powers of two, built straight from the exponent bits
+            vec3 origin = uintBitsToFloat(n0.xyz);
+            vec3 cell = uintBitsToFloat(((uvec3(n0.w, n0.w >> 8, n0.w >> 16) & 0xFFu) << 23));
+            uvec3 hi_bits = uvec3(n1.w, n2.xy);
+            uint count = n0.w >> 24;
+
+            uint refs[4];
+            float ts[4];
+            uint hits = 0u;
+            for (uint i = 0u; i < count; ++i) {
+                uint shift = 8u * i;
+                vec3 lo = origin + vec3((n1.xyz >> shift) & 0xFFu) * cell;
+                vec3 hi = origin + vec3((hi_bits >> shift) & 0xFFu) * cell;
+                float t = bvh_box(lo, hi, ray.origin, inv_dir, closest);
+                if (t >= BVH_MISS) continue;
+
+                uint j = hits++;
+                for (; j > 0u && ts[j - 1u] > t; --j) {
+                    refs[j] = refs[j - 1u];
+                    ts[j] = ts[j - 1u];
+                }
+                refs[j] = n3[i];
+                ts[j] = t;
+            }
+
+            if (hits > 0u) {
+                for (uint j = hits - 1u; j > 0u && sp < 3 * BVH_MAX_DEPTH; --j) {
+                    stack[sp] = refs[j];
+                    stack_t[sp++] = ts[j];
+                }
+                ref = refs[0];
+                continue;
+            }
+        }
+
+        // Pop the next child in front of the closest hit
+        while (sp > 0 && stack_t[sp - 1] > closest) --sp;
+        if (sp == 0) break;
+        ref = stack[--sp];
+    }
+
+    return false;
+}
+
+// Intersect the unbounded primitives, then traverse the tree. Returns true
+// when any_hit stops on a hit, otherwise the closest one is kept.
+bool bvh_intersect(in Ray ray, bool any_hit, inout float closest, inout int closest_primitive) {
+    if (bvh_primitives(bvh_num_bounded, bvh_num_unbounded, ray, any_hit, closest, closest_primitive)) return true;
+
+    if (BVH_LAYOUT == BVH_WIDE) return traverse_wide(ray, any_hit, closest, closest_primitive);
+    return traverse_binary(ray, any_hit, closest, closest_primitive);
+}
+
+#endif // BVH_GLSL
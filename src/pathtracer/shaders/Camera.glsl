@@ -0,0 +1,58 @@
+#ifndef CAMERA_GLSL
+#define CAMERA_GLSL
+
+#include "Ray.glsl"
+#include "Sampler.glsl"
+
+// The camera specification
+uniform vec3 eye;
+uniform vec3 ray00;
+uniform vec3 ray10;
+uniform vec3 ray01;
+uniform vec3 ray11;
+
+// Thin lens, the lens lies on the plane of cameraRight and cameraUp
+uniform float lensRadius;
+uniform float focusDistance;    // Distance to the plane in focus along cameraForward
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+uniform vec3 cameraForward;
+
+// Time the shutter stays open
+uniform float shutterTime;
+
+// Kernel variants fix the camera model at compile time, pinhole cameras and
+// frozen scenes don't draw lens or time samples
+#ifdef FIXED_THIN_LENS
+#define THIN_LENS (FIXED_THIN_LENS != 0)
+#else
+#define THIN_LENS (lensRadius > 0.0f)
+#endif
+
+#ifdef FIXED_MOTION_BLUR
+#define MOTION_BLUR (FIXED_MOTION_BLUR != 0)
+#else
+#define MOTION_BLUR (shutterTime > 0.0f)
+#endif
+
+// Ray born in the eye towards a point of the image, in pixels, also picks
+// the shutter time of the path
+Ray camera_ray(vec2 position, ivec2 size) {
+    // Interpolate to get this point ray
+    vec2 pos = position / vec2(size);
+    vec3 dir = mix(mix(ray00, ray01, pos.y), mix(ray10, ray11, pos.y), pos.x);
+
+    if (MOTION_BLUR) ray_time = shutterTime * sample_1d();
+
+    if (THIN_LENS) {
+        // Rays through any point of the lens meet on the plane in focus
+        vec3 focus = eye + dir * (focusDistance / dot(dir, cameraForward));
+        vec2 lens = lensRadius * sample_disk();
+        vec3 origin = eye + lens.x * cameraRight + lens.y * cameraUp;
+        return Ray(origin, normalize(focus - origin));
+    }
+
+    return Ray(eye, normalize(dir));
+}
+
+#endif // CAMERA_GLSL
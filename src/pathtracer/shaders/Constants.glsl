@@ -1,5 +1,5 @@
 #ifndef CONSTANTS_GLSL
-#define CONSTASNT_GLSL
+#define CONSTANTS_GLSL
 
 #define PI      3.14159265359f          // Number PI
 #define TWO_PI  6.28318530718f          // Number PI * 2
@@ -0,0 +1,69 @@
+#ifndef CYLINDER_GLSL
+#define CYLINDER_GLSL
+
+#include "Ray.glsl"
+
+// Intersect Ray-Cylinder test of a capped cylinder around a unit axis, only
+// finds the ray parameter. On a hit closer than t_max, t_max becomes its
+// ray parameter.
+bool intersect_cylinder(vec3 center, vec3 axis, float radius, float half_height,
+        Ray ray, float t_min, inout float t_max) {
+    // Split the ray along the axis and across it
+    vec3 oc = ray.origin - center;
+    float origin_height = dot(oc, axis);
+    float dir_height = dot(ray.dir, axis);
+    vec3 origin_across = oc - origin_height * axis;
+    vec3 dir_across = ray.dir - dir_height * axis;
+
+    float closest = t_max;
+
+    // Side, between the caps
+    float a = dot(dir_across, dir_across);
+    float half_b = dot(origin_across, dir_across);
+    float c = dot(origin_across, origin_across) - radius * radius;
+    float discriminant = half_b * half_b - a * c;
+
+    if (a > 0.0f && discriminant > 0.0f) {
+        float root = sqrt(discriminant);
+
+        float t1 = (-half_b - root) / a;
+        if (t1 > t_min && t1 < closest && abs(origin_height + t1 * dir_height) <= half_height) {
+            closest = t1;
+        }
+
+        float t2 = (-half_b + root) / a;
+        if (t2 > t_min && t2 < closest && abs(origin_height + t2 * dir_height) <= half_height) {
+            closest = t2;
+        }
+    }
+
+    // Caps, inside the radius
+    if (dir_height != 0.0f) {
+        for (float side = -1.0f; side <= 1.0f; side += 2.0f) {
+            float t = (side * half_height - origin_height) / dir_height;
+            vec3 across = origin_across + t * dir_across;
+            if (t > t_min && t < closest && dot(across, across) <= radius * radius) {
+                closest = t;
+            }
+        }
+    }
+
+    if (closest < t_max) {
+        t_max = closest;
+        return true;
+    }
+
+    return false;
+}
+
+// Outward normal of the side or cap closest to a point of the cylinder
+vec3 cylinder_normal(vec3 center, vec3 axis, float radius, float half_height, vec3 point) {
+    vec3 oc = point - center;
+    float height = dot(oc, axis);
+    vec3 across = oc - height * axis;
+
+    if (abs(abs(height) - half_height) < abs(length(across) - radius)) return sign(height) * axis;
+    return across / radius;
+}
+
+#endif // CYLINDER_GLSL
@@ -0,0 +1,101 @@
+#ifndef ENVIRONMENT_GLSL
+#define ENVIRONMENT_GLSL
+
+#include "Constants.glsl"
+#include "Sampler.glsl"
+
+// Equirectangular HDR map lighting the paths that escape the scene.
+// Texture u follows the azimuth around +Y, v goes from +Y (top row) to -Y.
+layout(binding = 1) uniform sampler2D environmentMap;
+
+// Alias tables of the map, built by the application over a grid of cells:
+// first the marginal table of the rows, then the conditional table of the
+// columns of every row
+struct EnvironmentAlias {
+    float prob;     // Probability of keeping the entry instead of its alias
+    uint  alias;
+    float pmf;      // Probability of picking the entry
+};
+
+layout(std430, binding = 2) readonly buffer EnvironmentTables {
+    EnvironmentAlias environment_aliases[];
+};
+
+uniform ivec2 environmentCells;     // Grid columns and rows
+
+// Kernel variants fix whether a map is loaded at compile time
+#ifdef FIXED_ENVIRONMENT
+#define ENVIRONMENT_MAP (FIXED_ENVIRONMENT != 0)
+#else
+uniform bool environmentEnabled;
+#define ENVIRONMENT_MAP environmentEnabled
+#endif
+
+// Unit direction of a map coordinate
+vec3 environment_direction(vec2 uv) {
+    float phi = (uv.x - 0.5f) * TWO_PI;
+    float theta = uv.y * PI;
+    float sin_theta = sin(theta);
+    return vec3(sin_theta * cos(phi), cos(theta), sin_theta * sin(phi));
+}
+
+// Map coordinate of a unit direction
+vec2 environment_uv(vec3 dir) {
+    float u = atan(dir.z, dir.x) / TWO_PI + 0.5f;
+    float v = acos(clamp(dir.y, -1.0f, 1.0f)) / PI;
+    return vec2(u, v);
+}
+
+// Radiance coming from a direction, the default sky without map
+vec3 environment(vec3 dir) {
+    vec3 unit_direction = normalize(dir);
+
+    if (ENVIRONMENT_MAP) {
+        return textureLod(environmentMap, environment_uv(unit_direction), 0.0f).rgb;
+    }
+
+    float t = 0.5 * (unit_direction.y + 1.0);
+    return mix(vec3(1.0f), vec3(0.3f, 0.5f, 0.7f), t);
+}
+
+// Pick an entry of the alias table starting at first, u is uniform on [0, 1)
+uint environment_pick(uint first, uint count, float u) {
+    float scaled = u * float(count);
+    uint i = min(uint(scaled), count - 1u);
+    EnvironmentAlias entry = environment_aliases[first + i];
+    return (scaled - float(i)) < entry.prob ? i : entry.alias;
+}
+
+// Solid angle density of a map coordinate: pmf of the cell divided by
+// the solid angle of a unit uv square, 2 * PI^2 * sin(theta)
+float environment_cell_pdf(uint row, uint col, float sin_theta) {
+    uvec2 cells = uvec2(environmentCells);
+    float pmf = environment_aliases[row].pmf *
+        environment_aliases[cells.y + row * cells.x + col].pmf;
+    return sin_theta > 0.0f ? pmf * float(cells.x * cells.y) / (2.0f * PI * PI * sin_theta) : 0.0f;
+}
+
+// Sample a direction proportionally to the map luminance, returns its
+// solid angle density
+float sample_environment(out vec3 dir) {
+    uvec2 cells = uvec2(environmentCells);
+    vec2 pick = sample_2d();
+    vec2 jitter = sample_2d();
+
+    uint row = environment_pick(0u, cells.y, pick.y);
+    uint col = environment_pick(cells.y + row * cells.x, cells.x, pick.x);
+
+    vec2 uv = (vec2(col, row) + jitter) / vec2(cells);
+    dir = environment_direction(uv);
+    return environment_cell_pdf(row, col, sin(uv.y * PI));
+}
+
+// Density sample_environment() picks a unit direction with
+float environment_pdf(vec3 dir) {
+    uvec2 cells = uvec2(environmentCells);
+    vec2 uv = environment_uv(dir);
+    uvec2 cell = min(uvec2(uv * vec2(cells)), cells - 1u);
+    return environment_cell_pdf(cell.y, cell.x, sqrt(max(1.0f - dir.y * dir.y, 0.0f)));
+}
+
+#endif // ENVIRONMENT_GLSL
@@ -0,0 +1,70 @@
+#ifndef FILTER_GLSL
+#define FILTER_GLSL
+
+#include "Constants.glsl"
+#include "Sampler.glsl"
+
+// Reconstruction filters, must match KernelVariants.h. Without a filter
+// rays go through the pixel corners, the box jitters them inside the pixel
+// and the others also splat every sample over the pixels around it.
+#define FILTER_NONE             0u
+#define FILTER_BOX              1u
+#define FILTER_GAUSSIAN         2u
+#define FILTER_BLACKMAN_HARRIS  3u
+#define FILTER_MITCHELL         4u
+
+#ifdef FIXED_FILTER
+#define FILTER FIXED_FILTER
+#else
+uniform uint reconstructionFilter;
+#define FILTER reconstructionFilter
+#endif
+
+#define SPLAT_FILTER (FILTER >= FILTER_GAUSSIAN)
+
+// Pixels around the sample pixel a splat reaches on each side
+int filter_apron() {
+    return FILTER == FILTER_MITCHELL ? 2 : (SPLAT_FILTER ? 1 : 0);
+}
+
+// Largest apron of the filter, pixels on each side
+#ifdef FIXED_FILTER
+#define FILTER_MAX_APRON (FIXED_FILTER == FILTER_MITCHELL ? 2 : 1)
+#else
+#define FILTER_MAX_APRON 2
+#endif
+
+// Most pixels a splat reaches on each axis and in total
+#define FILTER_SIDE (2 * FILTER_MAX_APRON + 1)
+#define FILTER_TAPS (FILTER_SIDE * FILTER_SIDE)
+
+// Point of the pixel a sample goes through, in pixels
+vec2 pixel_sample(ivec2 pixel) {
+    return FILTER == FILTER_NONE ? vec2(pixel) : vec2(pixel) + sample_2d();
+}
+
+// One dimensional filters, the weight of a sample at some offset from a
+// pixel center is the product of the filter on x and on y
+float filter_1d(float x) {
+    x = abs(x);
+    if (FILTER == FILTER_GAUSSIAN) {
+        // Standard deviation of half a pixel, shifted to 0 at a radius of 1.5
+        return max(exp(-2.0f * x * x) - exp(-4.5f), 0.0f);
+    } else if (FILTER == FILTER_BLACKMAN_HARRIS) {
+        // Four term window 3 pixels wide
+        if (x >= 1.5f) return 0.0f;
+        float t = 2.0f * PI * (x / 3.0f + 0.5f);
+        return 0.35875f - 0.48829f * cos(t) + 0.14128f * cos(2.0f * t) - 0.01168f * cos(3.0f * t);
+    } else {
+        // Mitchell-Netravali with B = C = 1/3 and a radius of 2, has negative lobes
+        const float B = 1.0f / 3.0f;
+        const float C = 1.0f / 3.0f;
+        if (x >= 2.0f) return 0.0f;
+        if (x >= 1.0f) return ((-B - 6.0f * C) * x * x * x + (6.0f * B + 30.0f * C) * x * x +
+            (-12.0f * B - 48.0f * C) * x + (8.0f * B + 24.0f * C)) / 6.0f;
+        return ((12.0f - 9.0f * B - 6.0f * C) * x * x * x + (-18.0f + 12.0f * B + 6.0f * C) * x * x +
+            (6.0f - 2.0f * B)) / 6.0f;
+    }
+}
+
+#endif // FILTER_GLSL
@@ -5,6 +5,7 @@
 struct HitInfo {
     bool  front_face;   // Front face hit?
     uint  mat_id;       // Material id of hitted surface
+    int   object;       // Index of the hitted primitive
     float ray_t;        // Ray t parameter
     vec3  point;        // Geometric point where the hit occurred
     vec3  normal;       // Normal vector of hitted surface
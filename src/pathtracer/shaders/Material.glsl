@@ -5,11 +5,18 @@
 #define METAL       1
 #define DIELECTRIC  2
 
+// Material types compiled into the kernel, one bit per type. Kernel
+// variants drop the types the scene doesn't use.
+#ifndef MATERIAL_MASK
+#define MATERIAL_MASK 7
+#endif
+
 struct Material {
     bool isEmisive;
     uint type;
     float fuzz;
     float ref_idx; // refract index
+    int medium;     // Medium inside a dielectric, -1 if none
     vec3 albedo;
 };
 
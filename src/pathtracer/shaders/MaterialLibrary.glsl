@@ -3,22 +3,31 @@
 
 #include "Material.glsl"
 
-#define NUM_MATERIALS 9
-
-// List of materials
-const Material materials[] = { 
-    Material(false, LAMBERT, 0.0f, 0.0f, vec3(0.1f, 0.1f, 1.0f)),
-    Material(false, METAL, 0.5f, 0.0f, vec3(0.7f, 0.7f, 0.7f)),
-    Material(false, METAL, 0.0f, 0.0f, vec3(1.0f, 1.0f, 1.0f)),
-    Material(false, DIELECTRIC, 0.9f, 1.5f, vec3(1.0f, 1.0f, 1.0f)),
-    Material(false, METAL, 0.5f, 0.0f, vec3(0.1f, 1.0f, 0.1f)),
-    Material(false, METAL, 0.0f, 0.5f, vec3(1.0f, 0.3f, 0.3f)),
-    Material(false, METAL, 9.0f, 0.5f, vec3(1.0f, 0.3f, 0.3f)),
-    Material(false, LAMBERT, 9.0f, 0.5f, vec3(0.8f, 0.3f, 0.8f)),
-    Material(false, LAMBERT, 9.0f, 0.5f, vec3(0.35f, 0.9f, 0.35f))
+// List of materials, uploaded by the application. 16 bytes per material:
+//  x: half float albedo red and green
+//  y: half float albedo blue and fuzz
+//  z: refraction index
+//  w: type on the low byte, emissive on bit 8, medium + 1 on bits 16-23
+layout(std430, binding = 0) readonly buffer MaterialBuffer {
+    uvec4 packed_materials[];
 };
 
+// Unpack a material of the list
+Material unpack_material(uvec4 p) {
+    vec2 rg = unpackHalf2x16(p.x);
+    vec2 b_fuzz = unpackHalf2x16(p.y);
+
+    Material mat;
+    mat.isEmisive = (p.w & 0x100u) != 0u;
+    mat.type = p.w & 0xFFu;
+    mat.fuzz = b_fuzz.y;
+    mat.ref_idx = uintBitsToFloat(p.z);
+    mat.medium = int((p.w >> 16u) & 0xFFu) - 1;
+    mat.albedo = vec3(rg, b_fuzz.x);
+    return mat;
+}
+
 // Find material on material list
-#define get_material_by_id(id) materials[id]
+#define get_material_by_id(id) unpack_material(packed_materials[id])
 
 #endif // MATERIALLIBRARY_GLSL
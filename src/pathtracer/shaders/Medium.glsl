@@ -0,0 +1,201 @@
+#ifndef MEDIUM_GLSL
+#define MEDIUM_GLSL
+
+#include "Constants.glsl"
+#include "Ray.glsl"
+#include "Sampler.glsl"
+#include "Sphere.glsl"
+
+// Participating media filling dielectric spheres, uploaded by the
+// application. 32 bytes per medium:
+//  [2 * id]:       scattering coefficient, Henyey-Greenstein g on w
+//  [2 * id + 1]:   absorption coefficient, flags on w
+layout(std430, binding = 3) readonly buffer MediumBuffer {
+    vec4 packed_media[];
+};
+
+#define MEDIUM_HETEROGENEOUS 1u
+
+struct Medium {
+    vec3  sigma_s;          // Scattering coefficient
+    vec3  sigma_a;          // Absorption coefficient
+    float g;                // Henyey-Greenstein anisotropy
+    bool  heterogeneous;    // Coefficients scaled by the density grid?
+};
+
+// Density of the heterogeneous media, stretched over the bounding box of
+// their sphere, and the largest density around every block of voxels
+layout(binding = 2) uniform sampler3D densityGrid;
+layout(binding = 3) uniform sampler3D majorantGrid;
+uniform vec3 majorantCellSize;  // Size of a majorant cell in grid coordinates
+
+// Kernel variants compile media out of scenes without them
+#ifdef FIXED_MEDIA
+#define MEDIA (FIXED_MEDIA != 0)
+#else
+uniform bool mediaEnabled;
+#define MEDIA mediaEnabled
+#endif
+
+// Result of tracking a path through a medium
+#define MEDIUM_PASS     0u  // Reached the end of the segment
+#define MEDIUM_SCATTER  1u  // Scattered inside the medium
+#define MEDIUM_ABSORB   2u  // Absorbed
+
+// Collisions a path may take in a single segment before it is dropped
+#define MEDIUM_MAX_STEPS 1024u
+
+// Is the id a medium of the table?
+bool has_medium(int id) {
+    return id >= 0 && uint(id) < uint(packed_media.length()) / 2u;
+}
+
+Medium get_medium(int id) {
+    vec4 scattering = packed_media[2 * id];
+    vec4 absorption = packed_media[2 * id + 1];
+
+    Medium medium;
+    medium.sigma_s = scattering.xyz;
+    medium.sigma_a = absorption.xyz;
+    medium.g = scattering.w;
+    medium.heterogeneous = (floatBitsToUint(absorption.w) & MEDIUM_HETEROGENEOUS) != 0u;
+    return medium;
+}
+
+// Henyey-Greenstein phase function, cos_theta between the incoming and the
+// scattered directions
+float hg_phase(float cos_theta, float g) {
+    float denom = 1.0f + g * g - 2.0f * g * cos_theta;
+    return (1.0f - g * g) / (4.0f * PI * denom * sqrt(denom));
+}
+
+// Sample a scattered direction around the unit incoming direction
+vec3 sample_hg(vec3 dir, float g, out float pdf) {
+    vec2 u = sample_2d();
+
+    float cos_theta;
+    if (abs(g) < 1e-3f) {
+        cos_theta = 1.0f - 2.0f * u.x;
+    } else {
+        float s = (1.0f - g * g) / (1.0f - g + 2.0f * g * u.x);
+        cos_theta = clamp((1.0f + g * g - s * s) / (2.0f * g), -1.0f, 1.0f);
+    }
+
+    float sin_theta = sqrt(max(1.0f - cos_theta * cos_theta, 0.0f));
+    float phi = TWO_PI * u.y;
+
+    vec3 tangent = normalize(cross(dir, abs(dir.x) > 0.9f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f)));
+    vec3 bitangent = cross(dir, tangent);
+
+    pdf = hg_phase(cos_theta, g);
+    return sin_theta * (cos(phi) * tangent + sin(phi) * bitangent) + cos_theta * dir;
+}
+
+// Track a ray through the medium filling a sphere along [t_min, t_max].
+// Collisions are sampled against the majorant of the grid cell the ray
+// crosses, cells without density are skipped in one step.
+//  Delta tracking (ratio false): samples where the path scatters, weight
+//      is the path throughput and takes the spectral weights of the events.
+//  Ratio tracking (ratio true): multiplies the transmittance of the
+//      segment into weight, never scatters.
+uint track_medium(in Ray ray, float t_min, float t_max, in Sphere sphere, in Medium medium,
+        bool ratio, inout vec3 weight, out float t_event) {
+    t_event = t_max;
+
+    // Extinction per unit of ray parameter, scattered rays aren't normalized
+    float len = length(ray.dir);
+    vec3 sigma_t = medium.sigma_s + medium.sigma_a;
+    float sigma_max = max(max(sigma_t.r, sigma_t.g), sigma_t.b) * len;
+    if (sigma_max <= 0.0f || t_max <= t_min) return MEDIUM_PASS;
+
+    if (ratio && !medium.heterogeneous) {
+        weight *= exp(-sigma_t * (len * (t_max - t_min)));
+        return MEDIUM_PASS;
+    }
+
+    // Grid coordinates along the ray, homogeneous media are a single cell
+    vec3 box_min = sphere_center(sphere) - sphere.radius;
+    vec3 grid_origin = (ray.origin - box_min) / (2.0f * sphere.radius);
+    vec3 grid_dir = ray.dir / (2.0f * sphere.radius);
+
+    ivec3 cells = medium.heterogeneous ? textureSize(majorantGrid, 0) : ivec3(1);
+    vec3 cell_size = medium.heterogeneous ? majorantCellSize : vec3(1.0f);
+    vec3 cell_origin = grid_origin / cell_size;
+    vec3 cell_dir = grid_dir / cell_size;
+
+    // Cell walk (Amanatides and Woo)
+    ivec3 cell = clamp(ivec3(floor(cell_origin + t_min * cell_dir)), ivec3(0), cells - 1);
+    ivec3 cell_step = ivec3(sign(cell_dir));
+    vec3 t_next = vec3(1e30f);
+    vec3 t_delta = vec3(1e30f);
+    for (int axis = 0; axis < 3; ++axis) {
+        if (cell_dir[axis] != 0.0f) {
+            float boundary = float(cell[axis] + (cell_dir[axis] > 0.0f ? 1 : 0));
+            t_next[axis] = (boundary - cell_origin[axis]) / cell_dir[axis];
+            t_delta[axis] = abs(1.0f / cell_dir[axis]);
+        }
+    }
+
+    float t = t_min;
+    uint steps = 0u;
+    while (steps < MEDIUM_MAX_STEPS) {
+        float t_end = min(min(min(t_next.x, t_next.y), t_next.z), t_max);
+        float majorant = medium.heterogeneous ? texelFetch(majorantGrid, cell, 0).r : 1.0f;
+        float mu = majorant * sigma_max;
+
+        while (mu > 0.0f && steps++ < MEDIUM_MAX_STEPS) {
+            t -= log(1.0f - sample_1d()) / mu;
+            if (t >= t_end) break;
+
+            float density = 1.0f;
+            if (medium.heterogeneous)
+                density = clamp(texture(densityGrid, grid_origin + t * grid_dir).r, 0.0f, majorant);
+
+            vec3 s_t = (density * len) * sigma_t;
+            if (ratio) {
+                weight *= 1.0f - s_t / mu;
+                continue;
+            }
+
+            // Pick absorption, scattering or a null collision by their
+            // average probability, weights fix the spectral difference
+            vec3 s_s = (density * len) * medium.sigma_s;
+            float p_a = dot(s_t - s_s, vec3(1.0f / 3.0f)) / mu;
+            float p_s = dot(s_s, vec3(1.0f / 3.0f)) / mu;
+            float u = sample_1d();
+
+            if (u < p_a) return MEDIUM_ABSORB;
+            if (u < p_a + p_s) {
+                weight *= s_s / (mu * p_s);
+                t_event = t;
+                return MEDIUM_SCATTER;
+            }
+
+            weight *= (mu - s_t) / (mu * (1.0f - p_a - p_s));
+        }
+
+        // Free flight is memoryless, continue from the cell boundary
+        if (t_end >= t_max) return MEDIUM_PASS;
+        t = t_end;
+
+        if (t_next.x <= t_next.y && t_next.x <= t_next.z) {
+            cell.x += cell_step.x;
+            t_next.x += t_delta.x;
+        } else if (t_next.y <= t_next.z) {
+            cell.y += cell_step.y;
+            t_next.y += t_delta.y;
+        } else {
+            cell.z += cell_step.z;
+            t_next.z += t_delta.z;
+        }
+
+        if (any(lessThan(cell, ivec3(0))) || any(greaterThanEqual(cell, cells))) return MEDIUM_PASS;
+        ++steps;
+    }
+
+    // Too dense to cross
+    if (ratio) weight = BLACK;
+    return ratio ? MEDIUM_PASS : MEDIUM_ABSORB;
+}
+
+#endif // MEDIUM_GLSL
@@ -0,0 +1,22 @@
+#ifndef PLANE_GLSL
+#define PLANE_GLSL
+
+#include "Ray.glsl"
+
+// Intersect Ray-Plane test of an infinite plane through point, only finds
+// the ray parameter. On a hit closer than t_max, t_max becomes its ray
+// parameter.
+bool intersect_plane(vec3 point, vec3 normal, Ray ray, float t_min, inout float t_max) {
+    float denom = dot(normal, ray.dir);
+    if (denom == 0.0f) return false;
+
+    float t = dot(point - ray.origin, normal) / denom;
+    if (t > t_min && t < t_max) {
+        t_max = t;
+        return true;
+    }
+
+    return false;
+}
+
+#endif // PLANE_GLSL
@@ -0,0 +1,158 @@
+#ifndef PRIMITIVE_GLSL
+#define PRIMITIVE_GLSL
+
+#include "Ray.glsl"
+#include "HitInfo.glsl"
+#include "Sphere.glsl"
+#include "Box.glsl"
+#include "Plane.glsl"
+#include "Cylinder.glsl"
+#include "Torus.glsl"
+#include "Sdf.glsl"
+#include "Voxels.glsl"
+#include "Stats.glsl"
+
+#define SPHERE      0
+#define BOX         1
+#define PLANE       2
+#define CYLINDER    3
+#define TORUS       4
+#define SDF         5
+#define VOXELS      6
+
+// Primitive types compiled into the kernel, one bit per type. Kernel
+// variants drop the types the scene doesn't use.
+#ifndef PRIMITIVE_MASK
+#define PRIMITIVE_MASK 127
+#endif
+
+// Primitives of the scene, uploaded by the application. 64 bytes per
+// primitive:
+//  center:     center when the shutter opens, radius on w (torus major
+//              radius, params.x of a signed distance function)
+//  velocity:   center displacement per unit of shutter time, cylinder half
+//              height on w (torus minor radius, params.y of a function)
+//  shape:      axis of planes, cylinders and tori, half extents of boxes,
+//              signed distance functions and voxels
+//  tag:        type, material id and signed distance function
+struct Primitive {
+    vec4  center;
+    vec4  velocity;
+    vec4  shape;
+    uvec4 tag;
+};
+
+layout(std430, binding = 4) readonly buffer PrimitiveBuffer {
+    Primitive primitives[];
+};
+
+#define num_primitives() primitives.length()
+
+// Center at the shutter time of the path. Kernels without motion blur
+// don't interpolate.
+vec3 primitive_center(in Primitive p) {
+#if defined(FIXED_MOTION_BLUR) && FIXED_MOTION_BLUR == 0
+    return p.center.xyz;
+#else
+    return p.center.xyz + p.velocity.xyz * ray_time;
+#endif
+}
+
+// The sphere of a SPHERE primitive
+Sphere primitive_sphere(in Primitive p) {
+    return Sphere(p.tag.y, p.center.w, p.center.xyz, p.velocity.xyz);
+}
+
+// Intersect a primitive, only finds the ray parameter. On a hit closer
+// than t_max, t_max becomes its ray parameter.
+bool intersect_primitive(in Primitive p, in Ray ray, float t_min, inout float t_max) {
+    STATS_TEST();
+    switch (int(p.tag.x)) {
+#if (PRIMITIVE_MASK & (1 << SPHERE)) != 0
+        case SPHERE:
+            return intersect_sphere(primitive_sphere(p), ray, t_min, t_max);
+#endif
+#if (PRIMITIVE_MASK & (1 << BOX)) != 0
+        case BOX:
+            return intersect_box(primitive_center(p), p.shape.xyz, ray, t_min, t_max);
+#endif
+#if (PRIMITIVE_MASK & (1 << PLANE)) != 0
+        case PLANE:
+            return intersect_plane(primitive_center(p), p.shape.xyz, ray, t_min, t_max);
+#endif
+#if (PRIMITIVE_MASK & (1 << CYLINDER)) != 0
+        case CYLINDER:
+            return intersect_cylinder(primitive_center(p), p.shape.xyz, p.center.w, p.velocity.w,
+                ray, t_min, t_max);
+#endif
+#if (PRIMITIVE_MASK & (1 << TORUS)) != 0
+        case TORUS:
+            return intersect_torus(primitive_center(p), p.shape.xyz, p.center.w, p.velocity.w,
+                ray, t_min, t_max);
+#endif
+#if (PRIMITIVE_MASK & (1 << SDF)) != 0
+        case SDF:
+            return intersect_sdf(p.tag.z, primitive_center(p), p.shape.xyz, vec2(p.center.w, p.velocity.w),
+                ray, t_min, t_max);
+#endif
+#if (PRIMITIVE_MASK & (1 << VOXELS)) != 0
+        case VOXELS:
+            return intersect_voxels(primitive_center(p), p.shape.xyz, ray, t_min, t_max);
+#endif
+        default:
+            return false;
+    }
+}
+
+// Fill the hit record of the closest hit
+void primitive_hit_info(int index, in Ray ray, float t, out HitInfo hit) {
+    Primitive p = primitives[index];
+
+    if (p.tag.x == uint(SPHERE)) {
+        sphere_hit_info(primitive_sphere(p), ray, t, hit);
+        hit.object = index;
+        return;
+    }
+
+    vec3 center = primitive_center(p);
+    hit.ray_t  = t;
+    hit.point  = ray_at(ray, t);
+    hit.mat_id = p.tag.y;
+    hit.object = index;
+
+    switch (int(p.tag.x)) {
+#if (PRIMITIVE_MASK & (1 << BOX)) != 0
+        case BOX:
+            hit.normal = box_normal(center, p.shape.xyz, hit.point);
+            break;
+#endif
+#if (PRIMITIVE_MASK & (1 << CYLINDER)) != 0
+        case CYLINDER:
+            hit.normal = cylinder_normal(center, p.shape.xyz, p.center.w, p.velocity.w, hit.point);
+            break;
+#endif
+#if (PRIMITIVE_MASK & (1 << TORUS)) != 0
+        case TORUS:
+            hit.normal = torus_normal(center, p.shape.xyz, p.center.w, p.velocity.w, hit.point);
+            break;
+#endif
+#if (PRIMITIVE_MASK & (1 << SDF)) != 0
+        case SDF:
+            hit.normal = sdf_normal(p.tag.z, center, p.shape.xyz, vec2(p.center.w, p.velocity.w), hit.point);
+            break;
+#endif
+#if (PRIMITIVE_MASK & (1 << VOXELS)) != 0
+        case VOXELS:
+            // Every voxel has its own material
+            hit.mat_id = max(voxel_hit(center, p.shape.xyz, ray, hit.point, hit.normal), 1u) - 1u;
+            break;
+#endif
+        default:
+            hit.normal = p.shape.xyz;
+            break;
+    }
+
+    hit_set_face_normal(ray, hit);
+}
+
+#endif // PRIMITIVE_GLSL
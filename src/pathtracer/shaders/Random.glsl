@@ -8,12 +8,18 @@
 // Value with random state
 uint rng_state;
 
-// Initialize random state
-void randf_seed(uint value) {
-    // We must setup rng state with unique value for every therad
-    rng_state = gl_GlobalInvocationID.x * (gl_NumWorkGroups * gl_WorkGroupSize).y +
-        gl_GlobalInvocationID.y;
-    rng_state = rng_state * value * 3451031;
+uint wang_hash(uint seed);
+
+// Initialize random state. Every (pixel, sample index) pair gets its own
+// stream, so samples rendered by different processes with disjoint sample
+// indices are independent and can be merged. Pixels are numbered by column
+// of a grid of rows, the height of the image rounded up to whole workgroups.
+void randf_seed(uint sample_index, uvec2 pixel, uint rows) {
+    // We must setup rng state with unique value for every pixel
+    rng_state = wang_hash(pixel.x * rows + pixel.y + wang_hash(sample_index));
+
+    // Xorshift never leaves the zero state
+    if (rng_state == 0u) rng_state = 0x9e3779b9u;
 }
 
 // @see http://www.reedbeta.com/blog/quick-and-easy-gpu-random-numbers-in-d3d11/
@@ -41,12 +47,4 @@ float randf() {
     return float(seed) / 4294967296.0f;
 }
 
-// Random unit vector for lambertian reflection
-vec3 rand_unit_vector() {
-    float a = randf() * 2.0f * PI;
-    float z = (randf() * 2.0f) - 1.0f;
-    float r = sqrt(1.0f - z * z);
-    return vec3(r * cos(a), r * sin(a), z);
-}
-
 #endif // RANDF_GLSL
\ No newline at end of file
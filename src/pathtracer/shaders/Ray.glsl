@@ -7,6 +7,9 @@ struct Ray {
     vec3 dir;       // Ray direcction vector
 };
 
+// Shutter time of the rays of the current path, scattered rays keep it
+float ray_time = 0.0f;
+
 // evaluate ray at specified t parameter
 vec3 ray_at(in Ray ray, in float t) {
     return ray.origin + (t * ray.dir);
@@ -0,0 +1,102 @@
+#ifndef SAMPLER_GLSL
+#define SAMPLER_GLSL
+
+#include "Constants.glsl"
+#include "Random.glsl"
+
+// Sample generators. Every random decision of a path is taken through
+// sample_1d() and sample_2d(), so the generator can be changed.
+#define SAMPLER_INDEPENDENT 0u  // Independent pseudo random numbers
+#define SAMPLER_KRONECKER   1u  // Low discrepancy Kronecker sequence
+
+// Kernel variants fix the sampler at compile time
+#ifdef FIXED_SAMPLER
+#define SAMPLER FIXED_SAMPLER
+#else
+uniform uint samplerType;
+#define SAMPLER samplerType
+#endif
+
+// Kronecker sequence steps in 0.32 fixed point: fractional part of the
+// square roots of the first primes. Dimensions past the table fall back
+// to independent samples.
+#define KRONECKER_DIMENSIONS 32u
+const uint kronecker_alpha[KRONECKER_DIMENSIONS] = uint[](
+    0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+    0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u,
+    0xcbbb9d5du, 0x629a292au, 0x9159015au, 0x152fecd8u,
+    0x67332667u, 0x8eb44a87u, 0xdb0c2e0du, 0x47b5481du,
+    0xae5f9156u, 0xcf6c85d3u, 0x2f73477du, 0x6d1826cau,
+    0x8b43d457u, 0xe360b596u, 0x1c456002u, 0x6f196331u,
+    0xd94ebeb1u, 0x0cc4a611u, 0x261dc1f2u, 0x5815a7beu,
+    0x70b7ed67u, 0xa1513c69u, 0x44f93635u, 0x720dcdfdu
+);
+
+uint sampler_index;     // Sample index in the global sequence
+uint sampler_pixel;     // Pixel hash, decorrelates pixels
+uint sampler_dimension; // Next dimension of the sample
+
+// Hash of a pixel
+uint sampler_hash(uvec2 pixel) {
+    return wang_hash(pixel.x * 0x8da6b343u ^ pixel.y * 0xd8163841u);
+}
+
+// Start a new sample of a pixel of an image of some size
+void sampler_init(uint sample_index, ivec2 pixel, ivec2 size) {
+    uint rows = (uint(size.y) + gl_WorkGroupSize.y - 1u) / gl_WorkGroupSize.y * gl_WorkGroupSize.y;
+    randf_seed(sample_index, uvec2(pixel), rows);
+    sampler_index = sample_index;
+    sampler_pixel = sampler_hash(uvec2(pixel));
+    sampler_dimension = 0u;
+}
+
+// Next sample dimension on range [0, 1)
+float sample_1d() {
+    uint dimension = sampler_dimension++;
+
+    if (SAMPLER == SAMPLER_KRONECKER && dimension < KRONECKER_DIMENSIONS) {
+        // Integer arithmetic wraps modulo 1 exactly. The random shift per
+        // pixel and dimension (Cranley-Patterson rotation) keeps it unbiased.
+        uint shift = wang_hash(sampler_pixel ^ wang_hash(dimension));
+        uint x = shift + sampler_index * kronecker_alpha[dimension];
+        return float(x >> 8u) / 16777216.0f;
+    }
+
+    return randf();
+}
+
+vec2 sample_2d() {
+    float u = sample_1d();
+    float v = sample_1d();
+    return vec2(u, v);
+}
+
+// Uniform unit vector for lambertian reflection
+vec3 sample_unit_vector() {
+    vec2 u = sample_2d();
+    float a = u.x * TWO_PI;
+    float z = (u.y * 2.0f) - 1.0f;
+    float r = sqrt(1.0f - z * z);
+    return vec3(r * cos(a), r * sin(a), z);
+}
+
+// Uniform point on the unit disk, concentric mapping keeps the
+// stratification of the samples
+// @see Shirley and Chiu, A Low Distortion Map Between Disk and Square
+vec2 sample_disk() {
+    vec2 u = sample_2d() * 2.0f - 1.0f;
+    if (u.x == 0.0f && u.y == 0.0f) return vec2(0.0f);
+
+    float r, theta;
+    if (abs(u.x) > abs(u.y)) {
+        r = u.x;
+        theta = (PI / 4.0f) * (u.y / u.x);
+    } else {
+        r = u.y;
+        theta = (PI / 2.0f) - (PI / 4.0f) * (u.x / u.y);
+    }
+
+    return r * vec2(cos(theta), sin(theta));
+}
+
+#endif // SAMPLER_GLSL
@@ -4,20 +4,19 @@
 #include "Ray.glsl"
 #include "HitInfo.glsl"
 #include "MaterialLibrary.glsl"
-#include "Random.glsl"
+#include "Sampler.glsl"
 
 // Scatter 
-bool lambert_scatter(in Ray ray_in, in HitInfo hit, out vec3 att, out Ray ray_out) {
-    vec3 scatter_direction = hit.normal + rand_unit_vector();
+bool lambert_scatter(in Ray ray_in, in HitInfo hit, in Material mat, out vec3 att, out Ray ray_out) {
+    vec3 scatter_direction = hit.normal + sample_unit_vector();
     ray_out = Ray(hit.point, scatter_direction);
-    att = get_material_by_id(hit.mat_id).albedo;
+    att = mat.albedo;
     return true;
 }
 
-bool metal_scatter(in Ray ray_in, in HitInfo hit, out vec3 att, out Ray ray_out) {
+bool metal_scatter(in Ray ray_in, in HitInfo hit, in Material mat, out vec3 att, out Ray ray_out) {
     vec3 reflected = reflect(normalize(ray_in.dir), hit.normal);
-    Material mat = get_material_by_id(hit.mat_id);
-    ray_out = Ray(hit.point, reflected + mat.fuzz * rand_unit_vector());
+    ray_out = Ray(hit.point, reflected + mat.fuzz * sample_unit_vector());
     att = mat.albedo;
     return dot(ray_out.dir, hit.normal) > 0.0f;
 }
@@ -28,10 +27,20 @@ float schlick(float cosine, float ref_idx) {
     return r0 + (1.0f - r0) * pow((1.0f - cosine), 5.0f);
 }
 
+// Index matched dielectrics only bound a medium, light crosses them
+// without bending or reflecting
+bool index_matched(in Material mat) {
+    return mat.type == DIELECTRIC && mat.ref_idx == 1.0f;
+}
+
 // Dielectric 
-bool dielectric_scatter(in Ray ray_in, in HitInfo hit, out vec3 att, out Ray ray_out) {
-    Material mat = get_material_by_id(hit.mat_id);
+bool dielectric_scatter(in Ray ray_in, in HitInfo hit, in Material mat, out vec3 att, out Ray ray_out) {
     att = vec3(1.0f);
+    if (index_matched(mat)) {
+        ray_out = Ray(hit.point, ray_in.dir);
+        return true;
+    }
+
     float eta = hit.front_face ? (1.0f / mat.ref_idx) :  mat.ref_idx; 
 
     vec3 unitdir = normalize(ray_in.dir);
@@ -44,7 +53,7 @@ bool dielectric_scatter(in Ray ray_in, in HitInfo hit, out vec3 att, out Ray ray
     }
 
     float reflect_prob = schlick(cos_theta, eta);
-    if (randf() < reflect_prob) {
+    if (sample_1d() < reflect_prob) {
         vec3 reflected = reflect(unitdir, hit.normal);
         ray_out = Ray(hit.point, reflected);
         return true;
@@ -55,17 +64,24 @@ bool dielectric_scatter(in Ray ray_in, in HitInfo hit, out vec3 att, out Ray ray
     return true;
 }
 
-// Check material type and use the corresponding function
-bool scatter(in Ray ray_in, in HitInfo hit, out vec3 att, out Ray ray_out) {
-    Material mat = get_material_by_id(hit.mat_id);
-    
+// Check material type and use the corresponding function. The caller
+// fetches the material of the hit once per bounce.
+bool scatter(in Ray ray_in, in HitInfo hit, in Material mat, out vec3 att, out Ray ray_out) {
     switch(mat.type) {
+#if (MATERIAL_MASK & (1 << LAMBERT)) != 0
         case LAMBERT:
-            return lambert_scatter(ray_in, hit, att, ray_out);
+            return lambert_scatter(ray_in, hit, mat, att, ray_out);
+#endif
+#if (MATERIAL_MASK & (1 << METAL)) != 0
         case METAL:
-            return metal_scatter(ray_in, hit, att, ray_out);
+            return metal_scatter(ray_in, hit, mat, att, ray_out);
+#endif
+#if (MATERIAL_MASK & (1 << DIELECTRIC)) != 0
+        case DIELECTRIC:
+            return dielectric_scatter(ray_in, hit, mat, att, ray_out);
+#endif
         default:
-            return dielectric_scatter(ray_in, hit, att, ray_out);
+            return false;   // Type compiled out of this kernel variant
     }
 }
 
@@ -0,0 +1,49 @@
+#ifndef SCENE_GLSL
+#define SCENE_GLSL
+
+#include "Constants.glsl"
+#include "Primitive.glsl"
+#include "HitInfo.glsl"
+#include "Bvh.glsl"
+
+// Closest hit of the ray, testing every primitive or traversing the
+// bounding volume hierarchy. Traversal only keeps the ray parameter and the
+// primitive index, the hit record is built once for the closest primitive.
+bool hit_all_primitives(in Ray ray, out HitInfo hit) {
+    STATS_RAY();
+    float closest = RAY_T_MAX;
+    int closest_primitive = -1;
+
+    if (BVH_LAYOUT == BVH_LINEAR) {
+        for (int i = 0; i < num_primitives(); ++i) {
+            if (intersect_primitive(primitives[i], ray, RAY_T_MIN, closest)) {
+                closest_primitive = i;
+            }
+        }
+    } else {
+        bvh_intersect(ray, false, closest, closest_primitive);
+    }
+
+    if (closest_primitive < 0) return false;
+
+    primitive_hit_info(closest_primitive, ray, closest, hit);
+    return true;
+}
+
+// Is anything in the way of the ray? For shadow rays, stops on the first hit.
+bool hit_any_primitive(in Ray ray, float t_max) {
+    STATS_RAY();
+    if (BVH_LAYOUT != BVH_LINEAR) {
+        int primitive = -1;
+        return bvh_intersect(ray, true, t_max, primitive);
+    }
+
+    for (int i = 0; i < num_primitives(); ++i) {
+        float t = t_max;
+        if (intersect_primitive(primitives[i], ray, RAY_T_MIN, t)) return true;
+    }
+
+    return false;
+}
+
+#endif // SCENE_GLSL
@@ -18,18 +18,40 @@
 // Draw a texture ScreenQuad. Used to draw to framebuffer a image2D generated 
 // via Compute Shader.
 
-R"(#version 450
+#version 450
 
 in vec2 textCoords; // Input texture coordinates
 
 out vec4 fragColor; // Output fragment color
 
 uniform uint      numSamples;   // Scene amount of samples
+uniform uint      imageSamples; // Samples summed in the texture, 1 if it holds their mean
+uniform bool      weighted;     // Alpha sums the filter weights of the samples instead
 uniform sampler2D textSampler;  // ScreenQuad texture
 
+// Heatmap of a traversal statistic instead of the image, must match PathTracer.h:
+// 0 shows the image, 1 nodes visited, 2 primitives tested, 3 bounces
+uniform uint      heatmap;
+uniform sampler2D statsSampler; // Accumulated traversal statistics
+uniform float     heatmapScale; // Value per sample at the hot end of the scale
+
+// Blue to red through cyan, green and yellow
+vec3 heat(float x) {
+    x = clamp(x, 0.0f, 1.0f);
+    return clamp(1.5f - abs(4.0f * x - vec3(3.0f, 2.0f, 1.0f)), 0.0f, 1.0f);
+}
+
 void main() {
-    vec3 color = texture(textSampler, textCoords).xyz / float(numSamples);
+    if (heatmap != 0u) {
+        float value = texture(statsSampler, textCoords)[heatmap - 1u] / float(numSamples);
+        fragColor = vec4(heat(value / heatmapScale), 1.0f);
+        return;
+    }
+
+    // Pixels without weight show black, negative filter lobes may ring below it
+    vec4 texel = texture(textSampler, textCoords);
+    float total = weighted ? texel.w : float(imageSamples);
+    vec3 color = total > 0.0f ? max(texel.xyz / total, 0.0f) : vec3(0.0f);
     // Gamma correction
     fragColor = vec4(sqrt(color), 1.0f);
 }
-)"
@@ -18,7 +18,7 @@
 // Draw a texture ScreenQuad. Used to draw to framebuffer a image2D generated 
 // via Compute Shader.
 
-R"(#version 450
+#version 450
 
 layout (location = 0) in vec2 position;
 
@@ -28,4 +28,3 @@ void main() {
     textCoords = (position + 1.0f) / 2.0f;
     gl_Position = vec4(position, 0.0f, 1.0f);
 }
-)"
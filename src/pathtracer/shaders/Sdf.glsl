@@ -0,0 +1,145 @@
+#ifndef SDF_GLSL
+#define SDF_GLSL
+
+#include "Ray.glsl"
+#include "Box.glsl"
+
+// Signed distance functions, add new ones to sdf_distance(). Functions
+// are centered on the origin and must fit in their bounds.
+#define SDF_ROUND_BOX   0   // Rounded box, params.x is the edge radius
+#define SDF_BLOBS       1   // Three spheres blended over params.x
+#define SDF_MENGER      2   // Menger sponge of params.x levels
+
+// Step cap of sphere tracing. Kernel variants fix it at compile time.
+#ifdef FIXED_SDF_STEPS
+#define SDF_STEPS FIXED_SDF_STEPS
+#else
+uniform uint sdfSteps;
+#define SDF_STEPS sdfSteps
+#endif
+
+#define SDF_EPSILON     1e-4f   // Distance of a hit to the surface
+#define SDF_RELAXATION  1.6f    // Step scale of over-relaxed sphere tracing
+
+float sdf_box(vec3 p, vec3 half_extents) {
+    vec3 q = abs(p) - half_extents;
+    return length(max(q, 0.0f)) + min(max(q.x, max(q.y, q.z)), 0.0f);
+}
+
+// Polynomial smooth minimum
+float sdf_blend(float a, float b, float k) {
+    if (k <= 0.0f) return min(a, b);
+    float h = max(k - abs(a - b), 0.0f) / k;
+    return min(a, b) - h * h * k * 0.25f;
+}
+
+float sdf_blobs(vec3 p, vec3 half_extents, float k) {
+    float radius = 0.45f * min(half_extents.x, min(half_extents.y, half_extents.z));
+    vec3 offset = half_extents - radius;
+    float d = length(p - offset * vec3(-0.6f, -0.6f, 0.0f)) - radius;
+    d = sdf_blend(d, length(p - offset * vec3(0.6f, -0.6f, 0.3f)) - radius, k);
+    return sdf_blend(d, length(p - offset * vec3(0.0f, 0.6f, -0.3f)) - radius, k);
+}
+
+// Menger sponge filling a cube of the smallest half extent
+float sdf_menger(vec3 p, vec3 half_extents, float levels) {
+    float size = min(half_extents.x, min(half_extents.y, half_extents.z));
+    p /= size;
+
+    float d = sdf_box(p, vec3(1.0f));
+    float scale = 1.0f;
+    for (int level = 0; level < int(levels); ++level) {
+        vec3 a = mod(p * scale, 2.0f) - 1.0f;
+        scale *= 3.0f;
+        vec3 r = abs(1.0f - 3.0f * abs(a));
+        float cross_distance = (min(max(r.x, r.y), min(max(r.y, r.z), max(r.z, r.x))) - 1.0f) / scale;
+        d = max(d, cross_distance);
+    }
+
+    return d * size;
+}
+
+// Distance from a point, relative to the center, to a function
+float sdf_distance(uint function, vec3 p, vec3 half_extents, vec2 params) {
+    switch (function) {
+        case SDF_BLOBS:
+            return sdf_blobs(p, half_extents, params.x);
+        case SDF_MENGER:
+            return sdf_menger(p, half_extents, params.x);
+        default:
+            return sdf_box(p, half_extents - params.x) - params.x;
+    }
+}
+
+// Sphere trace a function inside its bounds, only finds the ray
+// parameter. On a hit closer than t_max, t_max becomes its ray parameter.
+// Steps are over-relaxed and taken back when the unbounding spheres of two
+// steps don't overlap (Keinert et al., Enhanced Sphere Tracing).
+bool intersect_sdf(uint function, vec3 center, vec3 half_extents, vec2 params,
+        Ray ray, float t_min, inout float t_max) {
+    float enter, leave;
+    if (!box_interval(center - half_extents, center + half_extents, ray, enter, leave)) return false;
+
+    float t = max(enter, t_min);
+    float t_end = min(leave, t_max);
+    if (t >= t_end) return false;
+
+    // Distances are measured along the ray, the parameter runs len times slower
+    float inv_len = 1.0f / length(ray.dir);
+    float epsilon = SDF_EPSILON * inv_len;
+
+    float omega = SDF_RELAXATION;
+    float step = 0.0f;
+    float prev_radius = 0.0f;
+    float side = 1.0f;
+    bool armed = true;
+    for (uint i = 0u; i < SDF_STEPS; ++i) {
+        float distance = sdf_distance(function, ray_at(ray, t) - center, half_extents, params) * inv_len;
+
+        // Rays starting inside march on the negated distance. Rays leaving
+        // a surface must get away from it before a hit counts.
+        if (i == 0u) {
+            side = distance < 0.0f ? -1.0f : 1.0f;
+            armed = abs(distance) >= epsilon;
+        }
+
+        float signed_radius = side * distance;
+        float radius = abs(signed_radius);
+
+        bool overshot = omega > 1.0f && radius + prev_radius < step;
+        if (overshot) {
+            step -= omega * step;
+            omega = 1.0f;
+        } else {
+            if (radius < epsilon) {
+                if (armed) {
+                    t_max = t;
+                    return true;
+                }
+            } else {
+                armed = true;
+            }
+            step = signed_radius * omega;
+        }
+
+        // Steps of at least epsilon, so rays leaving a surface get away
+        prev_radius = radius;
+        t += overshot ? step : max(step, epsilon);
+        if (t >= t_end) return false;
+    }
+
+    return false;
+}
+
+// Outward normal of a point of the function, from its gradient
+vec3 sdf_normal(uint function, vec3 center, vec3 half_extents, vec2 params, vec3 point) {
+    const vec2 k = vec2(1.0f, -1.0f);
+    const float h = 10.0f * SDF_EPSILON;
+    vec3 p = point - center;
+    return normalize(k.xyy * sdf_distance(function, p + k.xyy * h, half_extents, params) +
+                     k.yyx * sdf_distance(function, p + k.yyx * h, half_extents, params) +
+                     k.yxy * sdf_distance(function, p + k.yxy * h, half_extents, params) +
+                     k.xxx * sdf_distance(function, p + k.xxx * h, half_extents, params));
+}
+
+#endif // SDF_GLSL
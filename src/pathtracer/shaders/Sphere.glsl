@@ -6,14 +6,26 @@
 
 // Sphere shape structure
 struct Sphere {
-    uint    mat_id; // Index of material in material list
-    float   radius; // Sphere radius
-    vec3    center; // Sphere geometric center
+    uint    mat_id;     // Index of material in material list
+    float   radius;     // Sphere radius
+    vec3    center;     // Sphere geometric center when the shutter opens
+    vec3    velocity;   // Center displacement per unit of shutter time
 };
 
-// Intersect Ray-Sphere test
-bool hit_sphere(Sphere sphere, Ray ray, float min, float max, inout HitInfo hit) {
-    vec3 oc = ray.origin - sphere.center;
+// Sphere center at the shutter time of the path. Kernels without motion
+// blur don't interpolate.
+vec3 sphere_center(Sphere sphere) {
+#if defined(FIXED_MOTION_BLUR) && FIXED_MOTION_BLUR == 0
+    return sphere.center;
+#else
+    return sphere.center + sphere.velocity * ray_time;
+#endif
+}
+
+// Intersect Ray-Sphere test, only finds the ray parameter. On a hit
+// closer than max, max becomes its ray parameter.
+bool intersect_sphere(Sphere sphere, Ray ray, float min, inout float max) {
+    vec3 oc = ray.origin - sphere_center(sphere);
     float a = dot(ray.dir, ray.dir);
     float half_b = dot(oc, ray.dir);
     float c = dot(oc, oc) - sphere.radius * sphere.radius;
@@ -24,21 +36,13 @@ bool hit_sphere(Sphere sphere, Ray ray, float min, float max, inout HitInfo hit)
 
         float t1 = (-half_b - root) / a;
         if (t1 < max && t1 > min) {
-            hit.ray_t  = t1;
-            hit.point  = ray_at(ray, t1);
-            hit.normal = (hit.point - sphere.center) / sphere.radius;
-            hit.mat_id = sphere.mat_id;
-            hit_set_face_normal(ray, hit);
+            max = t1;
             return true;
         }
 
         float t2 = (-half_b + root) / a;
         if (t2 < max && t2 > min) {
-            hit.ray_t  = t2;
-            hit.point  = ray_at(ray, t2);
-            hit.normal = (hit.point - sphere.center) / sphere.radius;
-            hit.mat_id = sphere.mat_id;
-            hit_set_face_normal(ray, hit);
+            max = t2;
             return true;
         }
     } 
@@ -46,5 +50,31 @@ bool hit_sphere(Sphere sphere, Ray ray, float min, float max, inout HitInfo hit)
     return false;
 }
 
-#endif // SPHERE_GLSL
+// Ray parameters where the ray enters and leaves the sphere, the first
+// one is negative if the ray starts inside
+bool sphere_interval(Sphere sphere, Ray ray, out float t0, out float t1) {
+    vec3 oc = ray.origin - sphere_center(sphere);
+    float a = dot(ray.dir, ray.dir);
+    float half_b = dot(oc, ray.dir);
+    float c = dot(oc, oc) - sphere.radius * sphere.radius;
+    float discriminant = half_b * half_b - a * c;
 
+    t0 = t1 = 0.0f;
+    if (discriminant <= 0.0f) return false;
+
+    float root = sqrt(discriminant);
+    t0 = (-half_b - root) / a;
+    t1 = (-half_b + root) / a;
+    return true;
+}
+
+// Fill the hit record of the closest hit
+void sphere_hit_info(Sphere sphere, Ray ray, float t, out HitInfo hit) {
+    hit.ray_t  = t;
+    hit.point  = ray_at(ray, t);
+    hit.normal = (hit.point - sphere_center(sphere)) / sphere.radius;
+    hit.mat_id = sphere.mat_id;
+    hit_set_face_normal(ray, hit);
+}
+
+#endif // SPHERE_GLSL
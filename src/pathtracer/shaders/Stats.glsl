@@ -0,0 +1,42 @@
+#ifndef STATS_GLSL
+#define STATS_GLSL
+
+// Traversal statistics of the debug kernel. Only the variants rendering
+// the stats AOV define TRAVERSAL_STATS, every other kernel compiles the
+// counters out.
+#ifndef TRAVERSAL_STATS
+#define TRAVERSAL_STATS 0
+#endif
+
+#if TRAVERSAL_STATS
+
+// Totals of every path, collected and cleared by the application after
+// every sample, must match PathTracer.cpp
+layout(std430, binding = 15) buffer StatsBuffer {
+    uint stats_total_nodes;
+    uint stats_total_tests;
+    uint stats_total_bounces;
+    uint stats_total_rays;
+};
+
+// Counters of the path this invocation traces
+uint stats_nodes = 0u;      // Hierarchy nodes visited
+uint stats_tests = 0u;      // Primitive intersection tests
+uint stats_bounces = 0u;    // Path segments
+uint stats_rays = 0u;       // Closest hit and shadow rays
+
+#define STATS_NODE()    ++stats_nodes
+#define STATS_TEST()    ++stats_tests
+#define STATS_BOUNCE()  ++stats_bounces
+#define STATS_RAY()     ++stats_rays
+
+#else
+
+#define STATS_NODE()
+#define STATS_TEST()
+#define STATS_BOUNCE()
+#define STATS_RAY()
+
+#endif
+
+#endif // STATS_GLSL
@@ -0,0 +1,134 @@
+#ifndef TILECULLING_GLSL
+#define TILECULLING_GLSL
+
+#include "Scene.glsl"
+#include "Camera.glsl"
+
+// Primary rays of a workgroup tile are coherent: they all leave the eye
+// inside the frustum of the tile corners. The workgroup tests the bounds
+// of the primitives against that frustum once, together, and keeps the
+// survivors as a bit mask in shared memory. Primary rays only intersect
+// the flagged primitives, in the same order as hit_all_primitives(), so
+// the image doesn't change. Secondary rays are incoherent and test every
+// primitive. Thin lenses spread the rays over the lens, past the frustum
+// of the eye, so they always test every primitive. A bounding volume
+// hierarchy already culls per ray, tiles only cull the linear layout.
+#ifdef FIXED_TILE_CULLING
+#define TILE_CULLING (FIXED_TILE_CULLING != 0 && !THIN_LENS && BVH_LAYOUT == BVH_LINEAR)
+#else
+uniform bool tileCulling;
+#define TILE_CULLING (tileCulling && !THIN_LENS && BVH_LAYOUT == BVH_LINEAR)
+#endif
+
+#define TILE_INVOCATIONS    (gl_WorkGroupSize.x * gl_WorkGroupSize.y)
+#define TILE_WORDS          TILE_INVOCATIONS    // One mask word per invocation
+#define TILE_MIN_PRIMITIVES 16  // Smaller scenes don't pay back the barrier, must match KernelVariants.h
+
+shared uint tile_mask[TILE_WORDS];
+
+// Bounding sphere of a primitive over the shutter interval, a negative
+// radius for unbounded primitives
+vec4 primitive_bounds(in Primitive p) {
+    float radius;
+    switch (int(p.tag.x)) {
+        case SPHERE:    radius = p.center.w; break;
+        case CYLINDER:  radius = length(vec2(p.center.w, p.velocity.w)); break;
+        case TORUS:     radius = p.center.w + p.velocity.w; break;
+        case PLANE:     return vec4(0.0f, 0.0f, 0.0f, -1.0f);
+        default:        radius = length(p.shape.xyz); break;
+    }
+
+    vec3 center = p.center.xyz;
+    if (MOTION_BLUR && p.tag.x != uint(PLANE)) {
+        vec3 sweep = p.velocity.xyz * (0.5f * shutterTime);
+        center += sweep;
+        radius += length(sweep);
+    }
+
+    return vec4(center, radius);
+}
+
+// Primary ray direction through a point of the image, in pixels
+vec3 tile_ray(vec2 position, ivec2 size) {
+    vec2 pos = position / vec2(size);
+    return mix(mix(ray00, ray01, pos.y), mix(ray10, ray11, pos.y), pos.x);
+}
+
+// Inward normal of a side of the tile frustum
+vec3 tile_plane(vec3 a, vec3 b, vec3 inside) {
+    vec3 n = normalize(cross(a, b));
+    return dot(n, inside) < 0.0f ? -n : n;
+}
+
+// Flag the primitives the primary rays of the tile starting at origin may
+// hit. Every invocation of the workgroup must call it. Returns false when
+// nothing is culled: the scene is too small to gain from it or too large
+// for the mask.
+bool cull_tile(ivec2 origin, ivec2 size) {
+    if (!TILE_CULLING || num_primitives() < TILE_MIN_PRIMITIVES ||
+            num_primitives() > int(TILE_WORDS * 32u)) return false;
+
+    // Rays of the tile go through its pixels anywhere up to their far
+    // corners. Half a pixel of margin around them also keeps the frustum
+    // open on tiles of a single pixel.
+    vec2 first = vec2(origin) - 0.5f;
+    vec2 last = min(vec2(origin + ivec2(gl_WorkGroupSize.xy)), vec2(size)) + 0.5f;
+    vec3 d00 = tile_ray(first, size);
+    vec3 d10 = tile_ray(vec2(last.x, first.y), size);
+    vec3 d01 = tile_ray(vec2(first.x, last.y), size);
+    vec3 d11 = tile_ray(last, size);
+    vec3 middle = d00 + d10 + d01 + d11;
+
+    vec3 planes[4] = vec3[4](
+        tile_plane(d00, d10, middle), tile_plane(d10, d11, middle),
+        tile_plane(d11, d01, middle), tile_plane(d01, d00, middle)
+    );
+
+    // Every invocation fills a whole word, no atomics nor clearing needed
+    int word = int(gl_LocalInvocationIndex);
+    int end = min(num_primitives(), (word + 1) << 5);
+    uint bits = 0u;
+    for (int i = word << 5; i < end; ++i) {
+        vec4 bounds = primitive_bounds(primitives[i]);
+        vec3 to_center = bounds.xyz - eye;
+        float margin = bounds.w * 1.001f + 1e-4f * length(to_center);
+
+        bool visible = bounds.w < 0.0f;
+        if (!visible) {
+            visible = true;
+            for (int k = 0; k < 4; ++k) visible = visible && dot(planes[k], to_center) > -margin;
+        }
+
+        if (visible) bits |= 1u << uint(i & 31);
+    }
+
+    tile_mask[word] = bits;
+    barrier();
+    return true;
+}
+
+// Closest hit of a primary ray among the primitives flagged by cull_tile()
+bool hit_tile_primitives(in Ray ray, out HitInfo hit) {
+    STATS_RAY();
+    float closest = RAY_T_MAX;
+    int closest_primitive = -1;
+
+    int words = (num_primitives() + 31) >> 5;
+    for (int w = 0; w < words; ++w) {
+        uint bits = tile_mask[w];
+        while (bits != 0u) {
+            int i = (w << 5) + findLSB(bits);
+            bits &= bits - 1u;
+            if (intersect_primitive(primitives[i], ray, RAY_T_MIN, closest)) {
+                closest_primitive = i;
+            }
+        }
+    }
+
+    if (closest_primitive < 0) return false;
+
+    primitive_hit_info(closest_primitive, ray, closest, hit);
+    return true;
+}
+
+#endif // TILECULLING_GLSL
@@ -0,0 +1,126 @@
+#ifndef TORUS_GLSL
+#define TORUS_GLSL
+
+#include "Ray.glsl"
+
+// Frame of a torus, its axis is the local z
+mat3 torus_frame(vec3 axis) {
+    vec3 tangent = normalize(cross(axis, abs(axis.x) > 0.9f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f)));
+    return mat3(tangent, cross(axis, tangent), axis);
+}
+
+// Quartic of a point along the ray: (|p|^2 + R^2 - r^2)^2 - 4 R^2 (x^2 + y^2)
+float torus_quartic(vec3 p, float major2, float minor2) {
+    float k = dot(p, p) + major2 - minor2;
+    return k * k - 4.0f * major2 * dot(p.xy, p.xy);
+}
+
+// Intersect Ray-Torus test, only finds the ray parameter. On a hit closer
+// than t_max, t_max becomes its ray parameter. The quartic is solved in
+// closed form through its resolvent cubic (Inigo Quilez), then the root
+// is refined with a Newton step.
+bool intersect_torus(vec3 center, vec3 axis, float major, float minor,
+        Ray ray, float t_min, inout float t_max) {
+    // Local frame with a unit direction
+    mat3 to_local = transpose(torus_frame(axis));
+    vec3 ro = to_local * (ray.origin - center);
+    vec3 rd = to_local * ray.dir;
+    float len = length(rd);
+    rd /= len;
+
+    float major2 = major * major;
+    float minor2 = minor * minor;
+    float m = dot(ro, ro);
+    float n = dot(ro, rd);
+
+    // Bounding sphere
+    float outer = major + minor;
+    if (n * n - m + outer * outer < 0.0f) return false;
+
+    // Monic quartic t^4 + 4 k3 t^3 + 6 k2 t^2 + 4 k1 t + k0
+    float k = (m - minor2 - major2) * 0.5f;
+    float k3 = n;
+    float k2 = n * n + major2 * rd.z * rd.z + k;
+    float k1 = k * n + major2 * ro.z * rd.z;
+    float k0 = k * k + major2 * ro.z * ro.z - major2 * minor2;
+
+    // Solve for 1 / t instead if the cubic term is close to 0
+    bool inverted = abs(k3 * (k3 * k3 - k2) + k1) < 0.01f;
+    if (inverted) {
+        float swap = k1;
+        k1 = k3;
+        k3 = swap;
+        k0 = 1.0f / k0;
+        k1 *= k0;
+        k2 *= k0;
+        k3 *= k0;
+    }
+
+    // Resolvent cubic
+    float c2 = (2.0f * k2 - 3.0f * k3 * k3) / 3.0f;
+    float c1 = 2.0f * (k3 * (k3 * k3 - k2) + k1);
+    float c0 = (k3 * (k3 * (-3.0f * k3 * k3 + 4.0f * k2) - 8.0f * k1) + 4.0f * k0) / 3.0f;
+
+    float q = c2 * c2 + c0;
+    float r = 3.0f * c0 * c2 - c2 * c2 * c2 - c1 * c1;
+    float h = r * r - q * q * q;
+    float z;
+    if (h < 0.0f) {
+        float sq = sqrt(q);
+        z = 2.0f * sq * cos(acos(clamp(r / (sq * q), -1.0f, 1.0f)) / 3.0f);
+    } else {
+        float sq = pow(sqrt(h) + abs(r), 1.0f / 3.0f);
+        z = sign(r) * abs(sq + q / sq);
+    }
+    z = c2 - z;
+
+    float d1 = z - 3.0f * c2;
+    float d2 = z * z - 3.0f * c0;
+    if (abs(d1) < 1.0e-4f) {
+        if (d2 < 0.0f) return false;
+        d2 = sqrt(d2);
+    } else {
+        if (d1 < 0.0f) return false;
+        d1 = sqrt(d1 * 0.5f);
+        d2 = c1 / d1;
+    }
+
+    // Up to four roots, keep the closest one in range
+    float local_min = t_min * len;
+    float closest = t_max * len;
+    bool found = false;
+    for (float side = -1.0f; side <= 1.0f; side += 2.0f) {
+        float disc = d1 * d1 - z - side * d2;
+        if (disc <= 0.0f) continue;
+
+        disc = sqrt(disc);
+        for (float root_side = -1.0f; root_side <= 1.0f; root_side += 2.0f) {
+            float t = side * d1 + root_side * disc - k3;
+            if (inverted) t = 2.0f / t;
+
+            // Newton step on the quartic
+            vec3 p = ro + t * rd;
+            float g = dot(p, p) + major2 - minor2;
+            float derivative = 4.0f * g * dot(p, rd) - 8.0f * major2 * dot(p.xy, rd.xy);
+            if (derivative != 0.0f) t -= torus_quartic(p, major2, minor2) / derivative;
+
+            if (t > local_min && t < closest) {
+                closest = t;
+                found = true;
+            }
+        }
+    }
+
+    if (found) t_max = closest / len;
+    return found;
+}
+
+// Outward normal of a point of the torus
+vec3 torus_normal(vec3 center, vec3 axis, float major, float minor, vec3 point) {
+    mat3 frame = torus_frame(axis);
+    vec3 p = transpose(frame) * (point - center);
+    vec3 n = p * (dot(p, p) - minor * minor - major * major * vec3(1.0f, 1.0f, -1.0f));
+    return normalize(frame * n);
+}
+
+#endif // TORUS_GLSL
@@ -0,0 +1,129 @@
+#ifndef VOXELS_GLSL
+#define VOXELS_GLSL
+
+#include "Ray.glsl"
+#include "Box.glsl"
+
+#define VOXEL_BRICK_SHIFT   3       // log2 of the voxels along a brick side
+#define VOXEL_ROOT_SHIFT    6       // log2 of the voxels along a root cell side
+#define VOXEL_MAX_STEPS     4096    // Cells a ray can cross before giving up
+
+// Voxel model, a brick map uploaded by the application:
+//  voxel_size:  voxels along each axis, offset of the nodes on w
+//  voxel_roots: root cells along each axis, offset of the bricks on w
+//  voxel_data:  root grid (node + 1), nodes of 512 brick references (brick
+//               + 1) and bricks of 128 words with 4 labels (material + 1)
+layout(std430, binding = 5) readonly buffer VoxelBuffer {
+    ivec4 voxel_size;
+    ivec4 voxel_roots;
+    uint  voxel_data[];
+};
+
+// Label of a voxel inside the grid: material id + 1, 0 if empty. span is
+// the side of the empty root cell or brick holding the voxel, 1 otherwise.
+uint voxel_label(ivec3 voxel, out int span) {
+    ivec3 root = voxel >> VOXEL_ROOT_SHIFT;
+    uint node = voxel_data[(root.z * voxel_roots.y + root.y) * voxel_roots.x + root.x];
+    if (node == 0u) {
+        span = 1 << VOXEL_ROOT_SHIFT;
+        return 0u;
+    }
+
+    ivec3 b = (voxel >> VOXEL_BRICK_SHIFT) & 7;
+    uint brick = voxel_data[voxel_size.w + int(node - 1u) * 512 + (b.z * 8 + b.y) * 8 + b.x];
+    if (brick == 0u) {
+        span = 1 << VOXEL_BRICK_SHIFT;
+        return 0u;
+    }
+
+    ivec3 v = voxel & 7;
+    int i = (v.z * 8 + v.y) * 8 + v.x;
+    span = 1;
+    return (voxel_data[voxel_roots.w + int(brick - 1u) * 128 + (i >> 2)] >> uint((i & 3) * 8)) & 0xFFu;
+}
+
+// Is the voxel inside the grid?
+bool voxel_in_grid(ivec3 voxel) {
+    return all(greaterThanEqual(voxel, ivec3(0))) && all(lessThan(voxel, voxel_size.xyz));
+}
+
+// Intersect Ray-Voxels test of the grid stretched over center +- half_extents,
+// only finds the ray parameter. A DDA walks the cells the ray crosses,
+// taking empty root cells and bricks in a single step. Rays starting in an
+// occupied voxel hit where they leave the occupied voxels. On a hit closer
+// than t_max, t_max becomes its ray parameter.
+bool intersect_voxels(vec3 center, vec3 half_extents, in Ray ray, float t_min, inout float t_max) {
+    float enter, leave;
+    if (!box_interval(center - half_extents, center + half_extents, ray, enter, leave)) return false;
+
+    float t = max(enter, t_min);
+    float t_end = min(leave, t_max);
+    if (t >= t_end) return false;
+
+    // Ray in voxel units, the ray parameter doesn't change
+    vec3 scale = vec3(voxel_size.xyz) / (2.0f * half_extents);
+    vec3 origin = (ray.origin - center + half_extents) * scale;
+    vec3 dir = ray.dir * scale;
+    dir = mix(dir, vec3(1e-20f), lessThan(abs(dir), vec3(1e-20f)));
+    vec3 inv_dir = 1.0f / dir;
+    bvec3 positive = greaterThan(dir, vec3(0.0f));
+
+    int span;
+    ivec3 voxel = clamp(ivec3(floor(origin + dir * t)), ivec3(0), voxel_size.xyz - 1);
+    bool inside = enter < t_min && voxel_label(voxel, span) != 0u;
+
+    for (int i = 0; i < VOXEL_MAX_STEPS; ++i) {
+        if ((voxel_label(voxel, span) != 0u) != inside) {
+            t_max = t;
+            return true;
+        }
+
+        // Leave the cell through its closest face
+        ivec3 cell_min = voxel & ~(span - 1);
+        vec3 bound = vec3(cell_min + mix(ivec3(0), ivec3(span), positive));
+        vec3 t_exit = (bound - origin) * inv_dir;
+        float t_next = min(min(t_exit.x, t_exit.y), t_exit.z);
+        int axis = t_next == t_exit.x ? 0 : (t_next == t_exit.y ? 1 : 2);
+
+        if (t_next >= t_end) break;
+
+        t = t_next;
+        voxel = clamp(ivec3(floor(origin + dir * t)), cell_min, cell_min + span - 1);
+        voxel[axis] = positive[axis] ? cell_min[axis] + span : cell_min[axis] - 1;
+        if (!voxel_in_grid(voxel)) break;
+    }
+
+    // Occupied voxels on the border of the grid end where the grid ends
+    if (inside && leave < t_max) {
+        t_max = leave;
+        return true;
+    }
+
+    return false;
+}
+
+// Occupied voxel of a hit point, its label and outward normal
+uint voxel_hit(vec3 center, vec3 half_extents, in Ray ray, vec3 point, out vec3 normal) {
+    vec3 scale = vec3(voxel_size.xyz) / (2.0f * half_extents);
+    vec3 local = (point - center + half_extents) * scale;
+    vec3 nudge = normalize(ray.dir * scale) * 0.01f;
+
+    // The ray enters the voxel after the point or leaves the one before it
+    int span;
+    ivec3 voxel = ivec3(floor(local + nudge));
+    uint label = voxel_in_grid(voxel) ? voxel_label(voxel, span) : 0u;
+    if (label == 0u) {
+        voxel = clamp(ivec3(floor(local - nudge)), ivec3(0), voxel_size.xyz - 1);
+        label = voxel_label(voxel, span);
+    }
+
+    vec3 d = local - (vec3(voxel) + 0.5f);
+    vec3 dist = abs(d);
+    if (dist.x >= dist.y && dist.x >= dist.z) normal = vec3(sign(d.x), 0.0f, 0.0f);
+    else if (dist.y >= dist.z) normal = vec3(0.0f, sign(d.y), 0.0f);
+    else normal = vec3(0.0f, 0.0f, sign(d.z));
+
+    return label;
+}
+
+#endif // VOXELS_GLSL
@@ -0,0 +1,59 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_AABB_H_
+#define PATHTRACER_AABB_H_
+
+#include <limits>
+
+#include <glm/glm.hpp>
+
+namespace scene {
+
+    /** Axis aligned bounding box, empty by default */
+    struct Aabb {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());     //!< Lower corner
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());    //!< Upper corner
+
+        /** Grow to hold a point */
+        void extend(const glm::vec3& point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        /** Grow to hold a box */
+        void extend(const Aabb& box) {
+            min = glm::min(min, box.min);
+            max = glm::max(max, box.max);
+        }
+
+        /** Is the box empty? */
+        bool empty() const { return glm::any(glm::greaterThan(min, max)); }
+
+        /** Get the center */
+        glm::vec3 center() const { return 0.5f * (min + max); }
+
+        /** Get the surface area, 0 for an empty box */
+        float area() const {
+            if (empty()) return 0.0f;
+            const glm::vec3 d = max - min;
+            return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+    };
+}
+
+#endif //PATHTRACER_AABB_H_
@@ -0,0 +1,269 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <numeric>
+
+#include "../util/ThreadPool.h"
+
+#include "BrickMap.h"
+
+namespace scene {
+
+    /** Linear index of a cell of a grid, x varies fastest */
+    static size_t cellIndex(const glm::ivec3& cell, const glm::ivec3& grid) {
+        return (size_t(cell.z) * size_t(grid.y) + size_t(cell.y)) * size_t(grid.x) + size_t(cell.x);
+    }
+
+    /** Number of cells of a grid */
+    static size_t cellCount(const glm::ivec3& grid) {
+        return size_t(grid.x) * size_t(grid.y) * size_t(grid.z);
+    }
+
+    /** Store a label in a brick */
+    static void setLabel(uint32_t* brick, const glm::ivec3& local, uint32_t label) {
+        const size_t i = cellIndex(local, glm::ivec3(BrickMap::BRICK_SIZE));
+        const uint32_t shift = uint32_t(i & 3) * 8;
+        brick[i >> 2] = (brick[i >> 2] & ~(0xFFu << shift)) | (label << shift);
+    }
+
+    /** Count the occupied voxels of a brick */
+    static uint32_t countLabels(const uint32_t* brick) {
+        uint32_t count = 0;
+        for (size_t w = 0; w < BrickMap::BRICK_WORDS; ++w)
+            for (uint32_t shift = 0; shift < 32; shift += 8)
+                count += ((brick[w] >> shift) & 0xFFu) != 0 ? 1 : 0;
+        return count;
+    }
+
+    BrickMap::BrickMap()
+        : size(1)
+        , roots(1)
+        , numVoxels(0)
+        , rootTable(1, 0)
+        , nodes()
+        , bricks() {
+
+    }
+
+    BrickMap BrickMap::fromDense(const glm::ivec3& size, const std::vector<uint8_t>& labels) {
+        BrickMap map;
+        if (glm::any(glm::lessThan(size, glm::ivec3(1))) || labels.size() != cellCount(size)) return map;
+
+        // Flag the bricks with any label, one slab of bricks per task
+        const glm::ivec3 brickGrid = (size + BRICK_SIZE - 1) / BRICK_SIZE;
+        std::vector<uint32_t> slots(cellCount(brickGrid), 0);
+        util::ThreadPool& pool = util::ThreadPool::instance();
+        pool.parallelFor(0, size_t(brickGrid.z), 1, [&](size_t begin, size_t end) {
+            for (int bz = int(begin); bz < int(end); ++bz)
+            for (int by = 0; by < brickGrid.y; ++by)
+            for (int bx = 0; bx < brickGrid.x; ++bx) {
+                const glm::ivec3 first = glm::ivec3(bx, by, bz) * BRICK_SIZE;
+                const glm::ivec3 last = glm::min(first + BRICK_SIZE, size);
+
+                bool occupied = false;
+                for (int z = first.z; z < last.z && !occupied; ++z)
+                for (int y = first.y; y < last.y && !occupied; ++y) {
+                    const uint8_t* row = labels.data() + cellIndex(glm::ivec3(0, y, z), size);
+                    for (int x = first.x; x < last.x; ++x) occupied = occupied || row[x] != 0;
+                }
+
+                slots[cellIndex(glm::ivec3(bx, by, bz), brickGrid)] = occupied ? 1 : 0;
+            }
+        });
+
+        map.size = size;
+        map.allocate(brickGrid, slots);
+
+        // Copy the labels, every brick is owned by the task of its slab
+        std::vector<uint32_t> counts(map.getNumBricks(), 0);
+        pool.parallelFor(0, size_t(brickGrid.z), 1, [&](size_t begin, size_t end) {
+            for (int bz = int(begin); bz < int(end); ++bz)
+            for (int by = 0; by < brickGrid.y; ++by)
+            for (int bx = 0; bx < brickGrid.x; ++bx) {
+                const uint32_t slot = slots[cellIndex(glm::ivec3(bx, by, bz), brickGrid)];
+                if (slot == 0) continue;
+
+                uint32_t* brick = map.bricks.data() + (slot - 1) * BRICK_WORDS;
+                const glm::ivec3 first = glm::ivec3(bx, by, bz) * BRICK_SIZE;
+                const glm::ivec3 last = glm::min(first + BRICK_SIZE, size);
+                for (int z = first.z; z < last.z; ++z)
+                for (int y = first.y; y < last.y; ++y) {
+                    const uint8_t* row = labels.data() + cellIndex(glm::ivec3(0, y, z), size);
+                    for (int x = first.x; x < last.x; ++x)
+                        setLabel(brick, glm::ivec3(x, y, z) - first, row[x]);
+                }
+
+                counts[slot - 1] = countLabels(brick);
+            }
+        });
+
+        map.numVoxels = std::accumulate(counts.begin(), counts.end(), size_t(0));
+        return map;
+    }
+
+    BrickMap BrickMap::fromSparse(const glm::ivec3& size, const std::vector<Voxel>& voxels) {
+        BrickMap map;
+        if (glm::any(glm::lessThan(size, glm::ivec3(1)))) return map;
+
+        // Brick of every voxel, invalid voxels get none
+        const glm::ivec3 brickGrid = (size + BRICK_SIZE - 1) / BRICK_SIZE;
+        const uint32_t NONE = 0xFFFFFFFFu;
+        std::vector<uint32_t> brickOf(voxels.size());
+        util::ThreadPool& pool = util::ThreadPool::instance();
+        pool.parallelFor(0, voxels.size(), 4096, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const Voxel& voxel = voxels[i];
+                const bool inside = glm::all(glm::greaterThanEqual(voxel.position, glm::ivec3(0))) &&
+                    glm::all(glm::lessThan(voxel.position, size));
+                brickOf[i] = inside && voxel.material <= MAX_MATERIAL ?
+                    uint32_t(cellIndex(voxel.position / BRICK_SIZE, brickGrid)) : NONE;
+            }
+        });
+
+        std::vector<uint32_t> slots(cellCount(brickGrid), 0);
+        for (uint32_t brick : brickOf)
+            if (brick != NONE) slots[brick] = 1;
+
+        map.size = size;
+        map.allocate(brickGrid, slots);
+
+        // Bucket the voxels per brick keeping their order
+        const size_t numBricks = map.getNumBricks();
+        std::vector<size_t> offsets(numBricks + 1, 0);
+        for (uint32_t brick : brickOf)
+            if (brick != NONE) ++offsets[slots[brick]];
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::vector<size_t> order(offsets[numBricks]);
+        std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < voxels.size(); ++i)
+            if (brickOf[i] != NONE) order[next[slots[brickOf[i]] - 1]++] = i;
+
+        // Fill every brick from its bucket
+        std::vector<uint32_t> counts(numBricks, 0);
+        pool.parallelFor(0, numBricks, 64, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                uint32_t* brick = map.bricks.data() + b * BRICK_WORDS;
+                for (size_t k = offsets[b]; k < offsets[b + 1]; ++k) {
+                    const Voxel& voxel = voxels[order[k]];
+                    setLabel(brick, voxel.position % BRICK_SIZE, voxel.material + 1);
+                }
+                counts[b] = countLabels(brick);
+            }
+        });
+
+        map.numVoxels = std::accumulate(counts.begin(), counts.end(), size_t(0));
+        return map;
+    }
+
+    void BrickMap::allocate(const glm::ivec3& brickGrid, std::vector<uint32_t>& slots) {
+        roots = (brickGrid + NODE_SIZE - 1) / NODE_SIZE;
+        rootTable.assign(cellCount(roots), 0);
+        nodes.clear();
+
+        // Root cells in order, so the bricks of a node are close in memory
+        uint32_t numNodes = 0;
+        uint32_t numBricks = 0;
+        for (int rz = 0; rz < roots.z; ++rz)
+        for (int ry = 0; ry < roots.y; ++ry)
+        for (int rx = 0; rx < roots.x; ++rx) {
+            const glm::ivec3 root(rx, ry, rz);
+            uint32_t node = 0;
+
+            for (int lz = 0; lz < NODE_SIZE; ++lz)
+            for (int ly = 0; ly < NODE_SIZE; ++ly)
+            for (int lx = 0; lx < NODE_SIZE; ++lx) {
+                const glm::ivec3 local(lx, ly, lz);
+                const glm::ivec3 brick = root * NODE_SIZE + local;
+                if (glm::any(glm::greaterThanEqual(brick, brickGrid))) continue;
+
+                uint32_t& slot = slots[cellIndex(brick, brickGrid)];
+                if (slot == 0) continue;
+
+                if (node == 0) {
+                    node = ++numNodes;
+                    nodes.resize(size_t(numNodes) * NODE_WORDS, 0);
+                }
+
+                slot = ++numBricks;
+                nodes[(node - 1) * NODE_WORDS + cellIndex(local, glm::ivec3(NODE_SIZE))] = slot;
+            }
+
+            rootTable[cellIndex(root, roots)] = node;
+        }
+
+        bricks.assign(size_t(numBricks) * BRICK_WORDS, 0);
+    }
+
+    glm::ivec3 BrickMap::getSize() const {
+        return size;
+    }
+
+    glm::ivec3 BrickMap::getRoots() const {
+        return roots;
+    }
+
+    size_t BrickMap::getNumVoxels() const {
+        return numVoxels;
+    }
+
+    size_t BrickMap::getNumBricks() const {
+        return bricks.size() / BRICK_WORDS;
+    }
+
+    size_t BrickMap::getBytes() const {
+        return (rootTable.size() + nodes.size() + bricks.size()) * sizeof(uint32_t);
+    }
+
+    const std::vector<uint32_t>& BrickMap::getRootTable() const {
+        return rootTable;
+    }
+
+    const std::vector<uint32_t>& BrickMap::getNodes() const {
+        return nodes;
+    }
+
+    const std::vector<uint32_t>& BrickMap::getBricks() const {
+        return bricks;
+    }
+
+    BrickMap defaultVoxels() {
+        const int side = 64;
+        const float pi = 3.14159265f;
+        const uint32_t bands[] = { 0, 8, 4, 5 };
+
+        std::vector<Voxel> voxels;
+        for (int z = 0; z < side; ++z)
+        for (int y = 0; y < side; ++y)
+        for (int x = 0; x < side; ++x) {
+            const glm::vec3 d = glm::vec3(x, y, z) + 0.5f - 0.5f * float(side);
+            const float r = glm::length(d);
+
+            // Rows of windows through the shell show the core
+            const int sector = int((std::atan2(d.z, d.x) + pi) / (2.0f * pi) * 16.0f);
+            const bool window = (y & 15) >= 4 && (y & 15) < 12 && (sector & 1) == 0;
+
+            if (r < 12.0f)
+                voxels.push_back({ glm::ivec3(x, y, z), 3 });
+            else if (r >= 26.0f && r < 30.0f && !window)
+                voxels.push_back({ glm::ivec3(x, y, z), bands[(y >> 3) & 3] });
+        }
+
+        return BrickMap::fromSparse(glm::ivec3(side), voxels);
+    }
+}
@@ -0,0 +1,131 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_BRICKMAP_H_
+#define PATHTRACER_BRICKMAP_H_
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace scene {
+
+    /** Occupied voxel of a sparse voxel list */
+    struct Voxel {
+        glm::ivec3  position;   //!< Voxel coordinates, x varies fastest
+        uint32_t    material;   //!< Index of the material table
+    };
+
+    /**
+     * Voxel grid with a material id per voxel, stored as a three level
+     * brick map: a dense root grid of cells of ROOT_SIZE^3 voxels, a node of
+     * NODE_SIZE^3 brick references for every occupied root cell, and a brick
+     * of BRICK_SIZE^3 8-bit labels for every occupied brick. Labels are the
+     * material id + 1, 0 is empty. Memory grows with the occupied bricks,
+     * the root grid only costs 4 bytes per ROOT_SIZE^3 voxels.
+     */
+    class BrickMap {
+    public:
+
+        /** Voxels along each side of a brick, must match Voxels.glsl */
+        static constexpr int BRICK_SIZE = 8;
+
+        /** Bricks along each side of a node, must match Voxels.glsl */
+        static constexpr int NODE_SIZE = 8;
+
+        /** Voxels along each side of a root cell */
+        static constexpr int ROOT_SIZE = BRICK_SIZE * NODE_SIZE;
+
+        /** 32 bit words of a node, a brick reference each */
+        static constexpr size_t NODE_WORDS = NODE_SIZE * NODE_SIZE * NODE_SIZE;
+
+        /** 32 bit words of a brick, 4 labels each */
+        static constexpr size_t BRICK_WORDS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE / 4;
+
+        /** Largest material id a voxel can hold */
+        static constexpr uint32_t MAX_MATERIAL = 254;
+
+        /** Default constructor, a single empty voxel */
+        BrickMap();
+
+        /**
+         * Build from a dense grid of labels, one task per slab of bricks
+         * @param[in] size   Voxels along each axis
+         * @param[in] labels size.x * size.y * size.z labels, x varies fastest.
+         *                   0 is empty, otherwise the material id + 1.
+         * @return The brick map, empty if the labels don't match the size
+         */
+        static BrickMap fromDense(const glm::ivec3& size, const std::vector<uint8_t>& labels);
+
+        /**
+         * Build from a list of occupied voxels. Voxels are bucketed per brick
+         * and every brick is filled by one task, so a position listed twice
+         * keeps its last material. Voxels outside the grid or with a material
+         * above MAX_MATERIAL are ignored.
+         * @param[in] size   Voxels along each axis
+         * @param[in] voxels Occupied voxels, in any order
+         * @return The brick map
+         */
+        static BrickMap fromSparse(const glm::ivec3& size, const std::vector<Voxel>& voxels);
+
+        /** Get the grid size in voxels */
+        glm::ivec3 getSize() const;
+
+        /** Get the root grid size in cells */
+        glm::ivec3 getRoots() const;
+
+        /** Get the number of occupied voxels */
+        size_t getNumVoxels() const;
+
+        /** Get the number of allocated bricks */
+        size_t getNumBricks() const;
+
+        /** Get the size of the root grid, nodes and bricks in bytes */
+        size_t getBytes() const;
+
+        /** Get the root grid, x varies fastest: node index + 1, 0 is empty */
+        const std::vector<uint32_t>& getRootTable() const;
+
+        /** Get the nodes, NODE_WORDS each: brick index + 1, 0 is empty */
+        const std::vector<uint32_t>& getNodes() const;
+
+        /** Get the bricks, BRICK_WORDS each: 4 labels per word, lowest byte first */
+        const std::vector<uint32_t>& getBricks() const;
+
+    private:
+
+        /**
+         * Allocate a node per occupied root cell and a brick per occupied brick
+         * @param[in]     bricks Brick grid size
+         * @param[in,out] slots  Occupancy of the brick grid, becomes the brick index + 1
+         */
+        void allocate(const glm::ivec3& bricks, std::vector<uint32_t>& slots);
+
+        glm::ivec3              size;       //!< Voxels along each axis
+        glm::ivec3              roots;      //!< Root cells along each axis
+        size_t                  numVoxels;  //!< Occupied voxels
+        std::vector<uint32_t>   rootTable;  //!< Node of every root cell
+        std::vector<uint32_t>   nodes;      //!< Brick references of the occupied root cells
+        std::vector<uint32_t>   bricks;     //!< Labels of the occupied bricks
+    };
+
+    /** Get the voxel model of the "voxels" scene: a shell with windows around a glass core */
+    BrickMap defaultVoxels();
+}
+
+#endif //PATHTRACER_BRICKMAP_H_
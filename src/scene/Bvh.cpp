@@ -0,0 +1,681 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "../util/ThreadPool.h"
+#include "Bvh.h"
+
+namespace scene {
+
+    /** Cost of visiting a node, relative to intersecting a primitive */
+    static constexpr float TRAVERSAL_COST = 1.0f;
+
+    /** Ranges of at least this many primitives split their children in tasks of their own */
+    static constexpr uint32_t TASK_MIN_PRIMITIVES = 4096;
+
+    /** Ranges of at least this many primitives are bounded and binned by the pool, a chunk per task */
+    static constexpr uint32_t POOL_MIN_PRIMITIVES = 1u << 16;
+    static constexpr uint32_t POOL_CHUNK = 1u << 14;
+
+    /** Spatial splits are only tried where the children of the object split overlap more than this, relative to the root */
+    static constexpr float SPATIAL_OVERLAP = 1e-5f;
+
+    /** Count of an arena node whose children are the roots of two forked tasks */
+    static constexpr uint32_t FORK = 0xFFFFFFFFu;
+
+    namespace {
+
+        /** Primitive of the index list with its bounds, partitioned in place so ranges are read in order */
+        struct Reference {
+            Aabb        box;    //!< Bounds of the primitive
+            uint32_t    index;  //!< Index of the primitive
+        };
+
+        /** Bounds of some primitives and of their centroids */
+        struct RangeBounds {
+            Aabb    bounds;
+            Aabb    centroids;
+
+            void merge(const RangeBounds& other) {
+                bounds.extend(other.bounds);
+                centroids.extend(other.centroids);
+            }
+        };
+
+        /**
+         * Centroid bins of the three axes, filled in a single pass over the
+         * primitives. Only the counts are cleared, the bounds of a bin are
+         * set by its first primitive: most nodes are small and fill few bins.
+         */
+        struct Bins {
+            glm::vec3   min[3][Bvh::NUM_BINS];      //!< Lower corner of the filled bins
+            glm::vec3   max[3][Bvh::NUM_BINS];      //!< Upper corner of the filled bins
+            uint32_t    counts[3][Bvh::NUM_BINS] = {};
+
+            void add(int axis, int bin, const glm::vec3& lo, const glm::vec3& hi, uint32_t count) {
+                if (counts[axis][bin] == 0) {
+                    min[axis][bin] = lo;
+                    max[axis][bin] = hi;
+                } else {
+                    min[axis][bin] = glm::min(min[axis][bin], lo);
+                    max[axis][bin] = glm::max(max[axis][bin], hi);
+                }
+                counts[axis][bin] += count;
+            }
+
+            void merge(const Bins& other) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    for (int bin = 0; bin < Bvh::NUM_BINS; ++bin) {
+                        if (other.counts[axis][bin] > 0)
+                            add(axis, bin, other.min[axis][bin], other.max[axis][bin], other.counts[axis][bin]);
+                    }
+                }
+            }
+
+            Aabb bounds(int axis, int bin) const {
+                Aabb box;
+                box.min = min[axis][bin];
+                box.max = max[axis][bin];
+                return box;
+            }
+        };
+
+        /**
+         * Bins of the spatial splits of the three axes, evenly spaced over
+         * the node bounds. A reference enters the bin of its lower side and
+         * exits the bin of its upper side, and every bin it crosses holds
+         * the bounds of its part in there.
+         */
+        struct SpatialBins {
+            Aabb        bounds[3][Bvh::NUM_BINS];       //!< Bounds of the parts in every bin
+            uint32_t    entries[3][Bvh::NUM_BINS] = {}; //!< References starting in every bin
+            uint32_t    exits[3][Bvh::NUM_BINS] = {};   //!< References ending in every bin
+
+            void merge(const SpatialBins& other) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    for (int bin = 0; bin < Bvh::NUM_BINS; ++bin) {
+                        bounds[axis][bin].extend(other.bounds[axis][bin]);
+                        entries[axis][bin] += other.entries[axis][bin];
+                        exits[axis][bin] += other.exits[axis][bin];
+                    }
+                }
+            }
+        };
+
+        /**
+         * Subtree split by a single thread into a node arena of its own,
+         * the root first. Its inner nodes refer to children in the arena,
+         * FORK nodes to a pair of forked tasks.
+         */
+        struct Task {
+            uint32_t                begin;      //!< First entry of the index list
+            uint32_t                end;        //!< One past the last entry
+            uint32_t                capacity;   //!< One past the last free entry, for references split in two
+            uint32_t                level;      //!< Depth of the root
+            uint32_t                depth;      //!< Number of levels down to the deepest leaf
+            std::vector<Bvh::Node>  nodes;      //!< Node arena
+            std::vector<Task>       forks;      //!< Forked subtrees, a pair per FORK node
+            std::vector<uint32_t>   forkSlots;  //!< Tree slot of the first root of every pair
+
+            Task(uint32_t begin, uint32_t end, uint32_t capacity, uint32_t level)
+                : begin(begin), end(end), capacity(capacity), level(level), depth(level + 1) {}
+        };
+
+        /** Where an arena lands in the flat tree */
+        struct Placement {
+            Task*       task;   //!< Task of the arena
+            uint32_t    slot;   //!< Slot of the root
+            uint32_t    base;   //!< Arena node k > 0 lands at base + k
+        };
+
+        /** State shared by the tasks of a build */
+        class Builder {
+        public:
+
+            Builder(std::vector<Reference>& references, const std::vector<Primitive>& primitives, float shutter,
+                    bool spatial)
+                : references(references)
+                , primitives(primitives)
+                , shutter(shutter)
+                , spatial(spatial)
+                , minOverlap(0.0f)
+                , pool(util::ThreadPool::instance()) {
+
+            }
+
+            /** Split the range of a task into its arena */
+            void run(Task& task) {
+                task.nodes.push_back(Bvh::Node());
+                split(task, 0, task.begin, task.end, task.capacity, task.level);
+            }
+
+            /**
+             * Lay the arenas out in the tree, forked roots in adjacent slots
+             * @param[in]     task       Task to place
+             * @param[in]     slot       Slot of its root
+             * @param[in,out] size       Nodes of the tree so far
+             * @param[out]    placements Every task and where it lands
+             */
+            static void place(Task& task, uint32_t slot, uint32_t& size, std::vector<Placement>& placements) {
+                placements.push_back({ &task, slot, size - 1 });
+                size += uint32_t(task.nodes.size()) - 1;
+
+                for (size_t fork = 0; fork < task.forks.size(); fork += 2) {
+                    const uint32_t pair = size;
+                    size += 2;
+                    task.forkSlots.push_back(pair);
+                    place(task.forks[fork], pair, size, placements);
+                    place(task.forks[fork + 1], pair + 1, size, placements);
+                }
+            }
+
+            /** Copy the arenas to their place in the tree, relocating the children */
+            void flatten(const std::vector<Placement>& placements, std::vector<Bvh::Node>& nodes) {
+                pool.parallelFor(0, placements.size(), 1, [&](size_t first, size_t last) {
+                    for (size_t p = first; p < last; ++p) {
+                        const Placement& placement = placements[p];
+                        const std::vector<Bvh::Node>& arena = placement.task->nodes;
+                        for (uint32_t k = 0; k < uint32_t(arena.size()); ++k) {
+                            Bvh::Node node = arena[k];
+                            if (node.count == FORK) {
+                                node.first = placement.task->forkSlots[node.first / 2];
+                                node.count = 0;
+                            } else if (node.count == 0) {
+                                node.first += placement.base;
+                            }
+                            nodes[k == 0 ? placement.slot : placement.base + k] = node;
+                        }
+                    }
+                });
+            }
+
+        private:
+
+            /**
+             * Run body(first, last, partial) over a range of the index list
+             * and merge the partial results, large ranges by the whole pool
+             */
+            template <typename Result, typename Body>
+            Result reduce(uint32_t begin, uint32_t end, const Body& body) {
+                Result result;
+                if (end - begin < POOL_MIN_PRIMITIVES) {
+                    body(begin, end, result);
+                    return result;
+                }
+
+                const size_t chunks = (end - begin + POOL_CHUNK - 1) / POOL_CHUNK;
+                std::vector<Result> partials(chunks);
+                pool.parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+                    for (size_t chunk = first; chunk < last; ++chunk) {
+                        const uint32_t chunkBegin = begin + uint32_t(chunk) * POOL_CHUNK;
+                        body(chunkBegin, std::min(chunkBegin + POOL_CHUNK, end), partials[chunk]);
+                    }
+                });
+
+                // Min, max and counts don't depend on the merge order, every thread count builds the same tree
+                for (const Result& partial : partials) result.merge(partial);
+                return result;
+            }
+
+            /**
+             * Split a range of the index list under an arena node. The free
+             * entries up to the capacity are shared by the children in
+             * proportion to their references.
+             */
+            void split(Task& task, uint32_t node, uint32_t begin, uint32_t end, uint32_t capacity, uint32_t level) {
+                task.depth = std::max(task.depth, level + 1);
+
+                const RangeBounds range = reduce<RangeBounds>(begin, end,
+                    [this](uint32_t first, uint32_t last, RangeBounds& partial) {
+                        for (uint32_t i = first; i < last; ++i) {
+                            partial.bounds.extend(references[i].box);
+                            partial.centroids.extend(references[i].box.center());
+                        }
+                    });
+
+                const uint32_t count = end - begin;
+                task.nodes[node].bounds = range.bounds;
+                task.nodes[node].first = begin;
+                task.nodes[node].count = count;
+                if (level == 0) minOverlap = SPATIAL_OVERLAP * range.bounds.area();
+
+                // Bin the centroids on every axis at once. Flat axes get a
+                // unit extent to keep the bin math finite, they never split.
+                const glm::vec3 lo = range.centroids.min;
+                const glm::vec3 extent = range.centroids.max - lo;
+                const glm::bvec3 flat = glm::not_(glm::greaterThan(extent, glm::vec3(0.0f)));
+                const glm::vec3 safeExtent = glm::mix(extent, glm::vec3(1.0f), flat);
+                const bool sah = count > 1 && level < Bvh::MAX_SAH_LEVEL;
+
+                Bins bins;
+                if (sah) {
+                    bins = reduce<Bins>(begin, end, [&](uint32_t first, uint32_t last, Bins& partial) {
+                        for (uint32_t i = first; i < last; ++i) {
+                            const Aabb& box = references[i].box;
+                            const glm::ivec3 bin = glm::min(glm::ivec3((box.center() - lo) / safeExtent *
+                                float(Bvh::NUM_BINS)), glm::ivec3(Bvh::NUM_BINS - 1));
+                            for (int axis = 0; axis < 3; ++axis) partial.add(axis, bin[axis], box.min, box.max, 1);
+                        }
+                    });
+                }
+
+                // Find the cheapest split between bins of every axis
+                const float area = std::max(range.bounds.area(), 1e-20f);
+                float bestCost = float(count);
+                int bestAxis = -1;
+                int bestBin = 0;
+                Aabb bestLeft, bestRight;
+                for (int axis = 0; axis < 3 && sah; ++axis) {
+                    if (flat[axis]) continue;
+
+                    // Right side of every split, then sweep the left side. Most
+                    // nodes are small, only their few filled bins change a side.
+                    const uint32_t* counts = bins.counts[axis];
+                    float rightArea[Bvh::NUM_BINS];
+                    uint32_t rightCount[Bvh::NUM_BINS];
+                    Aabb rightBounds[Bvh::NUM_BINS];
+                    Aabb right;
+                    float sideArea = 0.0f;
+                    uint32_t n = 0;
+                    for (int bin = Bvh::NUM_BINS - 1; bin > 0; --bin) {
+                        if (counts[bin] > 0) {
+                            right.extend(bins.bounds(axis, bin));
+                            n += counts[bin];
+                            sideArea = right.area();
+                        }
+                        rightArea[bin] = sideArea;
+                        rightCount[bin] = n;
+                        if (spatial) rightBounds[bin] = right;
+                    }
+
+                    Aabb left;
+                    sideArea = 0.0f;
+                    n = 0;
+                    for (int bin = 1; bin < Bvh::NUM_BINS; ++bin) {
+                        if (counts[bin - 1] > 0) {
+                            left.extend(bins.bounds(axis, bin - 1));
+                            n += counts[bin - 1];
+                            sideArea = left.area();
+                        }
+                        if (n == 0 || rightCount[bin] == 0) continue;
+
+                        const float cost = TRAVERSAL_COST +
+                            (sideArea * float(n) + rightArea[bin] * float(rightCount[bin])) / area;
+                        if (cost < bestCost) {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestBin = bin;
+                            if (spatial) {
+                                bestLeft = left;
+                                bestRight = rightBounds[bin];
+                            }
+                        }
+                    }
+                }
+
+                // Split references that straddle the children of the object split, while entries are free
+                Aabb overlap = bestLeft;
+                overlap.min = glm::max(overlap.min, bestRight.min);
+                overlap.max = glm::min(overlap.max, bestRight.max);
+                uint32_t middle = begin, rightBegin = end, rightEnd = end;
+                const bool spatialSplit = spatial && sah && capacity > end &&
+                    (bestAxis < 0 || overlap.area() > minOverlap) &&
+                    splitSpatially(range.bounds, begin, end, capacity, bestCost, middle, rightBegin, rightEnd);
+
+                if (count <= Bvh::MAX_LEAF_SIZE && bestAxis < 0 && !spatialSplit) return;
+
+                if (spatialSplit) {
+                    // The references are in place already
+                } else if (bestAxis >= 0) {
+                    const float axisLo = lo[bestAxis];
+                    const float axisExtent = extent[bestAxis];
+                    Reference* split = std::partition(references.data() + begin, references.data() + end,
+                            [&](const Reference& reference) {
+                        const int bin = std::min(int((reference.box.center()[bestAxis] - axisLo) / axisExtent * Bvh::NUM_BINS),
+                            Bvh::NUM_BINS - 1);
+                        return bin < bestBin;
+                    });
+                    middle = uint32_t(split - references.data());
+                } else {
+                    // Too many primitives on the same centroid, halve the list
+                    middle = begin + count / 2;
+                }
+
+                // Free entries go to the children in proportion to their references
+                if (!spatialSplit) {
+                    const uint32_t leftFree = uint32_t(uint64_t(capacity - end) * (middle - begin) / count);
+                    if (leftFree > 0) {
+                        std::move_backward(references.data() + middle, references.data() + end,
+                            references.data() + end + leftFree);
+                    }
+                    rightBegin = middle + leftFree;
+                    rightEnd = end + leftFree;
+                }
+
+                // Large children are split by other threads into arenas of their own
+                if (count >= TASK_MIN_PRIMITIVES) {
+                    const size_t fork = task.forks.size();
+                    task.nodes[node].first = uint32_t(fork);
+                    task.nodes[node].count = FORK;
+                    task.forks.emplace_back(begin, middle, rightBegin, level + 1);
+                    task.forks.emplace_back(rightBegin, rightEnd, capacity, level + 1);
+                    pool.parallelFor(0, 2, 1, [&](size_t first, size_t last) {
+                        for (size_t child = first; child < last; ++child) run(task.forks[fork + child]);
+                    });
+                    return;
+                }
+
+                const uint32_t left = uint32_t(task.nodes.size());
+                task.nodes.push_back(Bvh::Node());
+                task.nodes.push_back(Bvh::Node());
+                task.nodes[node].first = left;
+                task.nodes[node].count = 0;
+
+                split(task, left, begin, middle, rightBegin, level + 1);
+                split(task, left + 1, rightBegin, rightEnd, capacity, level + 1);
+            }
+
+            /**
+             * Find the cheapest spatial split of a range and apply it if it
+             * beats the cost of the object split
+             * @param[in]  bounds     Bounds of the range
+             * @param[in]  begin      First entry of the range
+             * @param[in]  end        One past the last entry
+             * @param[in]  capacity   One past the last free entry
+             * @param[in]  objectCost Cost of the object split
+             * @param[out] middle     One past the left references, which start at begin
+             * @param[out] rightBegin First right reference
+             * @param[out] rightEnd   One past the last right reference
+             * @return true if the range was split
+             */
+            bool splitSpatially(const Aabb& bounds, uint32_t begin, uint32_t end, uint32_t capacity, float objectCost,
+                    uint32_t& middle, uint32_t& rightBegin, uint32_t& rightEnd) {
+                const float infinity = std::numeric_limits<float>::max();
+                const glm::vec3 lo = bounds.min;
+                const glm::vec3 width = (bounds.max - bounds.min) / float(Bvh::NUM_BINS);
+
+                const SpatialBins bins = reduce<SpatialBins>(begin, end,
+                        [&](uint32_t first, uint32_t last, SpatialBins& partial) {
+                    for (uint32_t i = first; i < last; ++i) {
+                        const Reference& reference = references[i];
+                        for (int axis = 0; axis < 3; ++axis) {
+                            if (!(width[axis] > 0.0f)) continue;
+
+                            const int firstBin = glm::clamp(int((reference.box.min[axis] - lo[axis]) / width[axis]),
+                                0, Bvh::NUM_BINS - 1);
+                            const int lastBin = glm::clamp(int((reference.box.max[axis] - lo[axis]) / width[axis]),
+                                firstBin, Bvh::NUM_BINS - 1);
+                            partial.entries[axis][firstBin]++;
+                            partial.exits[axis][lastBin]++;
+                            for (int bin = firstBin; bin <= lastBin; ++bin) {
+                                const float binLo = bin == 0 ? -infinity : lo[axis] + width[axis] * float(bin);
+                                const float binHi = bin == Bvh::NUM_BINS - 1 ? infinity : lo[axis] + width[axis] * float(bin + 1);
+                                partial.bounds[axis][bin].extend(firstBin == lastBin ? reference.box :
+                                    clipPrimitive(primitives[reference.index], shutter, reference.box, axis, binLo, binHi));
+                            }
+                        }
+                    }
+                });
+
+                const float area = std::max(bounds.area(), 1e-20f);
+                float bestCost = objectCost;
+                int bestAxis = -1, bestBin = 0;
+                uint32_t bestLeftCount = 0, bestRightCount = 0;
+                Aabb bestLeft, bestRight;
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (!(width[axis] > 0.0f)) continue;
+
+                    Aabb rightBounds[Bvh::NUM_BINS];
+                    uint32_t rightCount[Bvh::NUM_BINS];
+                    Aabb right;
+                    uint32_t n = 0;
+                    for (int bin = Bvh::NUM_BINS - 1; bin > 0; --bin) {
+                        right.extend(bins.bounds[axis][bin]);
+                        n += bins.exits[axis][bin];
+                        rightBounds[bin] = right;
+                        rightCount[bin] = n;
+                    }
+
+                    Aabb left;
+                    n = 0;
+                    for (int bin = 1; bin < Bvh::NUM_BINS; ++bin) {
+                        left.extend(bins.bounds[axis][bin - 1]);
+                        n += bins.entries[axis][bin - 1];
+                        if (n == 0 || rightCount[bin] == 0) continue;
+
+                        const float cost = TRAVERSAL_COST +
+                            (left.area() * float(n) + rightBounds[bin].area() * float(rightCount[bin])) / area;
+                        if (cost < bestCost) {
+                            bestCost = cost;
+                            bestAxis = axis;
+                            bestBin = bin;
+                            bestLeftCount = n;
+                            bestRightCount = rightCount[bin];
+                            bestLeft = left;
+                            bestRight = rightBounds[bin];
+                        }
+                    }
+                }
+
+                if (bestAxis < 0) return false;
+
+                // Straddling references are split in two, unless the whole
+                // reference on one side is cheaper or no entry is left
+                const float plane = lo[bestAxis] + width[bestAxis] * float(bestBin);
+                const float splitCost = bestLeft.area() * float(bestLeftCount) + bestRight.area() * float(bestRightCount);
+                uint32_t freeEntries = capacity - end;
+                std::vector<Reference> left, right;
+                for (uint32_t i = begin; i < end; ++i) {
+                    const Reference& reference = references[i];
+                    if (reference.box.max[bestAxis] <= plane) {
+                        left.push_back(reference);
+                    } else if (reference.box.min[bestAxis] >= plane) {
+                        right.push_back(reference);
+                    } else {
+                        const Primitive& primitive = primitives[reference.index];
+                        const Aabb leftPart = clipPrimitive(primitive, shutter, reference.box, bestAxis, -infinity, plane);
+                        const Aabb rightPart = clipPrimitive(primitive, shutter, reference.box, bestAxis, plane, infinity);
+                        if (leftPart.empty() || rightPart.empty()) {
+                            (leftPart.empty() ? right : left).push_back(reference);
+                            continue;
+                        }
+
+                        Aabb leftWhole = bestLeft, rightWhole = bestRight;
+                        leftWhole.extend(reference.box);
+                        rightWhole.extend(reference.box);
+                        const float leftCost = leftWhole.area() * float(bestLeftCount) +
+                            bestRight.area() * float(bestRightCount - 1);
+                        const float rightCost = bestLeft.area() * float(bestLeftCount - 1) +
+                            rightWhole.area() * float(bestRightCount);
+                        if (freeEntries == 0 || leftCost < splitCost || rightCost < splitCost) {
+                            (leftCost <= rightCost ? left : right).push_back(reference);
+                        } else {
+                            left.push_back({ leftPart, reference.index });
+                            right.push_back({ rightPart, reference.index });
+                            --freeEntries;
+                        }
+                    }
+                }
+
+                if (left.empty() || right.empty()) return false;
+
+                const uint32_t leftFree = uint32_t(uint64_t(freeEntries) * left.size() / (left.size() + right.size()));
+                middle = begin + uint32_t(left.size());
+                rightBegin = middle + leftFree;
+                rightEnd = rightBegin + uint32_t(right.size());
+                std::copy(left.begin(), left.end(), references.begin() + begin);
+                std::copy(right.begin(), right.end(), references.begin() + rightBegin);
+                return true;
+            }
+
+            std::vector<Reference>&         references; //!< Index list, tasks partition disjoint ranges
+            const std::vector<Primitive>&   primitives; //!< Primitives, clipped by the spatial splits
+            float                           shutter;    //!< Shutter time of the bounds
+            bool                            spatial;    //!< Try spatial splits?
+            float                           minOverlap; //!< Child overlap area that tries spatial splits
+            util::ThreadPool&               pool;       //!< Runs the forked tasks and large ranges
+        };
+    }
+
+    Bvh::Bvh()
+        : nodes()
+        , indices()
+        , unbounded()
+        , depth(0) {
+
+    }
+
+    Bvh Bvh::build(const std::vector<Primitive>& primitives, float shutter, float duplication) {
+        util::ThreadPool& pool = util::ThreadPool::instance();
+
+        Bvh bvh;
+        std::vector<Aabb> boxes(primitives.size());
+        std::vector<char> bounded(primitives.size());
+        pool.parallelFor(0, primitives.size(), POOL_CHUNK, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) bounded[i] = primitiveBounds(primitives[i], shutter, boxes[i]);
+        });
+
+        std::vector<Reference> references;
+        for (uint32_t i = 0; i < uint32_t(primitives.size()); ++i) {
+            if (bounded[i]) references.push_back({ boxes[i], i });
+            else bvh.unbounded.push_back(i);
+        }
+
+        if (!references.empty()) {
+            // Room for the references split in two, free entries are spread across the leaves
+            const uint32_t count = uint32_t(references.size());
+            const bool spatial = duplication > 0.0f;
+            references.resize(count + uint32_t(float(count) * std::max(duplication, 0.0f)));
+
+            Builder builder(references, primitives, shutter, spatial);
+            Task root(0, count, uint32_t(references.size()), 0);
+            builder.run(root);
+
+            std::vector<Placement> placements;
+            uint32_t size = 1;
+            Builder::place(root, 0, size, placements);
+            bvh.nodes.resize(size);
+            builder.flatten(placements, bvh.nodes);
+
+            for (const Placement& placement : placements)
+                bvh.depth = std::max(bvh.depth, placement.task->depth);
+
+            if (spatial) {
+                // Gather the leaves, leaving the free entries out
+                for (Node& node : bvh.nodes) {
+                    if (node.count == 0) continue;
+                    const uint32_t first = uint32_t(bvh.indices.size());
+                    for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                        bvh.indices.push_back(references[i].index);
+                    node.first = first;
+                }
+            } else {
+                bvh.indices.resize(references.size());
+                pool.parallelFor(0, references.size(), POOL_CHUNK, [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) bvh.indices[i] = references[i].index;
+                });
+            }
+        }
+
+        return bvh;
+    }
+
+    const std::vector<Bvh::Node>& Bvh::getNodes() const {
+        return nodes;
+    }
+
+    const std::vector<uint32_t>& Bvh::getIndices() const {
+        return indices;
+    }
+
+    const std::vector<uint32_t>& Bvh::getUnbounded() const {
+        return unbounded;
+    }
+
+    uint32_t Bvh::getDepth() const {
+        return depth;
+    }
+
+    float Bvh::getCost() const {
+        if (nodes.empty()) return 0.0f;
+
+        float cost = 0.0f;
+        for (const Node& node : nodes)
+            cost += node.bounds.area() * (node.count > 0 ? float(node.count) : TRAVERSAL_COST);
+        return cost / std::max(nodes[0].bounds.area(), 1e-20f);
+    }
+
+    Bvh::Statistics Bvh::getStatistics() const {
+        Statistics statistics;
+        statistics.cost = getCost();
+        if (nodes.empty()) return statistics;
+
+        // Walk down from the root, keeping the level of every node
+        std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+        while (!stack.empty()) {
+            const uint32_t index = stack.back().first;
+            const uint32_t level = stack.back().second;
+            stack.pop_back();
+
+            const Node& node = nodes[index];
+            if (node.count == 0) {
+                statistics.innerNodes++;
+                stack.push_back({ node.first, level + 1 });
+                stack.push_back({ node.first + 1, level + 1 });
+                continue;
+            }
+
+            statistics.leaves++;
+            statistics.references += node.count;
+            if (statistics.leafSizes.size() <= node.count) statistics.leafSizes.resize(node.count + 1);
+            if (statistics.leafDepths.size() <= level) statistics.leafDepths.resize(level + 1);
+            statistics.leafSizes[node.count]++;
+            statistics.leafDepths[level]++;
+        }
+
+        return statistics;
+    }
+
+    /** Write the rows of a histogram with a bar scaled to the largest one */
+    static void histogram(std::ostream& out, const std::vector<uint32_t>& counts) {
+        const uint32_t largest = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (counts[i] == 0) continue;
+            const size_t bar = size_t(std::ceil(40.0 * counts[i] / largest));
+            out << std::setw(6) << i << std::setw(10) << counts[i] << "  " << std::string(bar, '#') << '\n';
+        }
+    }
+
+    void Bvh::report(std::ostream& out) const {
+        const Statistics statistics = getStatistics();
+        out << nodes.size() << " nodes (" << statistics.innerNodes << " inner, " << statistics.leaves << " leaves), "
+            << statistics.references << " references, " << unbounded.size() << " unbounded, depth " << depth
+            << ", SAH cost " << statistics.cost << '\n';
+        if (statistics.leaves == 0) return;
+
+        out << "  leaf size    leaves, mean " << float(statistics.references) / float(statistics.leaves) << '\n';
+        histogram(out, statistics.leafSizes);
+        out << "  leaf depth   leaves\n";
+        histogram(out, statistics.leafDepths);
+    }
+}
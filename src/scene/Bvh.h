@@ -0,0 +1,128 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_BVH_H_
+#define PATHTRACER_BVH_H_
+
+#include <iosfwd>
+#include <vector>
+#include <cstdint>
+
+#include "Aabb.h"
+#include "Primitive.h"
+
+namespace scene {
+
+    /**
+     * Binary bounding volume hierarchy over the bounded primitives of a
+     * scene, split with the surface area heuristic evaluated on bins of
+     * the primitive centroids. Unbounded primitives are kept in a list of
+     * their own, rays always test them.
+     *
+     * The build runs on util::ThreadPool: large ranges are bounded and
+     * binned by the whole pool, and the children of large nodes are split
+     * by tasks of their own, each into a node arena. The arenas are
+     * flattened into a single node list at the end. Every thread count
+     * builds the same tree.
+     *
+     * With a duplication budget the build also tries spatial splits (Stich
+     * et al. 2009): where the children of the best object split overlap,
+     * the node may be split by a plane instead, and the primitives across
+     * it are referenced by both children with their clipped bounds. The
+     * budget bounds the extra references, so a leaf may list a primitive
+     * that other leaves list too.
+     */
+    class Bvh {
+    public:
+
+        /** Node of the tree, the root is the first one */
+        struct Node {
+            Aabb        bounds;     //!< Bounds of every primitive below
+            uint32_t    first;      //!< Leaf: first entry of the index list, inner: left child
+            uint32_t    count;      //!< Leaf: number of primitives, inner: 0. The right child follows the left one.
+        };
+
+        /** Shape of the tree, to tune scenes and builds */
+        struct Statistics {
+            float                   cost = 0.0f;    //!< Surface area heuristic cost, see getCost()
+            uint32_t                innerNodes = 0; //!< Nodes with children
+            uint32_t                leaves = 0;     //!< Nodes with primitives
+            uint32_t                references = 0; //!< Primitive references of the leaves
+            std::vector<uint32_t>   leafSizes;      //!< Number of leaves of every primitive count
+            std::vector<uint32_t>   leafDepths;     //!< Number of leaves on every level, the root is on 0
+        };
+
+        /** Largest number of primitives of a leaf */
+        static constexpr uint32_t MAX_LEAF_SIZE = 8;
+
+        /** Largest number of levels, must match Bvh.glsl */
+        static constexpr uint32_t MAX_DEPTH = 64;
+
+        /** Deeper nodes halve their primitives instead of following the heuristic, bounding the depth */
+        static constexpr uint32_t MAX_SAH_LEVEL = 40;
+
+        /** Centroid bins of the surface area heuristic along each axis */
+        static constexpr int NUM_BINS = 16;
+
+        /** Default constructor, an empty tree */
+        Bvh();
+
+        /**
+         * Build the tree of some primitives
+         * @param[in] primitives  Primitives of the scene
+         * @param[in] shutter     Shutter time, moving primitives are bounded over all of it
+         * @param[in] duplication Extra references of the spatial splits, relative to the
+         *                        bounded primitives. 0 builds with object splits only.
+         * @return The tree, its indices refer to primitives
+         */
+        static Bvh build(const std::vector<Primitive>& primitives, float shutter, float duplication = 0.0f);
+
+        /** Get the nodes, the root first. An empty tree has no nodes. */
+        const std::vector<Node>& getNodes() const;
+
+        /** Get the primitive indices of the leaves, a primitive may be listed more than once after spatial splits */
+        const std::vector<uint32_t>& getIndices() const;
+
+        /** Get the indices of the unbounded primitives */
+        const std::vector<uint32_t>& getUnbounded() const;
+
+        /** Get the number of levels, 0 for an empty tree */
+        uint32_t getDepth() const;
+
+        /** Get the surface area heuristic cost of the tree, relative to the root area */
+        float getCost() const;
+
+        /** Get the shape of the tree */
+        Statistics getStatistics() const;
+
+        /**
+         * Write the statistics as text: the sizes and cost, then the leaf
+         * size histogram and the leaf depth distribution
+         * @param[out] out Output stream
+         */
+        void report(std::ostream& out) const;
+
+    private:
+
+        std::vector<Node>       nodes;      //!< Tree nodes, the root first
+        std::vector<uint32_t>   indices;    //!< Primitives of the leaves
+        std::vector<uint32_t>   unbounded;  //!< Primitives out of the tree
+        uint32_t                depth;      //!< Number of levels
+    };
+}
+
+#endif //PATHTRACER_BVH_H_
@@ -0,0 +1,61 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "Material.h"
+
+namespace scene {
+
+    uint32_t materialTypes(const std::vector<Material>& materials) {
+        uint32_t types = 0;
+        for (const Material& material : materials)
+            types |= 1u << material.type;
+        return types;
+    }
+
+    bool usesMedia(const std::vector<Material>& materials, size_t numMedia) {
+        for (const Material& material : materials) {
+            if (material.type == Material::DIELECTRIC && material.medium >= 0 &&
+                    size_t(material.medium) < numMedia)
+                return true;
+        }
+        return false;
+    }
+
+    /** Helper to build materials in one line */
+    static Material makeMaterial(Material::Type type, float fuzz, float refIdx, const glm::vec3& albedo) {
+        Material material;
+        material.type   = type;
+        material.fuzz   = fuzz;
+        material.refIdx = refIdx;
+        material.albedo = albedo;
+        return material;
+    }
+
+    std::vector<Material> defaultMaterials() {
+        return {
+            makeMaterial(Material::LAMBERT,     0.0f, 0.0f, glm::vec3(0.1f, 0.1f, 1.0f)),
+            makeMaterial(Material::METAL,       0.5f, 0.0f, glm::vec3(0.7f, 0.7f, 0.7f)),
+            makeMaterial(Material::METAL,       0.0f, 0.0f, glm::vec3(1.0f, 1.0f, 1.0f)),
+            makeMaterial(Material::DIELECTRIC,  0.9f, 1.5f, glm::vec3(1.0f, 1.0f, 1.0f)),
+            makeMaterial(Material::METAL,       0.5f, 0.0f, glm::vec3(0.1f, 1.0f, 0.1f)),
+            makeMaterial(Material::METAL,       0.0f, 0.5f, glm::vec3(1.0f, 0.3f, 0.3f)),
+            makeMaterial(Material::METAL,       9.0f, 0.5f, glm::vec3(1.0f, 0.3f, 0.3f)),
+            makeMaterial(Material::LAMBERT,     9.0f, 0.5f, glm::vec3(0.8f, 0.3f, 0.8f)),
+            makeMaterial(Material::LAMBERT,     9.0f, 0.5f, glm::vec3(0.35f, 0.9f, 0.35f))
+        };
+    }
+}
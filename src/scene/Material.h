@@ -0,0 +1,65 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_MATERIAL_H_
+#define PATHTRACER_MATERIAL_H_
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace scene {
+
+    /** Surface material, spheres reference materials by index */
+    struct Material {
+
+        /** Scattering model, values must match Material.glsl */
+        enum Type : uint32_t {
+            LAMBERT     = 0,
+            METAL       = 1,
+            DIELECTRIC  = 2,
+            NUM_TYPES   = 3
+        };
+
+        Type        type        = LAMBERT;      //!< Scattering model
+        glm::vec3   albedo      = glm::vec3(1.0f);  //!< Surface color
+        float       fuzz        = 0.0f;         //!< Metal reflection roughness
+        float       refIdx      = 1.5f;         //!< Dielectric refraction index
+        bool        emissive    = false;        //!< Light source?
+        int         medium      = -1;           //!< Medium inside a dielectric, index of the media list or -1
+    };
+
+    /**
+     * Get the bit mask of the types used by some materials
+     * @param[in] materials Material list
+     * @return One bit per Material::Type
+     */
+    uint32_t materialTypes(const std::vector<Material>& materials);
+
+    /**
+     * Check if some dielectric material is filled with a medium
+     * @param[in] materials Material list
+     * @param[in] numMedia  Size of the media list, other indices are ignored
+     */
+    bool usesMedia(const std::vector<Material>& materials, size_t numMedia);
+
+    /** Get the material list of the default scene */
+    std::vector<Material> defaultMaterials();
+}
+
+#endif //PATHTRACER_MATERIAL_H_
@@ -0,0 +1,37 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "Medium.h"
+
+namespace scene {
+
+    std::vector<Medium> defaultMedia() {
+        Medium fog;
+        fog.scattering      = glm::vec3(0.4f);
+        fog.absorption      = glm::vec3(0.02f);
+        fog.anisotropy      = 0.2f;
+
+        Medium smoke;
+        smoke.scattering    = glm::vec3(8.0f);
+        smoke.absorption    = glm::vec3(0.5f);
+        smoke.anisotropy    = 0.4f;
+        smoke.heterogeneous = true;
+
+        return { fog, smoke };
+    }
+}
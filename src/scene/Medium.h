@@ -0,0 +1,43 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_MEDIUM_H_
+#define PATHTRACER_MEDIUM_H_
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace scene {
+
+    /**
+     * Participating medium filling the inside of a dielectric sphere.
+     * Coefficients are per unit of distance, heterogeneous media scale them
+     * by the density grid stretched over the bounding box of the sphere.
+     */
+    struct Medium {
+        glm::vec3   scattering      = glm::vec3(1.0f);  //!< Scattering coefficient
+        glm::vec3   absorption      = glm::vec3(0.0f);  //!< Absorption coefficient
+        float       anisotropy      = 0.0f;             //!< Henyey-Greenstein g, in (-1, 1)
+        bool        heterogeneous   = false;            //!< Scaled by the density grid?
+    };
+
+    /** Get the media of the default scene: fog and smoke */
+    std::vector<Medium> defaultMedia();
+}
+
+#endif //PATHTRACER_MEDIUM_H_
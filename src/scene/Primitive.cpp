@@ -0,0 +1,280 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <algorithm>
+
+#include "Primitive.h"
+
+namespace scene {
+
+    Primitive makeSphere(uint32_t material, const glm::vec3& center, float radius, const glm::vec3& velocity) {
+        Primitive primitive;
+        primitive.type      = Primitive::SPHERE;
+        primitive.material  = material;
+        primitive.center    = center;
+        primitive.velocity  = velocity;
+        primitive.radius    = radius;
+        return primitive;
+    }
+
+    Primitive makeBox(uint32_t material, const glm::vec3& center, const glm::vec3& halfExtents) {
+        Primitive primitive;
+        primitive.type          = Primitive::BOX;
+        primitive.material      = material;
+        primitive.center        = center;
+        primitive.halfExtents   = halfExtents;
+        return primitive;
+    }
+
+    Primitive makePlane(uint32_t material, const glm::vec3& point, const glm::vec3& normal) {
+        Primitive primitive;
+        primitive.type      = Primitive::PLANE;
+        primitive.material  = material;
+        primitive.center    = point;
+        primitive.axis      = glm::normalize(normal);
+        return primitive;
+    }
+
+    Primitive makeCylinder(uint32_t material, const glm::vec3& center, const glm::vec3& axis,
+            float radius, float halfHeight) {
+        Primitive primitive;
+        primitive.type          = Primitive::CYLINDER;
+        primitive.material      = material;
+        primitive.center        = center;
+        primitive.axis          = glm::normalize(axis);
+        primitive.radius        = radius;
+        primitive.halfHeight    = halfHeight;
+        return primitive;
+    }
+
+    Primitive makeTorus(uint32_t material, const glm::vec3& center, const glm::vec3& axis,
+            float majorRadius, float minorRadius) {
+        Primitive primitive;
+        primitive.type          = Primitive::TORUS;
+        primitive.material      = material;
+        primitive.center        = center;
+        primitive.axis          = glm::normalize(axis);
+        primitive.radius        = majorRadius;
+        primitive.minorRadius   = minorRadius;
+        return primitive;
+    }
+
+    Primitive makeSdf(uint32_t material, Primitive::Function function, const glm::vec3& center,
+            const glm::vec3& halfExtents, const glm::vec2& params) {
+        Primitive primitive;
+        primitive.type          = Primitive::SDF;
+        primitive.material      = material;
+        primitive.function      = function;
+        primitive.center        = center;
+        primitive.halfExtents   = halfExtents;
+        primitive.params        = params;
+        return primitive;
+    }
+
+    Primitive makeVoxels(const glm::vec3& center, const glm::vec3& halfExtents) {
+        Primitive primitive;
+        primitive.type          = Primitive::VOXELS;
+        primitive.center        = center;
+        primitive.halfExtents   = halfExtents;
+        return primitive;
+    }
+
+    bool primitiveBounds(const Primitive& primitive, float shutter, Aabb& bounds) {
+        // Extent of a disk of unit radius around each axis
+        const glm::vec3 disk = glm::sqrt(glm::max(1.0f - primitive.axis * primitive.axis, 0.0f));
+
+        glm::vec3 extent;
+        switch (primitive.type) {
+            case Primitive::SPHERE:
+                extent = glm::vec3(primitive.radius);
+                break;
+            case Primitive::CYLINDER:
+                extent = primitive.halfHeight * glm::abs(primitive.axis) + primitive.radius * disk;
+                break;
+            case Primitive::TORUS:
+                extent = primitive.radius * disk + primitive.minorRadius;
+                break;
+            case Primitive::PLANE:
+                return false;
+            default:
+                extent = primitive.halfExtents;
+                break;
+        }
+
+        const glm::vec3 end = primitive.center + primitive.velocity * shutter;
+        bounds = Aabb();
+        bounds.extend(primitive.center - extent);
+        bounds.extend(primitive.center + extent);
+        bounds.extend(end - extent);
+        bounds.extend(end + extent);
+        return true;
+    }
+
+    Aabb clipPrimitive(const Primitive& primitive, float shutter, const Aabb& box, int axis, float lo, float hi) {
+        Aabb clipped = box;
+        clipped.min[axis] = std::max(clipped.min[axis], lo);
+        clipped.max[axis] = std::min(clipped.max[axis], hi);
+        if (clipped.empty()) return clipped;
+
+        const bool resting = shutter == 0.0f || primitive.velocity == glm::vec3(0.0f);
+        if (primitive.type == Primitive::SPHERE && resting) {
+            // Radius of the section nearest to the center, padded against rounding
+            const float c = primitive.center[axis];
+            const float distance = std::max(std::max(clipped.min[axis] - c, c - clipped.max[axis]), 0.0f);
+            const float r = primitive.radius;
+            const float section = std::min(std::sqrt(std::max(r * r - distance * distance, 0.0f)) + 1e-4f * r, r);
+            for (int other = 0; other < 3; ++other) {
+                if (other == axis) continue;
+                clipped.min[other] = std::max(clipped.min[other], primitive.center[other] - section);
+                clipped.max[other] = std::min(clipped.max[other], primitive.center[other] + section);
+            }
+        } else if (primitive.type == Primitive::CYLINDER && resting && primitive.axis[axis] != 0.0f) {
+            // Stretch of the axis whose disks reach the slab, padded against rounding
+            const glm::vec3 disk = primitive.radius * glm::sqrt(glm::max(1.0f - primitive.axis * primitive.axis, 0.0f));
+            const float pad = 1e-4f * (primitive.radius + primitive.halfHeight);
+            const float t0 = (clipped.min[axis] - disk[axis] - pad - primitive.center[axis]) / primitive.axis[axis];
+            const float t1 = (clipped.max[axis] + disk[axis] + pad - primitive.center[axis]) / primitive.axis[axis];
+            const float from = glm::clamp(std::min(t0, t1), -primitive.halfHeight, primitive.halfHeight);
+            const float to = glm::clamp(std::max(t0, t1), -primitive.halfHeight, primitive.halfHeight);
+            const glm::vec3 a = primitive.center + from * primitive.axis;
+            const glm::vec3 b = primitive.center + to * primitive.axis;
+            const glm::vec3 extent = disk + pad;
+            for (int other = 0; other < 3; ++other) {
+                if (other == axis) continue;
+                clipped.min[other] = std::max(clipped.min[other], std::min(a[other], b[other]) - extent[other]);
+                clipped.max[other] = std::min(clipped.max[other], std::max(a[other], b[other]) + extent[other]);
+            }
+        }
+        return clipped;
+    }
+
+    uint32_t primitiveTypes(const std::vector<Primitive>& primitives) {
+        uint32_t types = 0;
+        for (const Primitive& primitive : primitives)
+            types |= 1u << primitive.type;
+        return types;
+    }
+
+    std::vector<Primitive> defaultPrimitives() {
+        return {
+            makeSphere(0, glm::vec3(0.0f, 1.0f, 0.0f), 1.0f),
+            makeSphere(1, glm::vec3(0.0f, -30.0f, 0.0f), 30.0f),
+            makeSphere(2, glm::vec3(2.98f, 0.86f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f)),
+            makeSphere(3, glm::vec3(-2.98f, 0.86f, 0.0f), 1.0f),
+            makeSphere(4, glm::vec3(0.0f, 0.86f, -2.98f), 1.0f),
+            makeSphere(5, glm::vec3(0.0f, 0.86f, 2.98f), 1.0f),
+            makeSphere(7, glm::vec3(0.0f, 5.0f, 0.0f), 2.0f)
+        };
+    }
+
+    /** Benchmark scene: the default ground and an 8x8 grid of one type */
+    static std::vector<Primitive> gridScene(Primitive::Type type) {
+        const uint32_t numMaterials = 9;    // Size of defaultMaterials()
+        const int side = 8;
+
+        std::vector<Primitive> primitives = { makeSphere(1, glm::vec3(0.0f, -30.0f, 0.0f), 30.0f) };
+        for (int z = 0; z < side; ++z) {
+            for (int x = 0; x < side; ++x) {
+                const int i = z * side + x;
+                const uint32_t material = uint32_t(i) % numMaterials;
+                const glm::vec3 center(x - 0.5f * (side - 1), 0.4f, z - 0.5f * (side - 1));
+                const glm::vec3 tilt = glm::normalize(glm::vec3(std::sin(float(i)), 2.0f, std::cos(float(i))));
+
+                switch (type) {
+                    case Primitive::SPHERE:
+                        primitives.push_back(makeSphere(material, center, 0.35f));
+                        break;
+                    case Primitive::BOX:
+                        primitives.push_back(makeBox(material, center, glm::vec3(0.3f)));
+                        break;
+                    case Primitive::PLANE:
+                        // Slightly tilted layers of a faceted floor, all of them cross every view
+                        primitives.push_back(makePlane(material, glm::vec3(0.0f, -0.02f * i, 0.0f),
+                            glm::vec3(tilt.x, 16.0f, tilt.z)));
+                        break;
+                    case Primitive::CYLINDER:
+                        primitives.push_back(makeCylinder(material, center, tilt, 0.25f, 0.3f));
+                        break;
+                    case Primitive::TORUS:
+                        primitives.push_back(makeTorus(material, center, tilt, 0.3f, 0.1f));
+                        break;
+                    case Primitive::SDF: {
+                        const Primitive::Function function = Primitive::Function(i % 3);
+                        const glm::vec2 params(function == Primitive::MENGER ? 3.0f : 0.1f, 0.0f);
+                        primitives.push_back(makeSdf(material, function, center, glm::vec3(0.35f), params));
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+        }
+
+        return primitives;
+    }
+
+    /** Benchmark scene of the acceleration structure: a field of 4096 spheres of varied size */
+    static std::vector<Primitive> fieldScene() {
+        const uint32_t numMaterials = 9;    // Size of defaultMaterials()
+        const int side = 64;
+
+        std::vector<Primitive> primitives = { makeSphere(1, glm::vec3(0.0f, -30.0f, 0.0f), 30.0f) };
+        for (int z = 0; z < side; ++z) {
+            for (int x = 0; x < side; ++x) {
+                // Integer hash, the same field on every platform
+                uint32_t h = uint32_t(z * side + x) * 2654435761u;
+                h ^= h >> 15;
+                h *= 2246822519u;
+                h ^= h >> 13;
+
+                // Resting on the ground sphere
+                const float radius = 0.04f + 0.08f * float(h & 0xFF) / 255.0f;
+                const glm::vec2 position = 0.25f * (glm::vec2(x, z) - 0.5f * float(side - 1));
+                const float ground = std::sqrt(900.0f - glm::dot(position, position)) - 30.0f;
+                const glm::vec3 center(position.x, ground + radius, position.y);
+                if (((h >> 8) & 0xF) == 7u) continue;   // Leave some gaps
+                primitives.push_back(makeSphere((h >> 12) % numMaterials, center, radius));
+            }
+        }
+
+        return primitives;
+    }
+
+    const std::vector<std::string>& sceneNames() {
+        static const std::vector<std::string> names = {
+            "default", "spheres", "boxes", "planes", "cylinders", "tori", "sdf", "voxels", "field"
+        };
+        return names;
+    }
+
+    std::vector<Primitive> namedScene(const std::string& name) {
+        if (name == "default")      return defaultPrimitives();
+        if (name == "spheres")      return gridScene(Primitive::SPHERE);
+        if (name == "boxes")        return gridScene(Primitive::BOX);
+        if (name == "planes")       return gridScene(Primitive::PLANE);
+        if (name == "cylinders")    return gridScene(Primitive::CYLINDER);
+        if (name == "tori")         return gridScene(Primitive::TORUS);
+        if (name == "sdf")          return gridScene(Primitive::SDF);
+        if (name == "voxels")       return {
+            makeSphere(1, glm::vec3(0.0f, -30.0f, 0.0f), 30.0f),
+            makeVoxels(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(2.0f))
+        };
+        if (name == "field")        return fieldScene();
+        return {};
+    }
+}
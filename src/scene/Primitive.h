@@ -0,0 +1,146 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_PRIMITIVE_H_
+#define PATHTRACER_PRIMITIVE_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Aabb.h"
+
+namespace scene {
+
+    /**
+     * Shape of the scene. Every type moves with its velocity during the
+     * shutter interval, the meaning of the other fields depends on the type.
+     */
+    struct Primitive {
+
+        /** Shape, values must match Primitive.glsl */
+        enum Type : uint32_t {
+            SPHERE      = 0,    //!< center, radius
+            BOX         = 1,    //!< Axis aligned, center, halfExtents
+            PLANE       = 2,    //!< Infinite, center is a point on it, axis its normal
+            CYLINDER    = 3,    //!< Capped, center, axis, radius, halfHeight
+            TORUS       = 4,    //!< center, axis, radius (major) and minorRadius
+            SDF         = 5,    //!< Function of Sdf.glsl ray marched inside center +- halfExtents
+            VOXELS      = 6,    //!< Voxel model stretched over center +- halfExtents, voxels have their own materials
+            NUM_TYPES   = 7
+        };
+
+        /** Signed distance functions, values must match Sdf.glsl */
+        enum Function : uint32_t {
+            ROUND_BOX   = 0,    //!< Box of halfExtents with rounded edges of radius params.x
+            BLOBS       = 1,    //!< Three spheres blended over params.x
+            MENGER      = 2     //!< Menger sponge of params.x levels filling the bounds
+        };
+
+        Type        type        = SPHERE;           //!< Shape
+        uint32_t    material    = 0;                //!< Index of the material table
+        glm::vec3   center      = glm::vec3(0.0f);  //!< Center when the shutter opens
+        glm::vec3   velocity    = glm::vec3(0.0f);  //!< Center displacement per unit of shutter time
+        glm::vec3   axis        = glm::vec3(0.0f, 1.0f, 0.0f);  //!< Unit plane normal, cylinder and torus axis
+        glm::vec3   halfExtents = glm::vec3(1.0f);  //!< Box size, bounds of a signed distance function or voxels
+        float       radius      = 1.0f;             //!< Sphere and cylinder radius, torus major radius
+        float       halfHeight  = 1.0f;             //!< Cylinder half height
+        float       minorRadius = 0.25f;            //!< Torus tube radius
+        Function    function    = ROUND_BOX;        //!< Signed distance function
+        glm::vec2   params      = glm::vec2(0.0f);  //!< Signed distance function parameters
+    };
+
+    /** Build a sphere */
+    Primitive makeSphere(uint32_t material, const glm::vec3& center, float radius,
+        const glm::vec3& velocity = glm::vec3(0.0f));
+
+    /** Build an axis aligned box */
+    Primitive makeBox(uint32_t material, const glm::vec3& center, const glm::vec3& halfExtents);
+
+    /** Build an infinite plane through point */
+    Primitive makePlane(uint32_t material, const glm::vec3& point, const glm::vec3& normal);
+
+    /** Build a capped cylinder */
+    Primitive makeCylinder(uint32_t material, const glm::vec3& center, const glm::vec3& axis,
+        float radius, float halfHeight);
+
+    /** Build a torus around axis */
+    Primitive makeTorus(uint32_t material, const glm::vec3& center, const glm::vec3& axis,
+        float majorRadius, float minorRadius);
+
+    /** Build a signed distance function object bounded by center +- halfExtents */
+    Primitive makeSdf(uint32_t material, Primitive::Function function, const glm::vec3& center,
+        const glm::vec3& halfExtents, const glm::vec2& params = glm::vec2(0.0f));
+
+    /** Build an instance of the voxel model bounded by center +- halfExtents */
+    Primitive makeVoxels(const glm::vec3& center, const glm::vec3& halfExtents);
+
+    /**
+     * Get the bounds of a primitive over the shutter interval
+     * @param[in]  primitive Primitive
+     * @param[in]  shutter   Shutter time, the primitive sweeps velocity * shutter
+     * @param[out] bounds    Bounds, unchanged for unbounded primitives
+     * @return false if the primitive is unbounded (planes)
+     */
+    bool primitiveBounds(const Primitive& primitive, float shutter, Aabb& bounds);
+
+    /**
+     * Get the bounds of the part of a primitive inside a slab of a box,
+     * for the spatial splits of the hierarchy. Resting spheres are bounded
+     * by their widest section in the slab, resting cylinders by the stretch of
+     * their axis in the slab, other primitives by the clipped box.
+     * @param[in] primitive Primitive
+     * @param[in] shutter   Shutter time, the primitive sweeps velocity * shutter
+     * @param[in] box       Bounds of the primitive part to clip
+     * @param[in] axis      Axis of the slab
+     * @param[in] lo        Lower side of the slab
+     * @param[in] hi        Upper side of the slab
+     * @return The clipped bounds, empty if the part misses the slab
+     */
+    Aabb clipPrimitive(const Primitive& primitive, float shutter, const Aabb& box, int axis, float lo, float hi);
+
+    /**
+     * Get the bit mask of the types used by some primitives
+     * @param[in] primitives Primitive list
+     * @return One bit per Primitive::Type
+     */
+    uint32_t primitiveTypes(const std::vector<Primitive>& primitives);
+
+    /** Get the primitive list of the default scene */
+    std::vector<Primitive> defaultPrimitives();
+
+    /**
+     * Get the names of the built-in scenes: "default", and a benchmark scene
+     * per primitive type with 64 primitives of that type over the ground of
+     * the default scene: "spheres", "boxes", "planes", "cylinders", "tori"
+     * and "sdf". "voxels" places the voxel model over the same ground and
+     * "field" scatters about 4000 small spheres over it, to benchmark the
+     * acceleration structure.
+     */
+    const std::vector<std::string>& sceneNames();
+
+    /**
+     * Get the primitives of a built-in scene
+     * @param[in] name One of sceneNames()
+     * @return Primitive list, empty for an unknown name
+     */
+    std::vector<Primitive> namedScene(const std::string& name);
+}
+
+#endif //PATHTRACER_PRIMITIVE_H_
@@ -0,0 +1,58 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "ThinLensCamera.h"
+
+namespace scene {
+
+    ThinLensCamera::ThinLensCamera(float focusDistance)
+        : OrbitCamera()
+        , _aperture(0.0f)
+        , _focusDistance(focusDistance)
+        , _shutter(0.0f)
+    {
+
+    }
+
+    void ThinLensCamera::setAperture(float diameter) {
+        _aperture = glm::max(diameter, 0.0f);
+    }
+
+    float ThinLensCamera::getAperture() const {
+        return _aperture;
+    }
+
+    bool ThinLensCamera::isPinhole() const {
+        return _aperture == 0.0f;
+    }
+
+    void ThinLensCamera::setFocusDistance(float distance) {
+        _focusDistance = glm::max(distance, 0.0f);
+    }
+
+    float ThinLensCamera::getFocusDistance() const {
+        return _focusDistance;
+    }
+
+    void ThinLensCamera::setShutter(float time) {
+        _shutter = glm::max(time, 0.0f);
+    }
+
+    float ThinLensCamera::getShutter() const {
+        return _shutter;
+    }
+}
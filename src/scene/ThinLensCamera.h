@@ -0,0 +1,77 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_THINLENSCAMERA_H_
+#define PATHTRACER_THINLENSCAMERA_H_
+
+#include "OrbitCamera.h"
+
+namespace scene {
+
+    /**
+     * Orbit camera with a thin lens and a shutter. An aperture of 0 is a
+     * pinhole camera, everything in focus. A shutter time of 0 freezes
+     * moving objects.
+     */
+    class ThinLensCamera : public OrbitCamera {
+    public:
+
+        /**
+         * Construct a pinhole camera with the shutter closed
+         * @param[in] focusDistance Distance from eye to the plane in focus
+         */
+        ThinLensCamera(float focusDistance = 5.0f);
+
+        /**
+         * Set lens aperture
+         * @param[in] diameter Lens diameter in scene units, 0 for a pinhole
+         */
+        void setAperture(float diameter);
+
+        /** Get lens diameter */
+        float getAperture() const;
+
+        /** Is it a pinhole camera? */
+        bool isPinhole() const;
+
+        /**
+         * Set distance to the plane in focus
+         * @param[in] distance Distance along the view direction
+         */
+        void setFocusDistance(float distance);
+
+        /** Get distance to the plane in focus */
+        float getFocusDistance() const;
+
+        /**
+         * Set shutter interval, the shutter opens at time 0
+         * @param[in] time Time the shutter stays open, 0 freezes motion
+         */
+        void setShutter(float time);
+
+        /** Get time the shutter stays open */
+        float getShutter() const;
+
+    private:
+
+        float _aperture;        //!< Lens diameter
+        float _focusDistance;   //!< Distance to the plane in focus
+        float _shutter;         //!< Time the shutter stays open
+    };
+}
+
+#endif //PATHTRACER_THINLENSCAMERA_H_
@@ -0,0 +1,74 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_UTIL_HASH_H_
+#define PATHTRACER_UTIL_HASH_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace util {
+
+    /**
+     * Incremental 64 bit FNV-1a hash. Not cryptographic, only meant to detect
+     * whether persisted data (checkpoints, caches...) still matches its inputs.
+     * @see http://www.isthe.com/chongo/tech/comp/fnv/
+     */
+    class Hash {
+    public:
+
+        /** Start with the FNV offset basis */
+        Hash() : value(0xcbf29ce484222325ull) {  }
+
+        /**
+         * Add raw bytes to the hash
+         * @param[in] data  Pointer to the bytes
+         * @param[in] size  Number of bytes
+         */
+        Hash& add(const void* data, size_t size) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                value ^= bytes[i];
+                value *= 0x100000001b3ull;
+            }
+            return *this;
+        }
+
+        /** Add a string, including its length so concatenations don't collide */
+        Hash& add(const std::string& str) {
+            uint64_t size = str.size();
+            add(&size, sizeof(size));
+            return add(str.data(), str.size());
+        }
+
+        /** Add a trivially copyable value */
+        template <typename T>
+        Hash& addValue(const T& v) {
+            return add(&v, sizeof(T));
+        }
+
+        /** Get the hash value */
+        uint64_t get() const { return value; }
+
+    private:
+
+        uint64_t value; //!< Current hash state
+    };
+}
+
+#endif //PATHTRACER_UTIL_HASH_H_
@@ -0,0 +1,39 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_UTIL_MEMORY_H_
+#define PATHTRACER_UTIL_MEMORY_H_
+
+#include <cstddef>
+
+namespace util {
+
+    /**
+     * Get the peak resident memory of the process
+     * @return Bytes, 0 if the platform doesn't report it
+     */
+    size_t peakMemory();
+
+    /**
+     * Restart peak memory tracking, so peakMemory() reports the peak since
+     * this call. Only Linux supports it, elsewhere the peak covers the whole
+     * process lifetime.
+     */
+    void resetPeakMemory();
+}
+
+#endif //PATHTRACER_UTIL_MEMORY_H_
@@ -0,0 +1,128 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace util {
+
+    ThreadPool::ThreadPool()
+        : workers()
+        , tasks()
+        , mutex()
+        , condition()
+        , stopping(false) {
+        size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (size_t i = 0; i < numThreads; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        condition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain,
+            const std::function<void(size_t, size_t)>& body) {
+        if (begin >= end) return;
+
+        grain = std::max<size_t>(grain, 1);
+        const size_t numChunks = (end - begin + grain - 1) / grain;
+
+        // Shared by the caller and helpers. Helpers may start after the
+        // caller has returned, so the state must outlive this call
+        struct State {
+            std::atomic<size_t>     next{0};    // Next chunk to be claimed
+            std::atomic<size_t>     done{0};    // Chunks already processed
+            std::atomic<bool>       failed{false};  // Did a chunk throw?
+            std::exception_ptr      error;      // First exception thrown, guarded by mutex
+            std::mutex              mutex;
+            std::condition_variable finished;
+        };
+        auto state = std::make_shared<State>();
+
+        // Claim and run chunks until there is nothing left. Exceptions are
+        // kept for the caller, the remaining chunks are skipped but still
+        // counted as done so the caller never waits for them.
+        auto work = [state, begin, end, grain, numChunks, &body]() {
+            size_t chunk;
+            while ((chunk = state->next.fetch_add(1)) < numChunks) {
+                if (!state->failed.load()) {
+                    try {
+                        size_t first = begin + chunk * grain;
+                        body(first, std::min(first + grain, end));
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if (!state->error) state->error = std::current_exception();
+                        state->failed = true;
+                    }
+                }
+
+                if (state->done.fetch_add(1) + 1 == numChunks) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        // Late helpers find no chunks left and return without touching body
+        size_t numHelpers = std::min(numChunks - 1, workers.size());
+        for (size_t i = 0; i < numHelpers; ++i)
+            submit(work);
+
+        // The caller works too, so nested calls from pool tasks can't deadlock
+        work();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&]() { return state->done.load() == numChunks; });
+
+        // Every chunk is done, no helper uses body anymore
+        if (state->error) std::rethrow_exception(state->error);
+    }
+
+    size_t ThreadPool::size() const {
+        return workers.size();
+    }
+
+    void ThreadPool::workerLoop() {
+        while (true) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if (stopping && tasks.empty()) return;
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+        }
+    }
+}
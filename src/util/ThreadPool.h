@@ -0,0 +1,109 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of Pathtracer.
+//
+//    Pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PATHTRACER_UTIL_THREADPOOL_H_
+#define PATHTRACER_UTIL_THREADPOOL_H_
+
+#include <vector>
+#include <queue>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+#include "Singleton.h"
+
+namespace util {
+
+    /**
+     * Fixed size pool of worker threads fed by a FIFO task queue.
+     * Used to move CPU heavy work (image encoding, table building...)
+     * out of the render loop.
+     */
+    class ThreadPool : public Singleton<ThreadPool> {
+    private:
+
+        // Singleton<ThreadPool> needs access to the constructor and destructor
+        friend class Singleton<ThreadPool>;
+
+        /** Spawn one worker per hardware thread */
+        ThreadPool();
+
+        /** Wait for queued tasks and join the workers */
+        virtual ~ThreadPool();
+
+    public:
+
+        /**
+         * Queue a task on the pool
+         * @param[in] task  Callable without arguments
+         * @return Future that becomes ready when the task is done
+         */
+        template <typename F>
+        std::future<std::invoke_result_t<F>> submit(F&& task);
+
+        /**
+         * Run body(i) for every i in [begin, end) splitting the range in chunks
+         * of `grain` elements. The calling thread takes part in the work, so it
+         * is safe to call this method from a pool task.
+         * @param[in] begin First index
+         * @param[in] end   One past the last index
+         * @param[in] grain Number of indices processed by a single task
+         * @param[in] body  Callable invoked as body(first, last) for every chunk
+         * @throws The first exception thrown by body, once every chunk is done
+         *         or skipped. Chunks not started yet are skipped.
+         */
+        void parallelFor(size_t begin, size_t end, size_t grain,
+                const std::function<void(size_t, size_t)>& body);
+
+        /** Get number of worker threads */
+        size_t size() const;
+
+    private:
+
+        /** Worker thread main loop */
+        void workerLoop();
+
+        std::vector<std::thread>            workers;    //!< Worker threads
+        std::queue<std::function<void()>>   tasks;      //!< Pending tasks
+        std::mutex                          mutex;      //!< Protects tasks and stopping
+        std::condition_variable             condition;  //!< Signals new tasks or stopping
+        bool                                stopping;   //!< Is the pool being destroyed?
+    };
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> ThreadPool::submit(F&& task) {
+        using R = std::invoke_result_t<F>;
+
+        // packaged_task is move only, std::function needs a copyable callable
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packaged->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packaged]() { (*packaged)(); });
+        }
+
+        condition.notify_one();
+        return result;
+    }
+}
+
+#endif //PATHTRACER_UTIL_THREADPOOL_H_
@@ -0,0 +1,179 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+// The parallel hierarchy build must not depend on how the pool schedules
+// it: builds a fixed cloud of spheres, large enough for the pool to bin
+// ranges and fork tasks, checks the shape of the tree and that every node
+// bounds what is below it, builds it again and compares both node for
+// node, and compares a fingerprint with the one of the sequential build
+// the parallel one replaced. Spatial splits must stay within their
+// duplication budget and keep every primitive, and without a budget must
+// build the tree of object splits only. Returns non zero if any check fails.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#include "../src/scene/Bvh.h"
+#include "../src/scene/Primitive.h"
+#include "../src/util/Hash.h"
+
+/**
+ * Spheres of varied size scattered in a cube, and long thin rods across it
+ * whose bounds overlap most spheres, like benchmarks/bvhbuild.cpp
+ */
+static std::vector<scene::Primitive> cloud(size_t count, size_t rods = 0) {
+    std::vector<scene::Primitive> primitives;
+    primitives.reserve(count + rods);
+
+    const float side = 2.0f * std::cbrt(float(count));
+    uint32_t h = 1;
+    auto next = [&h]() {
+        // xorshift32
+        h ^= h << 13;
+        h ^= h >> 17;
+        h ^= h << 5;
+        return float(h & 0xFFFFFF) / float(0xFFFFFF);
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3 center = side * (glm::vec3(next(), next(), next()) - 0.5f);
+        primitives.push_back(scene::makeSphere(uint32_t(i % 9), center, 0.1f + 0.9f * next()));
+    }
+
+    for (size_t i = 0; i < rods; ++i) {
+        const glm::vec3 center = 0.5f * side * (glm::vec3(next(), next(), next()) - 0.5f);
+        const glm::vec3 axis = glm::vec3(next(), next(), next()) - 0.5f;
+        primitives.push_back(scene::makeCylinder(uint32_t(i % 9), center, axis, 0.2f, 0.5f * side));
+    }
+    return primitives;
+}
+
+/** Hash of every node and index of a tree */
+static uint64_t fingerprint(const scene::Bvh& bvh) {
+    util::Hash hash;
+    for (const scene::Bvh::Node& node : bvh.getNodes()) {
+        hash.addValue(node.bounds.min);
+        hash.addValue(node.bounds.max);
+        hash.addValue(node.first);
+        hash.addValue(node.count);
+    }
+    for (uint32_t index : bvh.getIndices()) hash.addValue(index);
+    return hash.get();
+}
+
+/** Is a box inside another? */
+static bool contains(const scene::Aabb& outer, const scene::Aabb& inner) {
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+}
+
+/** Do two boxes overlap? */
+static bool overlaps(const scene::Aabb& a, const scene::Aabb& b) {
+    return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+}
+
+/**
+ * Check the shape of a tree: a binary tree within the depth and leaf size
+ * limits, every node bounding its children, and every leaf bounding its
+ * primitives, each listed once. Spatial splits list primitives more than
+ * once, and each leaf only bounds the part of them inside it.
+ * @param[in] spatial Were spatial splits allowed?
+ * @return Description of the first problem, empty if there is none
+ */
+static std::string checkTree(const scene::Bvh& bvh, const std::vector<scene::Primitive>& primitives,
+        bool spatial = false) {
+    const std::vector<scene::Bvh::Node>& nodes = bvh.getNodes();
+    const std::vector<uint32_t>& indices = bvh.getIndices();
+    if (nodes.empty()) return "empty tree";
+    if (bvh.getDepth() > scene::Bvh::MAX_DEPTH) return "too deep";
+
+    uint32_t leaves = 0;
+    std::vector<uint32_t> listed(primitives.size(), 0);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const scene::Bvh::Node& node = nodes[i];
+        if (node.count == 0) {
+            if (node.first <= i || node.first + 1 >= nodes.size()) return "child out of range";
+            if (!contains(node.bounds, nodes[node.first].bounds) || !contains(node.bounds, nodes[node.first + 1].bounds))
+                return "node doesn't bound its children";
+            continue;
+        }
+
+        ++leaves;
+        if (node.count > scene::Bvh::MAX_LEAF_SIZE) return "leaf too large";
+        if (node.first + node.count > indices.size()) return "leaf out of range";
+        for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+            scene::Aabb bounds;
+            if (indices[j] >= primitives.size() || !scene::primitiveBounds(primitives[indices[j]], 0.0f, bounds))
+                return "leaf lists an invalid primitive";
+            if (spatial ? !overlaps(node.bounds, bounds) : !contains(node.bounds, bounds))
+                return "leaf doesn't bound its primitives";
+            ++listed[indices[j]];
+        }
+    }
+
+    if (nodes.size() != 2 * size_t(leaves) - 1) return "not a binary tree";
+    for (uint32_t count : listed)
+        if (count == 0 || (count > 1 && !spatial)) return "primitive not listed exactly once";
+    return "";
+}
+
+int main() {
+    // The pool bins ranges of 64k primitives and forks nodes of 4096
+    const std::vector<scene::Primitive> spheres = cloud(100000);
+
+    // Node count and fingerprint of the sequential build of this cloud
+    const size_t SEQUENTIAL_NODES = 173549;
+    const uint64_t SEQUENTIAL_FINGERPRINT = 0x05a5be14e6badaa0ull;
+
+    int failures = 0;
+    auto expect = [&failures](const std::string& name, bool ok, const std::string& problem = "") {
+        std::cout << name << ": " << (ok ? "ok" : "failed") << (problem.empty() ? "" : ", " + problem) << std::endl;
+        if (!ok) ++failures;
+    };
+
+    const scene::Bvh bvh = scene::Bvh::build(spheres, 0.0f);
+    const std::string problem = checkTree(bvh, spheres);
+    expect("shape and bounds", problem.empty(), problem);
+    expect("node count", bvh.getNodes().size() == SEQUENTIAL_NODES,
+        std::to_string(bvh.getNodes().size()) + " nodes");
+
+    const scene::Bvh again = scene::Bvh::build(spheres, 0.0f);
+    expect("deterministic", fingerprint(again) == fingerprint(bvh));
+    expect("same as the sequential build", fingerprint(bvh) == SEQUENTIAL_FINGERPRINT);
+
+    // Spheres crossed by rods, whose overlapping bounds call for spatial splits
+    const std::vector<scene::Primitive> rods = cloud(20000, 200);
+    const uint64_t OBJECT_SPLIT_FINGERPRINT = 0x17bb5bc3d89abd8bull;
+
+    const scene::Bvh objectSplits = scene::Bvh::build(rods, 0.0f, 0.0f);
+    expect("no budget, same as object splits only", fingerprint(objectSplits) == OBJECT_SPLIT_FINGERPRINT &&
+        objectSplits.getIndices().size() == rods.size());
+
+    const float budget = 0.3f;
+    const scene::Bvh spatialSplits = scene::Bvh::build(rods, 0.0f, budget);
+    const std::string spatialProblem = checkTree(spatialSplits, rods, true);
+    const size_t references = spatialSplits.getIndices().size();
+    expect("spatial shape and bounds", spatialProblem.empty(), spatialProblem);
+    expect("references duplicated", references > rods.size(), std::to_string(references) + " references");
+    expect("duplication within budget", references <= rods.size() + size_t(float(rods.size()) * budget));
+    expect("spatial cost below object splits", spatialSplits.getCost() < objectSplits.getCost());
+    expect("spatial deterministic", fingerprint(scene::Bvh::build(rods, 0.0f, budget)) == fingerprint(spatialSplits));
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+//    Copyright(C) 2019, 2020 José María Cruz Lorite
+//
+//    This file is part of pathtracer.
+//
+//    pathtracer is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    pathtracer is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with pathtracer.  If not, see <https://www.gnu.org/licenses/>.
+
+// Resuming a checkpoint with other render settings must be rejected:
+// writes a checkpoint hashed with the kernel settings the way
+// PathTracer::sceneHash adds them, reads it back and checks it against the
+// same settings and with each of them changed. Settings that only change
+// how the image is computed must still resume. Returns non zero if any
+// check gives the wrong answer.
+
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include <filesystem>
+
+#include "../src/io/Checkpoint.h"
+#include "../src/pathtracer/KernelVariants.h"
+
+using pathtracer::KernelSettings;
+
+/** Hash of the kernel settings, the rest of the scene stays the same */
+static uint64_t settingsHash(const KernelSettings& settings) {
+    util::Hash hash;
+    settings.addImageSettings(hash);
+    return hash.get();
+}
+
+/** Does the checkpoint resume with these settings? */
+static bool resumes(const std::string& path, const io::Checkpoint& checkpoint, const KernelSettings& settings) {
+    try {
+        io::checkSceneHash(path, checkpoint, settingsHash(settings));
+        return true;
+    } catch (const io::CheckpointError&) {
+        return false;
+    }
+}
+
+int main() {
+    const std::string path = (std::filesystem::temp_directory_path() /
+        "pathtracer-checkpoint-test.ckpt").string();
+
+    const KernelSettings settings;
+
+    io::Checkpoint state;
+    state.width         = 2;
+    state.height        = 2;
+    state.numSamples    = 16;
+    state.sceneHash     = settingsHash(settings);
+    state.sums.assign(size_t(state.width) * state.height * 3, 1.0f);
+    io::writeCheckpoint(path, state);
+    const io::Checkpoint checkpoint = io::readCheckpoint(path);
+    std::remove(path.c_str());
+
+    int failures = 0;
+    auto expect = [&](const char* name, const KernelSettings& changed, bool expected) {
+        const bool resumed = resumes(path, checkpoint, changed);
+        std::cout << name << ": " << (resumed ? "resumed" : "rejected") << std::endl;
+        if (resumed != expected) ++failures;
+    };
+
+    expect("same settings", settings, true);
+
+    KernelSettings changed = settings;
+    changed.bounces += 1;
+    expect("bounces", changed, false);
+
+    changed = settings;
+    changed.aovs = pathtracer::AOV_ALBEDO;
+    expect("aovs", changed, false);
+
+    changed = settings;
+    changed.sampler = pathtracer::SAMPLER_KRONECKER;
+    expect("sampler", changed, false);
+
+    changed = settings;
+    changed.filter = pathtracer::FILTER_MITCHELL;
+    expect("filter", changed, false);
+
+    changed = settings;
+    changed.sdfSteps += 1;
+    expect("sdf steps", changed, false);
+
+    changed = settings;
+    changed.sort = true;
+    changed.compensated = true;
+    changed.tileCulling = true;
+    changed.bvh = pathtracer::BVH_WIDE;
+    expect("sorting, compensation, tile culling and bvh", changed, true);
+
+    return failures == 0 ? 0 : 1;
+}